@@ -0,0 +1,112 @@
+/**********************************************************************
+ Copyright (c) 2016 Advanced Micro Devices, Inc. All rights reserved.
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+ ********************************************************************/
+
+/**
+ \file clw_buffer_patcher.h
+ \brief Contains ClwBufferPatcher class used for partial GPU buffer updates.
+ */
+#pragma once
+
+#include "CLW.h"
+
+#include <map>
+#include <vector>
+
+namespace Baikal
+{
+    /**
+     \brief Accumulates individual records of a GPU buffer and writes them back.
+
+     Records are staged by their index within the buffer. On commit adjacent
+     records are coalesced, so each contiguous run of indices results in a
+     single buffer write instead of mapping and rewriting the whole buffer.
+     */
+    template <typename T> class ClwBufferPatcher
+    {
+    public:
+        // Get zero initialized staging storage for the record at index
+        T* Stage(std::size_t index);
+        // Check if there is anything to write
+        bool IsEmpty() const { return m_records.empty(); }
+        // Write staged records into the buffer and drop them
+        void Commit(CLWContext const& context, CLWBuffer<T> buffer);
+
+    private:
+        // Staged records sorted by index
+        std::map<std::size_t, T> m_records;
+        // Contiguous copy of the records, has to outlive the writes
+        std::vector<T> m_staging;
+    };
+
+    template <typename T>
+    inline
+    T* ClwBufferPatcher<T>::Stage(std::size_t index)
+    {
+        return &m_records[index];
+    }
+
+    template <typename T>
+    inline
+    void ClwBufferPatcher<T>::Commit(CLWContext const& context, CLWBuffer<T> buffer)
+    {
+        if (m_records.empty())
+        {
+            return;
+        }
+
+        m_staging.clear();
+        m_staging.reserve(m_records.size());
+
+        // Contiguous run of records to be written at once
+        struct Run
+        {
+            std::size_t index;
+            std::size_t offset;
+            std::size_t count;
+        };
+
+        std::vector<Run> runs;
+
+        for (auto& record : m_records)
+        {
+            if (runs.empty() || runs.back().index + runs.back().count != record.first)
+            {
+                runs.push_back({ record.first, m_staging.size(), 0 });
+            }
+
+            m_staging.push_back(record.second);
+            ++runs.back().count;
+        }
+
+        CLWEvent last_write;
+
+        for (auto& run : runs)
+        {
+            last_write = context.WriteBuffer(0, buffer, m_staging.data() + run.offset, run.index, run.count);
+        }
+
+        // Writes are executed in order, so waiting for the last one is enough
+        last_write.Wait();
+
+        m_records.clear();
+    }
+}
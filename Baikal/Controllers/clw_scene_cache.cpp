@@ -0,0 +1,376 @@
+#include "Controllers/clw_scene_cache.h"
+#include "SceneGraph/material.h"
+#include "SceneGraph/shape.h"
+#include "SceneGraph/texture.h"
+#include "SceneGraph/uberv2material.h"
+#include "Utils/log.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <random>
+#include <sstream>
+#include <typeinfo>
+
+namespace Baikal
+{
+    // Bump whenever on-disk layout or key derivation changes
+    std::uint32_t constexpr kSceneCacheVersion = 3;
+    char constexpr kGeometryCacheMagic[4] = { 'B', 'K', 'S', 'C' };
+    char constexpr kBlobCacheMagic[4] = { 'B', 'K', 'S', 'B' };
+
+    std::uint64_t constexpr kHashSeed = 0xcbf29ce484222325ull;
+    std::uint64_t constexpr kHashPrime = 0x100000001b3ull;
+
+    struct GeometryCacheHeader
+    {
+        char magic[4];
+        std::uint32_t version;
+        std::uint64_t key;
+        std::uint64_t num_vertices;
+        std::uint64_t num_normals;
+        std::uint64_t num_uvs;
+        std::uint64_t num_indices;
+        std::uint64_t num_ranges;
+    };
+
+    struct BlobCacheHeader
+    {
+        char magic[4];
+        std::uint32_t version;
+        std::uint64_t key;
+        std::uint64_t size;
+    };
+
+    // FNV-1a style hash, consuming 8 bytes per step
+    static std::uint64_t HashBytes(void const* data, std::size_t size, std::uint64_t hash)
+    {
+        auto bytes = static_cast<unsigned char const*>(data);
+
+        std::size_t i = 0;
+        for (; i + sizeof(std::uint64_t) <= size; i += sizeof(std::uint64_t))
+        {
+            std::uint64_t word;
+            std::memcpy(&word, bytes + i, sizeof(word));
+            hash = (hash ^ word) * kHashPrime;
+            hash ^= hash >> 29;
+        }
+
+        for (; i < size; ++i)
+        {
+            hash = (hash ^ bytes[i]) * kHashPrime;
+        }
+
+        return hash;
+    }
+
+    template <typename T>
+    static std::uint64_t HashValue(T const& value, std::uint64_t hash)
+    {
+        return HashBytes(&value, sizeof(T), hash);
+    }
+
+    template <typename T>
+    static bool ReadArray(std::istream& in, std::vector<T>& data, std::uint64_t count)
+    {
+        data.resize(static_cast<std::size_t>(count));
+        if (count)
+        {
+            in.read(reinterpret_cast<char*>(data.data()), count * sizeof(T));
+        }
+        return !in.fail();
+    }
+
+    template <typename T>
+    static void WriteArray(std::ostream& out, T const* data, std::size_t count)
+    {
+        if (count)
+        {
+            out.write(reinterpret_cast<char const*>(data), count * sizeof(T));
+        }
+    }
+
+    // Write into a unique temporary file first and then rename it,
+    // so concurrent readers never observe partially written entries.
+    static void WriteEntry(std::string const& file_name, std::function<void(std::ostream&)> write)
+    {
+        std::random_device rd;
+        std::ostringstream oss;
+        oss << file_name << ".tmp" << std::hex << rd();
+        auto tmp_file_name = oss.str();
+
+        {
+            std::ofstream out(tmp_file_name, std::ios::out | std::ios::binary);
+
+            if (!out)
+            {
+                LogError("Cannot open scene cache file for writing: ", tmp_file_name, "\n");
+                return;
+            }
+
+            write(out);
+
+            if (out.fail())
+            {
+                out.close();
+                std::remove(tmp_file_name.c_str());
+                LogError("Failed to write scene cache file: ", tmp_file_name, "\n");
+                return;
+            }
+        }
+
+        if (std::rename(tmp_file_name.c_str(), file_name.c_str()) != 0)
+        {
+            // Another process might have won the race, its entry is equally valid
+            std::remove(tmp_file_name.c_str());
+        }
+    }
+
+    ClwSceneCache::ClwSceneCache(std::string const& cache_path)
+        : m_cache_path(cache_path)
+    {
+    }
+
+    std::uint64_t ClwSceneCache::CombineKey(std::uint64_t key, std::uint64_t value)
+    {
+        return HashValue(value, key);
+    }
+
+    template <typename T>
+    static std::uint64_t HashArray(T const* data, std::size_t count, std::uint64_t hash)
+    {
+        hash = HashValue(static_cast<std::uint64_t>(count), hash);
+        return count ? HashBytes(data, count * sizeof(T), hash) : hash;
+    }
+
+    std::uint64_t ClwSceneCache::GetMeshKey(Mesh const& mesh) const
+    {
+        // Geometry version changes with every attribute update,
+        // transforms and materials do not affect cached arrays
+        auto iter = m_mesh_keys.find(mesh.GetId());
+        if (iter != m_mesh_keys.cend() && iter->second.revision == mesh.GetGeometryVersion())
+        {
+            return iter->second.key;
+        }
+
+        auto key = kHashSeed;
+        key = HashArray(mesh.GetNumVertices() ? mesh.GetVertices() : nullptr, mesh.GetNumVertices(), key);
+        key = HashArray(mesh.GetNumNormals() ? mesh.GetNormals() : nullptr, mesh.GetNumNormals(), key);
+        key = HashArray(mesh.GetNumUVs() ? mesh.GetUVs() : nullptr, mesh.GetNumUVs(), key);
+        key = HashArray(mesh.GetNumIndices() ? mesh.GetIndices() : nullptr, mesh.GetNumIndices(), key);
+
+        m_mesh_keys[mesh.GetId()] = { mesh.GetGeometryVersion(), key };
+        return key;
+    }
+
+    std::uint64_t ClwSceneCache::GetTextureKey(Texture const& texture) const
+    {
+        auto iter = m_texture_keys.find(texture.GetId());
+        if (iter != m_texture_keys.cend() && iter->second.revision == texture.GetRevision())
+        {
+            return iter->second.key;
+        }
+
+        auto size = texture.GetSize();
+        auto key = HashValue(static_cast<std::uint32_t>(texture.GetFormat()), kHashSeed);
+        key = HashValue(size.x, key);
+        key = HashValue(size.y, key);
+        key = HashValue(size.z, key);
+        key = HashArray(texture.GetData(), texture.GetData() ? texture.GetSizeInBytes() : 0, key);
+
+        m_texture_keys[texture.GetId()] = { texture.GetRevision(), key };
+        return key;
+    }
+
+    std::uint64_t ClwSceneCache::GetMaterialKey(Material const& material) const
+    {
+        // Material class and its own type selector go into the record
+        auto const& type_name = typeid(material).name();
+        auto key = HashBytes(type_name, std::strlen(type_name), kHashSeed);
+        key = HashValue(material.IsThin(), key);
+
+        if (auto single = dynamic_cast<SingleBxdf const*>(&material))
+        {
+            key = HashValue(static_cast<std::uint32_t>(single->GetBxdfType()), key);
+        }
+        else if (auto multi = dynamic_cast<MultiBxdf const*>(&material))
+        {
+            key = HashValue(static_cast<std::uint32_t>(multi->GetType()), key);
+        }
+        else if (auto uberv2 = dynamic_cast<UberV2Material const*>(&material))
+        {
+            key = HashValue(uberv2->GetLayers(), key);
+        }
+
+        // Input storage is unordered, so visit inputs by name
+        std::vector<Material::Input> inputs;
+        inputs.reserve(material.GetNumInputs());
+        for (std::uint32_t i = 0; i < material.GetNumInputs(); ++i)
+        {
+            inputs.push_back(material.GetInput(i));
+        }
+
+        std::sort(inputs.begin(), inputs.end(), [](Material::Input const& a, Material::Input const& b)
+        {
+            return a.info.name < b.info.name;
+        });
+
+        for (auto const& input : inputs)
+        {
+            auto const& value = input.value;
+
+            key = HashBytes(input.info.name.data(), input.info.name.size(), key);
+            key = HashValue(static_cast<std::uint32_t>(value.type), key);
+
+            switch (value.type)
+            {
+            case Material::InputType::kUint:
+                key = HashValue(value.uint_value, key);
+                break;
+            case Material::InputType::kFloat4:
+                key = HashValue(value.float_value, key);
+                break;
+            case Material::InputType::kTexture:
+                key = CombineKey(key, value.tex_value ? GetTextureKey(*value.tex_value) : 0);
+                break;
+            case Material::InputType::kMaterial:
+                key = CombineKey(key, value.mat_value ? GetMaterialKey(*value.mat_value) : 0);
+                break;
+            case Material::InputType::kInputMap:
+                // Records reference input maps by id, their graphs are compiled separately
+                key = CombineKey(key, value.input_map_value ? value.input_map_value->GetId() : ~0ull);
+                break;
+            }
+        }
+
+        return key;
+    }
+
+    std::uint64_t ClwSceneCache::GetGeometryKey(std::vector<std::uint64_t> mesh_keys)
+    {
+        // Shape traversal order is not stable between runs, so sort the keys
+        std::sort(mesh_keys.begin(), mesh_keys.end());
+
+        auto key = HashValue(static_cast<std::uint64_t>(mesh_keys.size()), kHashSeed);
+        return mesh_keys.empty() ? key : HashBytes(mesh_keys.data(), mesh_keys.size() * sizeof(std::uint64_t), key);
+    }
+
+    std::string ClwSceneCache::GetFileName(std::string const& kind, std::uint64_t key) const
+    {
+        std::ostringstream oss;
+        oss << m_cache_path << "/" << kind << "_" << std::hex << std::setw(16) << std::setfill('0') << key << ".bin";
+        return oss.str();
+    }
+
+    ClwSceneCache::Statistics ClwSceneCache::GetStatistics() const
+    {
+        return m_statistics;
+    }
+
+    bool ClwSceneCache::LoadGeometry(std::uint64_t geometry_key, Geometry& geometry) const
+    {
+        std::ifstream in(GetFileName("geometry", geometry_key), std::ios::in | std::ios::binary);
+
+        if (!in)
+        {
+            ++m_statistics.num_misses;
+            return false;
+        }
+
+        GeometryCacheHeader header;
+        in.read(reinterpret_cast<char*>(&header), sizeof(header));
+
+        if (in.fail() ||
+            std::memcmp(header.magic, kGeometryCacheMagic, sizeof(kGeometryCacheMagic)) != 0 ||
+            header.version != kSceneCacheVersion ||
+            header.key != geometry_key)
+        {
+            LogInfo("Ignoring stale geometry cache entry\n");
+            ++m_statistics.num_misses;
+            return false;
+        }
+
+        if (!ReadArray(in, geometry.ranges, header.num_ranges) ||
+            !ReadArray(in, geometry.vertices, header.num_vertices) ||
+            !ReadArray(in, geometry.normals, header.num_normals) ||
+            !ReadArray(in, geometry.uvs, header.num_uvs) ||
+            !ReadArray(in, geometry.indices, header.num_indices))
+        {
+            LogInfo("Ignoring truncated geometry cache entry\n");
+            ++m_statistics.num_misses;
+            return false;
+        }
+
+        ++m_statistics.num_hits;
+        return true;
+    }
+
+    void ClwSceneCache::SaveGeometry(std::uint64_t geometry_key, GeometryView const& geometry) const
+    {
+        WriteEntry(GetFileName("geometry", geometry_key), [&](std::ostream& out)
+        {
+            GeometryCacheHeader header;
+            std::memcpy(header.magic, kGeometryCacheMagic, sizeof(kGeometryCacheMagic));
+            header.version = kSceneCacheVersion;
+            header.key = geometry_key;
+            header.num_vertices = geometry.num_vertices;
+            header.num_normals = geometry.num_normals;
+            header.num_uvs = geometry.num_uvs;
+            header.num_indices = geometry.num_indices;
+            header.num_ranges = geometry.ranges->size();
+
+            out.write(reinterpret_cast<char const*>(&header), sizeof(header));
+            WriteArray(out, geometry.ranges->data(), geometry.ranges->size());
+            WriteArray(out, geometry.vertices, geometry.num_vertices);
+            WriteArray(out, geometry.normals, geometry.num_normals);
+            WriteArray(out, geometry.uvs, geometry.num_uvs);
+            WriteArray(out, geometry.indices, geometry.num_indices);
+        });
+    }
+
+    bool ClwSceneCache::LoadBlob(std::string const& kind, std::uint64_t key, std::vector<char>& data) const
+    {
+        std::ifstream in(GetFileName(kind, key), std::ios::in | std::ios::binary);
+
+        if (!in)
+        {
+            ++m_statistics.num_misses;
+            return false;
+        }
+
+        BlobCacheHeader header;
+        in.read(reinterpret_cast<char*>(&header), sizeof(header));
+
+        if (in.fail() ||
+            std::memcmp(header.magic, kBlobCacheMagic, sizeof(kBlobCacheMagic)) != 0 ||
+            header.version != kSceneCacheVersion ||
+            header.key != key ||
+            !ReadArray(in, data, header.size))
+        {
+            LogInfo("Ignoring stale ", kind, " cache entry\n");
+            ++m_statistics.num_misses;
+            return false;
+        }
+
+        ++m_statistics.num_hits;
+        return true;
+    }
+
+    void ClwSceneCache::SaveBlob(std::string const& kind, std::uint64_t key, void const* data, std::size_t size) const
+    {
+        WriteEntry(GetFileName(kind, key), [&](std::ostream& out)
+        {
+            BlobCacheHeader header;
+            std::memcpy(header.magic, kBlobCacheMagic, sizeof(kBlobCacheMagic));
+            header.version = kSceneCacheVersion;
+            header.key = key;
+            header.size = size;
+
+            out.write(reinterpret_cast<char const*>(&header), sizeof(header));
+            WriteArray(out, static_cast<char const*>(data), size);
+        });
+    }
+}
@@ -0,0 +1,147 @@
+/**********************************************************************
+ Copyright (c) 2016 Advanced Micro Devices, Inc. All rights reserved.
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+ ********************************************************************/
+
+
+/**
+ \file clw_scene_cache.h
+ \brief Contains ClwSceneCache class declaration.
+ */
+#pragma once
+
+#include "math/float2.h"
+#include "math/float3.h"
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace Baikal
+{
+    class Material;
+    class Mesh;
+    class Texture;
+
+    /**
+     \brief Persistent on-disk cache for compiled scene data.
+
+     ClwSceneController serializes mesh data into a set of flat vertex, normal, uv and
+     index arrays. ClwSceneCache stores these arrays on disk together with the per-mesh
+     layout, so the next process compiling the same geometry can upload them in bulk
+     instead of gathering mesh by mesh. Serialized material records and the texture pool
+     are stored as opaque blobs next to geometry.
+
+     Entries are keyed by a hash of their content: vertex, normal, uv and index buffers,
+     material inputs and texel data, so an edited or different asset never hits a stale
+     entry no matter how the scene is loaded. Content keys are remembered per object and
+     only recomputed once the object changes, so unchanged data is hashed once per process.
+     */
+    class ClwSceneCache
+    {
+    public:
+        // Location of a single mesh within flattened geometry arrays
+        struct MeshRange
+        {
+            std::uint64_t key;
+            std::uint32_t start_vertex;
+            std::uint32_t start_normal;
+            std::uint32_t start_uv;
+            std::uint32_t start_index;
+        };
+
+        // Flattened geometry arrays
+        struct Geometry
+        {
+            std::vector<RadeonRays::float3> vertices;
+            std::vector<RadeonRays::float3> normals;
+            std::vector<RadeonRays::float2> uvs;
+            std::vector<std::uint32_t> indices;
+            std::vector<MeshRange> ranges;
+        };
+
+        // Geometry arrays view (used to save mapped GPU memory)
+        struct GeometryView
+        {
+            RadeonRays::float3 const* vertices;
+            std::size_t num_vertices;
+            RadeonRays::float3 const* normals;
+            std::size_t num_normals;
+            RadeonRays::float2 const* uvs;
+            std::size_t num_uvs;
+            std::uint32_t const* indices;
+            std::size_t num_indices;
+            std::vector<MeshRange> const* ranges;
+        };
+
+        // Number of lookups served from disk and missed since construction
+        struct Statistics
+        {
+            std::uint32_t num_hits = 0;
+            std::uint32_t num_misses = 0;
+        };
+
+        // Constructor
+        explicit ClwSceneCache(std::string const& cache_path);
+
+        // Key of a mesh built from its vertex, normal, uv and index buffers
+        std::uint64_t GetMeshKey(Mesh const& mesh) const;
+        // Key of a texture built from its format, size and texels
+        std::uint64_t GetTextureKey(Texture const& texture) const;
+        // Key of a material built from its type and inputs, plugged materials and textures are keyed by content
+        std::uint64_t GetMaterialKey(Material const& material) const;
+        // Accumulate a plain value into a key
+        static std::uint64_t CombineKey(std::uint64_t key, std::uint64_t value);
+        // Order-independent key of a set of meshes
+        static std::uint64_t GetGeometryKey(std::vector<std::uint64_t> mesh_keys);
+
+        // Load geometry for a given key, returns false if there is no valid entry
+        bool LoadGeometry(std::uint64_t geometry_key, Geometry& geometry) const;
+        // Save geometry for a given key, the entry is written atomically
+        void SaveGeometry(std::uint64_t geometry_key, GeometryView const& geometry) const;
+
+        // Load a blob of a given kind ("materials", "textures", ...), returns false if there is no valid entry
+        bool LoadBlob(std::string const& kind, std::uint64_t key, std::vector<char>& data) const;
+        // Save a blob of a given kind, the entry is written atomically
+        void SaveBlob(std::string const& kind, std::uint64_t key, void const* data, std::size_t size) const;
+
+        // Get cache folder path
+        std::string const& GetCachePath() const { return m_cache_path; }
+        // Get hit and miss counts
+        Statistics GetStatistics() const;
+
+    private:
+        std::string GetFileName(std::string const& kind, std::uint64_t key) const;
+
+        // Content key of an object along with the geometry version or revision it was computed for
+        struct ContentKey
+        {
+            std::uint32_t revision;
+            std::uint64_t key;
+        };
+
+        std::string m_cache_path;
+        mutable Statistics m_statistics;
+        // Content keys by object id
+        mutable std::unordered_map<std::uint32_t, ContentKey> m_mesh_keys;
+        mutable std::unordered_map<std::uint32_t, ContentKey> m_texture_keys;
+    };
+}
@@ -1,4 +1,9 @@
 #include "Controllers/clw_scene_controller.h"
+#include "Controllers/clw_scene_cache.h"
+#include "Controllers/clw_buffer_patcher.h"
+#include "Controllers/clw_texture_format.h"
+#include "Controllers/clw_texture_streamer.h"
+#include "Controllers/clw_vertex_format.h"
 #include "SceneGraph/scene1.h"
 #include "SceneGraph/camera.h"
 #include "SceneGraph/light.h"
@@ -10,21 +15,36 @@
 #include "SceneGraph/uberv2material.h"
 #include "SceneGraph/inputmaps.h"
 #include "Utils/distribution1d.h"
+#include "Utils/light_bvh.h"
+#include "Utils/half.h"
+#include "math/mathutils.h"
 #include "Utils/log.h"
+#include "Utils/cl_inputmap_compiler.h"
 #include "Utils/cl_inputmap_generator.h"
 #include "Utils/cl_program_manager.h"
+#include "Utils/thread_pool.h"
 
 
 #include <chrono>
+#include <cmath>
+#include <cstring>
 #include <memory>
 #include <stack>
 #include <vector>
 #include <array>
+#include <algorithm>
+#include <numeric>
+#include <set>
+#include <unordered_map>
 
 using namespace RadeonRays;
 
 namespace Baikal
 {
+    // Maximum resolution of environment light importance sampling distribution
+    static const int kMaxEnvDistributionWidth = 512;
+    static const int kMaxEnvDistributionHeight = 256;
+
     static std::size_t align16(std::size_t value)
     {
         return (value + 0xF) / 0x10 * 0x10;
@@ -55,6 +75,11 @@ namespace Baikal
     , m_context(context)
     , m_api(api)
     , m_program_manager(program_manager)
+    , m_thread_pool(new ThreadPool())
+    , m_half_float_textures(false)
+    , m_compact_vertices(false)
+    , m_tile_pool_size(0)
+    , m_intersector_dirty(false)
     {
         auto acc_type = "fatbvh";
         auto builder_type = "sah";
@@ -78,6 +103,64 @@ namespace Baikal
     {
     }
 
+    void ClwSceneController::SetHalfFloatTexturesEnabled(bool enabled)
+    {
+        m_half_float_textures = enabled;
+    }
+
+    void ClwSceneController::SetCompactVertexFormatEnabled(bool enabled)
+    {
+        m_compact_vertices = enabled;
+    }
+
+    void ClwSceneController::SetTextureStreamingEnabled(bool enabled, std::size_t tile_pool_size)
+    {
+        m_tile_pool_size = enabled ? tile_pool_size : 0;
+    }
+
+    void ClwSceneController::SetSceneCachePath(std::string const& cache_path)
+    {
+        if (cache_path.empty())
+        {
+            m_scene_cache.reset();
+        }
+        else
+        {
+            m_scene_cache.reset(new ClwSceneCache(cache_path));
+        }
+    }
+
+    ClwSceneCache::Statistics ClwSceneController::GetSceneCacheStatistics() const
+    {
+        return m_scene_cache ? m_scene_cache->GetStatistics() : ClwSceneCache::Statistics();
+    }
+
+    std::uint64_t ClwSceneController::GetCollectorKey(Collector const& collector, std::uint64_t key) const
+    {
+        auto iter = collector.CreateIterator();
+
+        for (; iter->IsValid(); iter->Next())
+        {
+            auto item = iter->Item();
+
+            if (auto material = std::dynamic_pointer_cast<Material>(item))
+            {
+                key = ClwSceneCache::CombineKey(key, m_scene_cache->GetMaterialKey(*material));
+            }
+            else if (auto texture = std::dynamic_pointer_cast<Texture>(item))
+            {
+                key = ClwSceneCache::CombineKey(key, m_scene_cache->GetTextureKey(*texture));
+            }
+            else
+            {
+                //Shouldn't happen
+                assert(false);
+            }
+        }
+
+        return key;
+    }
+
     static void SplitMeshesAndInstances(Iterator& shape_iter, std::set<Mesh::Ptr>& meshes, std::set<Instance::Ptr>& instances, std::set<Mesh::Ptr>& excluded_meshes)
     {
         // Clear all sets
@@ -163,23 +246,45 @@ namespace Baikal
         return -1;
     }
 
-    void ClwSceneController::UpdateIntersector(Scene1 const& scene, ClwScene& out) const
+    // Indices of all shapes at once, same as GetShapeIdx gives
+    static std::unordered_map<Shape const*, int> GetShapeIndices(Iterator& shape_iter)
     {
-        // Detach and delete all shapes
-        for (auto& shape : out.isect_shapes)
+        std::set<Mesh::Ptr> meshes;
+        std::set<Mesh::Ptr> excluded_meshes;
+        std::set<Instance::Ptr> instances;
+        SplitMeshesAndInstances(shape_iter, meshes, instances, excluded_meshes);
+
+        std::unordered_map<Shape const*, int> indices;
+
+        for (auto& i : meshes)
+        {
+            indices.emplace(i.get(), static_cast<int>(indices.size()));
+        }
+
+        for (auto& i : excluded_meshes)
+        {
+            indices.emplace(i.get(), static_cast<int>(indices.size()));
+        }
+
+        for (auto& i : instances)
         {
-            m_api->DetachShape(shape);
-            m_api->DeleteShape(shape);
+            indices.emplace(i.get(), static_cast<int>(indices.size()));
         }
 
-        // Clear shapes cache
+        return indices;
+    }
+
+    void ClwSceneController::UpdateIntersector(Scene1 const& scene, ClwScene& out) const
+    {
+        // Shape IDs follow shape buffer order, so the lists are rebuilt,
+        // but intersector shapes are only created for added or modified
+        // meshes and deleted for removed ones.
         out.isect_shapes.clear();
         // Only visible shapes are attached to the API.
         // So excluded meshes are pushed into isect_shapes, but
         // not to visible_shapes.
         out.visible_shapes.clear();
 
-        // Create new shapes
         auto shape_iter = scene.CreateShapeIterator();
 
         if (!shape_iter->IsValid())
@@ -195,16 +300,23 @@ namespace Baikal
         std::set<Instance::Ptr> instances;
         SplitMeshesAndInstances(*shape_iter, meshes, instances, excluded_meshes);
 
-        // Keep shape->rr shape association for
-        // instance base shape lookup.
-        std::map<Shape::Ptr, RadeonRays::Shape*> rr_shapes;
+        // Entries still in use are moved here, the rest is deleted afterwards
+        std::map<Shape::Ptr, ClwScene::IntersectorShape> isect_shape_map;
 
-        // Start from ID 1
-        // Handle meshes
-        int id = 1;
-        for (auto& iter : meshes)
+        std::size_t num_created = 0;
+
+        auto get_mesh_shape = [&](Mesh::Ptr const& mesh) -> RadeonRays::Shape*
         {
-            auto mesh = iter;
+            auto iter = out.isect_shape_map.find(mesh);
+
+            if (iter != out.isect_shape_map.cend() &&
+                iter->second.geometry_version == mesh->GetGeometryVersion())
+            {
+                auto shape = iter->second.shape;
+                isect_shape_map.insert(*iter);
+                out.isect_shape_map.erase(iter);
+                return shape;
+            }
 
             auto shape = m_api->CreateMesh(
                                            // Vertices starting from the first one
@@ -223,51 +335,58 @@ namespace Baikal
                                            static_cast<int>(mesh->GetNumIndices() / 3)
                                            );
 
+            isect_shape_map[mesh] = { shape, nullptr, mesh->GetGeometryVersion() };
+            ++num_created;
+            return shape;
+        };
+
+        // Start from ID 1
+        // Handle meshes
+        int id = 1;
+        for (auto& mesh : meshes)
+        {
+            auto shape = get_mesh_shape(mesh);
+
             auto transform = mesh->GetTransform();
             shape->SetTransform(transform, inverse(transform));
             shape->SetId(id++);
-            shape->SetMask(iter->GetVisibilityMask());
+            shape->SetMask(mesh->GetVisibilityMask());
 
             out.isect_shapes.push_back(shape);
             out.visible_shapes.push_back(shape);
-            rr_shapes[mesh] = shape;
         }
 
         // Handle excluded meshes
-        for (auto& iter : excluded_meshes)
+        for (auto& mesh : excluded_meshes)
         {
-            auto mesh = iter;
-
-            auto shape = m_api->CreateMesh(
-                                           // Vertices starting from the first one
-                                           (float*)mesh->GetVertices(),
-                                           // Number of vertices
-                                           static_cast<int>(mesh->GetNumVertices()),
-                                           // Stride
-                                           sizeof(float3),
-                                           // TODO: make API signature const
-                                           reinterpret_cast<int const*>(mesh->GetIndices()),
-                                           // Index stride
-                                           0,
-                                           // All triangles
-                                           nullptr,
-                                           // Number of primitives
-                                           static_cast<int>(mesh->GetNumIndices() / 3)
-                                           );
+            auto shape = get_mesh_shape(mesh);
 
             auto transform = mesh->GetTransform();
             shape->SetTransform(transform, inverse(transform));
             shape->SetId(id++);
             out.isect_shapes.push_back(shape);
-            rr_shapes[mesh] = shape;
         }
 
         // Handle instances
-        for (auto& iter: instances)
+        for (auto& instance : instances)
         {
-            auto instance = iter;
-            auto rr_mesh = rr_shapes[instance->GetBaseShape()];
-            auto shape = m_api->CreateInstance(rr_mesh);
+            auto rr_mesh = isect_shape_map.at(instance->GetBaseShape()).shape;
+
+            RadeonRays::Shape* shape = nullptr;
+            auto iter = out.isect_shape_map.find(instance);
+
+            if (iter != out.isect_shape_map.cend() && iter->second.base_shape == rr_mesh)
+            {
+                shape = iter->second.shape;
+                isect_shape_map.insert(*iter);
+                out.isect_shape_map.erase(iter);
+            }
+            else
+            {
+                shape = m_api->CreateInstance(rr_mesh);
+                isect_shape_map[instance] = { shape, rr_mesh, 0 };
+                ++num_created;
+            }
 
             auto transform = instance->GetTransform();
             shape->SetTransform(transform, inverse(transform));
@@ -275,57 +394,56 @@ namespace Baikal
             out.isect_shapes.push_back(shape);
             out.visible_shapes.push_back(shape);
         }
-    }
 
-    void ClwSceneController::UpdateIntersectorTransforms(Scene1 const& scene, ClwScene& out) const
-    {
-        // Create new shapes
-        auto shape_iter = scene.CreateShapeIterator();
+        // Delete shapes which are gone or have been recreated,
+        // instances first as they might reference deleted meshes.
+        auto num_deleted = out.isect_shape_map.size();
 
-        if (!shape_iter->IsValid())
+        for (auto pass = 0; pass < 2; ++pass)
         {
-            throw std::runtime_error("No shapes in the scene");
+            for (auto& entry : out.isect_shape_map)
+            {
+                bool is_instance = entry.second.base_shape != nullptr;
+
+                if (is_instance == (pass == 0))
+                {
+                    m_api->DetachShape(entry.second.shape);
+                    m_api->DeleteShape(entry.second.shape);
+                }
+            }
         }
 
-        // Split all shapes into meshes and instances sets.
-        std::set<Mesh::Ptr> meshes;
-        // Excluded shapes are shapes which are not in the scene,
-        // but references by at least one instance.
-        std::set<Mesh::Ptr> excluded_meshes;
-        std::set<Instance::Ptr> instances;
-        SplitMeshesAndInstances(*shape_iter, meshes, instances, excluded_meshes);
+        out.isect_shape_map.swap(isect_shape_map);
 
-        auto rr_iter = out.isect_shapes.begin();
+        LogInfo("Intersector shapes: ", num_created, " created, ", num_deleted, " deleted, ",
+                out.isect_shapes.size() - num_created, " reused\n");
+    }
 
-        // Start from ID 1
-        // Handle meshes
-        for (auto& iter : meshes)
+    void ClwSceneController::UpdateIntersectorTransforms(std::vector<Shape::Ptr> const& shapes, ClwScene& out) const
+    {
+        // Refit changed shapes only, geometry and shape IDs stay the same
+        for (auto& shape : shapes)
         {
-            auto mesh = iter;
-            auto transform = mesh->GetTransform();
-            (*rr_iter)->SetTransform(transform, inverse(transform));
-            ++rr_iter;
-        }
+            auto iter = out.isect_shape_map.find(shape);
 
-        // Handle excluded meshes
-        for (auto& iter : excluded_meshes)
-        {
-            auto mesh = iter;
-            auto transform = mesh->GetTransform();
-            (*rr_iter)->SetTransform(transform, inverse(transform));
-            ++rr_iter;
-        }
+            if (iter == out.isect_shape_map.cend())
+            {
+                continue;
+            }
 
-        // Handle instances
-        for (auto& iter : instances)
-        {
-            auto instance = iter;
-            auto transform = instance->GetTransform();
-            (*rr_iter)->SetTransform(transform, inverse(transform));
-            ++rr_iter;
+            auto rr_shape = iter->second.shape;
+            auto transform = shape->GetTransform();
+            rr_shape->SetTransform(transform, inverse(transform));
+
+            // Instances do not carry their own mask
+            if (!iter->second.base_shape)
+            {
+                rr_shape->SetMask(shape->GetVisibilityMask());
+            }
         }
 
-        m_api->Commit();
+        // Committed once by CommitUpdates along with other intersector changes
+        m_intersector_dirty = true;
     }
 
     void ClwSceneController::UpdateCamera(Scene1 const& scene, Collector& mat_collector, Collector& tex_collector, Collector& vol_collector, ClwScene& out) const
@@ -375,17 +493,19 @@ namespace Baikal
 
     void ClwSceneController::UpdateShapes(Scene1 const& scene, Collector& mat_collector, Collector& tex_collector, Collector& vol_collector, ClwScene& out) const
     {
+        using clock = std::chrono::high_resolution_clock;
+        auto elapsed_ms = [](clock::time_point start)
+        {
+            return std::chrono::duration_cast<std::chrono::milliseconds>(clock::now() - start).count();
+        };
+
+        auto layout_start = clock::now();
+
         std::size_t num_vertices = 0;
         std::size_t num_normals = 0;
         std::size_t num_uvs = 0;
         std::size_t num_indices = 0;
 
-        std::size_t num_vertices_written = 0;
-        std::size_t num_normals_written = 0;
-        std::size_t num_uvs_written = 0;
-        std::size_t num_indices_written = 0;
-        std::size_t num_shapes_written = 0;
-
         auto shape_iter = scene.CreateShapeIterator();
 
         // Sort shapes into meshes and instances sets.
@@ -396,12 +516,22 @@ namespace Baikal
         std::set<Instance::Ptr> instances;
         SplitMeshesAndInstances(*shape_iter, meshes, instances, excluded_meshes);
 
-        // Calculate GPU array sizes. Do that only for meshes,
-        // since instances do not occupy space in vertex buffers.
-        // However instances still have their own material ids.
-        for (auto& iter : meshes)
+        // Meshes and excluded meshes occupy space in vertex buffers
+        // in this order. Instances only occupy material IDs space.
+        std::vector<Mesh::Ptr> buffer_meshes(meshes.cbegin(), meshes.cend());
+        buffer_meshes.insert(buffer_meshes.end(), excluded_meshes.cbegin(), excluded_meshes.cend());
+
+        // Calculate GPU array sizes and mesh offsets within them.
+        std::vector<ClwSceneCache::MeshRange> mesh_ranges(buffer_meshes.size());
+        for (auto i = 0u; i < buffer_meshes.size(); ++i)
         {
-            auto mesh = iter;
+            auto& mesh = buffer_meshes[i];
+
+            mesh_ranges[i].key = 0;
+            mesh_ranges[i].start_vertex = static_cast<std::uint32_t>(num_vertices);
+            mesh_ranges[i].start_normal = static_cast<std::uint32_t>(num_normals);
+            mesh_ranges[i].start_uv = static_cast<std::uint32_t>(num_uvs);
+            mesh_ranges[i].start_index = static_cast<std::uint32_t>(num_indices);
 
             num_vertices += mesh->GetNumVertices();
             num_normals += mesh->GetNumNormals();
@@ -409,203 +539,336 @@ namespace Baikal
             num_indices += mesh->GetNumIndices();
         }
 
-        // Excluded meshes still occupy space in vertex buffers.
-        for (auto& iter : excluded_meshes)
+        LogInfo("Shape layout: ", elapsed_ms(layout_start), " ms\n");
+
+        // Try persistent geometry cache first, keys hash mesh content once
+        // per geometry version, so unchanged meshes are not rehashed
+        std::uint64_t geometry_key = 0;
+        ClwSceneCache::Geometry cached_geometry;
+        bool geometry_cached = false;
+
+        if (m_scene_cache)
         {
-            auto mesh = iter;
+            std::vector<std::uint64_t> mesh_keys(buffer_meshes.size());
+            for (auto i = 0u; i < buffer_meshes.size(); ++i)
+            {
+                mesh_keys[i] = m_scene_cache->GetMeshKey(*buffer_meshes[i]);
+                mesh_ranges[i].key = mesh_keys[i];
+            }
 
-            num_vertices += mesh->GetNumVertices();
-            num_normals += mesh->GetNumNormals();
-            num_uvs += mesh->GetNumUVs();
-            num_indices += mesh->GetNumIndices();
+            geometry_key = ClwSceneCache::GetGeometryKey(mesh_keys);
+
+            if (m_scene_cache->LoadGeometry(geometry_key, cached_geometry) &&
+                cached_geometry.vertices.size() == num_vertices &&
+                cached_geometry.normals.size() == num_normals &&
+                cached_geometry.uvs.size() == num_uvs &&
+                cached_geometry.indices.size() == num_indices &&
+                cached_geometry.ranges.size() == mesh_ranges.size())
+            {
+                // Cached layout might differ from current traversal order,
+                // so remap mesh ranges by key.
+                std::unordered_map<std::uint64_t, ClwSceneCache::MeshRange> cached_ranges;
+                for (auto& range : cached_geometry.ranges)
+                {
+                    cached_ranges.emplace(range.key, range);
+                }
+
+                std::vector<ClwSceneCache::MeshRange> cached_layout;
+                cached_layout.reserve(mesh_ranges.size());
+
+                for (auto& range : mesh_ranges)
+                {
+                    auto iter = cached_ranges.find(range.key);
+
+                    if (iter == cached_ranges.cend())
+                    {
+                        break;
+                    }
+
+                    cached_layout.push_back(iter->second);
+                }
+
+                if (cached_layout.size() == mesh_ranges.size())
+                {
+                    mesh_ranges.swap(cached_layout);
+                    geometry_cached = true;
+                    LogInfo("Loaded geometry from cache\n");
+                }
+            }
         }
 
-        // Instances only occupy material IDs space.
-        for (auto& iter : instances)
+        auto format = m_compact_vertices ? ClwScene::VERTEX_FORMAT_COMPACT : ClwScene::VERTEX_FORMAT_FLOAT;
+
+        // Tiled or atlas UVs far from the origin lose too much precision in half
+        if (format == ClwScene::VERTEX_FORMAT_COMPACT)
         {
-            auto instance = iter;
-            auto mesh = std::static_pointer_cast<Mesh>(instance->GetBaseShape());
+            bool half_uvs = geometry_cached ?
+                CanStoreHalfUVs(cached_geometry.uvs.data(), cached_geometry.uvs.size()) :
+                std::all_of(buffer_meshes.cbegin(), buffer_meshes.cend(), [](Mesh::Ptr const& mesh)
+                {
+                    return CanStoreHalfUVs(mesh->GetUVs(), mesh->GetNumUVs());
+                });
+
+            if (!half_uvs)
+            {
+                LogInfo("UVs out of half range, storing them as float\n");
+                format = ClwScene::VERTEX_FORMAT_COMPACT_FLOAT_UV;
+            }
         }
+        out.vertex_format = format;
 
         LogInfo("Creating vertex buffer...\n");
         // Create CL arrays
-        out.vertices = m_context.CreateBuffer<float3>(num_vertices, CL_MEM_READ_ONLY);
+        out.vertices = m_context.CreateBuffer<char>(num_vertices * GetPositionSize(format), CL_MEM_READ_ONLY);
 
         LogInfo("Creating normal buffer...\n");
-        out.normals = m_context.CreateBuffer<float3>(num_normals, CL_MEM_READ_ONLY);
+        out.normals = m_context.CreateBuffer<char>(num_normals * GetNormalSize(format), CL_MEM_READ_ONLY);
 
         LogInfo("Creating UV buffer...\n");
-        out.uvs = m_context.CreateBuffer<float2>(num_uvs, CL_MEM_READ_ONLY);
+        out.uvs = m_context.CreateBuffer<char>(num_uvs * GetUVSize(format), CL_MEM_READ_ONLY);
 
         LogInfo("Creating index buffer...\n");
         out.indices = m_context.CreateBuffer<int>(num_indices, CL_MEM_READ_ONLY);
 
-        // Total number of entries in shapes GPU array
-        auto num_shapes = meshes.size() + excluded_meshes.size() + instances.size();
-        out.shapes = m_context.CreateBuffer<ClwScene::Shape>(num_shapes, CL_MEM_READ_ONLY);
-
-        float3* vertices = nullptr;
-        float3* normals = nullptr;
-        float2* uvs = nullptr;
+        char* vertices = nullptr;
+        char* normals = nullptr;
+        char* uvs = nullptr;
         int* indices = nullptr;
-        ClwScene::Shape* shapes = nullptr;
 
         // Map arrays and prepare to write data
         LogInfo("Mapping buffers...\n");
         m_context.MapBuffer(0, out.vertices, CL_MAP_WRITE, &vertices);
         m_context.MapBuffer(0, out.normals, CL_MAP_WRITE, &normals);
         m_context.MapBuffer(0, out.uvs, CL_MAP_WRITE, &uvs);
-        m_context.MapBuffer(0, out.indices, CL_MAP_WRITE, &indices);
-        m_context.MapBuffer(0, out.shapes, CL_MAP_WRITE, &shapes).Wait();
+        m_context.MapBuffer(0, out.indices, CL_MAP_WRITE, &indices).Wait();
 
-        // Keep associated shapes data for instance look up.
-        // We retrieve data from here while serializing instances,
-        // using base shape lookup.
-        std::map<Mesh::Ptr, ClwScene::Shape> shape_data;
+        auto copy_start = clock::now();
 
-        // Handle meshes
-        //int shape_id = 0;
-        for (auto& iter : meshes)
+        // Offsets are known upfront, so every attribute array is split into
+        // fixed size chunks which are encoded independently.
+        enum class Stream
         {
-            auto mesh = iter;
+            kVertices,
+            kNormals,
+            kUVs,
+            kIndices
+        };
 
-            // Get pointers data
-            auto mesh_vertex_array = mesh->GetVertices();
-            auto mesh_num_vertices = mesh->GetNumVertices();
+        struct CopyChunk
+        {
+            Stream stream;
+            void const* src;
+            std::size_t dst_offset;
+            std::size_t count;
+        };
 
-            auto mesh_normal_array = mesh->GetNormals();
-            auto mesh_num_normals = mesh->GetNumNormals();
+        static std::size_t constexpr kCopyChunkSize = 1 << 16;
 
-            auto mesh_uv_array = mesh->GetUVs();
-            auto mesh_num_uvs = mesh->GetNumUVs();
+        std::vector<CopyChunk> chunks;
+        auto add_chunks = [&chunks](Stream stream, void const* src, std::size_t element_size, std::size_t dst_offset, std::size_t count)
+        {
+            for (std::size_t offset = 0; offset < count; offset += kCopyChunkSize)
+            {
+                chunks.push_back({
+                    stream,
+                    static_cast<char const*>(src) + offset * element_size,
+                    dst_offset + offset,
+                    std::min(kCopyChunkSize, count - offset) });
+            }
+        };
 
-            auto mesh_index_array = mesh->GetIndices();
-            auto mesh_num_indices = mesh->GetNumIndices();
+        if (geometry_cached)
+        {
+            // Cached arrays are already laid out according to mesh_ranges
+            add_chunks(Stream::kVertices, cached_geometry.vertices.data(), sizeof(float3), 0, num_vertices);
+            add_chunks(Stream::kNormals, cached_geometry.normals.data(), sizeof(float3), 0, num_normals);
+            add_chunks(Stream::kUVs, cached_geometry.uvs.data(), sizeof(float2), 0, num_uvs);
+            add_chunks(Stream::kIndices, cached_geometry.indices.data(), sizeof(int), 0, num_indices);
+        }
+        else
+        {
+            for (auto i = 0u; i < buffer_meshes.size(); ++i)
+            {
+                auto& mesh = buffer_meshes[i];
+                auto& range = mesh_ranges[i];
 
-            // Prepare shape descriptor
-            ClwScene::Shape shape;
+                add_chunks(Stream::kVertices, mesh->GetVertices(), sizeof(float3), range.start_vertex, mesh->GetNumVertices());
+                add_chunks(Stream::kNormals, mesh->GetNormals(), sizeof(float3), range.start_normal, mesh->GetNumNormals());
+                add_chunks(Stream::kUVs, mesh->GetUVs(), sizeof(float2), range.start_uv, mesh->GetNumUVs());
+                add_chunks(Stream::kIndices, mesh->GetIndices(), sizeof(int), range.start_index, mesh->GetNumIndices());
+            }
+        }
 
-            shape.id = iter->GetId();
+        // Encode all the chunks into given arrays using given vertex format
+        auto write_chunks = [this, &chunks](ClwScene::VertexFormat format, char* vertices, char* normals, char* uvs, int* indices)
+        {
+            m_thread_pool->ParallelFor(chunks.size(), [&](std::size_t i)
+            {
+                auto& chunk = chunks[i];
 
-            shape.startvtx = static_cast<int>(num_vertices_written);
-            shape.startidx = static_cast<int>(num_indices_written);
+                switch (chunk.stream)
+                {
+                case Stream::kVertices:
+                    WritePositions(static_cast<float3 const*>(chunk.src), chunk.count, format,
+                                   vertices + chunk.dst_offset * GetPositionSize(format));
+                    break;
+                case Stream::kNormals:
+                    WriteNormals(static_cast<float3 const*>(chunk.src), chunk.count, format,
+                                 normals + chunk.dst_offset * GetNormalSize(format));
+                    break;
+                case Stream::kUVs:
+                    WriteUVs(static_cast<float2 const*>(chunk.src), chunk.count, format,
+                             uvs + chunk.dst_offset * GetUVSize(format));
+                    break;
+                case Stream::kIndices:
+                    std::memcpy(indices + chunk.dst_offset, chunk.src, chunk.count * sizeof(int));
+                    break;
+                }
+            });
+        };
 
-            auto transform = mesh->GetTransform();
-            shape.transform.m0 = { transform.m00, transform.m01, transform.m02, transform.m03 };
-            shape.transform.m1 = { transform.m10, transform.m11, transform.m12, transform.m13 };
-            shape.transform.m2 = { transform.m20, transform.m21, transform.m22, transform.m23 };
-            shape.transform.m3 = { transform.m30, transform.m31, transform.m32, transform.m33 };
+        write_chunks(format, vertices, normals, uvs, indices);
 
-            shape.linearvelocity = float3(0.0f, 0.f, 0.f);
-            shape.angularvelocity = float3(0.f, 0.f, 0.f, 1.f);
-            shape.material_idx = GetMaterialIndex(mat_collector, mesh->GetMaterial());
-            shape.volume_idx = GetVolumeIndex(vol_collector, mesh->GetVolumeMaterial());
+        LogInfo("Geometry copy: ", elapsed_ms(copy_start), " ms (", chunks.size(), " chunks, ",
+                m_thread_pool->GetNumThreads(), " threads)\n");
 
-            shape_data[mesh] = shape;
+        if (m_scene_cache && !geometry_cached)
+        {
+            LogInfo("Saving geometry to cache...\n");
 
-            std::copy(mesh_vertex_array, mesh_vertex_array + mesh_num_vertices, vertices + num_vertices_written);
-            num_vertices_written += mesh_num_vertices;
+            // Cache always keeps float attributes, so compact
+            // buffers can not be used as a source directly.
+            std::vector<float3> float_vertices;
+            std::vector<float3> float_normals;
+            std::vector<float2> float_uvs;
 
-            std::copy(mesh_normal_array, mesh_normal_array + mesh_num_normals, normals + num_normals_written);
-            num_normals_written += mesh_num_normals;
+            ClwSceneCache::GeometryView view;
 
-            std::copy(mesh_uv_array, mesh_uv_array + mesh_num_uvs, uvs + num_uvs_written);
-            num_uvs_written += mesh_num_uvs;
+            if (format == ClwScene::VERTEX_FORMAT_FLOAT)
+            {
+                view.vertices = reinterpret_cast<float3 const*>(vertices);
+                view.normals = reinterpret_cast<float3 const*>(normals);
+                view.uvs = reinterpret_cast<float2 const*>(uvs);
+            }
+            else
+            {
+                float_vertices.resize(num_vertices);
+                float_normals.resize(num_normals);
+                float_uvs.resize(num_uvs);
+
+                // Index chunks are rewritten with the same values
+                write_chunks(ClwScene::VERTEX_FORMAT_FLOAT,
+                             reinterpret_cast<char*>(float_vertices.data()),
+                             reinterpret_cast<char*>(float_normals.data()),
+                             reinterpret_cast<char*>(float_uvs.data()),
+                             indices);
+
+                view.vertices = float_vertices.data();
+                view.normals = float_normals.data();
+                view.uvs = float_uvs.data();
+            }
 
-            std::copy(mesh_index_array, mesh_index_array + mesh_num_indices, indices + num_indices_written);
-            num_indices_written += mesh_num_indices;
+            view.num_vertices = num_vertices;
+            view.num_normals = num_normals;
+            view.num_uvs = num_uvs;
+            view.indices = reinterpret_cast<std::uint32_t const*>(indices);
+            view.num_indices = num_indices;
+            view.ranges = &mesh_ranges;
 
-            shapes[num_shapes_written++] = shape;
+            m_scene_cache->SaveGeometry(geometry_key, view);
         }
 
-        // Excluded shapes are handled in almost the same way
-        // except materials.
-        for (auto& iter : excluded_meshes)
-        {
-            auto mesh = iter;
+        LogInfo("Unmapping buffers...\n");
+        m_context.UnmapBuffer(0, out.vertices, vertices);
+        m_context.UnmapBuffer(0, out.normals, normals);
+        m_context.UnmapBuffer(0, out.uvs, uvs);
+        m_context.UnmapBuffer(0, out.indices, indices);
+
+        // Total number of entries in shapes GPU array
+        auto num_shapes = meshes.size() + excluded_meshes.size() + instances.size();
+        out.shapes = m_context.CreateBuffer<ClwScene::Shape>(num_shapes, CL_MEM_READ_ONLY);
 
-            // Get pointers data
-            auto mesh_vertex_array = mesh->GetVertices();
-            auto mesh_num_vertices = mesh->GetNumVertices();
+        ClwScene::Shape* shapes = nullptr;
+        m_context.MapBuffer(0, out.shapes, CL_MAP_WRITE, &shapes).Wait();
 
-            auto mesh_normal_array = mesh->GetNormals();
-            auto mesh_num_normals = mesh->GetNumNormals();
+        auto descriptors_start = clock::now();
 
-            auto mesh_uv_array = mesh->GetUVs();
-            auto mesh_num_uvs = mesh->GetNumUVs();
+        auto write_transform = [](matrix const& transform, ClwScene::Shape& shape)
+        {
+            shape.transform.m0 = { transform.m00, transform.m01, transform.m02, transform.m03 };
+            shape.transform.m1 = { transform.m10, transform.m11, transform.m12, transform.m13 };
+            shape.transform.m2 = { transform.m20, transform.m21, transform.m22, transform.m23 };
+            shape.transform.m3 = { transform.m30, transform.m31, transform.m32, transform.m33 };
+        };
 
-            auto mesh_index_array = mesh->GetIndices();
-            auto mesh_num_indices = mesh->GetNumIndices();
+        // Handle meshes and excluded meshes, descriptor i corresponds to buffer_meshes[i]
+        m_thread_pool->ParallelFor(buffer_meshes.size(), [&](std::size_t i)
+        {
+            auto& mesh = buffer_meshes[i];
 
             // Prepare shape descriptor
             ClwScene::Shape shape;
 
             shape.id = mesh->GetId();
 
-            shape.startvtx = static_cast<int>(num_vertices_written);
-            shape.startidx = static_cast<int>(num_indices_written);
+            shape.startvtx = static_cast<int>(mesh_ranges[i].start_vertex);
+            shape.startidx = static_cast<int>(mesh_ranges[i].start_index);
+            shape.vertex_format = format;
+            shape.num_prims = static_cast<int>(mesh->GetNumIndices() / 3);
 
-            auto transform = mesh->GetTransform();
-            shape.transform.m0 = { transform.m00, transform.m01, transform.m02, transform.m03 };
-            shape.transform.m1 = { transform.m10, transform.m11, transform.m12, transform.m13 };
-            shape.transform.m2 = { transform.m20, transform.m21, transform.m22, transform.m23 };
-            shape.transform.m3 = { transform.m30, transform.m31, transform.m32, transform.m33 };
+            write_transform(mesh->GetTransform(), shape);
 
             shape.linearvelocity = float3(0.0f, 0.f, 0.f);
             shape.angularvelocity = float3(0.f, 0.f, 0.f, 1.f);
             shape.material_idx = GetMaterialIndex(mat_collector, mesh->GetMaterial());
             shape.volume_idx = GetVolumeIndex(vol_collector, mesh->GetVolumeMaterial());
 
-            shape_data[mesh] = shape;
+            shapes[i] = shape;
+        });
 
-            std::copy(mesh_vertex_array, mesh_vertex_array + mesh_num_vertices, vertices + num_vertices_written);
-            num_vertices_written += mesh_num_vertices;
-
-            std::copy(mesh_normal_array, mesh_normal_array + mesh_num_normals, normals + num_normals_written);
-            num_normals_written += mesh_num_normals;
-
-            std::copy(mesh_uv_array, mesh_uv_array + mesh_num_uvs, uvs + num_uvs_written);
-            num_uvs_written += mesh_num_uvs;
+        // Meshes and excluded meshes come from ordered sets, so base shape
+        // descriptors are found with a binary search in either half.
+        auto meshes_end = buffer_meshes.cbegin() + meshes.size();
+        auto find_mesh_index = [&](Mesh::Ptr const& mesh) -> std::size_t
+        {
+            auto iter = std::lower_bound(buffer_meshes.cbegin(), meshes_end, mesh);
 
-            std::copy(mesh_index_array, mesh_index_array + mesh_num_indices, indices + num_indices_written);
-            num_indices_written += mesh_num_indices;
+            if (iter == meshes_end || *iter != mesh)
+            {
+                iter = std::lower_bound(meshes_end, buffer_meshes.cend(), mesh);
+            }
 
-            shapes[num_shapes_written++] = shape;
-        }
+            return static_cast<std::size_t>(iter - buffer_meshes.cbegin());
+        };
 
         // Handle instances
-        for (auto& iter : instances)
+        std::vector<Instance::Ptr> instance_list(instances.cbegin(), instances.cend());
+        auto num_buffer_meshes = buffer_meshes.size();
+
+        m_thread_pool->ParallelFor(instance_list.size(), [&](std::size_t i)
         {
-            auto instance = iter;
+            auto& instance = instance_list[i];
             auto base_shape = std::static_pointer_cast<Mesh>(instance->GetBaseShape());
-            auto transform = instance->GetTransform();
 
-            // Here shape_data is guaranteed to contain
-            // info for base_shape since we have serialized it
-            // above in a different pass.
-            ClwScene::Shape shape = shape_data[base_shape];
+            // Here base shape descriptor is guaranteed to be
+            // written above since all base meshes are in buffer_meshes.
+            ClwScene::Shape shape = shapes[find_mesh_index(base_shape)];
 
-            shape.id = iter->GetId();
+            shape.id = instance->GetId();
 
             // Instance has its own transform.
-            shape.transform.m0 = { transform.m00, transform.m01, transform.m02, transform.m03 };
-            shape.transform.m1 = { transform.m10, transform.m11, transform.m12, transform.m13 };
-            shape.transform.m2 = { transform.m20, transform.m21, transform.m22, transform.m23 };
-            shape.transform.m3 = { transform.m30, transform.m31, transform.m32, transform.m33 };
+            write_transform(instance->GetTransform(), shape);
 
             shape.linearvelocity = float3(0.0f, 0.f, 0.f);
             shape.angularvelocity = float3(0.f, 0.f, 0.f, 1.f);
             shape.material_idx = GetMaterialIndex(mat_collector, instance->GetMaterial());
             shape.volume_idx = GetVolumeIndex(vol_collector, instance->GetVolumeMaterial());
 
-            shapes[num_shapes_written++] = shape;
-        }
+            shapes[num_buffer_meshes + i] = shape;
+        });
+
+        LogInfo("Shape descriptors: ", elapsed_ms(descriptors_start), " ms\n");
 
-        LogInfo("Unmapping buffers...\n");
-        m_context.UnmapBuffer(0, out.vertices, vertices);
-        m_context.UnmapBuffer(0, out.normals, normals);
-        m_context.UnmapBuffer(0, out.uvs, uvs);
-        m_context.UnmapBuffer(0, out.indices, indices);
         m_context.UnmapBuffer(0, out.shapes, shapes).Wait();
 
         LogInfo("Updating intersector...\n");
@@ -615,6 +878,21 @@ namespace Baikal
         ReloadIntersector(scene, out);
     }
 
+    void ClwSceneController::WriteShapeProperties(Shape const& shape, Collector& mat_collector, Collector& volume_collector, void* data) const
+    {
+        auto clw_shape = reinterpret_cast<ClwScene::Shape*>(data);
+
+        auto transform = shape.GetTransform();
+        clw_shape->transform.m0 = { transform.m00, transform.m01, transform.m02, transform.m03 };
+        clw_shape->transform.m1 = { transform.m10, transform.m11, transform.m12, transform.m13 };
+        clw_shape->transform.m2 = { transform.m20, transform.m21, transform.m22, transform.m23 };
+        clw_shape->transform.m3 = { transform.m30, transform.m31, transform.m32, transform.m33 };
+        clw_shape->material_idx = GetMaterialIndex(mat_collector, shape.GetMaterial());
+        clw_shape->volume_idx = GetVolumeIndex(volume_collector, shape.GetVolumeMaterial());
+
+        clw_shape->id = shape.GetId();
+    }
+
     void ClwSceneController::UpdateShapeProperties(Scene1 const& scene, Collector& mat_collector, Collector& tex_collector, Collector& volume_collector, ClwScene& out) const
     {
         auto shape_iter = scene.CreateShapeIterator();
@@ -629,71 +907,90 @@ namespace Baikal
 
         ClwScene::Shape* shapes = nullptr;
 
+        auto const& changed_shapes = GetChangeJournal().shapes;
+
+        if (!changed_shapes.empty())
+        {
+            // Shape buffer follows meshes, excluded meshes, instances order
+            std::unordered_map<Shape const*, std::size_t> shape_indices;
+            std::size_t idx = 0;
+            for (auto& mesh : meshes)
+            {
+                shape_indices.emplace(mesh.get(), idx++);
+            }
+
+            for (auto& mesh : excluded_meshes)
+            {
+                shape_indices.emplace(mesh.get(), idx++);
+            }
+
+            for (auto& instance : instances)
+            {
+                shape_indices.emplace(instance.get(), idx++);
+            }
+
+            std::vector<std::size_t> changed_indices;
+            changed_indices.reserve(changed_shapes.size());
+            for (auto& shape : changed_shapes)
+            {
+                changed_indices.push_back(shape_indices.at(shape.get()));
+            }
+
+            // Only map the range spanning changed records
+            auto minmax = std::minmax_element(changed_indices.cbegin(), changed_indices.cend());
+            auto range_start = *minmax.first;
+            auto range_size = *minmax.second - range_start + 1;
+
+            m_context.MapBuffer(0, out.shapes, CL_MAP_READ | CL_MAP_WRITE, range_start, range_size, &shapes).Wait();
+
+            for (std::size_t i = 0; i < changed_shapes.size(); ++i)
+            {
+                WriteShapeProperties(*changed_shapes[i], mat_collector, volume_collector, shapes + changed_indices[i] - range_start);
+            }
+
+            m_context.UnmapBuffer(0, out.shapes, shapes).Wait();
+
+            UpdateIntersectorTransforms(changed_shapes, out);
+            return;
+        }
+
         // Map arrays and prepare to write data
         m_context.MapBuffer(0, out.shapes, CL_MAP_READ | CL_MAP_WRITE, &shapes).Wait();
 
         auto current_shape = shapes;
         for (auto& iter : meshes)
         {
-            auto mesh = iter;
-
-            auto transform = mesh->GetTransform();
-            current_shape->transform.m0 = { transform.m00, transform.m01, transform.m02, transform.m03 };
-            current_shape->transform.m1 = { transform.m10, transform.m11, transform.m12, transform.m13 };
-            current_shape->transform.m2 = { transform.m20, transform.m21, transform.m22, transform.m23 };
-            current_shape->transform.m3 = { transform.m30, transform.m31, transform.m32, transform.m33 };
-            current_shape->material_idx = GetMaterialIndex(mat_collector, mesh->GetMaterial());
-            current_shape->volume_idx = GetVolumeIndex(volume_collector, mesh->GetVolumeMaterial());
-
-            current_shape->id = iter->GetId();
-
-            ++current_shape;
+            WriteShapeProperties(*iter, mat_collector, volume_collector, current_shape++);
         }
 
-        // Excluded shapes are handled in almost the same way
-        // except materials.
+        // Excluded shapes are handled in the same way
         for (auto& iter : excluded_meshes)
         {
-            auto mesh = iter;
-
-            auto transform = mesh->GetTransform();
-            current_shape->transform.m0 = { transform.m00, transform.m01, transform.m02, transform.m03 };
-            current_shape->transform.m1 = { transform.m10, transform.m11, transform.m12, transform.m13 };
-            current_shape->transform.m2 = { transform.m20, transform.m21, transform.m22, transform.m23 };
-            current_shape->transform.m3 = { transform.m30, transform.m31, transform.m32, transform.m33 };
-            current_shape->material_idx = GetMaterialIndex(mat_collector, mesh->GetMaterial());
-            current_shape->volume_idx = GetVolumeIndex(volume_collector, mesh->GetVolumeMaterial());
-
-            current_shape->id = iter->GetId();
-
-            ++current_shape;
+            WriteShapeProperties(*iter, mat_collector, volume_collector, current_shape++);
         }
 
         // Handle instances
         for (auto& iter : instances)
         {
-            auto instance = iter;
-            auto base_shape = std::static_pointer_cast<Mesh>(instance->GetBaseShape());
-            auto transform = instance->GetTransform();
-
-            current_shape->transform.m0 = { transform.m00, transform.m01, transform.m02, transform.m03 };
-            current_shape->transform.m1 = { transform.m10, transform.m11, transform.m12, transform.m13 };
-            current_shape->transform.m2 = { transform.m20, transform.m21, transform.m22, transform.m23 };
-            current_shape->transform.m3 = { transform.m30, transform.m31, transform.m32, transform.m33 };
-            current_shape->material_idx = GetMaterialIndex(mat_collector, instance->GetMaterial());
-            current_shape->volume_idx = GetVolumeIndex(volume_collector, instance->GetVolumeMaterial());
-
-            current_shape->id = iter->GetId();
-
-            ++current_shape;
+            WriteShapeProperties(*iter, mat_collector, volume_collector, current_shape++);
         }
 
         m_context.UnmapBuffer(0, out.shapes, shapes).Wait();
+
+        std::vector<Shape::Ptr> scene_shapes(meshes.cbegin(), meshes.cend());
+        scene_shapes.insert(scene_shapes.end(), instances.cbegin(), instances.cend());
+        UpdateIntersectorTransforms(scene_shapes, out);
     }
 
     void ClwSceneController::UpdateCurrentScene(Scene1 const& scene, ClwScene& out) const
     {
         ReloadIntersector(scene, out);
+
+        // Input map source is shared by all scenes, restore the one of this scene
+        if (!out.input_map_header.empty())
+        {
+            m_program_manager->AddHeader("inputmaps.cl", out.input_map_header);
+        }
     }
 
     void ClwSceneController::UpdateMaterials(Scene1 const& scene, Collector& mat_collector, Collector& tex_collector, ClwScene& out) const
@@ -711,13 +1008,48 @@ namespace Baikal
         ClwScene::Material* materials = nullptr;
         std::size_t num_materials_written = 0;
 
+        auto const& changed_materials = GetChangeJournal().materials;
+
+        // Material set is unchanged, so only rewrite changed materials in place,
+        // material slot is its index within the collector
+        if (!changed_materials.empty())
+        {
+            ClwBufferPatcher<ClwScene::Material> patcher;
+
+            for (auto& material : changed_materials)
+            {
+                auto slot = patcher.Stage(mat_collector.GetItemIndex(material));
+                WriteMaterial(*material, mat_collector, tex_collector, slot);
+            }
+
+            patcher.Commit(m_context, out.materials);
+            return;
+        }
+
+        // Update material bundle first to be able to track differences
+        out.material_bundle.reset(mat_collector.CreateBundle());
+
+        // Records reference other materials and textures by collector index
+        std::uint64_t cache_key = 0;
+
+        if (m_scene_cache)
+        {
+            cache_key = GetCollectorKey(tex_collector, GetCollectorKey(mat_collector, 0));
+
+            std::vector<char> cached;
+            if (m_scene_cache->LoadBlob("materials", cache_key, cached) &&
+                cached.size() == mat_buffer_size * sizeof(ClwScene::Material))
+            {
+                m_context.WriteBuffer(0, out.materials, reinterpret_cast<ClwScene::Material*>(cached.data()), mat_buffer_size).Wait();
+                return;
+            }
+        }
+
         // Map GPU materials buffer
         m_context.MapBuffer(0, out.materials, CL_MAP_WRITE, &materials).Wait();
 
         // Serialize
         {
-            // Update material bundle first to be able to track differences
-            out.material_bundle.reset(mat_collector.CreateBundle());
 
             // Create material iterator
             auto mat_iter = mat_collector.CreateIterator();
@@ -729,6 +1061,12 @@ namespace Baikal
                 ++num_materials_written;
             }
         }
+
+        if (m_scene_cache)
+        {
+            m_scene_cache->SaveBlob("materials", cache_key, materials, num_materials_written * sizeof(ClwScene::Material));
+        }
+
         // Unmap material buffer
         m_context.UnmapBuffer(0, out.materials, materials);
 
@@ -783,7 +1121,18 @@ namespace Baikal
             m_api->AttachShape(s);
         }
 
-        m_api->Commit();
+        m_intersector_dirty = true;
+    }
+
+    void ClwSceneController::CommitUpdates(Scene1 const& scene, ClwScene& out) const
+    {
+        // Shape updates and scene switches might both touch the intersector,
+        // but the acceleration structure is only rebuilt once per compilation
+        if (m_intersector_dirty)
+        {
+            m_api->Commit();
+            m_intersector_dirty = false;
+        }
     }
 
     void ClwSceneController::UpdateTextures(Scene1 const& scene, Collector& mat_collector, Collector& tex_collector, ClwScene& out) const
@@ -796,6 +1145,9 @@ namespace Baikal
         {
             out.textures = m_context.CreateBuffer<ClwScene::Texture>(1, CL_MEM_READ_ONLY);
             out.texturedata = m_context.CreateBuffer<char>(1, CL_MEM_READ_ONLY);
+            out.texturefeedback = m_context.CreateBuffer<int>(1, CL_MEM_READ_WRITE);
+            out.texture_data_offsets.clear();
+            out.texture_streamer.reset();
             return;
         }
 
@@ -806,28 +1158,187 @@ namespace Baikal
             out.textures = m_context.CreateBuffer<ClwScene::Texture>(tex_buffer_size, CL_MEM_READ_ONLY);
         }
 
-        ClwScene::Texture* textures = nullptr;
-        std::size_t num_textures_written = 0;
+        // Kernels always get a feedback buffer, the streamer provides its own
+        if (out.texturefeedback.GetElementCount() == 0)
+        {
+            out.texturefeedback = m_context.CreateBuffer<int>(1, CL_MEM_READ_WRITE);
+        }
 
-        // Map GPU materials buffer
-        m_context.MapBuffer(0, out.textures, CL_MAP_WRITE, &textures).Wait();
+        auto const& changed_textures = GetChangeJournal().textures;
+
+        // Texture set is unchanged: rewrite headers and data of changed textures
+        // in place as long as they still fit into their byte range.
+        // Streaming layout depends on all the textures, so it is always rebuilt.
+        if (!changed_textures.empty() && !out.texture_streamer)
+        {
+            bool fits = true;
+
+            for (auto& tex : changed_textures)
+            {
+                auto slot = tex_collector.GetItemIndex(tex);
+                auto range_size = out.texture_data_offsets[slot + 1] - out.texture_data_offsets[slot];
+
+                if (align16(GetPoolTextureSize(*tex)) != range_size)
+                {
+                    fits = false;
+                    break;
+                }
+            }
+
+            if (fits)
+            {
+                ClwBufferPatcher<ClwScene::Texture> patcher;
+                std::vector<char> staging;
+
+                for (auto& tex : changed_textures)
+                {
+                    auto slot = tex_collector.GetItemIndex(tex);
+                    auto data_offset = out.texture_data_offsets[slot];
+
+                    WriteTexture(*tex, data_offset, patcher.Stage(slot));
+
+                    // Pool representation (mip chain, format) is built in staging memory
+                    staging.resize(GetPoolTextureSize(*tex));
+                    WriteTextureData(*tex, staging.data());
+                    m_context.WriteBuffer(0, out.texturedata, staging.data(), data_offset, staging.size()).Wait();
+                }
+
+                patcher.Commit(m_context, out.textures);
+                return;
+            }
+        }
+
+        // Large textures are streamed in tiles if enabled, so only their mip tail goes into the pool
+        if (m_tile_pool_size > 0)
+        {
+            if (!out.texture_streamer)
+            {
+                out.texture_streamer = std::make_shared<ClwTextureStreamer>(m_context, m_tile_pool_size);
+            }
+
+            out.texture_streamer->Clear();
+        }
+        else
+        {
+            out.texture_streamer.reset();
+        }
+
+        auto streamer = out.texture_streamer.get();
 
         // Update material bundle first to be able to track differences
         out.texture_bundle.reset(tex_collector.CreateBundle());
 
+        // Streaming layout depends on the tile pool, so only resident pools are cached.
+        // Headers (data offsets followed by texture records) and data are kept separately
+        // to avoid assembling the whole pool in host memory.
+        std::uint64_t cache_key = 0;
+        bool use_cache = m_scene_cache && !streamer;
+
+        if (use_cache)
+        {
+            cache_key = GetCollectorKey(tex_collector, ClwSceneCache::CombineKey(0, m_half_float_textures ? 1 : 0));
+
+            std::vector<char> headers;
+            std::vector<char> cached_data;
+
+            auto offsets_size = (tex_buffer_size + 1) * sizeof(std::size_t);
+            auto headers_size = offsets_size + tex_buffer_size * sizeof(ClwScene::Texture);
+
+            if (m_scene_cache->LoadBlob("texture_headers", cache_key, headers) &&
+                headers.size() == headers_size &&
+                m_scene_cache->LoadBlob("texture_data", cache_key, cached_data))
+            {
+                out.texture_data_offsets.resize(tex_buffer_size + 1);
+                std::memcpy(out.texture_data_offsets.data(), headers.data(), offsets_size);
+
+                if (out.texture_data_offsets.back() == cached_data.size())
+                {
+                    m_context.WriteBuffer(0, out.textures, reinterpret_cast<ClwScene::Texture*>(headers.data() + offsets_size), tex_buffer_size);
+
+                    if (cached_data.size() > out.texturedata.GetElementCount())
+                    {
+                        out.texturedata = m_context.CreateBuffer<char>(cached_data.size(), CL_MEM_READ_ONLY);
+                    }
+
+                    m_context.WriteBuffer(0, out.texturedata, cached_data.data(), cached_data.size()).Wait();
+                    return;
+                }
+            }
+        }
+
+        // Remember texture data ranges for partial updates
+        out.texture_data_offsets.resize(tex_buffer_size + 1);
+
+        // Streamer index of each texture (-1 if the texture is resident)
+        std::vector<int> streamed_indices(tex_buffer_size, -1);
+
         // Create material iterator
         std::unique_ptr<Iterator> tex_iter(tex_collector.CreateIterator());
 
+        // Lay out resident texture data
+        for (std::size_t i = 0; tex_iter->IsValid(); tex_iter->Next(), ++i)
+        {
+            auto tex = tex_iter->ItemAs<Texture>();
+
+            out.texture_data_offsets[i] = tex_data_buffer_size;
+
+            if (streamer)
+            {
+                streamed_indices[i] = streamer->AddTexture(tex, GetPoolTextureFormat(*tex));
+            }
+
+            if (streamed_indices[i] >= 0)
+            {
+                auto const& layout = streamer->GetLayout(streamed_indices[i]);
+                tex_data_buffer_size += align16(GetMipChainSize(ClwTextureStreamer::GetTailSize(layout.size), layout.format));
+            }
+            else
+            {
+                tex_data_buffer_size += align16(GetPoolTextureSize(*tex));
+            }
+        }
+
+        out.texture_data_offsets[tex_buffer_size] = tex_data_buffer_size;
+
+        // Page tables and tile pool follow resident data
+        auto streaming_offset = tex_data_buffer_size;
+        if (streamer)
+        {
+            tex_data_buffer_size += streamer->Place(streaming_offset);
+            out.texturefeedback = streamer->GetFeedbackBuffer();
+        }
+
+        ClwScene::Texture* textures = nullptr;
+
+        // Map GPU materials buffer
+        m_context.MapBuffer(0, out.textures, CL_MAP_WRITE, &textures).Wait();
+
+        tex_iter->Reset();
+
         // Iterate and serialize
-        for (; tex_iter->IsValid(); tex_iter->Next())
+        for (std::size_t i = 0; tex_iter->IsValid(); tex_iter->Next(), ++i)
         {
             auto tex = tex_iter->ItemAs<Texture>();
 
-            WriteTexture(*tex, tex_data_buffer_size, textures + num_textures_written);
+            if (streamed_indices[i] >= 0)
+            {
+                WriteStreamedTexture(streamer->GetLayout(streamed_indices[i]), out.texture_data_offsets[i], textures + i);
+            }
+            else
+            {
+                WriteTexture(*tex, out.texture_data_offsets[i], textures + i);
+            }
+        }
+
+        if (use_cache)
+        {
+            auto offsets_size = out.texture_data_offsets.size() * sizeof(std::size_t);
 
-            ++num_textures_written;
+            std::vector<char> headers(offsets_size + tex_buffer_size * sizeof(ClwScene::Texture));
+            std::memcpy(headers.data(), out.texture_data_offsets.data(), offsets_size);
+            std::memcpy(headers.data() + offsets_size, textures, tex_buffer_size * sizeof(ClwScene::Texture));
 
-            tex_data_buffer_size += align16(tex->GetSizeInBytes());
+            m_scene_cache->SaveBlob("texture_headers", cache_key, headers.data(), headers.size());
         }
 
         // Unmap material buffer
@@ -841,7 +1352,6 @@ namespace Baikal
         }
 
         char* data = nullptr;
-        std::size_t num_bytes_written = 0;
 
         tex_iter->Reset();
 
@@ -849,19 +1359,43 @@ namespace Baikal
         m_context.MapBuffer(0, out.texturedata, CL_MAP_WRITE, &data).Wait();
 
         // Write texture data for all textures
-        for (; tex_iter->IsValid(); tex_iter->Next())
+        for (std::size_t i = 0; tex_iter->IsValid(); tex_iter->Next(), ++i)
         {
             auto tex = tex_iter->ItemAs<Texture>();
 
-            WriteTextureData(*tex, data + num_bytes_written);
+            if (streamed_indices[i] >= 0)
+            {
+                WriteStreamedTextureData(*tex, streamer->GetLayout(streamed_indices[i]), data + out.texture_data_offsets[i]);
+            }
+            else
+            {
+                WriteTextureData(*tex, data + out.texture_data_offsets[i]);
+            }
+        }
 
-            num_bytes_written += align16(tex->GetSizeInBytes());
+        // Nothing is resident in the tile pool yet
+        if (streamer)
+        {
+            streamer->WriteRegion(data + streaming_offset);
+        }
+
+        if (use_cache)
+        {
+            m_scene_cache->SaveBlob("texture_data", cache_key, data, out.texture_data_offsets.back());
         }
 
         // Unmap material buffer
         m_context.UnmapBuffer(0, out.texturedata, data);
     }
 
+    void ClwSceneController::UpdateResidency(Scene1 const& scene, ClwScene& out) const
+    {
+        if (out.texture_streamer)
+        {
+            out.texture_streamer->Update(out.texturedata);
+        }
+    }
+
     // Convert Material:: types to ClwScene:: types
     static ClwScene::Bxdf GetMaterialType(Material const& material)
     {
@@ -1441,6 +1975,357 @@ namespace Baikal
         }
     }
 
+    // Get world space emission bounds of a light, infinite lights can't be bounded
+    static bool GetLightBounds(Light const& light, LightBvh::LightBounds& bounds)
+    {
+        switch (GetLightType(light))
+        {
+            case ClwScene::kPoint:
+            {
+                bounds.bounds = RadeonRays::bbox(light.GetPosition());
+                bounds.axis = RadeonRays::float3(0.f, 0.f, 1.f);
+                bounds.cos_theta_o = -1.f;
+                bounds.cos_theta_e = 0.f;
+                return true;
+            }
+
+            case ClwScene::kSpot:
+            {
+                // Nothing is emitted outside of the outer cone, tiny theta_e keeps its boundary inside
+                auto cone_shape = static_cast<SpotLight const&>(light).GetConeShape();
+                bounds.bounds = RadeonRays::bbox(light.GetPosition());
+                bounds.axis = RadeonRays::normalize(light.GetDirection());
+                bounds.cos_theta_o = cone_shape.y;
+                bounds.cos_theta_e = std::cos(1e-3f);
+                return true;
+            }
+
+            case ClwScene::kArea:
+            {
+                auto& area_light = static_cast<AreaLight const&>(light);
+                auto mesh = std::static_pointer_cast<Mesh>(area_light.GetShape());
+                auto transform = mesh->GetTransform();
+                auto indices = mesh->GetIndices() + 3 * area_light.GetPrimitiveIdx();
+
+                auto v0 = RadeonRays::transform_point(mesh->GetVertices()[indices[0]], transform);
+                auto v1 = RadeonRays::transform_point(mesh->GetVertices()[indices[1]], transform);
+                auto v2 = RadeonRays::transform_point(mesh->GetVertices()[indices[2]], transform);
+
+                bounds.bounds = RadeonRays::bbox(v0);
+                bounds.bounds.grow(v1);
+                bounds.bounds.grow(v2);
+                bounds.axis = RadeonRays::float3(0.f, 0.f, 1.f);
+                bounds.cos_theta_o = -1.f;
+                bounds.cos_theta_e = 0.f;
+
+                // Triangle emits to the side of interpolated normals, so the cone around
+                // geometric normal has to contain all of them. Otherwise emission is two sided.
+                auto ng = RadeonRays::cross(v1 - v0, v2 - v0);
+
+                if (mesh->GetNumNormals() > 0 && ng.sqnorm() > 0.f)
+                {
+                    auto n0 = RadeonRays::normalize(RadeonRays::transform_vector(mesh->GetNormals()[indices[0]], transform));
+                    auto n1 = RadeonRays::normalize(RadeonRays::transform_vector(mesh->GetNormals()[indices[1]], transform));
+                    auto n2 = RadeonRays::normalize(RadeonRays::transform_vector(mesh->GetNormals()[indices[2]], transform));
+
+                    ng = RadeonRays::normalize(ng);
+
+                    if (RadeonRays::dot(ng, n0 + n1 + n2) < 0.f)
+                    {
+                        ng = -ng;
+                    }
+
+                    auto cos_theta_o = std::min(RadeonRays::dot(ng, n0), std::min(RadeonRays::dot(ng, n1), RadeonRays::dot(ng, n2)));
+
+                    // Wider cone does not contain interpolated normals anymore
+                    if (cos_theta_o >= 0.f)
+                    {
+                        bounds.axis = ng;
+                        bounds.cos_theta_o = cos_theta_o;
+                    }
+                }
+
+                return true;
+            }
+
+            default:
+                return false;
+        }
+    }
+
+    void ClwSceneController::WriteLightBvh(Scene1 const& scene, std::vector<float> const& light_power, std::vector<int>& out) const
+    {
+        std::vector<LightBvh::Emitter> emitters;
+        std::vector<int> infinite_lights;
+        // Shape, primitive and light index of area lights
+        std::vector<std::array<int, 3>> emissives;
+
+        auto shape_iter = scene.CreateShapeIterator();
+        auto shape_indices = GetShapeIndices(*shape_iter);
+
+        std::unique_ptr<Iterator> light_iter(scene.CreateLightIterator());
+
+        for (auto light_idx = 0; light_iter->IsValid(); light_iter->Next(), ++light_idx)
+        {
+            auto light = light_iter->ItemAs<Light>();
+
+            if (auto area_light = std::dynamic_pointer_cast<AreaLight>(light))
+            {
+                emissives.push_back({ {
+                    shape_indices.at(area_light->GetShape().get()),
+                    static_cast<int>(area_light->GetPrimitiveIdx()),
+                    light_idx } });
+            }
+
+            LightBvh::Emitter emitter;
+            emitter.light = light_idx;
+            emitter.bounds.power = light_power[light_idx];
+
+            if (GetLightBounds(*light, emitter.bounds))
+            {
+                emitters.push_back(emitter);
+            }
+            else
+            {
+                infinite_lights.push_back(light_idx);
+            }
+        }
+
+        std::sort(emissives.begin(), emissives.end());
+
+        // Empty tree with no infinite lights makes kernels fall back to power distribution
+        LightBvh bvh;
+        if (scene.GetLightSamplingMode() == Scene1::LightSamplingMode::kBvh)
+        {
+            bvh.Build(std::move(emitters));
+        }
+        else
+        {
+            infinite_lights.clear();
+        }
+
+        auto const& nodes = bvh.GetNodes();
+        static_assert(sizeof(LightBvh::Node) == 16 * sizeof(int), "LightBvh::Node does not match light_bvh.cl layout");
+
+        auto offset = out.size();
+        auto num_lights = light_power.size();
+
+        // Header, block size is filled in at the end
+        out.push_back(0);
+        out.push_back(static_cast<int>(num_lights));
+        out.push_back(static_cast<int>(nodes.size()));
+        out.push_back(static_cast<int>(infinite_lights.size()));
+        out.push_back(static_cast<int>(emissives.size()));
+
+        // Leaf node of every light
+        auto leafs_offset = out.size();
+        out.resize(leafs_offset + num_lights, -1);
+
+        for (auto i = 0u; i < nodes.size(); ++i)
+        {
+            if (nodes[i].light >= 0)
+            {
+                out[leafs_offset + nodes[i].light] = static_cast<int>(i);
+            }
+        }
+
+        out.insert(out.end(), infinite_lights.cbegin(), infinite_lights.cend());
+
+        for (auto const& emissive : emissives)
+        {
+            out.insert(out.end(), emissive.cbegin(), emissive.cend());
+        }
+
+        auto nodes_data = reinterpret_cast<int const*>(nodes.data());
+        out.insert(out.end(), nodes_data, nodes_data + 16 * nodes.size());
+
+        out[offset] = static_cast<int>(out.size() - offset);
+    }
+
+    // Append distribution in GPU layout: number of segments, CDF values, PDF values
+    static void AppendDistribution(std::vector<float>& values, std::vector<int>& out)
+    {
+        // Zero function can't be normalized, fall back to uniform distribution
+        if (std::all_of(values.cbegin(), values.cend(), [](float v) { return v <= 0.f; }))
+        {
+            std::fill(values.begin(), values.end(), 1.f);
+        }
+
+        Distribution1D distribution(values.data(), (std::uint32_t)values.size());
+
+        auto offset = out.size();
+        out.resize(offset + 2 * distribution.m_num_segments + 2);
+
+        // Write the number of segments first
+        out[offset] = (int)distribution.m_num_segments;
+
+        // Then write num_segments + 1 CDF values
+        auto cdf = reinterpret_cast<float*>(&out[offset + 1]);
+        for (auto i = 0u; i < distribution.m_num_segments + 1; ++i)
+        {
+            cdf[i] = distribution.m_cdf[i];
+        }
+
+        // Then write num_segments PDF values
+        auto pdf = cdf + distribution.m_num_segments + 1;
+        for (auto i = 0u; i < distribution.m_num_segments; ++i)
+        {
+            pdf[i] = distribution.m_func_values[i] / distribution.m_func_sum;
+        }
+    }
+
+    // Get luminance of a single texel
+    static float GetTexelLuminance(Texture const& texture, int x, int y)
+    {
+        auto size = texture.GetSize();
+        auto idx = 4 * (static_cast<std::size_t>(y) * size.x + x);
+
+        RadeonRays::float3 value;
+
+        switch (texture.GetFormat())
+        {
+            case Texture::Format::kRgba8:
+            {
+                auto data = reinterpret_cast<std::uint8_t const*>(texture.GetData());
+                value = RadeonRays::float3(data[idx] / 255.f, data[idx + 1] / 255.f, data[idx + 2] / 255.f);
+                break;
+            }
+            case Texture::Format::kRgba16:
+            {
+                auto data = reinterpret_cast<std::uint16_t const*>(texture.GetData());
+                half r, g, b;
+                r.setBits(data[idx]);
+                g.setBits(data[idx + 1]);
+                b.setBits(data[idx + 2]);
+                value = RadeonRays::float3(r, g, b);
+                break;
+            }
+            case Texture::Format::kRgba32:
+            {
+                auto data = reinterpret_cast<float const*>(texture.GetData());
+                value = RadeonRays::float3(data[idx], data[idx + 1], data[idx + 2]);
+                break;
+            }
+            default:
+                break;
+        }
+
+        return std::max(0.2126f * value.x + 0.7152f * value.y + 0.0722f * value.z, 0.f);
+    }
+
+    // Build luminance based importance sampling distribution for lat-long environment map.
+    // Layout: width, height, marginal distribution over rows (theta),
+    // then conditional distribution over columns (phi) for each row.
+    static void BuildEnvironmentDistribution(Texture const& texture, std::vector<int>& out)
+    {
+        auto size = texture.GetSize();
+
+        // Distribution is built over a coarser grid for large maps,
+        // PDFs stay consistent as sampling and evaluation use the same grid
+        auto width = std::min(size.x, kMaxEnvDistributionWidth);
+        auto height = std::min(size.y, kMaxEnvDistributionHeight);
+
+        std::vector<float> cells(width * height, 0.f);
+
+        for (auto y = 0; y < size.y; ++y)
+        {
+            auto cell_y = y * height / size.y;
+
+            for (auto x = 0; x < size.x; ++x)
+            {
+                auto cell_x = x * width / size.x;
+                cells[cell_y * width + cell_x] += GetTexelLuminance(texture, x, y);
+            }
+        }
+
+        // Account for solid angle distortion of lat-long mapping,
+        // texture rows go from theta = 0 (top) to theta = PI
+        std::vector<float> marginal(height);
+
+        for (auto y = 0; y < height; ++y)
+        {
+            auto sin_theta = std::sin(PI * (y + 0.5f) / height);
+            auto row = cells.begin() + y * width;
+
+            std::transform(row, row + width, row, [sin_theta](float v) { return v * sin_theta; });
+            marginal[y] = std::accumulate(row, row + width, 0.f) / width;
+        }
+
+        out.clear();
+        out.push_back(width);
+        out.push_back(height);
+
+        AppendDistribution(marginal, out);
+
+        std::vector<float> conditional(width);
+
+        for (auto y = 0; y < height; ++y)
+        {
+            std::copy(cells.cbegin() + y * width, cells.cbegin() + (y + 1) * width, conditional.begin());
+            AppendDistribution(conditional, out);
+        }
+    }
+
+    // Collect textures environment light samples radiance from. Light samples are drawn
+    // from the distribution of a single texture, so it is only built when all of them match.
+    static void CollectEnvironmentTextures(ImageBasedLight const& ibl, std::set<Texture::Ptr>& textures)
+    {
+        textures.insert(ibl.GetTexture());
+
+        for (auto const& texture : { ibl.GetReflectionTexture(), ibl.GetRefractionTexture(), ibl.GetTransparencyTexture() })
+        {
+            if (texture)
+            {
+                textures.insert(texture);
+            }
+        }
+    }
+
+    // Texture to build environment distribution from, nullptr falls back to uniform sampling
+    static Texture::Ptr GetEnvironmentSamplingTexture(std::set<Texture::Ptr> const& textures)
+    {
+        return textures.size() == 1 ? *textures.begin() : nullptr;
+    }
+
+    void ClwSceneController::WriteLightDistribution(Scene1 const& scene, std::vector<float> const& light_power, Texture::Ptr env_texture, ClwScene& out) const
+    {
+        std::vector<int> distribution_data;
+
+        // Create distribution over light sources based on their power
+        std::vector<float> values(light_power);
+        AppendDistribution(values, distribution_data);
+
+        // Light BVH goes next, it is small enough to be rebuilt along with the distribution
+        WriteLightBvh(scene, light_power, distribution_data);
+
+        // Environment map distribution follows, it is rebuilt on texture change only
+        if (env_texture)
+        {
+            if (out.env_light_distribution_texture.lock() != env_texture || env_texture->IsDirty())
+            {
+                BuildEnvironmentDistribution(*env_texture, out.env_light_distribution);
+                out.env_light_distribution_texture = env_texture;
+            }
+
+            distribution_data.insert(distribution_data.end(), out.env_light_distribution.cbegin(), out.env_light_distribution.cend());
+        }
+        else
+        {
+            out.env_light_distribution.clear();
+            out.env_light_distribution_texture.reset();
+
+            // Zero width means there is no environment distribution
+            distribution_data.push_back(0);
+        }
+
+        if (distribution_data.size() > out.light_distributions.GetElementCount())
+        {
+            out.light_distributions = m_context.CreateBuffer<int>(distribution_data.size(), CL_MEM_READ_ONLY);
+        }
+
+        m_context.WriteBuffer(0, out.light_distributions, distribution_data.data(), distribution_data.size()).Wait();
+    }
+
     void ClwSceneController::UpdateLights(Scene1 const& scene, Collector& mat_collector, Collector& tex_collector, ClwScene& out) const
     {
         std::size_t num_lights_written = 0;
@@ -1448,20 +2333,60 @@ namespace Baikal
         auto env_override = scene.GetEnvironmentOverride();
 
         auto num_lights = scene.GetNumLights();
-        auto distribution_buffer_size = (1 + 1 + num_lights + num_lights);
 
         // Create light buffer if needed
         if (num_lights > out.lights.GetElementCount())
         {
             out.lights = m_context.CreateBuffer<ClwScene::Light>(num_lights, CL_MEM_READ_ONLY);
-            out.light_distributions = m_context.CreateBuffer<int>(distribution_buffer_size, CL_MEM_READ_ONLY);
         }
 
+        // Textures environment lights sample, importance sampling needs them to match
+        std::set<Texture::Ptr> env_textures;
+
         ClwScene::Light* lights = nullptr;
 
-        m_context.MapBuffer(0, out.lights, CL_MAP_WRITE, &lights).Wait();
         std::unique_ptr<Iterator> light_iter(scene.CreateLightIterator());
 
+        auto const& changed_lights = GetChangeJournal().lights;
+
+        // Light set is unchanged, so only changed lights are rewritten,
+        // while the power distribution is small enough to be rebuilt
+        if (!changed_lights.empty())
+        {
+            std::unordered_map<Light const*, std::size_t> light_indices;
+            std::vector<float> light_power(num_lights);
+            std::uint32_t k = 0;
+
+            for (; light_iter->IsValid(); light_iter->Next())
+            {
+                auto light = light_iter->ItemAs<Light>();
+                light_indices.emplace(light.get(), k);
+
+                if (auto ibl = std::dynamic_pointer_cast<ImageBasedLight>(light))
+                {
+                    CollectEnvironmentTextures(*ibl, env_textures);
+                }
+
+                auto power = light->GetPower(scene);
+                light_power[k++] = 0.2126f * power.x + 0.7152f * power.y + 0.0722f * power.z;
+            }
+
+            ClwBufferPatcher<ClwScene::Light> patcher;
+
+            for (auto& light : changed_lights)
+            {
+                auto slot = patcher.Stage(light_indices.at(light.get()));
+                WriteLight(scene, *light, tex_collector, slot);
+            }
+
+            patcher.Commit(m_context, out.lights);
+
+            WriteLightDistribution(scene, light_power, GetEnvironmentSamplingTexture(env_textures), out);
+            return;
+        }
+
+        m_context.MapBuffer(0, out.lights, CL_MAP_WRITE, &lights).Wait();
+
         // Disable IBL by default
         out.envmapidx = -1;
 
@@ -1482,6 +2407,7 @@ namespace Baikal
                 if (ibl)
                 {
                     out.envmapidx = static_cast<int>(num_lights_written);
+                    CollectEnvironmentTextures(*ibl, env_textures);
                 }
 
                 ++num_lights_written;
@@ -1495,48 +2421,49 @@ namespace Baikal
 
         m_context.UnmapBuffer(0, out.lights, lights);
 
-        // Create distribution over light sources based on their power
-        Distribution1D light_distribution(&light_power[0], (std::uint32_t)light_power.size());
-
-        // Write distribution data
-        int* distribution_ptr = nullptr;
-        m_context.MapBuffer(0, out.light_distributions, CL_MAP_WRITE, &distribution_ptr).Wait();
-        auto current = distribution_ptr;
+        WriteLightDistribution(scene, light_power, GetEnvironmentSamplingTexture(env_textures), out);
 
-        // Write the number of segments first
-        *current++ = (int)light_distribution.m_num_segments;
+        out.num_lights = static_cast<int>(num_lights_written);
+    }
 
-        // Then write num_segments  + 1 CDF values
-        auto values = reinterpret_cast<float*>(current);
-        for (auto i = 0u; i < light_distribution.m_num_segments + 1; ++i)
-        {
-            values[i] = light_distribution.m_cdf[i];
-        }
 
-        // Then write num_segments PDF values
-        values += light_distribution.m_num_segments + 1;
+    ClwScene::TextureFormat ClwSceneController::GetPoolTextureFormat(Texture const& texture) const
+    {
+        auto format = GetTextureFormat(texture);
+        return (m_half_float_textures && format == ClwScene::TextureFormat::RGBA32) ? ClwScene::TextureFormat::RGBA16 : format;
+    }
 
-        for (auto i = 0u; i < light_distribution.m_num_segments; ++i)
+    // Box filter 2D texel data into an image of different dimensions and format
+    static void ResampleTexels(char const* src, ClwScene::TextureFormat src_format, RadeonRays::int3 const& src_size,
+                               char* dst, ClwScene::TextureFormat dst_format, RadeonRays::int3 const& dst_size)
+    {
+        for (auto y = 0; y < dst_size.y; ++y)
         {
-            values[i] = light_distribution.m_func_values[i] / light_distribution.m_func_sum;
-        }
+            auto y0 = y * src_size.y / dst_size.y;
+            auto y1 = std::max((y + 1) * src_size.y / dst_size.y, y0 + 1);
 
-        m_context.UnmapBuffer(0, out.light_distributions, distribution_ptr);
+            for (auto x = 0; x < dst_size.x; ++x)
+            {
+                auto x0 = x * src_size.x / dst_size.x;
+                auto x1 = std::max((x + 1) * src_size.x / dst_size.x, x0 + 1);
 
-        out.num_lights = static_cast<int>(num_lights_written);
-    }
+                RadeonRays::float4 value;
+                for (auto src_y = y0; src_y < y1; ++src_y)
+                {
+                    for (auto src_x = x0; src_x < x1; ++src_x)
+                    {
+                        value = value + LoadTexel(src, src_format, static_cast<std::size_t>(src_y) * src_size.x + src_x);
+                    }
+                }
 
+                StoreTexel(dst, dst_format, y * dst_size.x + x, value * (1.f / ((x1 - x0) * (y1 - y0))));
+            }
+        }
+    }
 
-    // Convert texture format into ClwScene:: types
-    static ClwScene::TextureFormat GetTextureFormat(Texture const& texture)
+    std::size_t ClwSceneController::GetPoolTextureSize(Texture const& texture) const
     {
-        switch (texture.GetFormat())
-        {
-            case Texture::Format::kRgba8: return ClwScene::TextureFormat::RGBA8;
-            case Texture::Format::kRgba16: return ClwScene::TextureFormat::RGBA16;
-            case Texture::Format::kRgba32: return ClwScene::TextureFormat::RGBA32;
-            default: return ClwScene::TextureFormat::RGBA8;
-        }
+        return GetMipChainSize(texture.GetSize(), GetPoolTextureFormat(texture));
     }
 
     void ClwSceneController::WriteTexture(Texture const& texture, std::size_t data_offset, void* data) const
@@ -1548,15 +2475,64 @@ namespace Baikal
         clw_texture->w = dim.x;
         clw_texture->h = dim.y;
         clw_texture->d = dim.z;
-        clw_texture->fmt = GetTextureFormat(texture);
+        clw_texture->fmt = GetPoolTextureFormat(texture);
+        clw_texture->dataoffset = static_cast<int>(data_offset);
+        clw_texture->num_levels = GetNumMipLevels(dim);
+        clw_texture->pagetable = -1;
+        clw_texture->feedback = -1;
+        clw_texture->num_tiled_levels = 0;
+    }
+
+    void ClwSceneController::WriteStreamedTexture(ClwTextureStreamer::Layout const& layout, std::size_t data_offset, void* data) const
+    {
+        auto clw_texture = reinterpret_cast<ClwScene::Texture*>(data);
+
+        clw_texture->w = layout.size.x;
+        clw_texture->h = layout.size.y;
+        clw_texture->d = 1;
+        clw_texture->fmt = layout.format;
         clw_texture->dataoffset = static_cast<int>(data_offset);
+        clw_texture->num_levels = GetNumMipLevels(layout.size);
+        clw_texture->pagetable = static_cast<int>(layout.page_table_offset);
+        clw_texture->feedback = static_cast<int>(layout.first_page);
+        clw_texture->num_tiled_levels = layout.num_tiled_levels;
     }
 
     void ClwSceneController::WriteTextureData(Texture const& texture, void* data) const
     {
-        auto begin = texture.GetData();
-        auto end = begin + texture.GetSizeInBytes();
-        std::copy(begin, end, static_cast<char*>(data));
+        auto size = texture.GetSize();
+        auto src_format = GetTextureFormat(texture);
+        auto dst_format = GetPoolTextureFormat(texture);
+        auto dst = static_cast<char*>(data);
+
+        // Level 0 is copied as is unless it needs format conversion
+        auto num_texels = static_cast<std::size_t>(size.x) * size.y * size.z;
+        if (src_format == dst_format)
+        {
+            auto begin = texture.GetData();
+            auto end = begin + texture.GetSizeInBytes();
+            std::copy(begin, end, dst);
+        }
+        else
+        {
+            for (std::size_t i = 0; i < num_texels; ++i)
+            {
+                StoreTexel(dst, dst_format, i, LoadTexel(texture.GetData(), src_format, i));
+            }
+        }
+
+        WriteMipChain(dst, dst_format, size);
+    }
+
+    void ClwSceneController::WriteStreamedTextureData(Texture const& texture, ClwTextureStreamer::Layout const& layout, void* data) const
+    {
+        auto tail_size = ClwTextureStreamer::GetTailSize(layout.size);
+        auto dst = static_cast<char*>(data);
+
+        // Top resident level is filtered from texture data, which is either
+        // full resolution image or a preview of the texture source
+        ResampleTexels(texture.GetData(), GetTextureFormat(texture), texture.GetSize(), dst, layout.format, tail_size);
+        WriteMipChain(dst, layout.format, tail_size);
     }
 
     void ClwSceneController::WriteVolume(VolumeMaterial const& volume, Collector& tex_collector, void* data) const
@@ -1617,47 +2593,88 @@ namespace Baikal
 
     void Baikal::ClwSceneController::UpdateInputMaps(const Baikal::Scene1& scene, Baikal::Collector& input_map_collector, Collector& input_map_leafs_collector, ClwScene& out) const
     {
-        CLInputMapGenerator generator;
-        generator.Generate(input_map_collector, input_map_leafs_collector);
-        std::string source = generator.GetGeneratedSource();
-        m_program_manager->AddHeader("inputmaps.cl", source);
-    }
+        // Update input map bundle to be able to track differences
+        out.input_map_bundle.reset(input_map_collector.CreateBundle());
 
-    void Baikal::ClwSceneController::UpdateLeafsData(Scene1 const& scene, Collector& input_map_leafs_collector, Collector& tex_collector, ClwScene& out) const
-    {
-        // Get new buffer size
-        std::size_t buffer_size = input_map_leafs_collector.GetNumItems();
+        // Both backends look input maps up through the same table
+        m_program_manager->LoadHeader(CLInputMapGenerator::GetTablePath());
 
-        // Recreate input map leafs buffer if it needs resize
-        if (buffer_size > out.input_map_data.GetElementCount())
+        // Interpreter source never changes, graph edits only touch the buffer.
+        // Graphs exceeding interpreter registers are handled by generated source.
+        CLInputMapCompiler compiler;
+        if (scene.GetInputMapMode() == Scene1::InputMapMode::kInterpreted &&
+            compiler.Compile(input_map_collector, input_map_leafs_collector))
         {
-            // Create material buffer
-            out.input_map_data = m_context.CreateBuffer<ClwScene::InputMapData>(buffer_size, CL_MEM_READ_ONLY);
-        }
+            out.input_map_program = compiler.GetProgram();
+            out.input_map_leaf_indices.clear();
+            out.input_map_header = CLInputMapCompiler::GetInterpreterSource();
 
-        if (buffer_size > 0)
+            m_program_manager->LoadHeader(CLInputMapCompiler::GetInterpreterPath());
+        }
+        else
         {
-            ClwScene::InputMapData *input_map_data = nullptr;
+            // Generated source only depends on graph structure, so it is shared by
+            // scenes with the same input map topology and hits program cache
+            CLInputMapGenerator generator;
+            generator.Generate(input_map_collector, input_map_leafs_collector);
+            out.input_map_program = generator.GetTable();
+            out.input_map_leaf_indices = generator.GetLeafIndices();
+            out.input_map_header = generator.GetGeneratedSource();
+        }
+
+        m_program_manager->AddHeader("inputmaps.cl", out.input_map_header);
 
-            // Map GPU input map buffer
-            m_context.MapBuffer(0, out.input_map_data, CL_MAP_WRITE, &input_map_data).Wait();
+        UploadInputMapProgram(out);
+    }
 
-            // Update input map leafs bundle to be able to track differences
-            out.input_map_leafs_bundle.reset(input_map_leafs_collector.CreateBundle());
+    void Baikal::ClwSceneController::UploadInputMapProgram(ClwScene& out) const
+    {
+        if (out.input_map_program.empty())
+        {
+            return;
+        }
 
-            // leaf iterator
-            auto iter = input_map_leafs_collector.CreateIterator();
-            std::size_t num_inputmap_leafs_written = 0;
+        std::vector<ClwScene::InputMapDataStorage> data;
+        data.reserve(out.input_map_program.size() + out.input_map_leafs.size() + out.input_map_leaf_indices.size());
+        data.insert(data.end(), out.input_map_program.cbegin(), out.input_map_program.cend());
 
-            // Iterate and serialize
-            for (; iter->IsValid(); iter->Next())
+        // Generated input maps address leafs through per input slots
+        if (!out.input_map_leaf_indices.empty())
+        {
+            for (auto index : out.input_map_leaf_indices)
             {
-                WriteInputMapLeaf(*iter->ItemAs<InputMap>(), tex_collector, input_map_data + num_inputmap_leafs_written);
-                ++num_inputmap_leafs_written;
+                data.push_back(out.input_map_leafs[index]);
             }
+        }
+        else
+        {
+            data.insert(data.end(), out.input_map_leafs.cbegin(), out.input_map_leafs.cend());
+        }
 
-            //Unmap buffer
-            m_context.UnmapBuffer(0, out.input_map_data, input_map_data);
+        // Recreate input map buffer if it needs resize
+        if (data.size() > out.input_map_data.GetElementCount())
+        {
+            out.input_map_data = m_context.CreateBuffer<ClwScene::InputMapData>(data.size(), CL_MEM_READ_ONLY);
+        }
+
+        m_context.WriteBuffer(0, out.input_map_data, reinterpret_cast<ClwScene::InputMapData*>(data.data()), data.size()).Wait();
+    }
+
+    void Baikal::ClwSceneController::UpdateLeafsData(Scene1 const& scene, Collector& input_map_leafs_collector, Collector& tex_collector, ClwScene& out) const
+    {
+        // Update input map leafs bundle to be able to track differences
+        out.input_map_leafs_bundle.reset(input_map_leafs_collector.CreateBundle());
+        out.input_map_leafs.resize(input_map_leafs_collector.GetNumItems());
+
+        // leaf iterator
+        auto iter = input_map_leafs_collector.CreateIterator();
+        std::size_t num_inputmap_leafs_written = 0;
+
+        // Iterate and serialize, leafs are uploaded along with input map table by UpdateInputMaps
+        for (; iter->IsValid(); iter->Next())
+        {
+            WriteInputMapLeaf(*iter->ItemAs<InputMap>(), tex_collector, out.input_map_leafs[num_inputmap_leafs_written].data());
+            ++num_inputmap_leafs_written;
         }
     }
 
@@ -29,12 +29,18 @@
 #pragma once
 
 #include "scene_controller.h"
+#include "clw_scene_cache.h"
+#include "clw_texture_streamer.h"
 #include "CLW.h"
 
 #include "SceneGraph/clwscene.h"
 
 #include "radeon_rays_cl.h"
 
+#include <memory>
+#include <string>
+#include <vector>
+
 namespace Baikal
 {
     class Scene1;
@@ -44,6 +50,7 @@ namespace Baikal
     class Light;
     class Texture;
     class CLProgramManager;
+    class ThreadPool;
 
 
     /**
@@ -65,6 +72,26 @@ namespace Baikal
         // Get underlying intersection API.
         RadeonRays::IntersectionApi* GetIntersectionApi() { return  m_api; }
 
+        // Enable persistent compiled scene cache in a given folder (empty path disables it).
+        // Geometry, material records and resident texture pool are cached.
+        void SetSceneCachePath(std::string const& cache_path);
+        // Get number of scene cache lookups served from disk and missed.
+        ClwSceneCache::Statistics GetSceneCacheStatistics() const;
+
+        // Store 32-bit float textures as 16-bit half floats in the texture pool.
+        // Should be set before the scene is compiled.
+        void SetHalfFloatTexturesEnabled(bool enabled);
+
+        // Store vertex attributes in a compact layout (packed positions, octahedral normals, half UVs).
+        // Should be set before the scene is compiled.
+        void SetCompactVertexFormatEnabled(bool enabled);
+
+        // Stream textures larger than a tile through a tile pool of a given size in bytes
+        // instead of keeping them in device memory entirely. Missing tiles are requested
+        // by kernels and loaded between CompileScene calls.
+        // Should be set before the scene is compiled.
+        void SetTextureStreamingEnabled(bool enabled, std::size_t tile_pool_size);
+
     protected:
         // Clear intersector and load meshes into it.
         void ReloadIntersector(Scene1 const& scene, ClwScene& inout) const;
@@ -94,28 +121,54 @@ namespace Baikal
         void UpdateVolumes(Scene1 const& scene, Collector& volume_collector, Collector& tex_collector, ClwScene& out) const override;
         // If scene attributes changed
         void UpdateSceneAttributes(Scene1 const& scene, Collector& tex_collector, ClwScene& out) const override;
+        // Upload streamed texture tiles requested by previous iterations
+        void UpdateResidency(Scene1 const& scene, ClwScene& out) const override;
+        // Commit intersector changes made during the compilation
+        void CommitUpdates(Scene1 const& scene, ClwScene& out) const override;
 
-        // Update intersection API
+        // Update intersection API, only added or modified shapes are recreated
         void UpdateIntersector(Scene1 const& scene, ClwScene& out) const;
-        void UpdateIntersectorTransforms(Scene1 const& scene, ClwScene& out) const;
+        // Refit transforms and masks of given shapes without recreating them
+        void UpdateIntersectorTransforms(std::vector<Shape::Ptr> const& shapes, ClwScene& out) const;
         // Write out single material at data pointer.
         // Collectors are required to convert texture and material pointers into indices.
         void WriteMaterial(Material const& material, Collector& mat_collector, Collector& tex_collector, void* data) const;
         // Write out single light at data pointer.
         // Collector is required to convert texture pointers into indices.
         void WriteLight(Scene1 const& scene, Light const& light, Collector& tex_collector, void* data) const;
+        // Write out light power distribution used for light sampling followed by light BVH
+        // and environment map distribution (if env_texture is present).
+        void WriteLightDistribution(Scene1 const& scene, std::vector<float> const& light_power, Texture::Ptr env_texture, ClwScene& out) const;
+        // Append light BVH, light index to leaf mapping and area light lookup table to out.
+        void WriteLightBvh(Scene1 const& scene, std::vector<float> const& light_power, std::vector<int>& out) const;
+        // Write out transform, material and volume of a single shape at data pointer.
+        // Geometry offsets are left intact.
+        void WriteShapeProperties(Shape const& shape, Collector& mat_collector, Collector& volume_collector, void* data) const;
         // Write out single texture header at data pointer.
         // Header requires texture data offset, so it is passed in.
         void WriteTexture(Texture const& texture, std::size_t data_offset, void* data) const;
-        // Write out texture data at data pointer.
+        // Write out texture data along with its mip chain at data pointer.
         void WriteTextureData(Texture const& texture, void* data) const;
+        // Write out streamed texture header at data pointer.
+        void WriteStreamedTexture(ClwTextureStreamer::Layout const& layout, std::size_t data_offset, void* data) const;
+        // Write out resident mip tail of a streamed texture at data pointer.
+        void WriteStreamedTextureData(Texture const& texture, ClwTextureStreamer::Layout const& layout, void* data) const;
+        // Get format of a texture in the texture pool.
+        ClwScene::TextureFormat GetPoolTextureFormat(Texture const& texture) const;
+        // Get size of texture data in the texture pool including all mip levels.
+        std::size_t GetPoolTextureSize(Texture const& texture) const;
         // Write single volume at data pointer
         void WriteVolume(VolumeMaterial const& volume, Collector& tex_collector, void* data) const;
         // Write single input map leaf at data pointer
         // Collectore is required to convert texture pointers into indices.
         void WriteInputMapLeaf(InputMap const& leaf, Collector& tex_collector, void* data) const;
+        // Upload input map table followed by leafs into input_map_data
+        void UploadInputMapProgram(ClwScene& out) const;
 
     private:
+        // Scene cache key of collected objects, accumulated into a given key
+        std::uint64_t GetCollectorKey(Collector const& collector, std::uint64_t key) const;
+
         int GetMaterialIndex(Collector const& collector, Material::Ptr material) const;
         int GetTextureIndex(Collector const& collector, Texture::Ptr material) const;
         int GetVolumeIndex(Collector const& collector, VolumeMaterial::Ptr volume) const;
@@ -128,5 +181,17 @@ namespace Baikal
         Material::Ptr m_default_material;
         // CL Program manager
         const CLProgramManager *m_program_manager;
+        // Persistent compiled scene cache (optional)
+        std::unique_ptr<ClwSceneCache> m_scene_cache;
+        // Workers for CPU side scene serialization
+        std::unique_ptr<ThreadPool> m_thread_pool;
+        // Convert RGBA32 textures into RGBA16 in the texture pool
+        bool m_half_float_textures;
+        // Use VERTEX_FORMAT_COMPACT (or VERTEX_FORMAT_COMPACT_FLOAT_UV) for geometry buffers
+        bool m_compact_vertices;
+        // Texture streaming tile pool size (0 if streaming is disabled)
+        std::size_t m_tile_pool_size;
+        // Intersector shapes have been changed but not committed yet
+        mutable bool m_intersector_dirty;
     };
 }
@@ -0,0 +1,208 @@
+/**********************************************************************
+ Copyright (c) 2016 Advanced Micro Devices, Inc. All rights reserved.
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+ ********************************************************************/
+
+
+/**
+ \file clw_texture_format.h
+ \brief Texel format helpers shared by texture pool writers.
+ */
+#pragma once
+
+#include "SceneGraph/clwscene.h"
+#include "SceneGraph/texture.h"
+#include "Utils/half.h"
+
+#include <algorithm>
+#include <cstdint>
+
+namespace Baikal
+{
+    // Convert texture format into ClwScene:: types
+    inline ClwScene::TextureFormat GetTextureFormat(Texture const& texture)
+    {
+        switch (texture.GetFormat())
+        {
+            case Texture::Format::kRgba8: return ClwScene::TextureFormat::RGBA8;
+            case Texture::Format::kRgba16: return ClwScene::TextureFormat::RGBA16;
+            case Texture::Format::kRgba32: return ClwScene::TextureFormat::RGBA32;
+            default: return ClwScene::TextureFormat::RGBA8;
+        }
+    }
+
+    // Get size of a single texel of a given format
+    inline std::size_t GetTexelSize(ClwScene::TextureFormat format)
+    {
+        switch (format)
+        {
+            case ClwScene::TextureFormat::RGBA8: return 4;
+            case ClwScene::TextureFormat::RGBA16: return 8;
+            case ClwScene::TextureFormat::RGBA32: return 16;
+            default: return 0;
+        }
+    }
+
+    // Get number of mip levels down to 1x1, volume textures only have a single level
+    inline int GetNumMipLevels(RadeonRays::int3 const& size)
+    {
+        if (size.z > 1)
+        {
+            return 1;
+        }
+
+        auto num_levels = 1;
+        for (auto w = size.x, h = size.y; w > 1 || h > 1; ++num_levels)
+        {
+            w = std::max(w / 2, 1);
+            h = std::max(h / 2, 1);
+        }
+
+        return num_levels;
+    }
+
+    // Read texel at a given index as float4
+    inline RadeonRays::float4 LoadTexel(char const* data, ClwScene::TextureFormat format, std::size_t idx)
+    {
+        switch (format)
+        {
+            case ClwScene::TextureFormat::RGBA8:
+            {
+                auto texel = reinterpret_cast<std::uint8_t const*>(data) + 4 * idx;
+                return RadeonRays::float4(texel[0], texel[1], texel[2], texel[3]) * (1.f / 255.f);
+            }
+            case ClwScene::TextureFormat::RGBA16:
+            {
+                auto texel = reinterpret_cast<std::uint16_t const*>(data) + 4 * idx;
+                half r, g, b, a;
+                r.setBits(texel[0]);
+                g.setBits(texel[1]);
+                b.setBits(texel[2]);
+                a.setBits(texel[3]);
+                return RadeonRays::float4(r, g, b, a);
+            }
+            case ClwScene::TextureFormat::RGBA32:
+            {
+                auto texel = reinterpret_cast<float const*>(data) + 4 * idx;
+                return RadeonRays::float4(texel[0], texel[1], texel[2], texel[3]);
+            }
+            default:
+                return RadeonRays::float4();
+        }
+    }
+
+    // Write float4 value into texel at a given index
+    inline void StoreTexel(char* data, ClwScene::TextureFormat format, std::size_t idx, RadeonRays::float4 const& value)
+    {
+        switch (format)
+        {
+            case ClwScene::TextureFormat::RGBA8:
+            {
+                auto texel = reinterpret_cast<std::uint8_t*>(data) + 4 * idx;
+                for (auto i = 0; i < 4; ++i)
+                {
+                    texel[i] = static_cast<std::uint8_t>(std::min(std::max(value[i], 0.f), 1.f) * 255.f + 0.5f);
+                }
+                break;
+            }
+            case ClwScene::TextureFormat::RGBA16:
+            {
+                // Values out of half range would turn into infinities and spread over mips
+                auto texel = reinterpret_cast<std::uint16_t*>(data) + 4 * idx;
+                auto const max_value = static_cast<float>(HALF_MAX);
+                for (auto i = 0; i < 4; ++i)
+                {
+                    texel[i] = half(std::min(std::max(value[i], -max_value), max_value)).bits();
+                }
+                break;
+            }
+            case ClwScene::TextureFormat::RGBA32:
+            {
+                auto texel = reinterpret_cast<float*>(data) + 4 * idx;
+                for (auto i = 0; i < 4; ++i)
+                {
+                    texel[i] = value[i];
+                }
+                break;
+            }
+            default:
+                break;
+        }
+    }
+
+    // Get size of a mip chain starting at a given level 0 size
+    inline std::size_t GetMipChainSize(RadeonRays::int3 const& size, ClwScene::TextureFormat format)
+    {
+        auto texel_size = GetTexelSize(format);
+        auto num_levels = GetNumMipLevels(size);
+
+        std::size_t chain_size = 0;
+        for (auto level = 0, w = size.x, h = size.y; level < num_levels; ++level)
+        {
+            chain_size += texel_size * w * h * size.z;
+            w = std::max(w / 2, 1);
+            h = std::max(h / 2, 1);
+        }
+
+        return chain_size;
+    }
+
+    // Build mip levels 1..n in place following level 0 at data pointer
+    inline void WriteMipChain(char* data, ClwScene::TextureFormat format, RadeonRays::int3 const& size)
+    {
+        auto num_levels = GetNumMipLevels(size);
+        auto texel_size = GetTexelSize(format);
+        auto src_width = size.x;
+        auto src_height = size.y;
+        auto src = data;
+
+        // Each next level is box filtered from the previous one
+        for (auto level = 1; level < num_levels; ++level)
+        {
+            auto dst = src + texel_size * src_width * src_height;
+
+            auto width = std::max(src_width / 2, 1);
+            auto height = std::max(src_height / 2, 1);
+
+            for (auto y = 0; y < height; ++y)
+            {
+                auto y0 = std::min(2 * y, src_height - 1);
+                auto y1 = std::min(2 * y + 1, src_height - 1);
+
+                for (auto x = 0; x < width; ++x)
+                {
+                    auto x0 = std::min(2 * x, src_width - 1);
+                    auto x1 = std::min(2 * x + 1, src_width - 1);
+
+                    auto value = LoadTexel(src, format, y0 * src_width + x0) +
+                                 LoadTexel(src, format, y0 * src_width + x1) +
+                                 LoadTexel(src, format, y1 * src_width + x0) +
+                                 LoadTexel(src, format, y1 * src_width + x1);
+
+                    StoreTexel(dst, format, y * width + x, value * 0.25f);
+                }
+            }
+
+            src = dst;
+            src_width = width;
+            src_height = height;
+        }
+    }
+}
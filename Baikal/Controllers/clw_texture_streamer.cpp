@@ -0,0 +1,496 @@
+/**********************************************************************
+ Copyright (c) 2016 Advanced Micro Devices, Inc. All rights reserved.
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+ ********************************************************************/
+#include "Controllers/clw_texture_streamer.h"
+#include "Controllers/clw_texture_format.h"
+#include "Utils/log.h"
+
+#include <algorithm>
+#include <climits>
+#include <stdexcept>
+
+namespace Baikal
+{
+    static std::size_t GetNumTiles(int size)
+    {
+        return static_cast<std::size_t>((size + ClwTextureStreamer::kTileSize - 1) / ClwTextureStreamer::kTileSize);
+    }
+
+    // Read a row of full resolution texels either from texture source or texture data
+    static void ReadTextureRow(Texture const& texture, int x, int y, int width, char* data)
+    {
+        if (auto source = texture.GetSource())
+        {
+            source->ReadRow(x, y, width, data);
+        }
+        else
+        {
+            auto texel_size = GetTexelSize(GetTextureFormat(texture));
+            auto row = texture.GetData() + texel_size * (static_cast<std::size_t>(y) * texture.GetSize().x + x);
+            std::copy(row, row + texel_size * width, data);
+        }
+    }
+
+    // Check if a command has finished (or failed) without waiting for it
+    static bool IsComplete(CLWEvent const& event)
+    {
+        cl_event handle = event;
+        cl_int status = CL_COMPLETE;
+        clGetEventInfo(handle, CL_EVENT_COMMAND_EXECUTION_STATUS, sizeof(status), &status, nullptr);
+        return status <= CL_COMPLETE;
+    }
+
+    ClwTextureStreamer::ClwTextureStreamer(CLWContext context, std::size_t pool_size)
+        : m_context(context)
+        , m_pool_size(pool_size)
+        , m_page_table_offset(0)
+        , m_pool_offset(0)
+        , m_feedback_pending(false)
+        , m_update_index(0)
+        , m_stop(false)
+    {
+    }
+
+    ClwTextureStreamer::~ClwTextureStreamer()
+    {
+        StopWorker();
+        WaitFeedback();
+    }
+
+    RadeonRays::int3 ClwTextureStreamer::GetStreamedSize(Texture const& texture)
+    {
+        auto source = texture.GetSource();
+        return source ? source->GetSize() : texture.GetSize();
+    }
+
+    int ClwTextureStreamer::GetNumTiledLevels(RadeonRays::int3 const& size)
+    {
+        if (size.z > 1)
+        {
+            return 0;
+        }
+
+        auto num_levels = 0;
+        for (auto w = size.x, h = size.y; std::max(w, h) > kTileSize; ++num_levels)
+        {
+            w = std::max(w / 2, 1);
+            h = std::max(h / 2, 1);
+        }
+
+        return num_levels;
+    }
+
+    RadeonRays::int3 ClwTextureStreamer::GetTailSize(RadeonRays::int3 const& size)
+    {
+        auto tail = size;
+        for (auto level = GetNumTiledLevels(size); level > 0; --level)
+        {
+            tail.x = std::max(tail.x / 2, 1);
+            tail.y = std::max(tail.y / 2, 1);
+        }
+
+        return tail;
+    }
+
+    void ClwTextureStreamer::Clear()
+    {
+        StopWorker();
+        WaitFeedback();
+
+        m_textures.clear();
+        m_page_table.clear();
+        m_feedback.clear();
+        m_page_slots.clear();
+        m_slots.clear();
+        m_lru.clear();
+        m_failed.clear();
+    }
+
+    int ClwTextureStreamer::AddTexture(Texture::Ptr texture, ClwScene::TextureFormat format)
+    {
+        auto size = GetStreamedSize(*texture);
+        auto num_tiled_levels = GetNumTiledLevels(size);
+
+        if (num_tiled_levels == 0)
+        {
+            return -1;
+        }
+
+        Layout layout = {};
+        layout.size = size;
+        layout.format = format;
+        layout.num_tiled_levels = num_tiled_levels;
+        layout.first_page = m_page_table.size();
+
+        for (auto level = 0, w = size.x, h = size.y; level < num_tiled_levels; ++level)
+        {
+            layout.num_pages += GetNumTiles(w) * GetNumTiles(h);
+            w = std::max(w / 2, 1);
+            h = std::max(h / 2, 1);
+        }
+
+        // Nothing is resident yet
+        m_page_table.resize(m_page_table.size() + layout.num_pages, -1);
+
+        m_textures.push_back({ texture, layout });
+        return static_cast<int>(m_textures.size() - 1);
+    }
+
+    std::size_t ClwTextureStreamer::Place(std::size_t offset)
+    {
+        WaitFeedback();
+
+        auto num_pages = m_page_table.size();
+
+        // Kernels get a valid feedback buffer even if nothing is streamed
+        m_feedback.assign(num_pages, 0);
+        m_feedback_buffer = m_context.CreateBuffer<int>(std::max<std::size_t>(num_pages, 1), CL_MEM_READ_WRITE);
+        m_context.FillBuffer(0, m_feedback_buffer, 0, m_feedback_buffer.GetElementCount());
+
+        if (m_textures.empty())
+        {
+            return 0;
+        }
+
+        m_page_table_offset = offset;
+        m_pool_offset = (m_page_table_offset + num_pages * sizeof(int) + 0xF) / 0x10 * 0x10;
+
+        auto num_slots = std::max<std::size_t>(m_pool_size / kTileSlotSize, 1);
+        auto end = m_pool_offset + num_slots * kTileSlotSize;
+
+        // Kernels address texture data with 32-bit offsets
+        if (end > static_cast<std::size_t>(INT_MAX))
+        {
+            throw std::runtime_error("ClwTextureStreamer: texture data exceeds 2GB");
+        }
+
+        for (auto& texture : m_textures)
+        {
+            texture.layout.page_table_offset = m_page_table_offset + texture.layout.first_page * sizeof(int);
+        }
+
+        m_page_slots.assign(num_pages, -1);
+
+        m_slots.resize(num_slots);
+        m_lru.clear();
+
+        for (auto i = 0u; i < num_slots; ++i)
+        {
+            m_slots[i].page = -1;
+            m_slots[i].last_used = 0;
+            m_slots[i].lru = m_lru.insert(m_lru.end(), i);
+        }
+
+        return end - offset;
+    }
+
+    void ClwTextureStreamer::WriteRegion(char* data) const
+    {
+        auto page_table = reinterpret_cast<char const*>(m_page_table.data());
+
+        std::copy(page_table, page_table + m_page_table.size() * sizeof(int), data);
+    }
+
+    std::size_t ClwTextureStreamer::Update(CLWBuffer<char> texturedata)
+    {
+        if (m_textures.empty())
+        {
+            return 0;
+        }
+
+        if (!m_worker.joinable())
+        {
+            m_worker = std::thread(&ClwTextureStreamer::WorkerMain, this);
+        }
+
+        ++m_update_index;
+
+        std::vector<std::size_t> requests;
+
+        // Pages touched by the kernels are processed once their readback has finished,
+        // until then tiles requested earlier keep being uploaded
+        if (m_feedback_pending && IsComplete(m_feedback_event))
+        {
+            m_feedback_pending = false;
+
+            for (auto page = 0u; page < m_feedback.size(); ++page)
+            {
+                if (!m_feedback[page])
+                {
+                    continue;
+                }
+
+                auto slot = m_page_slots[page];
+
+                if (slot >= 0)
+                {
+                    m_slots[slot].last_used = m_update_index;
+                    m_lru.splice(m_lru.begin(), m_lru, m_slots[slot].lru);
+                }
+                else if (!m_failed.count(page) && m_pending.insert(page).second)
+                {
+                    requests.push_back(page);
+                }
+            }
+        }
+
+        // Read usage back and reset it for the next iterations, both are queued after the current ones
+        if (!m_feedback_pending)
+        {
+            m_feedback_event = m_context.ReadBuffer(0, m_feedback_buffer, m_feedback.data(), m_feedback.size());
+            m_context.FillBuffer(0, m_feedback_buffer, 0, m_feedback.size());
+            m_context.Flush(0);
+            m_feedback_pending = true;
+        }
+
+        if (!requests.empty())
+        {
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_requests.insert(m_requests.end(), requests.cbegin(), requests.cend());
+            }
+
+            m_condition.notify_one();
+        }
+
+        // Upload tiles loaded since the last update
+        std::vector<LoadedTile> loaded;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            loaded.swap(m_loaded);
+        }
+
+        std::vector<CLWEvent> events;
+
+        for (auto& tile : loaded)
+        {
+            m_pending.erase(tile.page);
+
+            // Kernels keep sampling the mip tail in place of the tile
+            if (tile.data.empty())
+            {
+                m_failed.insert(tile.page);
+                continue;
+            }
+
+            // Pool is full of tiles in use, the page is going to be requested again
+            auto slot = AcquireSlot();
+            if (slot < 0)
+            {
+                continue;
+            }
+
+            auto& s = m_slots[slot];
+
+            if (s.page >= 0)
+            {
+                m_page_table[s.page] = -1;
+                m_page_slots[s.page] = -1;
+            }
+
+            s.page = static_cast<std::int64_t>(tile.page);
+            s.last_used = m_update_index;
+            m_lru.splice(m_lru.begin(), m_lru, s.lru);
+
+            auto offset = m_pool_offset + slot * kTileSlotSize;
+            events.push_back(m_context.WriteBuffer(0, texturedata, tile.data.data(), offset, tile.data.size()));
+
+            m_page_table[tile.page] = static_cast<int>(offset);
+            m_page_slots[tile.page] = slot;
+        }
+
+        if (!events.empty())
+        {
+            m_context.WriteBuffer(0, texturedata, reinterpret_cast<char*>(m_page_table.data()),
+                                  m_page_table_offset, m_page_table.size() * sizeof(int)).Wait();
+
+            for (auto& e : events)
+            {
+                e.Wait();
+            }
+        }
+
+        return events.size();
+    }
+
+    std::int64_t ClwTextureStreamer::AcquireSlot()
+    {
+        auto slot = m_lru.back();
+
+        if (m_slots[slot].page >= 0 && m_slots[slot].last_used == m_update_index)
+        {
+            return -1;
+        }
+
+        return static_cast<std::int64_t>(slot);
+    }
+
+    void ClwTextureStreamer::LoadTile(std::size_t page, std::vector<char>& data) const
+    {
+        // Find the texture owning the page
+        auto iter = std::upper_bound(m_textures.cbegin(), m_textures.cend(), page,
+            [](std::size_t page, StreamedTexture const& texture)
+            {
+                return page < texture.layout.first_page;
+            });
+
+        auto const& texture = *(iter - 1);
+        auto const& layout = texture.layout;
+
+        // Find mip level and tile coordinates
+        auto local_page = page - layout.first_page;
+        auto level = 0;
+        auto width = layout.size.x;
+        auto height = layout.size.y;
+
+        for (; level < layout.num_tiled_levels - 1; ++level)
+        {
+            auto num_tiles = GetNumTiles(width) * GetNumTiles(height);
+
+            if (local_page < num_tiles)
+            {
+                break;
+            }
+
+            local_page -= num_tiles;
+            width = std::max(width / 2, 1);
+            height = std::max(height / 2, 1);
+        }
+
+        auto tile_x = static_cast<int>(local_page % GetNumTiles(width));
+        auto tile_y = static_cast<int>(local_page / GetNumTiles(width));
+
+        auto x0 = tile_x * kTileSize;
+        auto y0 = tile_y * kTileSize;
+        auto x1 = std::min(x0 + kTileSize, width);
+        auto y1 = std::min(y0 + kTileSize, height);
+
+        // Each texel of the level is a box filtered block of full resolution texels,
+        // the last row and column of a level also cover the remainder of odd sizes
+        auto scale = 1 << level;
+        auto src_width = layout.size.x;
+        auto src_height = layout.size.y;
+        auto src_x0 = x0 * scale;
+        auto src_x1 = x1 == width ? src_width : std::min(x1 * scale, src_width);
+
+        auto src_format = GetTextureFormat(*texture.texture);
+        auto src_texel_size = GetTexelSize(src_format);
+
+        std::vector<char> row(src_texel_size * (src_x1 - src_x0));
+        std::vector<RadeonRays::float4> accum(x1 - x0);
+
+        data.assign(kTileSize * kTileSize * GetTexelSize(layout.format), 0);
+
+        for (auto y = y0; y < y1; ++y)
+        {
+            std::fill(accum.begin(), accum.end(), RadeonRays::float4());
+
+            auto row_begin = y * scale;
+            auto row_end = y == height - 1 ? src_height : std::min(row_begin + scale, src_height);
+
+            for (auto src_y = row_begin; src_y < row_end; ++src_y)
+            {
+                ReadTextureRow(*texture.texture, src_x0, src_y, src_x1 - src_x0, row.data());
+
+                for (auto src_x = src_x0; src_x < src_x1; ++src_x)
+                {
+                    auto x = std::min(src_x / scale, x1 - 1) - x0;
+                    accum[x] = accum[x] + LoadTexel(row.data(), src_format, src_x - src_x0);
+                }
+            }
+
+            for (auto x = x0; x < x1; ++x)
+            {
+                auto column_begin = x * scale;
+                auto column_end = x == width - 1 ? src_width : std::min(column_begin + scale, src_width);
+                auto weight = 1.f / ((column_end - column_begin) * (row_end - row_begin));
+
+                StoreTexel(data.data(), layout.format, (y - y0) * kTileSize + (x - x0), accum[x - x0] * weight);
+            }
+        }
+    }
+
+    void ClwTextureStreamer::WaitFeedback()
+    {
+        if (m_feedback_pending)
+        {
+            m_feedback_event.Wait();
+            m_feedback_pending = false;
+        }
+    }
+
+    void ClwTextureStreamer::StopWorker()
+    {
+        if (m_worker.joinable())
+        {
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_stop = true;
+                m_requests.clear();
+            }
+
+            m_condition.notify_all();
+            m_worker.join();
+        }
+
+        m_stop = false;
+        m_loaded.clear();
+        m_pending.clear();
+    }
+
+    void ClwTextureStreamer::WorkerMain()
+    {
+        for (;;)
+        {
+            std::size_t page = 0;
+
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_condition.wait(lock, [this]() { return m_stop || !m_requests.empty(); });
+
+                if (m_stop)
+                {
+                    return;
+                }
+
+                page = m_requests.front();
+                m_requests.pop_front();
+            }
+
+            LoadedTile tile;
+            tile.page = page;
+
+            try
+            {
+                LoadTile(page, tile.data);
+            }
+            catch (std::exception const& e)
+            {
+                // Empty data marks the page as failed, so it is not requested again
+                LogError("ClwTextureStreamer: failed to load tile: ", e.what(), "\n");
+                tile.data.clear();
+            }
+
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_loaded.push_back(std::move(tile));
+        }
+    }
+}
@@ -0,0 +1,198 @@
+/**********************************************************************
+ Copyright (c) 2016 Advanced Micro Devices, Inc. All rights reserved.
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+ ********************************************************************/
+
+
+/**
+ \file clw_texture_streamer.h
+ \brief Contains ClwTextureStreamer class declaration.
+ */
+#pragma once
+
+#include "CLW.h"
+#include "SceneGraph/clwscene.h"
+#include "SceneGraph/texture.h"
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <list>
+#include <mutex>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+namespace Baikal
+{
+    /**
+     \brief Keeps a fixed size pool of texture tiles resident on the device.
+
+     Large textures are not copied into the texture pool entirely. Only their mip tail
+     (levels fitting into a single tile) is resident, the remaining levels are split into
+     kTileSize x kTileSize tiles referenced through a page table. Kernels mark the pages they
+     touch in a separate feedback buffer, ClwTextureStreamer reads it back asynchronously between
+     iterations, loads missing tiles on a worker thread and uploads them into least recently used
+     pool slots. Until a tile arrives kernels fall back to the resident mip tail, tiles failing
+     to load are not requested again.
+
+     Page tables and tile pool are placed at the end of read only texturedata buffer:
+     [resident data][page tables][tile slots]
+     */
+    class ClwTextureStreamer
+    {
+    public:
+        // Tile dimensions in texels
+        static int constexpr kTileSize = 64;
+        // Pool slot size in bytes (large enough for RGBA32 tiles)
+        static std::size_t constexpr kTileSlotSize = kTileSize * kTileSize * 16;
+
+        // Placement of a streamed texture
+        struct Layout
+        {
+            // Full resolution dimensions
+            RadeonRays::int3 size;
+            // Pool format
+            ClwScene::TextureFormat format;
+            // Number of mip levels split into tiles
+            int num_tiled_levels;
+            // Index of the first page in the page table and feedback buffer
+            std::size_t first_page;
+            // Number of pages
+            std::size_t num_pages;
+            // Byte offset of the page table entries of this texture
+            std::size_t page_table_offset;
+        };
+
+        // Constructor
+        ClwTextureStreamer(CLWContext context, std::size_t pool_size);
+        // Destructor
+        ~ClwTextureStreamer();
+
+        // Get full resolution dimensions of a texture
+        static RadeonRays::int3 GetStreamedSize(Texture const& texture);
+        // Get number of mip levels split into tiles for given dimensions, 0 if the texture fits a tile
+        static int GetNumTiledLevels(RadeonRays::int3 const& size);
+        // Get dimensions of the first resident (tail) mip level
+        static RadeonRays::int3 GetTailSize(RadeonRays::int3 const& size);
+
+        // Drop all textures and residency state, called when texturedata is rebuilt
+        void Clear();
+        // Register a texture, returns its index or -1 if the texture is too small to be streamed
+        int AddTexture(Texture::Ptr texture, ClwScene::TextureFormat format);
+        // Assign page table and pool placement starting at offset within texturedata
+        // and create feedback buffer. Returns the number of bytes occupied by the streaming region.
+        std::size_t Place(std::size_t offset);
+        // Get layout of a registered texture (valid after Place)
+        Layout const& GetLayout(int index) const { return m_textures[index].layout; }
+        // Write initial streaming region contents (nothing resident) at data pointer
+        void WriteRegion(char* data) const;
+        // Get buffer kernels write page usage into (valid after Place)
+        CLWBuffer<int> GetFeedbackBuffer() const { return m_feedback_buffer; }
+
+        // Process kernel feedback read back since the last update, schedule missing tiles
+        // and upload tiles loaded so far. Never waits for the feedback readback to finish.
+        // Returns the number of tiles uploaded.
+        std::size_t Update(CLWBuffer<char> texturedata);
+
+        // Get number of tile slots in the pool
+        std::size_t GetNumSlots() const { return m_slots.size(); }
+        // Get number of tiles which failed to load
+        std::size_t GetNumFailedTiles() const { return m_failed.size(); }
+        // Check if all the tiles requested so far have been uploaded or failed
+        bool IsIdle() const { return m_pending.empty(); }
+
+        // Disallow copying
+        ClwTextureStreamer(ClwTextureStreamer const&) = delete;
+        ClwTextureStreamer& operator = (ClwTextureStreamer const&) = delete;
+
+    private:
+        // Registered texture
+        struct StreamedTexture
+        {
+            Texture::Ptr texture;
+            Layout layout;
+        };
+
+        // Tile loaded by the worker, data is empty if loading failed
+        struct LoadedTile
+        {
+            std::size_t page;
+            std::vector<char> data;
+        };
+
+        // Tile pool slot
+        struct Slot
+        {
+            // Page occupying the slot (-1 if free)
+            std::int64_t page;
+            // Update the slot has been used last
+            std::uint64_t last_used;
+            // Position in LRU list
+            std::list<std::size_t>::iterator lru;
+        };
+
+        // Load tile data of a given page in pool format
+        void LoadTile(std::size_t page, std::vector<char>& data) const;
+        // Get a slot to upload a tile into, evicting the least recently used one.
+        // Returns -1 if all slots have been used during the current update.
+        std::int64_t AcquireSlot();
+        // Wait for feedback readback in flight, host feedback copy is its destination
+        void WaitFeedback();
+        // Stop worker thread and drop pending requests
+        void StopWorker();
+        // Worker thread main function
+        void WorkerMain();
+
+        CLWContext m_context;
+        std::size_t m_pool_size;
+        std::vector<StreamedTexture> m_textures;
+        // Byte offsets of streaming region parts within texturedata
+        std::size_t m_page_table_offset;
+        std::size_t m_pool_offset;
+
+        // Host copy of the page table (byte offsets of tiles or -1)
+        std::vector<int> m_page_table;
+        // Feedback written by kernels and its host copy, which is the destination
+        // of the readback in flight while m_feedback_pending is set
+        CLWBuffer<int> m_feedback_buffer;
+        std::vector<int> m_feedback;
+        CLWEvent m_feedback_event;
+        bool m_feedback_pending;
+        // Slot of each page (-1 if not resident)
+        std::vector<std::int64_t> m_page_slots;
+
+        // Tile slots ordered by last use (most recent first)
+        std::vector<Slot> m_slots;
+        std::list<std::size_t> m_lru;
+        std::uint64_t m_update_index;
+
+        // Worker state
+        std::thread m_worker;
+        std::mutex m_mutex;
+        std::condition_variable m_condition;
+        std::deque<std::size_t> m_requests;
+        std::vector<LoadedTile> m_loaded;
+        std::unordered_set<std::size_t> m_pending;
+        // Pages which failed to load, never requested again
+        std::unordered_set<std::size_t> m_failed;
+        bool m_stop;
+    };
+}
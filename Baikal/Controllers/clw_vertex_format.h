@@ -0,0 +1,212 @@
+/**********************************************************************
+ Copyright (c) 2016 Advanced Micro Devices, Inc. All rights reserved.
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+ ********************************************************************/
+
+
+
+/**
+ \file clw_vertex_format.h
+ \brief Vertex attribute encoders and decoders for scene geometry buffers.
+ */
+#pragma once
+
+#include "SceneGraph/clwscene.h"
+#include "Utils/half.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+namespace Baikal
+{
+    // Get size of a single vertex position of a given format
+    inline std::size_t GetPositionSize(ClwScene::VertexFormat format)
+    {
+        return format != ClwScene::VERTEX_FORMAT_FLOAT ? 3 * sizeof(float) : sizeof(RadeonRays::float3);
+    }
+
+    // Get size of a single vertex normal of a given format
+    inline std::size_t GetNormalSize(ClwScene::VertexFormat format)
+    {
+        return format != ClwScene::VERTEX_FORMAT_FLOAT ? sizeof(std::uint32_t) : sizeof(RadeonRays::float3);
+    }
+
+    // Get size of a single vertex UV of a given format
+    inline std::size_t GetUVSize(ClwScene::VertexFormat format)
+    {
+        return format == ClwScene::VERTEX_FORMAT_COMPACT ? 2 * sizeof(std::uint16_t) : sizeof(RadeonRays::float2);
+    }
+
+    // Largest UV magnitude kept as half by VERTEX_FORMAT_COMPACT. Half spacing is 2^-10
+    // below 2, so rounding stays within half a texel of a 1024 texel wide texture.
+    float constexpr kMaxHalfUV = 2.f;
+
+    // Check if UVs can be stored as half without visible loss of precision
+    inline bool CanStoreHalfUVs(RadeonRays::float2 const* uvs, std::size_t count)
+    {
+        for (auto i = 0u; i < count; ++i)
+        {
+            // Negated comparison catches NaNs as well
+            if (!(std::abs(uvs[i].x) <= kMaxHalfUV && std::abs(uvs[i].y) <= kMaxHalfUV))
+            {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    // Pack direction into two 16 bit snorm octahedral coordinates (matches DecodeOctahedralNormal in scene.cl)
+    inline std::uint32_t EncodeOctahedralNormal(RadeonRays::float3 const& n)
+    {
+        auto l1 = std::abs(n.x) + std::abs(n.y) + std::abs(n.z);
+
+        if (l1 == 0.f)
+        {
+            return 0;
+        }
+
+        auto x = n.x / l1;
+        auto y = n.y / l1;
+
+        // Fold lower hemisphere over the diagonals
+        if (n.z < 0.f)
+        {
+            auto fx = (1.f - std::abs(y)) * (x >= 0.f ? 1.f : -1.f);
+            auto fy = (1.f - std::abs(x)) * (y >= 0.f ? 1.f : -1.f);
+            x = fx;
+            y = fy;
+        }
+
+        auto quantize = [](float v) -> std::uint32_t
+        {
+            auto snorm = static_cast<std::int16_t>(std::round(std::min(std::max(v, -1.f), 1.f) * 32767.f));
+            return static_cast<std::uint16_t>(snorm);
+        };
+
+        return quantize(x) | (quantize(y) << 16);
+    }
+
+    // Write count positions at data pointer
+    inline void WritePositions(RadeonRays::float3 const* positions, std::size_t count, ClwScene::VertexFormat format, char* data)
+    {
+        if (format != ClwScene::VERTEX_FORMAT_FLOAT)
+        {
+            auto out = reinterpret_cast<float*>(data);
+            for (auto i = 0u; i < count; ++i)
+            {
+                out[3 * i] = positions[i].x;
+                out[3 * i + 1] = positions[i].y;
+                out[3 * i + 2] = positions[i].z;
+            }
+        }
+        else
+        {
+            std::memcpy(data, positions, count * sizeof(RadeonRays::float3));
+        }
+    }
+
+    // Write count normals at data pointer
+    inline void WriteNormals(RadeonRays::float3 const* normals, std::size_t count, ClwScene::VertexFormat format, char* data)
+    {
+        if (format != ClwScene::VERTEX_FORMAT_FLOAT)
+        {
+            auto out = reinterpret_cast<std::uint32_t*>(data);
+            for (auto i = 0u; i < count; ++i)
+            {
+                out[i] = EncodeOctahedralNormal(normals[i]);
+            }
+        }
+        else
+        {
+            std::memcpy(data, normals, count * sizeof(RadeonRays::float3));
+        }
+    }
+
+    // Write count UVs at data pointer
+    inline void WriteUVs(RadeonRays::float2 const* uvs, std::size_t count, ClwScene::VertexFormat format, char* data)
+    {
+        if (format == ClwScene::VERTEX_FORMAT_COMPACT)
+        {
+            auto out = reinterpret_cast<std::uint16_t*>(data);
+            for (auto i = 0u; i < count; ++i)
+            {
+                out[2 * i] = half(uvs[i].x).bits();
+                out[2 * i + 1] = half(uvs[i].y).bits();
+            }
+        }
+        else
+        {
+            std::memcpy(data, uvs, count * sizeof(RadeonRays::float2));
+        }
+    }
+
+    // Unpack direction encoded by EncodeOctahedralNormal
+    inline RadeonRays::float3 DecodeOctahedralNormal(std::uint32_t packed)
+    {
+        auto x = std::max(static_cast<std::int16_t>(packed & 0xFFFF) / 32767.f, -1.f);
+        auto y = std::max(static_cast<std::int16_t>(packed >> 16) / 32767.f, -1.f);
+        auto z = 1.f - std::abs(x) - std::abs(y);
+        auto t = std::max(-z, 0.f);
+        x += x >= 0.f ? -t : t;
+        y += y >= 0.f ? -t : t;
+        return RadeonRays::normalize(RadeonRays::float3(x, y, z));
+    }
+
+    // Read position of vertex i from data pointer
+    inline RadeonRays::float3 ReadPosition(char const* data, std::size_t i, ClwScene::VertexFormat format)
+    {
+        if (format != ClwScene::VERTEX_FORMAT_FLOAT)
+        {
+            auto in = reinterpret_cast<float const*>(data) + 3 * i;
+            return RadeonRays::float3(in[0], in[1], in[2]);
+        }
+
+        return reinterpret_cast<RadeonRays::float3 const*>(data)[i];
+    }
+
+    // Read normal of vertex i from data pointer
+    inline RadeonRays::float3 ReadNormal(char const* data, std::size_t i, ClwScene::VertexFormat format)
+    {
+        if (format != ClwScene::VERTEX_FORMAT_FLOAT)
+        {
+            return DecodeOctahedralNormal(reinterpret_cast<std::uint32_t const*>(data)[i]);
+        }
+
+        return reinterpret_cast<RadeonRays::float3 const*>(data)[i];
+    }
+
+    // Read UV of vertex i from data pointer
+    inline RadeonRays::float2 ReadUV(char const* data, std::size_t i, ClwScene::VertexFormat format)
+    {
+        if (format == ClwScene::VERTEX_FORMAT_COMPACT)
+        {
+            auto in = reinterpret_cast<std::uint16_t const*>(data) + 2 * i;
+            half u, v;
+            u.setBits(in[0]);
+            v.setBits(in[1]);
+            return RadeonRays::float2(u, v);
+        }
+
+        return reinterpret_cast<RadeonRays::float2 const*>(data)[i];
+    }
+}
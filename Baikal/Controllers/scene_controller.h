@@ -31,9 +31,15 @@
 #include "SceneGraph/Collector/collector.h"
 #include "SceneGraph/material.h"
 #include "SceneGraph/scene1.h"
+#include "SceneGraph/shape.h"
+#include "SceneGraph/light.h"
+#include "SceneGraph/texture.h"
 
+#include <cstdint>
 #include <memory>
 #include <map>
+#include <unordered_map>
+#include <vector>
 
 namespace Baikal
 {
@@ -62,7 +68,45 @@ namespace Baikal
         CompiledScene& CompileScene(Scene1::Ptr scene) const;
 
         CompiledScene& GetCachedScene(Scene1::Ptr scene) const;
+
+        // Check if a scene has been compiled, GetCachedScene throws otherwise
+        bool HasCachedScene(Scene1::Ptr scene) const;
+
+        // Statistics of incremental scene compilation
+        struct UpdateStatistics
+        {
+            // Number of CompileScene calls
+            std::uint32_t num_compilations = 0;
+            // Number of times objects have been recollected after structural changes
+            std::uint32_t num_collector_rebuilds = 0;
+            // Number of changed objects found by the last compilation
+            std::uint32_t num_changed_objects = 0;
+        };
+
+        UpdateStatistics GetUpdateStatistics() const { return m_update_stats; }
     protected:
+        // Objects changed since the previous compilation of a cached scene.
+        // An empty list means the corresponding Update* call should rewrite
+        // everything (first compilation or objects added/removed/reindexed).
+        struct ChangeJournal
+        {
+            std::vector<Shape::Ptr> shapes;
+            std::vector<Light::Ptr> lights;
+            std::vector<Material::Ptr> materials;
+            std::vector<Texture::Ptr> textures;
+
+            void Clear()
+            {
+                shapes.clear();
+                lights.clear();
+                materials.clear();
+                textures.clear();
+            }
+        };
+
+        // Change journal of the scene being compiled, valid during Update* calls only.
+        ChangeJournal const& GetChangeJournal() const { return m_change_journal; }
+
         // Recompile the scene from scratch, i.e. not loading from cache.
         // All the buffers are recreated and reloaded.
         void RecompileFull(Scene1 const& scene, Collector& mat_collector, Collector& tex_collector,
@@ -98,17 +142,72 @@ namespace Baikal
         virtual void UpdateVolumes(Scene1 const& scene, Collector& volume_collector, Collector& tex_collector, CompiledScene& out) const = 0;
         // If scene attributes changed
         virtual void UpdateSceneAttributes(Scene1 const& scene, Collector& tex_collector, CompiledScene& out) const = 0;
+        // Stream in resources requested since the previous compilation
+        virtual void UpdateResidency(Scene1 const& scene, CompiledScene& out) const = 0;
+        // Apply work deferred by the Update* calls, called once per compilation
+        virtual void CommitUpdates(Scene1 const& scene, CompiledScene& out) const = 0;
 
     private:
+        // Kinds of collected objects, an object can be of several kinds
+        enum CollectedKind : std::uint32_t
+        {
+            kCollectedShape = 1 << 0,
+            kCollectedLight = 1 << 1,
+            kCollectedMaterial = 1 << 2,
+            kCollectedVolume = 1 << 3,
+            kCollectedTexture = 1 << 4,
+            kCollectedInputMap = 1 << 5,
+            kCollectedInputMapLeaf = 1 << 6
+        };
+
+        struct CollectedObject
+        {
+            SceneObject::Ptr object;
+            std::uint32_t kinds = 0;
+        };
+
+        // Objects of the collected scene with dirty flags set
+        struct DirtyObjects
+        {
+            std::vector<Shape::Ptr> shapes;
+            std::vector<Light::Ptr> lights;
+            std::vector<Material::Ptr> materials;
+            std::vector<VolumeMaterial::Ptr> volumes;
+            std::vector<Texture::Ptr> textures;
+            std::vector<InputMap::Ptr> input_maps;
+            std::vector<InputMap::Ptr> input_map_leafs;
+        };
+
+        // Rebuild object id mapping after objects have been recollected
+        void IndexCollectedObjects(Scene1 const& scene) const;
+        // Find dirty objects among the collected ones. With use_change_log only
+        // the objects logged after the since change counter are looked at.
+        void FindDirtyObjects(bool use_change_log, std::uint64_t since, DirtyObjects& out) const;
+
         mutable Scene1::Ptr m_current_scene;
         // Scene cache map (CPU scene -> GPU scene mapping)
         mutable std::map<Scene1::Ptr, CompiledScene> m_scene_cache;
+        // SceneObject change counter observed by the last compilation of a cached scene
+        mutable std::map<Scene1::Ptr, std::uint64_t> m_scene_change_counter;
 
         mutable Collector m_material_collector;
         mutable Collector m_volume_collector;
         mutable Collector m_texture_collector;
         mutable Collector m_input_maps_collector;
         mutable Collector m_input_map_leafs_collector;
+
+        // Scene the collectors have been filled for, they are kept until it changes structurally
+        mutable Scene1::Ptr m_collected_scene;
+        // SceneObject structure counter observed by the last collection
+        mutable std::uint64_t m_collected_structure = 0;
+        // Collected objects by id
+        mutable std::unordered_map<std::uint32_t, CollectedObject> m_collected_objects;
+        // Area lights by id of their shapes
+        mutable std::unordered_multimap<std::uint32_t, Light::Ptr> m_area_lights;
+
+        mutable UpdateStatistics m_update_stats;
+
+        mutable ChangeJournal m_change_journal;
     };
 }
 
@@ -8,6 +8,7 @@
 #include "SceneGraph/iterator.h"
 #include "SceneGraph/uberv2material.h"
 
+#include <algorithm>
 #include <chrono>
 #include <memory>
 #include <stack>
@@ -33,6 +34,12 @@ namespace Baikal
         }
     }
 
+    template <typename CompiledScene>
+    inline
+    bool SceneController<CompiledScene>::HasCachedScene(Scene1::Ptr scene) const {
+        return m_scene_cache.find(scene) != m_scene_cache.cend();
+    }
+
     template <typename CompiledScene>
     inline
     CompiledScene& SceneController<CompiledScene>::CompileScene(
@@ -48,220 +55,266 @@ namespace Baikal
         // As soon as we have this mapping we are analyzing dirty flags and
         // updating necessary parts.
 
-        // We need to make sure collectors are empty before proceeding
-        m_material_collector.Clear();
-        m_texture_collector.Clear();
-        m_volume_collector.Clear();
-
-        // Create shape and light iterators
-        auto shape_iter = scene->CreateShapeIterator();
-        auto light_iter = scene->CreateLightIterator();
-
-        auto default_material = GetDefaultMaterial();
-        // Collect materials from shapes first
-        m_material_collector.Collect(*shape_iter,
-                              // This function adds all materials to resulting map
-                              // recursively via Material dependency API
-                              [default_material](SceneObject::Ptr item) ->
-                              std::set<SceneObject::Ptr>
-                              {
-                                  // Resulting material set
-                                  std::set<SceneObject::Ptr> mats;
-                                  // Material stack
-                                  std::stack<Material::Ptr> material_stack;
-
-                                  // Get material from current shape
-                                  auto shape = std::static_pointer_cast<Shape>(item);
-                                  auto material = shape->GetMaterial();
-
-                                  // If shape does not have a material, use default one
-                                  if (!material)
-                                  {
-                                      material = default_material;
-                                  }
+        // Any edit of a scene object bumps the global change counter, so if it has not
+        // moved since the last compilation of the current scene, collectors and
+        // compiled data are still valid and only resource streaming has to be serviced.
+        auto change_counter = SceneObject::GetChangeCounter();
 
-                                  // Push to stack as an initializer
-                                  material_stack.push(material);
+        if (scene == m_current_scene)
+        {
+            auto iter = m_scene_cache.find(scene);
+            auto counter_iter = m_scene_change_counter.find(scene);
 
-                                  // Drain the stack
-                                  while (!material_stack.empty())
-                                  {
-                                      // Get current material
-                                      auto m = material_stack.top();
-                                      material_stack.pop();
+            if (iter != m_scene_cache.cend() &&
+                counter_iter != m_scene_change_counter.cend() &&
+                counter_iter->second == change_counter)
+            {
+                ++m_update_stats.num_compilations;
+                m_update_stats.num_changed_objects = 0;
+                UpdateResidency(*scene, iter->second);
+                return iter->second;
+            }
+        }
+
+        ++m_update_stats.num_compilations;
+        m_change_journal.Clear();
 
-                                      // Emplace into the set
-                                      mats.emplace(m);
+        // Collectors only depend on references between objects, so they are kept as
+        // long as the same scene is compiled and nothing has been attached, detached
+        // or reassigned since the last collection.
+        auto structure_counter = SceneObject::GetStructureCounter();
+        auto structure_flags = Scene1::kShapes | Scene1::kLights | Scene1::kBackground;
 
-                                      // Create dependency iterator
-                                      auto mat_iter = m->CreateMaterialIterator();
+        bool recollect = scene != m_collected_scene ||
+            structure_counter != m_collected_structure ||
+            (scene->GetDirtyFlags() & structure_flags) != 0;
 
-                                      // Push all dependencies into the stack
-                                      for (; mat_iter->IsValid(); mat_iter->Next())
+        if (recollect)
+        {
+            // Collectors are invalid until the collection is over
+            m_collected_scene = nullptr;
+
+            // We need to make sure collectors are empty before proceeding
+            m_material_collector.Clear();
+            m_texture_collector.Clear();
+            m_volume_collector.Clear();
+
+            // Create shape and light iterators
+            auto shape_iter = scene->CreateShapeIterator();
+            auto light_iter = scene->CreateLightIterator();
+
+            auto default_material = GetDefaultMaterial();
+            // Collect materials from shapes first
+            m_material_collector.Collect(*shape_iter,
+                                  // This function adds all materials to resulting map
+                                  // recursively via Material dependency API
+                                  [default_material](SceneObject::Ptr item) ->
+                                  std::set<SceneObject::Ptr>
+                                  {
+                                      // Resulting material set
+                                      std::set<SceneObject::Ptr> mats;
+                                      // Material stack
+                                      std::stack<Material::Ptr> material_stack;
+
+                                      // Get material from current shape
+                                      auto shape = std::static_pointer_cast<Shape>(item);
+                                      auto material = shape->GetMaterial();
+
+                                      // If shape does not have a material, use default one
+                                      if (!material)
                                       {
-                                          material_stack.push(
-                                            mat_iter->ItemAs<Material>()
-                                          );
+                                          material = default_material;
                                       }
-                                  }
-
-                                  // Return resulting set
-                                  return mats;
-                              });
 
-        // Commit stuff (we can iterate over it after commit has happened)
-        m_material_collector.Commit();
+                                      // Push to stack as an initializer
+                                      material_stack.push(material);
 
-        // set iterator position at begin
-        shape_iter->Reset();
-        // Collect volume materials from shapes first
-        m_volume_collector.Collect(*shape_iter,
-                                    [](SceneObject::Ptr item) -> std::set<SceneObject::Ptr>
-                                    {
-                                        // Resulting material set
-                                        std::set<SceneObject::Ptr> vol_mats;
+                                      // Drain the stack
+                                      while (!material_stack.empty())
+                                      {
+                                          // Get current material
+                                          auto m = material_stack.top();
+                                          material_stack.pop();
+
+                                          // Emplace into the set
+                                          mats.emplace(m);
+
+                                          // Create dependency iterator
+                                          auto mat_iter = m->CreateMaterialIterator();
+
+                                          // Push all dependencies into the stack
+                                          for (; mat_iter->IsValid(); mat_iter->Next())
+                                          {
+                                              material_stack.push(
+                                                mat_iter->ItemAs<Material>()
+                                              );
+                                          }
+                                      }
 
-                                        // Get volume material from current shape
-                                        auto shape = std::static_pointer_cast<Shape>(item);
-                                        auto volume_material = shape->GetVolumeMaterial();
+                                      // Return resulting set
+                                      return mats;
+                                  });
 
-                                        if (volume_material)
-                                            vol_mats.emplace(volume_material);
+            // Commit stuff (we can iterate over it after commit has happened)
+            m_material_collector.Commit();
 
-                                        return vol_mats;
-                                    });
+            // set iterator position at begin
+            shape_iter->Reset();
+            // Collect volume materials from shapes first
+            m_volume_collector.Collect(*shape_iter,
+                                        [](SceneObject::Ptr item) -> std::set<SceneObject::Ptr>
+                                        {
+                                            // Resulting material set
+                                            std::set<SceneObject::Ptr> vol_mats;
 
-        // Commit stuff
-        m_volume_collector.Commit();
+                                            // Get volume material from current shape
+                                            auto shape = std::static_pointer_cast<Shape>(item);
+                                            auto volume_material = shape->GetVolumeMaterial();
 
-        // Now we need to collect textures from our materials
-        // Create material iterator
-        auto mat_iter = m_material_collector.CreateIterator();
+                                            if (volume_material)
+                                                vol_mats.emplace(volume_material);
 
-        // Collect textures from materials
-        m_texture_collector.Collect(*mat_iter,
-                                    [](SceneObject::Ptr item) -> std::set<SceneObject::Ptr>
-                              {
-                                  // Texture set
-                                  std::set<SceneObject::Ptr> textures;
+                                            return vol_mats;
+                                        });
 
-                                  auto material = std::static_pointer_cast<Material>(item);
+            // Commit stuff
+            m_volume_collector.Commit();
 
-                                  // Create texture dependency iterator
-                                  auto tex_iter = material->CreateTextureIterator();
+            // Now we need to collect textures from our materials
+            // Create material iterator
+            auto mat_iter = m_material_collector.CreateIterator();
 
-                                  // Emplace all dependent textures
-                                  for (; tex_iter->IsValid(); tex_iter->Next())
+            // Collect textures from materials
+            m_texture_collector.Collect(*mat_iter,
+                                        [](SceneObject::Ptr item) -> std::set<SceneObject::Ptr>
                                   {
-                                      textures.emplace(tex_iter->ItemAs<Texture>());
-                                  }
+                                      // Texture set
+                                      std::set<SceneObject::Ptr> textures;
 
-                                  // Return resulting set
-                                  return textures;
-                              });
+                                      auto material = std::static_pointer_cast<Material>(item);
 
-        // Now we need to collect textures from volumes
-        // Create volume iterator
-        auto vol_iter = m_volume_collector.CreateIterator();
+                                      // Create texture dependency iterator
+                                      auto tex_iter = material->CreateTextureIterator();
 
-        // Collect textures from materials
-        m_texture_collector.Collect(*vol_iter,
-            [](SceneObject::Ptr item) -> std::set<SceneObject::Ptr>
-        {
-            // Texture set
-            std::set<SceneObject::Ptr> textures;
+                                      // Emplace all dependent textures
+                                      for (; tex_iter->IsValid(); tex_iter->Next())
+                                      {
+                                          textures.emplace(tex_iter->ItemAs<Texture>());
+                                      }
 
-            auto volume = std::static_pointer_cast<VolumeMaterial>(item);
+                                      // Return resulting set
+                                      return textures;
+                                  });
 
-            // Create texture dependency iterator
-            auto tex_iter = volume->CreateTextureIterator();
+            // Now we need to collect textures from volumes
+            // Create volume iterator
+            auto vol_iter = m_volume_collector.CreateIterator();
 
-            // Emplace all dependent textures
-            for (; tex_iter->IsValid(); tex_iter->Next())
+            // Collect textures from materials
+            m_texture_collector.Collect(*vol_iter,
+                [](SceneObject::Ptr item) -> std::set<SceneObject::Ptr>
             {
-                textures.emplace(tex_iter->ItemAs<Texture>());
-            }
+                // Texture set
+                std::set<SceneObject::Ptr> textures;
 
-            // Return resulting set
-            return textures;
-        });
+                auto volume = std::static_pointer_cast<VolumeMaterial>(item);
 
-        // Collect textures from lights
-        m_texture_collector.Collect(*light_iter,
-                                    [](SceneObject::Ptr item) -> std::set<SceneObject::Ptr>
-                              {
-                                  // Resulting set
-                                  std::set<SceneObject::Ptr> textures;
+                // Create texture dependency iterator
+                auto tex_iter = volume->CreateTextureIterator();
 
-                                  auto light = std::static_pointer_cast<Light>(item);
+                // Emplace all dependent textures
+                for (; tex_iter->IsValid(); tex_iter->Next())
+                {
+                    textures.emplace(tex_iter->ItemAs<Texture>());
+                }
 
-                                  // Create texture dependency iterator
-                                  auto tex_iter = light->CreateTextureIterator();
+                // Return resulting set
+                return textures;
+            });
 
-                                  // Emplace all dependent textures
-                                  for (; tex_iter->IsValid(); tex_iter->Next())
+            // Collect textures from lights
+            m_texture_collector.Collect(*light_iter,
+                                        [](SceneObject::Ptr item) -> std::set<SceneObject::Ptr>
                                   {
-                                      textures.emplace(tex_iter->ItemAs<Texture>());
-                                  }
+                                      // Resulting set
+                                      std::set<SceneObject::Ptr> textures;
 
-                                  // Return resulting set
-                                  return textures;
-                              });
+                                      auto light = std::static_pointer_cast<Light>(item);
 
-        mat_iter->Reset();
-        m_input_maps_collector.Collect(*mat_iter,
-                                [](SceneObject::Ptr item) -> std::set<SceneObject::Ptr>
-                                {
-                                    // Texture set
-                                    std::set<SceneObject::Ptr> input_maps;
+                                      // Create texture dependency iterator
+                                      auto tex_iter = light->CreateTextureIterator();
 
-                                    auto material = std::static_pointer_cast<Material>(item);
+                                      // Emplace all dependent textures
+                                      for (; tex_iter->IsValid(); tex_iter->Next())
+                                      {
+                                          textures.emplace(tex_iter->ItemAs<Texture>());
+                                      }
 
-                                    // Create texture dependency iterator
-                                    auto input_map_iter = material->CreateInputMapsIterator();
+                                      // Return resulting set
+                                      return textures;
+                                  });
 
-                                    // Emplace all dependent textures
-                                    for (; input_map_iter->IsValid(); input_map_iter->Next())
+            mat_iter->Reset();
+            m_input_maps_collector.Collect(*mat_iter,
+                                    [](SceneObject::Ptr item) -> std::set<SceneObject::Ptr>
                                     {
-                                        input_maps.emplace(input_map_iter->ItemAs<InputMap>());
-                                    }
+                                        // Texture set
+                                        std::set<SceneObject::Ptr> input_maps;
 
-                                    // Return resulting set
-                                    return input_maps;
-                                });
-        m_input_maps_collector.Commit();
+                                        auto material = std::static_pointer_cast<Material>(item);
 
-        mat_iter->Reset();
-        m_input_map_leafs_collector.Collect(*mat_iter,
-                                [](SceneObject::Ptr item) -> std::set<SceneObject::Ptr>
-                                {
-                                    // Texture set
-                                    std::set<SceneObject::Ptr> input_maps;
+                                        // Create texture dependency iterator
+                                        auto input_map_iter = material->CreateInputMapsIterator();
 
-                                    auto material = std::static_pointer_cast<Material>(item);
+                                        // Emplace all dependent textures
+                                        for (; input_map_iter->IsValid(); input_map_iter->Next())
+                                        {
+                                            input_maps.emplace(input_map_iter->ItemAs<InputMap>());
+                                        }
 
-                                    // Create texture dependency iterator
-                                    auto input_map_iter = material->CreateInputMapLeafsIterator();
+                                        // Return resulting set
+                                        return input_maps;
+                                    });
+            m_input_maps_collector.Commit();
 
-                                    // Emplace all dependent textures
-                                    for (; input_map_iter->IsValid(); input_map_iter->Next())
+            mat_iter->Reset();
+            m_input_map_leafs_collector.Collect(*mat_iter,
+                                    [](SceneObject::Ptr item) -> std::set<SceneObject::Ptr>
                                     {
-                                        input_maps.emplace(input_map_iter->ItemAs<InputMap>());
-                                    }
+                                        // Texture set
+                                        std::set<SceneObject::Ptr> input_maps;
+
+                                        auto material = std::static_pointer_cast<Material>(item);
 
-                                    // Return resulting set
-                                    return input_maps;
-                                });
-        m_input_map_leafs_collector.Commit();
+                                        // Create texture dependency iterator
+                                        auto input_map_iter = material->CreateInputMapLeafsIterator();
 
+                                        // Emplace all dependent textures
+                                        for (; input_map_iter->IsValid(); input_map_iter->Next())
+                                        {
+                                            input_maps.emplace(input_map_iter->ItemAs<InputMap>());
+                                        }
 
-        // Add background texture from scene into texture collector
-        auto background_texture = scene->GetBackgroundImage();
-        if (background_texture)
-            m_texture_collector.Collect(background_texture);
+                                        // Return resulting set
+                                        return input_maps;
+                                    });
+            m_input_map_leafs_collector.Commit();
+
+
+            // Add background texture from scene into texture collector
+            auto background_texture = scene->GetBackgroundImage();
+            if (background_texture)
+                m_texture_collector.Collect(background_texture);
 
-        // Commit textures
-        m_texture_collector.Commit();
+            // Commit textures
+            m_texture_collector.Commit();
+
+            IndexCollectedObjects(*scene);
+
+            m_collected_scene = scene;
+            m_collected_structure = structure_counter;
+            ++m_update_stats.num_collector_rebuilds;
+        }
 
         // Try to find scene in cache first
         auto iter = m_scene_cache.find(scene);
@@ -275,6 +328,8 @@ namespace Baikal
             RecompileFull(*scene, m_material_collector, m_texture_collector, m_volume_collector,
                           m_input_maps_collector, m_input_map_leafs_collector, res.first->second);
 
+            CommitUpdates(*scene, res.first->second);
+
             // Set scene as current
             m_current_scene = scene;
 
@@ -301,6 +356,10 @@ namespace Baikal
                 input_map->SetDirty(false);
             });
 
+            m_scene_change_counter[scene] = change_counter;
+            m_update_stats.num_changed_objects = static_cast<std::uint32_t>(m_collected_objects.size());
+            res.first->second.revision = change_counter;
+
             // Return the scene
             return res.first->second;
         }
@@ -310,41 +369,78 @@ namespace Baikal
             auto& out = iter->second;
             auto dirty = scene->GetDirtyFlags();
 
-            bool should_update_materials = !out.material_bundle ||
-                m_material_collector.NeedsUpdate(out.material_bundle.get(),
-                                                 [](SceneObject::Ptr ptr)->bool
+            // If the collectors have been kept, only objects edited since the previous
+            // compilation of the scene have to be looked at.
+            auto counter_iter = m_scene_change_counter.find(scene);
+            bool use_change_log = !recollect && counter_iter != m_scene_change_counter.cend();
+
+            DirtyObjects changed;
+            FindDirtyObjects(use_change_log, use_change_log ? counter_iter->second : 0, changed);
+
+            m_update_stats.num_changed_objects = static_cast<std::uint32_t>(
+                changed.shapes.size() + changed.lights.size() + changed.materials.size() +
+                changed.volumes.size() + changed.textures.size() + changed.input_maps.size());
+
+            // Structural changes (objects added or removed) shift collector indices,
+            // so everything referencing these objects by index has to be rewritten.
+            // Kept collectors can not have those.
+            auto never_changed = [](SceneObject::Ptr)->bool { return false; };
+
+            bool materials_restructured = !out.material_bundle ||
+                (recollect && m_material_collector.NeedsUpdate(out.material_bundle.get(), never_changed));
+
+            bool volumes_restructured = !out.volume_bundle ||
+                (recollect && m_volume_collector.NeedsUpdate(out.volume_bundle.get(), never_changed));
+
+            bool textures_restructured = m_texture_collector.GetNumItems() > 0 &&
+                (!out.texture_bundle ||
+                 (recollect && m_texture_collector.NeedsUpdate(out.texture_bundle.get(), never_changed)));
+
+            bool leafs_restructured = m_input_map_leafs_collector.GetNumItems() > 0 &&
+                (!out.input_map_leafs_bundle ||
+                 (recollect && m_input_map_leafs_collector.NeedsUpdate(out.input_map_leafs_bundle.get(), never_changed)));
+
+            bool input_maps_restructured = m_input_maps_collector.GetNumItems() > 0 &&
+                (!out.input_map_bundle ||
+                 (recollect && m_input_maps_collector.NeedsUpdate(out.input_map_bundle.get(), never_changed)));
+
+            // If the material set is the same, journal individual dirty materials
+            // so the compiled scene can be patched in place.
+            if (!materials_restructured)
             {
-                auto mat = std::static_pointer_cast<Material>(ptr);
-                return mat->IsDirty();
-            });
+                m_change_journal.materials = changed.materials;
+            }
+
+            bool should_update_materials = materials_restructured || !changed.materials.empty();
+
+            bool should_update_volumes = volumes_restructured || !changed.volumes.empty();
 
-            bool should_update_volumes = !out.volume_bundle ||
-                m_volume_collector.NeedsUpdate(out.volume_bundle.get(),
-                                               [](SceneObject::Ptr ptr)->bool
+            // Same for textures if the texture set is unchanged
+            if (!textures_restructured)
             {
-                auto volume = std::static_pointer_cast<VolumeMaterial>(ptr);
-                return volume->IsDirty();
-            });
+                m_change_journal.textures = changed.textures;
+            }
 
-            bool should_update_textures = m_texture_collector.GetNumItems() > 0 && (
-                !out.texture_bundle ||
-                m_texture_collector.NeedsUpdate(out.texture_bundle.get(), [](SceneObject::Ptr ptr) {
-                auto tex = std::static_pointer_cast<Texture>(ptr);
-                return tex->IsDirty(); }));
+            bool should_update_textures = textures_restructured || !changed.textures.empty();
 
-            bool should_update_leafs_data = (m_input_map_leafs_collector.GetNumItems() > 0) && (
-                !out.input_map_leafs_bundle ||
-                m_input_map_leafs_collector.NeedsUpdate(out.input_map_leafs_bundle.get(), [](SceneObject::Ptr ptr)
-                {
-                    return ptr->IsDirty();
-                }));
+            // Materials reference textures by index
+            if (textures_restructured)
+            {
+                m_change_journal.materials.clear();
+                should_update_materials = true;
+            }
 
-            bool should_update_input_maps = (m_input_maps_collector.GetNumItems() > 0) && (
-                !out.input_map_bundle ||
-                m_input_maps_collector.NeedsUpdate(out.input_map_bundle.get(), [](SceneObject::Ptr ptr)
-                {
-                    return ptr->IsDirty();
-                }));
+            // Switching input map mode changes the layout of input map data
+            bool input_map_mode_changed = (dirty & Scene1::kInputMaps) != 0;
+
+            bool should_update_leafs_data = leafs_restructured ||
+                (m_input_map_leafs_collector.GetNumItems() > 0 &&
+                 (input_map_mode_changed || !changed.input_map_leafs.empty()));
+
+            // Leaf values are uploaded along with input maps, which also reference them by index
+            bool should_update_input_maps = input_maps_restructured ||
+                (m_input_maps_collector.GetNumItems() > 0 &&
+                 (input_map_mode_changed || should_update_leafs_data || !changed.input_maps.empty()));
 
             // Check if we have valid camera
             auto camera = scene->GetCamera();
@@ -373,29 +469,24 @@ namespace Baikal
                     throw std::runtime_error("No lights in the scene");
                 }
 
+                // Lights with changed parameters or moved emissive shapes
+                m_change_journal.lights = changed.lights;
 
-                // Check if light parameters have been changed
-                bool lights_changed = false;
+                // Light set changes and texture or shape reindexing invalidate
+                // all the light records, otherwise only changed lights are patched.
+                bool lights_restructured = (dirty & Scene1::kLights) ||
+                    (dirty & Scene1::kShapes) || textures_restructured;
 
-                for (; light_iter->IsValid(); light_iter->Next())
+                // Update lights if needed
+                if (lights_restructured || !m_change_journal.lights.empty() ||
+                    should_update_textures || should_update_materials)
                 {
-                    auto light = light_iter->ItemAs<Light>();
-
-                    if (light->IsDirty())
+                    if (lights_restructured)
                     {
-                        lights_changed = true;
-                        break;
+                        m_change_journal.lights.clear();
                     }
-                }
-
 
-                // Update lights if needed
-                if (dirty & Scene1::kLights || lights_changed ||
-                    should_update_textures || should_update_materials)
-                {
                     UpdateLights(*scene, m_material_collector, m_texture_collector, out);
-                    light_iter->Reset();
-                    DropDirty(*light_iter);
                 }
             }
 
@@ -408,29 +499,24 @@ namespace Baikal
                     throw std::runtime_error("No shapes in the scene");
                 }
 
-                // Check if shape parameters have been changed
-                bool shapes_changed = false;
-
-                for (; shape_iter->IsValid(); shape_iter->Next())
-                {
-                    auto shape = shape_iter->ItemAs<Shape>();
-
-                    if (shape->IsDirty())
-                    {
-                        shapes_changed = true;
-                        break;
-                    }
-                }
+                // Shapes with changed parameters
+                m_change_journal.shapes = changed.shapes;
 
                 // Update shapes if needed
                 if (dirty & Scene1::kShapes)
                 {
+                    m_change_journal.shapes.clear();
                     UpdateShapes(*scene, m_material_collector, m_texture_collector, m_volume_collector, out);
-                    shape_iter->Reset();
-                    DropDirty(*shape_iter);
                 }
-                else if (shapes_changed)
+                else if (!m_change_journal.shapes.empty() || materials_restructured || volumes_restructured)
                 {
+                    // Shapes reference materials and volumes by index,
+                    // so reindexing requires all shape records to be rewritten.
+                    if (materials_restructured || volumes_restructured)
+                    {
+                        m_change_journal.shapes.clear();
+                    }
+
                     UpdateShapeProperties(*scene, m_material_collector, m_texture_collector, m_volume_collector, out);
                 }
             }
@@ -473,42 +559,164 @@ namespace Baikal
             }
 
             // If background image need an update, do it.
-            if ((scene->GetDirtyFlags() & Scene1::kBackground) == Scene1::kBackground)
+            if (dirty & Scene1::kBackground)
             {
                 UpdateSceneAttributes(*scene, m_texture_collector, out);
             }
 
+            // Stream in data used by the previous iterations
+            UpdateResidency(*scene, out);
+
+            CommitUpdates(*scene, out);
+
             // Make sure to clear dirty flags
             scene->ClearDirtyFlags();
 
-            // Clear material dirty flags
-            m_material_collector.Finalize([](SceneObject::Ptr item)
+            // Only the objects found above can have dirty flags set
+            auto drop_dirty = [](SceneObject::Ptr object) { object->SetDirty(false); };
+
+            std::for_each(changed.shapes.cbegin(), changed.shapes.cend(), drop_dirty);
+            std::for_each(changed.lights.cbegin(), changed.lights.cend(), drop_dirty);
+            std::for_each(changed.materials.cbegin(), changed.materials.cend(), drop_dirty);
+            std::for_each(changed.volumes.cbegin(), changed.volumes.cend(), drop_dirty);
+            std::for_each(changed.textures.cbegin(), changed.textures.cend(), drop_dirty);
+            // It will mark entire hierarchy as not dirty
+            std::for_each(changed.input_maps.cbegin(), changed.input_maps.cend(), drop_dirty);
+            std::for_each(changed.input_map_leafs.cbegin(), changed.input_map_leafs.cend(), drop_dirty);
+
+            // Journal is only valid for the duration of the update
+            m_change_journal.Clear();
+
+            m_scene_change_counter[scene] = change_counter;
+            out.revision = change_counter;
+
+            // Return the scene
+            return out;
+        }
+    }
+
+    template <typename CompiledScene>
+    inline
+    void SceneController<CompiledScene>::IndexCollectedObjects(Scene1 const& scene) const
+    {
+        m_collected_objects.clear();
+        m_area_lights.clear();
+
+        auto add = [this](Iterator& iter, std::uint32_t kind)
+        {
+            for (; iter.IsValid(); iter.Next())
             {
-                auto material = std::static_pointer_cast<Material>(item);
-                material->SetDirty(false);
-            });
+                auto object = iter.Item();
+                auto& entry = m_collected_objects[object->GetId()];
+                entry.object = object;
+                entry.kinds |= kind;
+            }
+        };
+
+        add(*scene.CreateShapeIterator(), kCollectedShape);
+        add(*scene.CreateLightIterator(), kCollectedLight);
+        add(*m_material_collector.CreateIterator(), kCollectedMaterial);
+        add(*m_volume_collector.CreateIterator(), kCollectedVolume);
+        add(*m_texture_collector.CreateIterator(), kCollectedTexture);
+        add(*m_input_maps_collector.CreateIterator(), kCollectedInputMap);
+        add(*m_input_map_leafs_collector.CreateIterator(), kCollectedInputMapLeaf);
+
+        // Moving an emissive shape changes its light as well
+        auto light_iter = scene.CreateLightIterator();
+
+        for (; light_iter->IsValid(); light_iter->Next())
+        {
+            auto area_light = std::dynamic_pointer_cast<AreaLight>(light_iter->ItemAs<Light>());
 
-            m_texture_collector.Finalize([](SceneObject::Ptr item)
+            if (area_light)
             {
-                auto tex = std::static_pointer_cast<Texture>(item);
-                tex->SetDirty(false);
-            });
+                m_area_lights.emplace(area_light->GetShape()->GetId(), area_light);
+            }
+        }
+    }
 
-            m_volume_collector.Finalize([](SceneObject::Ptr item)
+    template <typename CompiledScene>
+    inline
+    void SceneController<CompiledScene>::FindDirtyObjects(
+        bool use_change_log, std::uint64_t since, DirtyObjects& out) const
+    {
+        std::vector<std::uint32_t> ids;
+
+        if (use_change_log && SceneObject::GetChangedObjects(since, ids))
+        {
+            // Objects are logged each time they are marked dirty
+            std::sort(ids.begin(), ids.end());
+            ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+        }
+        else
+        {
+            ids.clear();
+            ids.reserve(m_collected_objects.size());
+
+            for (auto const& entry : m_collected_objects)
             {
-                auto volume = std::static_pointer_cast<VolumeMaterial>(item);
-                volume->SetDirty(false);
-            });
+                ids.push_back(entry.first);
+            }
+        }
 
-            // It will mark entire hierarchy as not dirty
-            m_input_maps_collector.Finalize([](SceneObject::Ptr item)
+        for (auto id : ids)
+        {
+            auto iter = m_collected_objects.find(id);
+
+            // Not used by the scene or compiled already
+            if (iter == m_collected_objects.cend() || !iter->second.object->IsDirty())
             {
-                auto input_map = std::static_pointer_cast<InputMap>(item);
-                input_map->SetDirty(false);
-            });
+                continue;
+            }
 
-            // Return the scene
-            return out;
+            auto const& object = iter->second.object;
+            auto kinds = iter->second.kinds;
+
+            if (kinds & kCollectedShape)
+            {
+                out.shapes.push_back(std::static_pointer_cast<Shape>(object));
+
+                auto lights = m_area_lights.equal_range(id);
+
+                for (auto light = lights.first; light != lights.second; ++light)
+                {
+                    // Dirty lights are found on their own
+                    if (!light->second->IsDirty())
+                    {
+                        out.lights.push_back(light->second);
+                    }
+                }
+            }
+
+            if (kinds & kCollectedLight)
+            {
+                out.lights.push_back(std::static_pointer_cast<Light>(object));
+            }
+
+            if (kinds & kCollectedMaterial)
+            {
+                out.materials.push_back(std::static_pointer_cast<Material>(object));
+            }
+
+            if (kinds & kCollectedVolume)
+            {
+                out.volumes.push_back(std::static_pointer_cast<VolumeMaterial>(object));
+            }
+
+            if (kinds & kCollectedTexture)
+            {
+                out.textures.push_back(std::static_pointer_cast<Texture>(object));
+            }
+
+            if (kinds & kCollectedInputMap)
+            {
+                out.input_maps.push_back(std::static_pointer_cast<InputMap>(object));
+            }
+
+            if (kinds & kCollectedInputMapLeaf)
+            {
+                out.input_map_leafs.push_back(std::static_pointer_cast<InputMap>(object));
+            }
         }
     }
 
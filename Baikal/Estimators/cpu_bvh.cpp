@@ -0,0 +1,410 @@
+/**********************************************************************
+Copyright (c) 2017 Advanced Micro Devices, Inc. All rights reserved.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+********************************************************************/
+#include "cpu_bvh.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <numeric>
+
+namespace Baikal
+{
+    using namespace RadeonRays;
+
+    namespace
+    {
+        std::uint32_t constexpr kNumBins = 16;
+        std::uint32_t constexpr kMaxLeafSize = 4;
+        std::uint32_t constexpr kMaxDepth = 60;
+
+        struct Bounds
+        {
+            float min[3];
+            float max[3];
+
+            Bounds()
+            {
+                std::fill(min, min + 3, std::numeric_limits<float>::max());
+                std::fill(max, max + 3, -std::numeric_limits<float>::max());
+            }
+
+            void Grow(float3 const& p)
+            {
+                for (auto i = 0; i < 3; ++i)
+                {
+                    min[i] = std::min(min[i], p[i]);
+                    max[i] = std::max(max[i], p[i]);
+                }
+            }
+
+            void Grow(Bounds const& b)
+            {
+                for (auto i = 0; i < 3; ++i)
+                {
+                    min[i] = std::min(min[i], b.min[i]);
+                    max[i] = std::max(max[i], b.max[i]);
+                }
+            }
+
+            float Area() const
+            {
+                if (min[0] > max[0])
+                {
+                    return 0.f;
+                }
+
+                auto x = max[0] - min[0];
+                auto y = max[1] - min[1];
+                auto z = max[2] - min[2];
+                return 2.f * (x * y + y * z + z * x);
+            }
+        };
+
+        // Entry distance of a ray into the box, infinity on a miss
+        inline float IntersectBox(float const* bmin, float const* bmax, float3 const& o, float const* inv_d, float tmax)
+        {
+            auto tnear = 0.f;
+            auto tfar = tmax;
+
+            for (auto i = 0; i < 3; ++i)
+            {
+                auto t0 = (bmin[i] - o[i]) * inv_d[i];
+                auto t1 = (bmax[i] - o[i]) * inv_d[i];
+                tnear = std::max(tnear, std::min(t0, t1));
+                tfar = std::min(tfar, std::max(t0, t1));
+            }
+
+            return tnear <= tfar ? tnear : std::numeric_limits<float>::infinity();
+        }
+    }
+
+    void CpuBvh::Build(std::vector<float3> const& vertices,
+                       std::vector<int> const& shapes,
+                       std::vector<int> const& prims)
+    {
+        auto num_triangles = shapes.size();
+
+        std::vector<Bounds> triangle_bounds(num_triangles);
+        std::vector<float3> centroids(num_triangles);
+
+        for (auto i = 0u; i < num_triangles; ++i)
+        {
+            for (auto j = 0u; j < 3; ++j)
+            {
+                triangle_bounds[i].Grow(vertices[3 * i + j]);
+            }
+
+            centroids[i] = (vertices[3 * i] + vertices[3 * i + 1] + vertices[3 * i + 2]) * (1.f / 3.f);
+        }
+
+        std::vector<int> order(num_triangles);
+        std::iota(order.begin(), order.end(), 0);
+
+        m_nodes.clear();
+
+        if (num_triangles == 0)
+        {
+            m_v0.clear();
+            m_e1.clear();
+            m_e2.clear();
+            m_shapes.clear();
+            m_prims.clear();
+            return;
+        }
+
+        m_nodes.reserve(2 * num_triangles);
+        m_nodes.push_back(Node());
+
+        struct Task
+        {
+            int node;
+            int begin;
+            int end;
+            std::uint32_t depth;
+        };
+
+        std::vector<Task> tasks;
+        tasks.push_back({ 0, 0, static_cast<int>(num_triangles), 0 });
+
+        while (!tasks.empty())
+        {
+            auto task = tasks.back();
+            tasks.pop_back();
+
+            Bounds bounds;
+            Bounds centroid_bounds;
+
+            for (auto i = task.begin; i < task.end; ++i)
+            {
+                bounds.Grow(triangle_bounds[order[i]]);
+                centroid_bounds.Grow(centroids[order[i]]);
+            }
+
+            auto& node = m_nodes[task.node];
+            std::copy(bounds.min, bounds.min + 3, node.bmin);
+            std::copy(bounds.max, bounds.max + 3, node.bmax);
+
+            auto count = task.end - task.begin;
+
+            // Find the cheapest bin boundary over all axes
+            auto best_cost = std::numeric_limits<float>::max();
+            auto best_axis = -1;
+            auto best_split = 0u;
+
+            for (auto axis = 0; axis < 3 && count > 1; ++axis)
+            {
+                auto extent = centroid_bounds.max[axis] - centroid_bounds.min[axis];
+
+                if (extent <= 0.f)
+                {
+                    continue;
+                }
+
+                Bounds bin_bounds[kNumBins];
+                int bin_counts[kNumBins] = {};
+                auto scale = kNumBins / extent;
+
+                for (auto i = task.begin; i < task.end; ++i)
+                {
+                    auto bin = std::min(static_cast<std::uint32_t>((centroids[order[i]][axis] - centroid_bounds.min[axis]) * scale), kNumBins - 1);
+                    bin_bounds[bin].Grow(triangle_bounds[order[i]]);
+                    ++bin_counts[bin];
+                }
+
+                // Sweep from the right to get costs of all the right halves
+                float right_area[kNumBins];
+                int right_count[kNumBins];
+                Bounds accumulated;
+                auto accumulated_count = 0;
+
+                for (auto i = kNumBins - 1; i > 0; --i)
+                {
+                    accumulated.Grow(bin_bounds[i]);
+                    accumulated_count += bin_counts[i];
+                    right_area[i] = accumulated.Area();
+                    right_count[i] = accumulated_count;
+                }
+
+                accumulated = Bounds();
+                accumulated_count = 0;
+
+                for (auto i = 1u; i < kNumBins; ++i)
+                {
+                    accumulated.Grow(bin_bounds[i - 1]);
+                    accumulated_count += bin_counts[i - 1];
+
+                    auto cost = accumulated.Area() * accumulated_count + right_area[i] * right_count[i];
+
+                    if (accumulated_count > 0 && right_count[i] > 0 && cost < best_cost)
+                    {
+                        best_cost = cost;
+                        best_axis = axis;
+                        best_split = i;
+                    }
+                }
+            }
+
+            // Intersecting the triangles directly is cheaper than splitting
+            auto leaf_cost = bounds.Area() * count;
+            bool make_leaf = best_axis < 0 || task.depth >= kMaxDepth ||
+                (count <= static_cast<int>(kMaxLeafSize) && best_cost >= leaf_cost);
+
+            if (make_leaf)
+            {
+                node.index = task.begin;
+                node.count = count;
+                continue;
+            }
+
+            auto scale = kNumBins / (centroid_bounds.max[best_axis] - centroid_bounds.min[best_axis]);
+            auto axis_min = centroid_bounds.min[best_axis];
+
+            auto middle = std::partition(order.begin() + task.begin, order.begin() + task.end, [&](int i)
+            {
+                auto bin = std::min(static_cast<std::uint32_t>((centroids[i][best_axis] - axis_min) * scale), kNumBins - 1);
+                return bin < best_split;
+            }) - order.begin();
+
+            auto children = static_cast<int>(m_nodes.size());
+            node.index = children;
+            node.count = 0;
+
+            // Node reference is invalidated here
+            m_nodes.push_back(Node());
+            m_nodes.push_back(Node());
+
+            tasks.push_back({ children, task.begin, static_cast<int>(middle), task.depth + 1 });
+            tasks.push_back({ children + 1, static_cast<int>(middle), task.end, task.depth + 1 });
+        }
+
+        // Store triangles in leaf order
+        m_v0.resize(num_triangles);
+        m_e1.resize(num_triangles);
+        m_e2.resize(num_triangles);
+        m_shapes.resize(num_triangles);
+        m_prims.resize(num_triangles);
+
+        for (auto i = 0u; i < num_triangles; ++i)
+        {
+            auto t = order[i];
+            m_v0[i] = vertices[3 * t];
+            m_e1[i] = vertices[3 * t + 1] - vertices[3 * t];
+            m_e2[i] = vertices[3 * t + 2] - vertices[3 * t];
+            m_shapes[i] = shapes[t];
+            m_prims[i] = prims[t];
+        }
+    }
+
+    template <bool kAnyHit>
+    bool CpuBvh::Traverse(float3 const& o, float3 const& d, float tmax, Hit* hit) const
+    {
+        if (m_nodes.empty())
+        {
+            return false;
+        }
+
+        float inv_d[3];
+        for (auto i = 0; i < 3; ++i)
+        {
+            inv_d[i] = std::abs(d[i]) > 1e-20f ? 1.f / d[i] : std::copysign(1e20f, d[i]);
+        }
+
+        int stack[2 * kMaxDepth + 2];
+        auto stack_size = 0;
+        auto node_index = 0;
+        auto closest = tmax;
+        auto found = false;
+
+        if (IntersectBox(m_nodes[0].bmin, m_nodes[0].bmax, o, inv_d, closest) == std::numeric_limits<float>::infinity())
+        {
+            return false;
+        }
+
+        for (;;)
+        {
+            auto const& node = m_nodes[node_index];
+
+            if (node.count > 0)
+            {
+                for (auto i = node.index; i < node.index + node.count; ++i)
+                {
+                    // Moller-Trumbore
+                    auto p = cross(d, m_e2[i]);
+                    auto det = dot(m_e1[i], p);
+
+                    if (std::abs(det) < 1e-20f)
+                    {
+                        continue;
+                    }
+
+                    auto inv_det = 1.f / det;
+                    auto s = o - m_v0[i];
+                    auto u = dot(s, p) * inv_det;
+
+                    if (u < 0.f || u > 1.f)
+                    {
+                        continue;
+                    }
+
+                    auto q = cross(s, m_e1[i]);
+                    auto v = dot(d, q) * inv_det;
+
+                    if (v < 0.f || u + v > 1.f)
+                    {
+                        continue;
+                    }
+
+                    auto t = dot(m_e2[i], q) * inv_det;
+
+                    if (t > 0.f && t < closest)
+                    {
+                        if (kAnyHit)
+                        {
+                            return true;
+                        }
+
+                        closest = t;
+                        found = true;
+                        hit->shape = m_shapes[i];
+                        hit->prim = m_prims[i];
+                        hit->u = u;
+                        hit->v = v;
+                        hit->t = t;
+                    }
+                }
+            }
+            else
+            {
+                auto left = node.index;
+                auto right = node.index + 1;
+                auto tleft = IntersectBox(m_nodes[left].bmin, m_nodes[left].bmax, o, inv_d, closest);
+                auto tright = IntersectBox(m_nodes[right].bmin, m_nodes[right].bmax, o, inv_d, closest);
+
+                auto inf = std::numeric_limits<float>::infinity();
+
+                if (tleft != inf && tright != inf)
+                {
+                    // Visit the nearer child first
+                    if (tright < tleft)
+                    {
+                        std::swap(left, right);
+                    }
+
+                    stack[stack_size++] = right;
+                    node_index = left;
+                    continue;
+                }
+                else if (tleft != inf)
+                {
+                    node_index = left;
+                    continue;
+                }
+                else if (tright != inf)
+                {
+                    node_index = right;
+                    continue;
+                }
+            }
+
+            if (stack_size == 0)
+            {
+                break;
+            }
+
+            node_index = stack[--stack_size];
+        }
+
+        return found;
+    }
+
+    bool CpuBvh::Intersect(float3 const& o, float3 const& d, float tmax, Hit& hit) const
+    {
+        hit.shape = -1;
+        hit.prim = -1;
+        return Traverse<false>(o, d, tmax, &hit);
+    }
+
+    bool CpuBvh::Occluded(float3 const& o, float3 const& d, float tmax) const
+    {
+        return Traverse<true>(o, d, tmax, nullptr);
+    }
+}
@@ -0,0 +1,88 @@
+/**********************************************************************
+Copyright (c) 2017 Advanced Micro Devices, Inc. All rights reserved.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+********************************************************************/
+#pragma once
+
+#include "math/float3.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace Baikal
+{
+    /**
+     \brief Bounding volume hierarchy over world space triangles for host side ray queries.
+
+     Built with binned SAH, children of a node are stored next to each other.
+     Traversal is single ray and thread safe, so a built hierarchy can be
+     queried concurrently.
+     */
+    class CpuBvh
+    {
+    public:
+        struct Hit
+        {
+            // Shape and primitive as passed to Build, -1 on a miss
+            int shape;
+            int prim;
+            // Barycentrics of the hit point and ray distance
+            float u;
+            float v;
+            float t;
+        };
+
+        // Build the hierarchy over triangles, (v0, v1, v2) vertex triplets
+        // with shape and primitive index for each triangle
+        void Build(std::vector<RadeonRays::float3> const& vertices,
+                   std::vector<int> const& shapes,
+                   std::vector<int> const& prims);
+
+        // Find the closest hit within (0, tmax), returns false on a miss
+        bool Intersect(RadeonRays::float3 const& o, RadeonRays::float3 const& d, float tmax, Hit& hit) const;
+
+        // Check if anything is hit within (0, tmax)
+        bool Occluded(RadeonRays::float3 const& o, RadeonRays::float3 const& d, float tmax) const;
+
+        std::size_t GetNumTriangles() const { return m_shapes.size(); }
+
+    private:
+        struct Node
+        {
+            float bmin[3];
+            // First child for inner nodes, first triangle for leaves
+            int index;
+            float bmax[3];
+            // Number of triangles for leaves, 0 for inner nodes
+            int count;
+        };
+
+        template <bool kAnyHit>
+        bool Traverse(RadeonRays::float3 const& o, RadeonRays::float3 const& d, float tmax, Hit* hit) const;
+
+        std::vector<Node> m_nodes;
+        // Triangles in leaf order, as vertex and two edges
+        std::vector<RadeonRays::float3> m_v0;
+        std::vector<RadeonRays::float3> m_e1;
+        std::vector<RadeonRays::float3> m_e2;
+        std::vector<int> m_shapes;
+        std::vector<int> m_prims;
+    };
+}
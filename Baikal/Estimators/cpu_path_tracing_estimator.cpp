@@ -0,0 +1,1407 @@
+/**********************************************************************
+Copyright (c) 2017 Advanced Micro Devices, Inc. All rights reserved.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+********************************************************************/
+#include "cpu_path_tracing_estimator.h"
+#include "cpu_bvh.h"
+
+#include "Controllers/clw_vertex_format.h"
+#include "Utils/half.h"
+#include "Utils/sobol.h"
+#include "Utils/thread_pool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <functional>
+#include <numeric>
+#include <set>
+#include <stdexcept>
+#include <type_traits>
+
+namespace Baikal
+{
+    using namespace RadeonRays;
+
+    namespace
+    {
+        float constexpr kPi = 3.14159265358979323846f;
+        // Match the limits the kernels use (common.cl)
+        float constexpr kMaxRadiance = 10.f;
+        float constexpr kMaxDistance = 1000000.f;
+        float constexpr kRayEpsilon = 0.001f;
+        float constexpr kDenomEps = 1e-8f;
+        float constexpr kRoughnessEps = 0.0001f;
+        // Number of rays a thread picks from the queue at a time
+        std::size_t constexpr kRaysPerTask = 256;
+
+        inline float3 ClampRadiance(float3 const& v)
+        {
+            return float3(
+                std::min(std::max(v.x, 0.f), kMaxRadiance),
+                std::min(std::max(v.y, 0.f), kMaxRadiance),
+                std::min(std::max(v.z, 0.f), kMaxRadiance));
+        }
+
+        inline float3 MulPoint(ClwScene::matrix4x4 const& m, float3 const& p)
+        {
+            return float3(
+                m.m0.x * p.x + m.m0.y * p.y + m.m0.z * p.z + m.m0.w,
+                m.m1.x * p.x + m.m1.y * p.y + m.m1.z * p.z + m.m1.w,
+                m.m2.x * p.x + m.m2.y * p.y + m.m2.z * p.z + m.m2.w);
+        }
+
+        inline float3 MulVector(ClwScene::matrix4x4 const& m, float3 const& v)
+        {
+            return float3(
+                m.m0.x * v.x + m.m0.y * v.y + m.m0.z * v.z,
+                m.m1.x * v.x + m.m1.y * v.y + m.m1.z * v.z,
+                m.m2.x * v.x + m.m2.y * v.y + m.m2.z * v.z);
+        }
+
+        // Orthonormal basis around n
+        inline void MakeBasis(float3 const& n, float3& t, float3& b)
+        {
+            t = std::abs(n.x) > 0.1f ? float3(n.z, 0.f, -n.x) : float3(0.f, -n.z, n.y);
+            t = normalize(t);
+            b = cross(n, t);
+        }
+
+        // Cosine weighted direction around n
+        inline float3 SampleHemisphere(float3 const& n, float u0, float u1)
+        {
+            float3 t, b;
+            MakeBasis(n, t, b);
+
+            auto r = std::sqrt(u0);
+            auto phi = 2.f * kPi * u1;
+            auto y = std::sqrt(std::max(0.f, 1.f - u0));
+
+            return normalize(t * (r * std::cos(phi)) + n * y + b * (r * std::sin(phi)));
+        }
+
+        // Uniform direction on the hemisphere around n
+        inline float3 SampleUniformHemisphere(float3 const& n, float u0, float u1)
+        {
+            float3 t, b;
+            MakeBasis(n, t, b);
+
+            auto r = std::sqrt(std::max(0.f, 1.f - u0 * u0));
+            auto phi = 2.f * kPi * u1;
+
+            return normalize(t * (r * std::cos(phi)) + n * u0 + b * (r * std::sin(phi)));
+        }
+
+        // Uniform direction on the sphere
+        inline float3 SampleSphere(float u0, float u1)
+        {
+            auto y = 1.f - 2.f * u0;
+            auto r = std::sqrt(std::max(0.f, 1.f - y * y));
+            auto phi = 2.f * kPi * u1;
+
+            return float3(r * std::cos(phi), y, r * std::sin(phi));
+        }
+
+        inline float FresnelDielectric(float etai, float etat, float cosi, float cost)
+        {
+            auto rparl = ((etat * cosi) - (etai * cost)) / ((etat * cosi) + (etai * cost));
+            auto rperp = ((etai * cosi) - (etat * cost)) / ((etai * cosi) + (etat * cost));
+            return (rparl * rparl + rperp * rperp) * 0.5f;
+        }
+
+        // Fresnel reflectance of a dielectric boundary for a cosine against the normal
+        inline float Fresnel(float ior, float cosi)
+        {
+            auto etai = 1.f;
+            auto etat = ior;
+
+            if (cosi < 0.f)
+            {
+                std::swap(etai, etat);
+                cosi = -cosi;
+            }
+
+            auto eta = etai / etat;
+            auto sint2 = eta * eta * (1.f - cosi * cosi);
+
+            if (sint2 >= 1.f)
+            {
+                return 1.f;
+            }
+
+            return FresnelDielectric(etai, etat, cosi, std::sqrt(std::max(0.f, 1.f - sint2)));
+        }
+
+        // Microfacet terms in a local frame with the normal along y (bxdf_basic.cl)
+        enum class Distribution
+        {
+            kGGX,
+            kBeckmann
+        };
+
+        inline float MicrofacetD(Distribution distribution, float roughness, float3 const& m)
+        {
+            auto ndotm = std::abs(m.y);
+            auto ndotm2 = ndotm * ndotm;
+            auto sinmn = std::sqrt(1.f - std::min(std::max(ndotm2, 0.f), 1.f));
+            auto tanmn = ndotm > kDenomEps ? sinmn / ndotm : 0.f;
+            auto a2 = roughness * roughness;
+
+            if (distribution == Distribution::kBeckmann)
+            {
+                return ndotm > kDenomEps ? std::exp(-tanmn * tanmn / a2) / (kPi * a2 * ndotm2 * ndotm2) : 0.f;
+            }
+
+            auto denom = kPi * ndotm2 * ndotm2 * (a2 + tanmn * tanmn) * (a2 + tanmn * tanmn);
+            return denom > kDenomEps ? a2 / denom : 1.f;
+        }
+
+        inline float MicrofacetG1(Distribution distribution, float roughness, float3 const& v)
+        {
+            auto ndotv = std::abs(v.y);
+            auto sinnv = std::sqrt(1.f - std::min(std::max(ndotv * ndotv, 0.f), 1.f));
+            auto tannv = ndotv > kDenomEps ? sinnv / ndotv : 0.f;
+
+            if (distribution == Distribution::kGGX)
+            {
+                auto a2 = roughness * roughness;
+                return 2.f / (1.f + std::sqrt(1.f + a2 * tannv * tannv));
+            }
+
+            // Rational approximation of the Beckmann shadowing, no shadowing at normal incidence
+            if (tannv <= kDenomEps)
+            {
+                return 1.f;
+            }
+
+            auto a = 1.f / (roughness * tannv);
+
+            if (a > 1.6f)
+            {
+                return 1.f;
+            }
+
+            return (3.535f * a + 2.181f * a * a) / (1.f + 2.276f * a + 2.577f * a * a);
+        }
+
+        inline float MicrofacetG(Distribution distribution, float roughness, float3 const& wi, float3 const& wo)
+        {
+            return MicrofacetG1(distribution, roughness, wi) * MicrofacetG1(distribution, roughness, wo);
+        }
+
+        inline float3 MicrofacetSampleNormal(Distribution distribution, float roughness, float u0, float u1)
+        {
+            auto theta = distribution == Distribution::kGGX ?
+                std::atan2(roughness * std::sqrt(u0), std::sqrt(1.f - u0)) :
+                std::atan(std::sqrt(-roughness * roughness * std::log(std::max(kDenomEps, 1.f - u0))));
+            auto phi = 2.f * kPi * u1;
+
+            return float3(std::sin(theta) * std::cos(phi), std::cos(theta), std::sin(theta) * std::sin(phi));
+        }
+
+        // Single BxDF picked out of a material, directions are in the local frame
+        struct Bxdf
+        {
+            int type;
+            // Reflectance scaled by Fresnel
+            float3 ks;
+            float roughness;
+            float ni;
+        };
+
+        // Specular BxDFs scatter into a single direction and are never hit by light samples
+        inline bool IsSingular(int type)
+        {
+            return type == ClwScene::kIdealReflect || type == ClwScene::kIdealRefract || type == ClwScene::kPassthrough;
+        }
+
+        inline bool IsTransmissive(int type)
+        {
+            return type == ClwScene::kIdealRefract || type == ClwScene::kTranslucent ||
+                type == ClwScene::kMicrofacetRefractionGGX || type == ClwScene::kMicrofacetRefractionBeckmann ||
+                type == ClwScene::kPassthrough;
+        }
+
+        inline Distribution GetDistribution(int type)
+        {
+            return type == ClwScene::kMicrofacetBeckmann || type == ClwScene::kMicrofacetRefractionBeckmann ?
+                Distribution::kBeckmann : Distribution::kGGX;
+        }
+
+        // Half vector of a refraction event, oriented by the side wi is on
+        inline float3 RefractionHalfVector(Bxdf const& bxdf, float3 const& wi, float3 const& wo, float& etat)
+        {
+            auto etai = 1.f;
+            etat = bxdf.ni;
+
+            if (wi.y < 0.f)
+            {
+                std::swap(etai, etat);
+            }
+
+            return -(wi * etai + wo * etat);
+        }
+
+        inline float3 EvaluateBxdf(Bxdf const& bxdf, float3 const& wi, float3 const& wo)
+        {
+            switch (bxdf.type)
+            {
+            case ClwScene::kLambert:
+                return wo.y > 0.f ? bxdf.ks * (1.f / kPi) : float3(0.f, 0.f, 0.f);
+            case ClwScene::kTranslucent:
+                return wi.y * wo.y < 0.f ? bxdf.ks * (1.f / kPi) : float3(0.f, 0.f, 0.f);
+            case ClwScene::kMicrofacetGGX:
+            case ClwScene::kMicrofacetBeckmann:
+            {
+                auto denom = 4.f * std::abs(wo.y) * std::abs(wi.y);
+
+                if (wo.y <= 0.f || denom <= kDenomEps)
+                {
+                    return float3(0.f, 0.f, 0.f);
+                }
+
+                auto distribution = GetDistribution(bxdf.type);
+                auto wh = normalize(wi + wo);
+                auto dg = MicrofacetD(distribution, bxdf.roughness, wh) * MicrofacetG(distribution, bxdf.roughness, wi, wo);
+                return bxdf.ks * (dg / denom);
+            }
+            case ClwScene::kMicrofacetRefractionGGX:
+            case ClwScene::kMicrofacetRefractionBeckmann:
+            {
+                if (wi.y * wo.y >= 0.f)
+                {
+                    return float3(0.f, 0.f, 0.f);
+                }
+
+                float etat;
+                auto ht = RefractionHalfVector(bxdf, wi, wo, etat);
+                auto wh = normalize(ht);
+                auto denom = dot(ht, ht) * std::abs(wi.y) * std::abs(wo.y);
+
+                if (denom <= kDenomEps)
+                {
+                    return float3(0.f, 0.f, 0.f);
+                }
+
+                auto distribution = GetDistribution(bxdf.type);
+                auto dg = MicrofacetD(distribution, bxdf.roughness, wh) * MicrofacetG(distribution, bxdf.roughness, wi, wo);
+                return bxdf.ks * (std::abs(dot(wh, wi)) * std::abs(dot(wh, wo)) * etat * etat * dg / denom);
+            }
+            default:
+                return float3(0.f, 0.f, 0.f);
+            }
+        }
+
+        inline float GetBxdfPdf(Bxdf const& bxdf, float3 const& wi, float3 const& wo)
+        {
+            switch (bxdf.type)
+            {
+            case ClwScene::kLambert:
+                return wo.y > 0.f ? wo.y / kPi : 0.f;
+            case ClwScene::kTranslucent:
+                return wi.y * wo.y < 0.f ? std::abs(wo.y) / kPi : 0.f;
+            case ClwScene::kMicrofacetGGX:
+            case ClwScene::kMicrofacetBeckmann:
+            {
+                auto wh = normalize(wi + wo);
+                auto denom = 4.f * std::abs(dot(wo, wh));
+                return denom > kDenomEps ?
+                    MicrofacetD(GetDistribution(bxdf.type), bxdf.roughness, wh) * std::abs(wh.y) / denom : 0.f;
+            }
+            case ClwScene::kMicrofacetRefractionGGX:
+            case ClwScene::kMicrofacetRefractionBeckmann:
+            {
+                if (wi.y * wo.y >= 0.f)
+                {
+                    return 0.f;
+                }
+
+                float etat;
+                auto ht = RefractionHalfVector(bxdf, wi, wo, etat);
+                auto wh = normalize(ht);
+                auto denom = dot(ht, ht);
+                auto whpdf = MicrofacetD(GetDistribution(bxdf.type), bxdf.roughness, wh) * std::abs(wh.y);
+                return denom > kDenomEps ? whpdf * std::abs(dot(wo, wh)) * etat * etat / denom : 0.f;
+            }
+            default:
+                return 0.f;
+            }
+        }
+
+        // Sample wo, returns the BxDF value, singular BxDFs return their weight divided by |cos(wo)| with pdf 1
+        inline float3 SampleBxdf(Bxdf const& bxdf, float3 const& wi, float u0, float u1, float3& wo, float& pdf)
+        {
+            float3 const up(0.f, 1.f, 0.f);
+            float3 const zero(0.f, 0.f, 0.f);
+            pdf = 0.f;
+
+            switch (bxdf.type)
+            {
+            case ClwScene::kLambert:
+                wo = SampleHemisphere(up, u0, u1);
+                break;
+            case ClwScene::kTranslucent:
+                wo = SampleHemisphere(wi.y > 0.f ? -up : up, u0, u1);
+                break;
+            case ClwScene::kMicrofacetGGX:
+            case ClwScene::kMicrofacetBeckmann:
+            {
+                auto wh = MicrofacetSampleNormal(GetDistribution(bxdf.type), bxdf.roughness, u0, u1);
+                wo = wh * (2.f * std::abs(dot(wi, wh))) - wi;
+                break;
+            }
+            case ClwScene::kMicrofacetRefractionGGX:
+            case ClwScene::kMicrofacetRefractionBeckmann:
+            {
+                if (wi.y == 0.f)
+                {
+                    return zero;
+                }
+
+                auto etai = 1.f;
+                auto etat = bxdf.ni;
+                auto s = 1.f;
+
+                if (wi.y < 0.f)
+                {
+                    std::swap(etai, etat);
+                    s = -s;
+                }
+
+                auto wh = MicrofacetSampleNormal(GetDistribution(bxdf.type), bxdf.roughness, u0, u1);
+                auto c = dot(wi, wh);
+                auto eta = etai / etat;
+                auto d = 1.f + eta * (c * c - 1.f);
+
+                if (d <= 0.f)
+                {
+                    return zero;
+                }
+
+                wo = normalize(wh * (eta * c - s * std::sqrt(d)) - wi * eta);
+                break;
+            }
+            case ClwScene::kIdealReflect:
+            {
+                wo = float3(-wi.x, wi.y, -wi.z);
+                pdf = 1.f;
+                return std::abs(wo.y) > kDenomEps ? bxdf.ks * (1.f / std::abs(wo.y)) : zero;
+            }
+            case ClwScene::kIdealRefract:
+            {
+                auto etai = 1.f;
+                auto etat = bxdf.ni;
+                auto cosi = wi.y;
+
+                if (cosi < 0.f)
+                {
+                    std::swap(etai, etat);
+                    cosi = -cosi;
+                }
+
+                auto eta = etai / etat;
+                auto sint2 = eta * eta * (1.f - cosi * cosi);
+
+                if (sint2 >= 1.f)
+                {
+                    return zero;
+                }
+
+                auto cost = std::sqrt(std::max(0.f, 1.f - sint2));
+                wo = normalize(float3(-wi.x * eta, wi.y > 0.f ? -cost : cost, -wi.z * eta));
+                pdf = 1.f;
+                return cost > kDenomEps ? bxdf.ks * (eta * eta / cost) : zero;
+            }
+            case ClwScene::kPassthrough:
+            {
+                wo = -wi;
+                pdf = 1.f;
+                return std::abs(wo.y) > kDenomEps ? float3(1.f, 1.f, 1.f) * (1.f / std::abs(wo.y)) : zero;
+            }
+            default:
+                return zero;
+            }
+
+            pdf = GetBxdfPdf(bxdf, wi, wo);
+            return EvaluateBxdf(bxdf, wi, wo);
+        }
+
+        // Power heuristic of combining light and BxDF samples
+        inline float PowerHeuristic(float pdf, float other_pdf)
+        {
+            auto denom = pdf * pdf + other_pdf * other_pdf;
+            return denom > 0.f ? pdf * pdf / denom : 0.f;
+        }
+    }
+
+    // PCG32 stream, one per ray and sample
+    class CpuPathTracingEstimator::Sampler
+    {
+    public:
+        Sampler(std::uint32_t seed, std::uint32_t sample, std::uint32_t index)
+            : m_state(0u)
+            , m_inc((static_cast<std::uint64_t>(index) << 1u) | 1u)
+        {
+            Next();
+            m_state += (static_cast<std::uint64_t>(seed) << 32u) | sample;
+            Next();
+        }
+
+        float Sample1D()
+        {
+            return (Next() >> 8) * (1.f / 16777216.f);
+        }
+
+    private:
+        std::uint32_t Next()
+        {
+            auto old = m_state;
+            m_state = old * 6364136223846793005ULL + m_inc;
+            auto xorshifted = static_cast<std::uint32_t>(((old >> 18u) ^ old) >> 27u);
+            auto rot = static_cast<std::uint32_t>(old >> 59u);
+            return (xorshifted >> rot) | (xorshifted << ((~rot + 1u) & 31u));
+        }
+
+        std::uint64_t m_state;
+        std::uint64_t m_inc;
+    };
+
+    struct CpuPathTracingEstimator::SceneData
+    {
+        ClwScene const* scene = nullptr;
+        std::uint64_t revision = 0;
+
+        ClwScene::VertexFormat vertex_format = ClwScene::VERTEX_FORMAT_FLOAT;
+        std::vector<char> vertices;
+        std::vector<char> normals;
+        std::vector<char> uvs;
+        std::vector<int> indices;
+        std::vector<ClwScene::Shape> shapes;
+        // Material unions are not default constructible, keep them as raw storage
+        std::vector<char> materials;
+        std::vector<ClwScene::Light> lights;
+        std::vector<ClwScene::Texture> textures;
+        std::vector<char> texturedata;
+        int env_light_idx = -1;
+
+        CpuBvh bvh;
+
+        ClwScene::Material const& GetMaterial(int idx) const
+        {
+            return reinterpret_cast<ClwScene::Material const*>(materials.data())[idx];
+        }
+
+        // Bilinear lookup of the top resident mip level (texture.cl)
+        float3 SampleTexture(float2 uv, int idx) const
+        {
+            auto const& texture = textures[idx];
+            auto width = texture.w;
+            auto height = texture.h;
+
+            // Tiles of streamed textures are not copied, use the first pooled level
+            if (texture.pagetable >= 0)
+            {
+                width = std::max(width >> texture.num_tiled_levels, 1);
+                height = std::max(height >> texture.num_tiled_levels, 1);
+            }
+
+            auto data = texturedata.data() + texture.dataoffset;
+
+            uv.x -= std::floor(uv.x);
+            uv.y -= std::floor(uv.y);
+            uv.y = 1.f - uv.y;
+
+            auto x0 = std::min(std::max(static_cast<int>(std::floor(uv.x * width)), 0), width - 1);
+            auto y0 = std::min(std::max(static_cast<int>(std::floor(uv.y * height)), 0), height - 1);
+            auto x1 = std::min(x0 + 1, width - 1);
+            auto y1 = std::min(y0 + 1, height - 1);
+            auto wx = uv.x * width - std::floor(uv.x * width);
+            auto wy = uv.y * height - std::floor(uv.y * height);
+
+            auto load = [&](int x, int y)
+            {
+                auto i = width * y + x;
+
+                switch (texture.fmt)
+                {
+                case ClwScene::RGBA32:
+                {
+                    auto texel = reinterpret_cast<float const*>(data) + 4 * i;
+                    return float3(texel[0], texel[1], texel[2]);
+                }
+                case ClwScene::RGBA16:
+                {
+                    auto texel = reinterpret_cast<std::uint16_t const*>(data) + 4 * i;
+                    half r, g, b;
+                    r.setBits(texel[0]);
+                    g.setBits(texel[1]);
+                    b.setBits(texel[2]);
+                    return float3(r, g, b);
+                }
+                case ClwScene::RGBA8:
+                {
+                    auto texel = reinterpret_cast<unsigned char const*>(data) + 4 * i;
+                    return float3(texel[0] / 255.f, texel[1] / 255.f, texel[2] / 255.f);
+                }
+                default:
+                    return float3(0.f, 0.f, 0.f);
+                }
+            };
+
+            auto top = load(x0, y0) * (1.f - wx) + load(x1, y0) * wx;
+            auto bottom = load(x0, y1) * (1.f - wx) + load(x1, y1) * wx;
+            return top * (1.f - wy) + bottom * wy;
+        }
+
+        float3 GetValue3f(float3 const& value, float2 const& uv, int idx) const
+        {
+            return idx == -1 ? value : SampleTexture(uv, idx);
+        }
+
+        float GetValue1f(float value, float2 const& uv, int idx) const
+        {
+            return idx == -1 ? value : SampleTexture(uv, idx).x;
+        }
+
+        // Spherical lookup, same mapping as Texture_SampleEnvMap
+        float3 SampleEnvMap(float3 const& d, int idx) const
+        {
+            auto r = std::sqrt(d.x * d.x + d.y * d.y + d.z * d.z);
+            auto phi = std::atan2(d.x, d.z);
+            phi = phi >= 0.f ? phi : phi + 2.f * kPi;
+            auto theta = std::acos(std::min(std::max(d.y / r, -1.f), 1.f));
+            return SampleTexture(float2(phi / (2.f * kPi), 1.f - theta / kPi), idx);
+        }
+    };
+
+    struct CpuPathTracingEstimator::SurfacePoint
+    {
+        float3 p;
+        // Shading and geometric normals, on the same side
+        float3 n;
+        float3 ng;
+        float2 uv;
+    };
+
+    CpuPathTracingEstimator::CpuPathTracingEstimator(CLWContext context, std::shared_ptr<RadeonRays::IntersectionApi> api)
+        : Estimator(api)
+        , m_context(context)
+        , m_thread_pool(new ThreadPool())
+        , m_scene_data(new SceneData)
+        , m_sample_counter(0)
+        , m_random_seed(0)
+    {
+        m_sobolmat = context.CreateBuffer<std::uint32_t>(1024 * 52, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, &g_SobolMatrices[0]);
+        m_ray_count = context.CreateBuffer<int>(1, CL_MEM_READ_WRITE | CL_MEM_ALLOC_HOST_PTR);
+    }
+
+    CpuPathTracingEstimator::~CpuPathTracingEstimator() = default;
+
+    std::size_t CpuPathTracingEstimator::GetWorkBufferSize() const
+    {
+        return m_rays.GetElementCount();
+    }
+
+    std::size_t CpuPathTracingEstimator::GetWorkBufferItemSize() const
+    {
+        std::size_t size = 0;
+        ForEachWorkBuffer(*this, [&size](auto const& buffer)
+        {
+            size += sizeof(typename BufferElement<std::decay_t<decltype(buffer)>>::type);
+        });
+
+        return size;
+    }
+
+    void CpuPathTracingEstimator::SetWorkBufferSize(std::size_t size)
+    {
+        auto flags = CL_MEM_READ_WRITE | CL_MEM_ALLOC_HOST_PTR;
+
+        ForEachWorkBuffer(*this, [this, size, flags](auto& buffer)
+        {
+            using T = typename BufferElement<std::decay_t<decltype(buffer)>>::type;
+            buffer = m_context.CreateBuffer<T>(size, flags);
+        });
+
+        std::vector<int> iota(size);
+        std::iota(iota.begin(), iota.end(), 0);
+        m_context.WriteBuffer(0, m_iota, iota.data(), size).Wait();
+
+        m_seeds.resize(size);
+        GenerateRandomSeeds(m_random_seed, m_seeds);
+        m_context.WriteBuffer(0, m_random, m_seeds.data(), size).Wait();
+    }
+
+    void CpuPathTracingEstimator::SetRandomSeed(std::uint32_t seed)
+    {
+        m_random_seed = seed;
+        m_sample_counter = 0;
+
+        if (!m_seeds.empty())
+        {
+            GenerateRandomSeeds(seed, m_seeds);
+            m_context.WriteBuffer(0, m_random, m_seeds.data(), m_seeds.size()).Wait();
+        }
+    }
+
+    CLWBuffer<ray> CpuPathTracingEstimator::GetRayBuffer() const
+    {
+        return m_rays;
+    }
+
+    CLWBuffer<int> CpuPathTracingEstimator::GetOutputIndexBuffer() const
+    {
+        return m_output_indices;
+    }
+
+    CLWBuffer<int> CpuPathTracingEstimator::GetRayCountBuffer() const
+    {
+        return m_ray_count;
+    }
+
+    CLWBuffer<RadeonRays::Intersection> CpuPathTracingEstimator::GetFirstHitBuffer() const
+    {
+        return m_intersections;
+    }
+
+    bool CpuPathTracingEstimator::HasRandomBuffer(RandomBufferType buffer) const
+    {
+        switch (buffer)
+        {
+        case RandomBufferType::kRandomSeed:
+        case RandomBufferType::kSobolLUT:
+            return true;
+        }
+
+        return false;
+    }
+
+    CLWBuffer<std::uint32_t> CpuPathTracingEstimator::GetRandomBuffer(RandomBufferType buffer) const
+    {
+        switch (buffer)
+        {
+        case RandomBufferType::kRandomSeed:
+            return m_random;
+        case RandomBufferType::kSobolLUT:
+            return m_sobolmat;
+        }
+
+        return CLWBuffer<std::uint32_t>();
+    }
+
+    CpuPathTracingEstimator::SceneData const& CpuPathTracingEstimator::GetSceneData(ClwScene const& scene)
+    {
+        auto& data = *m_scene_data;
+
+        if (data.scene == &scene && data.revision == scene.revision)
+        {
+            return data;
+        }
+
+        // Buffers are refilled in place, do not hand them out again if loading fails
+        data.scene = nullptr;
+
+        auto read = [this](auto buffer, auto& out)
+        {
+            out.resize(buffer.GetElementCount());
+
+            if (!out.empty())
+            {
+                m_context.ReadBuffer(0, buffer, out.data(), out.size()).Wait();
+            }
+        };
+
+        read(scene.vertices, data.vertices);
+        read(scene.normals, data.normals);
+        read(scene.uvs, data.uvs);
+        read(scene.indices, data.indices);
+        read(scene.shapes, data.shapes);
+        data.materials.resize(scene.materials.GetElementCount() * sizeof(ClwScene::Material));
+
+        if (!data.materials.empty())
+        {
+            m_context.ReadBuffer(0, scene.materials, reinterpret_cast<ClwScene::Material*>(data.materials.data()),
+                scene.materials.GetElementCount()).Wait();
+        }
+
+        read(scene.lights, data.lights);
+        read(scene.textures, data.textures);
+        read(scene.texturedata, data.texturedata);
+
+        data.vertex_format = scene.vertex_format;
+        data.env_light_idx = scene.envmapidx;
+
+        // Excluded meshes are only referenced by instances and are not traced
+        std::set<RadeonRays::Shape*> visible(scene.visible_shapes.cbegin(), scene.visible_shapes.cend());
+
+        // Fail on materials the host BxDFs do not implement rather than render something else
+        std::function<void(int)> check_material = [&data, &check_material](int idx)
+        {
+            auto const& mat = data.GetMaterial(idx);
+
+            switch (mat.type)
+            {
+            case ClwScene::kMix:
+            case ClwScene::kFresnelBlend:
+                check_material(mat.compound.top_brdf_idx);
+                check_material(mat.compound.base_brdf_idx);
+                break;
+            case ClwScene::kLayered:
+            case ClwScene::kDisney:
+            case ClwScene::kUberV2:
+                throw std::runtime_error("CpuPathTracingEstimator: layered, Disney and UberV2 materials are not supported");
+            default:
+                break;
+            }
+        };
+
+        std::vector<float3> vertices;
+        std::vector<int> triangle_shapes;
+        std::vector<int> triangle_prims;
+
+        for (auto i = 0u; i < data.shapes.size(); ++i)
+        {
+            if (i < scene.isect_shapes.size() && visible.find(scene.isect_shapes[i]) == visible.cend())
+            {
+                continue;
+            }
+
+            auto const& shape = data.shapes[i];
+            check_material(shape.material_idx);
+
+            for (auto prim = 0; prim < shape.num_prims; ++prim)
+            {
+                for (auto k = 0; k < 3; ++k)
+                {
+                    auto idx = data.indices[shape.startidx + 3 * prim + k];
+                    auto p = ReadPosition(data.vertices.data(), shape.startvtx + idx, data.vertex_format);
+                    vertices.push_back(MulPoint(shape.transform, p));
+                }
+
+                triangle_shapes.push_back(static_cast<int>(i));
+                triangle_prims.push_back(prim);
+            }
+        }
+
+        data.bvh.Build(vertices, triangle_shapes, triangle_prims);
+
+        data.scene = &scene;
+        data.revision = scene.revision;
+        return data;
+    }
+
+    std::size_t CpuPathTracingEstimator::ReadRays(std::size_t num_estimates, std::vector<ray>& rays) const
+    {
+        int count = 0;
+        m_context.ReadBuffer(0, m_ray_count, &count, 1).Wait();
+
+        auto num_rays = std::min(static_cast<std::size_t>(std::max(count, 0)), num_estimates);
+        rays.resize(num_rays);
+
+        if (num_rays > 0)
+        {
+            m_context.ReadBuffer(0, m_rays, rays.data(), num_rays).Wait();
+        }
+
+        return num_rays;
+    }
+
+    float3 CpuPathTracingEstimator::TracePath(
+        SceneData const& data,
+        ray const& r,
+        Sampler& sampler,
+        bool shade_primary_miss,
+        Intersection* first_hit
+    ) const
+    {
+        enum class Event
+        {
+            kCamera,
+            kDiffuse,
+            kReflection,
+            kRefraction
+        };
+
+        // Event a BxDF scatters with
+        auto get_event = [](int type)
+        {
+            switch (type)
+            {
+            case ClwScene::kLambert:
+            case ClwScene::kTranslucent:
+                return Event::kDiffuse;
+            case ClwScene::kIdealRefract:
+            case ClwScene::kMicrofacetRefractionGGX:
+            case ClwScene::kMicrofacetRefractionBeckmann:
+                return Event::kRefraction;
+            default:
+                return Event::kReflection;
+            }
+        };
+
+        // Texture selection of EnvironmentLight_GetTexture
+        auto get_env_texture = [](ClwScene::Light const& light, Event event)
+        {
+            switch (event)
+            {
+            case Event::kCamera:
+                return light.tex_background == -1 ? light.tex : light.tex_background;
+            case Event::kReflection:
+                return light.tex_reflection == -1 ? light.tex : light.tex_reflection;
+            case Event::kRefraction:
+                return light.tex_refraction == -1 ? light.tex : light.tex_refraction;
+            default:
+                return light.tex;
+            }
+        };
+
+        // Environment light samples are uniform over the sphere for transmissive BxDFs
+        // and over the hemisphere around the normal otherwise (EnvironmentLight_Sample)
+        auto get_env_pdf = [](bool transmissive, float3 const& n, float3 const& wo)
+        {
+            if (transmissive)
+            {
+                return 1.f / (4.f * kPi);
+            }
+
+            return dot(n, wo) > 0.f ? 1.f / (2.f * kPi) : 0.f;
+        };
+
+        float3 radiance(0.f, 0.f, 0.f);
+        float3 throughput(1.f, 1.f, 1.f);
+        float3 o(r.o.x, r.o.y, r.o.z);
+        float3 d = normalize(float3(r.d.x, r.d.y, r.d.z));
+        auto tmax = r.o.w;
+        auto event = Event::kCamera;
+        bool active = r.extra.y != 0;
+
+        // Pdfs of the last scattered direction, the light pdf is zero if the
+        // environment has not been sampled there and hits are not weighted
+        auto bxdf_pdf = 0.f;
+        auto env_pdf = 0.f;
+
+        for (auto bounce = 0u; bounce < GetMaxBounces(); ++bounce)
+        {
+            CpuBvh::Hit hit;
+            bool found = active && data.bvh.Intersect(o, d, tmax, hit);
+
+            if (first_hit)
+            {
+                first_hit->shapeid = found ? hit.shape + 1 : -1;
+                first_hit->primid = found ? hit.prim : -1;
+                first_hit->uvwt = float4(hit.u, hit.v, 0.f, hit.t);
+                first_hit = nullptr;
+            }
+
+            if (!active)
+            {
+                break;
+            }
+
+            if (!found)
+            {
+                if (data.env_light_idx >= 0 && (bounce > 0 || shade_primary_miss))
+                {
+                    auto const& light = data.lights[data.env_light_idx];
+                    auto tex = get_env_texture(light, event);
+
+                    if (tex != -1)
+                    {
+                        auto weight = env_pdf > 0.f ? PowerHeuristic(bxdf_pdf, env_pdf) : 1.f;
+                        radiance += ClampRadiance(throughput * data.SampleEnvMap(d, tex) * (light.multiplier * weight));
+                    }
+                }
+
+                break;
+            }
+
+            // Interpolate vertex attributes
+            auto const& shape = data.shapes[hit.shape];
+            auto format = data.vertex_format;
+            SurfacePoint sp;
+            {
+                int idx[3];
+                float3 v[3];
+                float3 n(0.f, 0.f, 0.f);
+                float2 uv(0.f, 0.f);
+                float w[3] = { 1.f - hit.u - hit.v, hit.u, hit.v };
+
+                for (auto k = 0; k < 3; ++k)
+                {
+                    idx[k] = shape.startvtx + data.indices[shape.startidx + 3 * hit.prim + k];
+                    v[k] = MulPoint(shape.transform, ReadPosition(data.vertices.data(), idx[k], format));
+                    n += ReadNormal(data.normals.data(), idx[k], format) * w[k];
+                    uv = uv + ReadUV(data.uvs.data(), idx[k], format) * w[k];
+                }
+
+                sp.p = v[0] * w[0] + v[1] * w[1] + v[2] * w[2];
+                sp.n = normalize(MulVector(shape.transform, n));
+                sp.ng = normalize(cross(v[1] - v[0], v[2] - v[0]));
+                sp.uv = uv;
+
+                if (dot(sp.ng, sp.n) < 0.f)
+                {
+                    sp.ng = -sp.ng;
+                }
+            }
+
+            auto wi = -d;
+            bool backfacing = dot(sp.ng, wi) < 0.f;
+
+            // Pick a BxDF out of compound materials (Material_Select)
+            auto mat = data.GetMaterial(shape.material_idx);
+            auto ndotwi = dot(sp.n, wi);
+            auto fresnel = 1.f;
+
+            while (mat.type == ClwScene::kMix || mat.type == ClwScene::kFresnelBlend)
+            {
+                auto weight = mat.type == ClwScene::kFresnelBlend ?
+                    Fresnel(mat.compound.weight, ndotwi) :
+                    data.GetValue1f(mat.compound.weight, sp.uv, mat.compound.weight_map_idx);
+
+                auto idx = sampler.Sample1D() < weight ? mat.compound.top_brdf_idx : mat.compound.base_brdf_idx;
+                mat = data.GetMaterial(idx);
+            }
+
+            auto type = mat.type;
+
+            if (mat.simple.fresnel > 0.f)
+            {
+                auto f = Fresnel(mat.simple.ni, mat.thin && ndotwi < 0.f ? -ndotwi : ndotwi);
+                bool reflective = type == ClwScene::kIdealReflect || type == ClwScene::kMicrofacetGGX ||
+                    type == ClwScene::kMicrofacetBeckmann || type == ClwScene::kLambert;
+                fresnel = reflective ? f : 1.f - f;
+            }
+
+            if (type == ClwScene::kEmissive)
+            {
+                if (!backfacing)
+                {
+                    auto le = data.GetValue3f(mat.simple.kx, sp.uv, mat.simple.kxmapidx);
+                    radiance += ClampRadiance(throughput * le);
+                }
+
+                break;
+            }
+
+            bool transmissive = IsTransmissive(type);
+
+            if (backfacing && !transmissive)
+            {
+                sp.n = -sp.n;
+                sp.ng = -sp.ng;
+            }
+
+            Bxdf bxdf;
+            bxdf.type = type;
+            bxdf.ks = type == ClwScene::kZero ? float3(0.f, 0.f, 0.f) :
+                data.GetValue3f(mat.simple.kx, sp.uv, mat.simple.kxmapidx) * fresnel;
+            bxdf.roughness = std::max(data.GetValue1f(mat.simple.ns, sp.uv, mat.simple.nsmapidx), kRoughnessEps);
+            bxdf.ni = mat.simple.ni;
+
+            // BxDFs work in a frame with the shading normal along y
+            float3 t, b;
+            MakeBasis(sp.n, t, b);
+
+            auto to_local = [&](float3 const& v)
+            {
+                return float3(dot(v, t), dot(v, sp.n), dot(v, b));
+            };
+
+            auto wi_local = to_local(wi);
+            auto offset = sp.ng * kRayEpsilon;
+
+            auto get_shadow_origin = [&](float3 const& wo)
+            {
+                return sp.p + (dot(sp.ng, wo) > 0.f ? offset : -offset);
+            };
+
+            bool singular = IsSingular(type) || type == ClwScene::kZero;
+
+            // Direct lighting, emissive geometry is picked up by hits
+            if (!singular)
+            {
+                for (auto const& light : data.lights)
+                {
+                    float3 wo;
+                    float3 le;
+
+                    switch (light.type)
+                    {
+                    case ClwScene::kPoint:
+                        wo = light.p - sp.p;
+                        le = light.intensity * (1.f / dot(wo, wo));
+                        break;
+                    case ClwScene::kDirectional:
+                        wo = -light.d * kMaxDistance;
+                        le = light.intensity;
+                        break;
+                    case ClwScene::kSpot:
+                    {
+                        wo = light.p - sp.p;
+                        auto ddotwo = dot(-normalize(wo), light.d);
+
+                        if (ddotwo <= light.oa)
+                        {
+                            continue;
+                        }
+
+                        le = light.intensity * (1.f / dot(wo, wo));
+
+                        if (ddotwo <= light.ia)
+                        {
+                            le = le * (1.f - (light.ia - ddotwo) / (light.ia - light.oa));
+                        }
+
+                        break;
+                    }
+                    default:
+                        continue;
+                    }
+
+                    auto dist = std::sqrt(dot(wo, wo));
+                    wo = wo * (1.f / dist);
+
+                    auto wo_local = to_local(wo);
+                    auto contribution = throughput * EvaluateBxdf(bxdf, wi_local, wo_local) * le * std::abs(wo_local.y);
+
+                    if (contribution.sqnorm() <= 0.f)
+                    {
+                        continue;
+                    }
+
+                    if (!data.bvh.Occluded(get_shadow_origin(wo), wo, dist - 2.f * kRayEpsilon))
+                    {
+                        radiance += ClampRadiance(contribution);
+                    }
+                }
+
+                // Environment light, combined with BxDF samples hitting it
+                if (data.env_light_idx >= 0)
+                {
+                    auto const& light = data.lights[data.env_light_idx];
+                    auto tex = get_env_texture(light, get_event(type));
+
+                    auto u0 = sampler.Sample1D();
+                    auto u1 = sampler.Sample1D();
+                    auto wo = transmissive ? SampleSphere(u0, u1) : SampleUniformHemisphere(sp.n, u0, u1);
+                    auto pdf = get_env_pdf(transmissive, sp.n, wo);
+
+                    if (tex != -1 && pdf > 0.f)
+                    {
+                        auto wo_local = to_local(wo);
+                        auto weight = PowerHeuristic(pdf, GetBxdfPdf(bxdf, wi_local, wo_local));
+                        auto le = data.SampleEnvMap(wo, tex) * light.multiplier;
+                        auto contribution = throughput * EvaluateBxdf(bxdf, wi_local, wo_local) * le *
+                            (std::abs(wo_local.y) * weight / pdf);
+
+                        if (contribution.sqnorm() > 0.f &&
+                            !data.bvh.Occluded(get_shadow_origin(wo), wo, kMaxDistance))
+                        {
+                            radiance += ClampRadiance(contribution);
+                        }
+                    }
+                }
+            }
+
+            // Continue the path
+            auto u0 = sampler.Sample1D();
+            auto u1 = sampler.Sample1D();
+
+            float3 wo_local;
+            auto pdf = 0.f;
+            auto f = SampleBxdf(bxdf, wi_local, u0, u1, wo_local, pdf);
+
+            if (pdf <= 0.f)
+            {
+                break;
+            }
+
+            auto wo = normalize(t * wo_local.x + sp.n * wo_local.y + b * wo_local.z);
+            throughput = throughput * f * (std::abs(wo_local.y) / pdf);
+
+            if (throughput.sqnorm() <= 0.f)
+            {
+                break;
+            }
+
+            bxdf_pdf = pdf;
+            env_pdf = singular || data.env_light_idx < 0 ? 0.f : get_env_pdf(transmissive, sp.n, wo);
+
+            if (type != ClwScene::kPassthrough)
+            {
+                event = get_event(type);
+            }
+
+            o = get_shadow_origin(wo);
+            d = wo;
+            tmax = kMaxDistance;
+        }
+
+        return radiance;
+    }
+
+    void CpuPathTracingEstimator::Estimate(
+        ClwScene const& scene,
+        std::size_t num_estimates,
+        QualityLevel quality,
+        CLWBuffer<RadeonRays::float3> output,
+        bool use_output_indices,
+        bool atomic_update,
+        MissedPrimaryRaysHandler missedPrimaryRaysHandler
+    )
+    {
+        auto const& data = GetSceneData(scene);
+
+        std::vector<ray> rays;
+        auto num_rays = ReadRays(num_estimates, rays);
+
+        if (num_rays == 0)
+        {
+            return;
+        }
+
+        std::vector<int> output_indices(num_rays);
+
+        if (use_output_indices)
+        {
+            m_context.ReadBuffer(0, m_output_indices, output_indices.data(), num_rays).Wait();
+        }
+        else
+        {
+            std::iota(output_indices.begin(), output_indices.end(), 0);
+        }
+
+        std::vector<float3> radiance(num_rays);
+        std::vector<Intersection> first_hits(missedPrimaryRaysHandler ? num_rays : 0);
+
+        // Threads pick up tasks as they get done, so tiles with expensive paths
+        // do not hold the others back
+        auto num_tasks = (num_rays + kRaysPerTask - 1) / kRaysPerTask;
+        auto sample = m_sample_counter;
+
+        m_thread_pool->ParallelFor(num_tasks, [&](std::size_t task)
+        {
+            auto end = std::min(num_rays, (task + 1) * kRaysPerTask);
+
+            for (auto i = task * kRaysPerTask; i < end; ++i)
+            {
+                Sampler sampler(m_seeds[i], sample, static_cast<std::uint32_t>(i));
+                radiance[i] = TracePath(data, rays[i], sampler, !missedPrimaryRaysHandler,
+                    missedPrimaryRaysHandler ? &first_hits[i] : nullptr);
+            }
+        });
+
+        // The handler shades primary misses and advances sample counts
+        if (missedPrimaryRaysHandler)
+        {
+            m_context.WriteBuffer(0, m_intersections, first_hits.data(), num_rays).Wait();
+            missedPrimaryRaysHandler(
+                m_rays,
+                m_intersections,
+                m_iota,
+                use_output_indices ? m_output_indices : m_iota,
+                num_rays, output);
+        }
+
+        float3* mapped = nullptr;
+        m_context.MapBuffer(0, output, CL_MAP_READ | CL_MAP_WRITE, &mapped).Wait();
+
+        for (auto i = 0u; i < num_rays; ++i)
+        {
+            auto& v = mapped[output_indices[i]];
+            v.x += radiance[i].x;
+            v.y += radiance[i].y;
+            v.z += radiance[i].z;
+
+            if (!missedPrimaryRaysHandler)
+            {
+                v.w += 1.f;
+            }
+        }
+
+        m_context.UnmapBuffer(0, output, mapped).Wait();
+
+        ++m_sample_counter;
+    }
+
+    void CpuPathTracingEstimator::TraceFirstHit(
+        ClwScene const& scene,
+        std::size_t num_estimates
+    )
+    {
+        auto const& data = GetSceneData(scene);
+
+        std::vector<ray> rays;
+        auto num_rays = ReadRays(num_estimates, rays);
+
+        if (num_rays == 0)
+        {
+            return;
+        }
+
+        std::vector<Intersection> hits(num_rays);
+        auto num_tasks = (num_rays + kRaysPerTask - 1) / kRaysPerTask;
+
+        m_thread_pool->ParallelFor(num_tasks, [&](std::size_t task)
+        {
+            auto end = std::min(num_rays, (task + 1) * kRaysPerTask);
+
+            for (auto i = task * kRaysPerTask; i < end; ++i)
+            {
+                CpuBvh::Hit hit;
+                auto const& r = rays[i];
+                bool found = r.extra.y != 0 &&
+                    data.bvh.Intersect(float3(r.o.x, r.o.y, r.o.z), float3(r.d.x, r.d.y, r.d.z), r.o.w, hit);
+
+                hits[i].shapeid = found ? hit.shape + 1 : -1;
+                hits[i].primid = found ? hit.prim : -1;
+                hits[i].uvwt = found ? float4(hit.u, hit.v, 0.f, hit.t) : float4(0.f, 0.f, 0.f, 0.f);
+            }
+        });
+
+        m_context.WriteBuffer(0, m_intersections, hits.data(), num_rays).Wait();
+    }
+
+    void CpuPathTracingEstimator::Benchmark(
+        ClwScene const& scene,
+        std::size_t num_estimates,
+        RayTracingStats& stats
+    )
+    {
+        using clock = std::chrono::high_resolution_clock;
+
+        auto const& data = GetSceneData(scene);
+
+        std::vector<ray> rays;
+        auto num_rays = ReadRays(num_estimates, rays);
+
+        if (num_rays == 0)
+        {
+            stats = RayTracingStats();
+            return;
+        }
+
+        auto num_passes = 4u;
+        auto num_tasks = (num_rays + kRaysPerTask - 1) / kRaysPerTask;
+
+        auto throughput = [&](clock::duration delta)
+        {
+            auto ms = std::max(std::chrono::duration<float, std::milli>(delta).count(), 1e-3f);
+            return num_rays / (ms / num_passes / 1000.f);
+        };
+
+        auto for_each_ray = [&](std::function<void(std::size_t)> const& func)
+        {
+            m_thread_pool->ParallelFor(num_tasks, [&](std::size_t task)
+            {
+                auto end = std::min(num_rays, (task + 1) * kRaysPerTask);
+
+                for (auto i = task * kRaysPerTask; i < end; ++i)
+                {
+                    func(i);
+                }
+            });
+        };
+
+        std::vector<CpuBvh::Hit> hits(num_rays);
+        std::vector<char> found(num_rays);
+
+        auto start = clock::now();
+
+        for (auto pass = 0u; pass < num_passes; ++pass)
+        {
+            for_each_ray([&](std::size_t i)
+            {
+                auto const& r = rays[i];
+                found[i] = data.bvh.Intersect(float3(r.o.x, r.o.y, r.o.z), float3(r.d.x, r.d.y, r.d.z), r.o.w, hits[i]);
+            });
+        }
+
+        stats.primary_throughput = throughput(clock::now() - start);
+
+        // Bounce the rays off primary hits, misses keep going
+        std::vector<ray> secondary(rays);
+
+        for_each_ray([&](std::size_t i)
+        {
+            if (!found[i])
+            {
+                return;
+            }
+
+            auto const& r = rays[i];
+            float3 o(r.o.x, r.o.y, r.o.z);
+            float3 d(r.d.x, r.d.y, r.d.z);
+
+            Sampler sampler(m_seeds[i], m_sample_counter, static_cast<std::uint32_t>(i));
+            auto u0 = sampler.Sample1D();
+            auto u1 = sampler.Sample1D();
+            auto n = normalize(-d);
+
+            secondary[i].o = o + d * hits[i].t + n * kRayEpsilon;
+            secondary[i].o.w = kMaxDistance;
+            secondary[i].d = SampleHemisphere(n, u0, u1);
+        });
+
+        start = clock::now();
+
+        for (auto pass = 0u; pass < num_passes; ++pass)
+        {
+            for_each_ray([&](std::size_t i)
+            {
+                auto const& r = secondary[i];
+                data.bvh.Occluded(float3(r.o.x, r.o.y, r.o.z), float3(r.d.x, r.d.y, r.d.z), r.o.w);
+            });
+        }
+
+        stats.shadow_throughput = throughput(clock::now() - start);
+
+        start = clock::now();
+
+        for (auto pass = 0u; pass < num_passes; ++pass)
+        {
+            for_each_ray([&](std::size_t i)
+            {
+                auto const& r = secondary[i];
+                CpuBvh::Hit hit;
+                data.bvh.Intersect(float3(r.o.x, r.o.y, r.o.z), float3(r.d.x, r.d.y, r.d.z), r.o.w, hit);
+            });
+        }
+
+        stats.secondary_throughput = throughput(clock::now() - start);
+
+        // Shading is not split from tracing here, time whole paths instead
+        start = clock::now();
+
+        for (auto pass = 0u; pass < num_passes; ++pass)
+        {
+            for_each_ray([&](std::size_t i)
+            {
+                Sampler sampler(m_seeds[i], pass, static_cast<std::uint32_t>(i));
+                TracePath(data, secondary[i], sampler, true, nullptr);
+            });
+        }
+
+        stats.shading_throughput = throughput(clock::now() - start);
+        stats.sorted_shading_throughput = stats.shading_throughput;
+    }
+}
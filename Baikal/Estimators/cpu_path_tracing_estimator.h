@@ -0,0 +1,138 @@
+/**********************************************************************
+Copyright (c) 2017 Advanced Micro Devices, Inc. All rights reserved.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+********************************************************************/
+#pragma once
+
+#include "estimator.h"
+
+#include <memory>
+#include <vector>
+
+namespace Baikal
+{
+    class ThreadPool;
+
+    /**
+    \brief Estimator tracing paths on the host.
+
+    Work buffers are regular CLW buffers, so the estimator plugs into the renderers
+    unchanged, but intersection and shading run in C++ on a thread pool against a
+    host copy of the compiled scene. Contexts of CPU OpenCL devices keep the buffers
+    in host memory, so no data crosses the bus there.
+
+    Estimates only depend on the random seed, which makes the estimator a reference
+    for the kernels. Supported are the basic BxDFs of bxdf_basic.cl, compound materials,
+    analytic lights, emissive geometry hit by the paths and environment lights, which
+    are sampled uniformly and combined with BxDF samples by multiple importance
+    sampling. Scenes with layered, Disney or UberV2 materials throw std::runtime_error
+    when estimated. Volumes and normal maps are ignored.
+    */
+    class CpuPathTracingEstimator : public Estimator
+    {
+    public:
+        CpuPathTracingEstimator(CLWContext context, std::shared_ptr<RadeonRays::IntersectionApi> api);
+
+        ~CpuPathTracingEstimator() override;
+
+        void SetWorkBufferSize(std::size_t size) override;
+        std::size_t GetWorkBufferSize() const override;
+        std::size_t GetWorkBufferItemSize() const override;
+
+        void SetRandomSeed(std::uint32_t seed) override;
+
+        CLWBuffer<ray> GetRayBuffer() const override;
+        CLWBuffer<int> GetOutputIndexBuffer() const override;
+        CLWBuffer<int> GetRayCountBuffer() const override;
+        CLWBuffer<RadeonRays::Intersection> GetFirstHitBuffer() const override;
+
+        bool HasRandomBuffer(RandomBufferType buffer) const override;
+        CLWBuffer<std::uint32_t> GetRandomBuffer(RandomBufferType buffer) const override;
+
+        void Estimate(
+            ClwScene const& scene,
+            std::size_t num_estimates,
+            QualityLevel quality,
+            CLWBuffer<RadeonRays::float3> output,
+            bool use_output_indices = true,
+            bool atomic_update = false,
+            MissedPrimaryRaysHandler missedPrimaryRaysHandler = nullptr
+        ) override;
+
+        void TraceFirstHit(
+            ClwScene const& scene,
+            std::size_t num_estimates
+        ) override;
+
+        void Benchmark(
+            ClwScene const& scene,
+            std::size_t num_estimates,
+            RayTracingStats& stats
+        ) override;
+
+    private:
+        struct SceneData;
+        struct SurfacePoint;
+        class Sampler;
+
+        // Refresh host copy of the scene if it has been recompiled
+        SceneData const& GetSceneData(ClwScene const& scene);
+
+        // Read rays the client has put into the ray buffer
+        std::size_t ReadRays(std::size_t num_estimates, std::vector<ray>& rays) const;
+
+        // Single sample estimate of radiance along a ray
+        RadeonRays::float3 TracePath(
+            SceneData const& data,
+            ray const& r,
+            Sampler& sampler,
+            bool shade_primary_miss,
+            RadeonRays::Intersection* first_hit
+        ) const;
+
+        // Visit every buffer holding one element per work item
+        template <typename Self, typename F>
+        static void ForEachWorkBuffer(Self& self, F&& f)
+        {
+            f(self.m_rays);
+            f(self.m_output_indices);
+            f(self.m_iota);
+            f(self.m_intersections);
+            f(self.m_random);
+        }
+
+        CLWContext m_context;
+        std::unique_ptr<ThreadPool> m_thread_pool;
+        std::unique_ptr<SceneData> m_scene_data;
+
+        CLWBuffer<ray> m_rays;
+        CLWBuffer<int> m_output_indices;
+        CLWBuffer<int> m_ray_count;
+        CLWBuffer<int> m_iota;
+        CLWBuffer<RadeonRays::Intersection> m_intersections;
+        CLWBuffer<std::uint32_t> m_random;
+        CLWBuffer<std::uint32_t> m_sobolmat;
+
+        std::vector<std::uint32_t> m_seeds;
+        std::uint32_t m_sample_counter;
+        // Seed of per work item random generators
+        std::uint32_t m_random_seed;
+    };
+}
@@ -24,14 +24,40 @@ THE SOFTWARE.
 #include "radeon_rays.h"
 #include "SceneGraph/clwscene.h"
 #include "Utils/clw_class.h"
+#include "Utils/render_statistics.h"
 
 #include "CLW.h"
 
+#include <algorithm>
 #include <array>
+#include <cstdint>
 #include <memory>
+#include <random>
+#include <vector>
 
 namespace Baikal
 {
+    // Element type of a device buffer, work buffer footprints are derived from it
+    template <typename T>
+    struct BufferElement;
+
+    template <typename T>
+    struct BufferElement<CLWBuffer<T>>
+    {
+        using type = T;
+    };
+
+    // Fill per work item seeds of device side random generators. The engine is local,
+    // so estimators on different threads do not share state. Kernels expect seeds above 2.
+    inline void GenerateRandomSeeds(std::uint32_t seed, std::vector<std::uint32_t>& seeds)
+    {
+        std::mt19937 engine(seed);
+        std::generate(seeds.begin(), seeds.end(), [&engine]()
+        {
+            return std::max(static_cast<std::uint32_t>(engine()), 3u);
+        });
+    }
+
     /**
     \brief Estimator calculates radiance estimates for a given set of directions in the scene.
 
@@ -67,6 +93,9 @@ namespace Baikal
             float primary_throughput;
             float secondary_throughput;
             float shadow_throughput;
+            // Surface shading of secondary hits, unsorted and sorted by material
+            float shading_throughput;
+            float sorted_shading_throughput;
         };
 
         using MissedPrimaryRaysHandler = std::function<void(
@@ -77,6 +106,11 @@ namespace Baikal
             : m_intersector(api)
             , m_max_bounces(5u)
             , m_max_shadow_ray_transmission_steps(2u)
+            , m_path_regeneration_passes(0u)
+            , m_frame(0u)
+            , m_camera_image_size(0, 0)
+            , m_material_sorting_enabled(false)
+            , m_statistics_enabled(false)
         {
         }
 
@@ -95,6 +129,13 @@ namespace Baikal
         */
         virtual std::size_t GetWorkBufferSize() const = 0;
 
+        /**
+        \brief Returns device memory footprint of a single work buffer entry in bytes.
+
+        Clients use this value to derive work buffer size from a memory budget.
+        */
+        virtual std::size_t GetWorkBufferItemSize() const = 0;
+
         /**
         \brief Set random seed value for the renderer. Renders
         with the same random seed are guaranteed to be the same.
@@ -288,6 +329,118 @@ namespace Baikal
             return m_max_shadow_ray_transmission_steps;
         }
 
+        /**
+        \brief Set number of passes restarting terminated paths with new camera rays.
+
+        Restarted paths keep the ray batch full while other paths are still bouncing.
+        The estimate then runs num_passes extra passes to let restarted paths finish.
+
+        \param num_passes Number of regeneration passes, 0 disables regeneration.
+        */
+        void SetPathRegenerationPasses(std::uint32_t num_passes) {
+            m_path_regeneration_passes = num_passes;
+        }
+
+        /**
+        \brief Get number of path regeneration passes.
+        */
+        std::uint32_t GetPathRegenerationPasses() const {
+            return m_path_regeneration_passes;
+        }
+
+        /**
+        \brief Set index of the frame being estimated.
+
+        Every frame owns regeneration passes + 1 consecutive sample indices: camera
+        rays take the first one and paths restarted at a later pass take the following
+        ones, so sample indices of camera dimensions never repeat between frames.
+
+        \param frame Frame index, counted from the last output clear.
+        */
+        void SetFrame(std::uint32_t frame) {
+            m_frame = frame;
+        }
+
+        /**
+        \brief Get sampler index of camera rays of the current frame.
+        */
+        std::uint32_t GetFirstSampleIndex() const {
+            return m_frame * (m_path_regeneration_passes + 1);
+        }
+
+        /**
+        \brief Set dimensions of the image camera rays are generated for.
+
+        Output indices of the ray buffer refer to pixels of this image,
+        restarted paths generate new camera rays through the same pixels.
+
+        \param size Image width and height.
+        */
+        void SetCameraImageSize(RadeonRays::int2 const& size) {
+            m_camera_image_size = size;
+        }
+
+        /**
+        \brief Get dimensions of the image camera rays are generated for.
+        */
+        RadeonRays::int2 GetCameraImageSize() const {
+            return m_camera_image_size;
+        }
+
+        /**
+        \brief Enable sorting of hits by material before shading.
+
+        Sorting groups similar materials into the same wavefronts to reduce
+        divergence in shading kernels at the cost of a radix sort per bounce.
+
+        \param enabled
+        */
+        void SetMaterialSortingEnabled(bool enabled) {
+            m_material_sorting_enabled = enabled;
+        }
+
+        /**
+        \brief Check if hits are sorted by material before shading.
+        */
+        bool IsMaterialSortingEnabled() const {
+            return m_material_sorting_enabled;
+        }
+
+        /**
+        \brief Enable collection of per bounce ray counts and kernel times.
+
+        Kernel times are only available if the command queue has profiling enabled.
+
+        \param enabled
+        */
+        virtual void SetStatisticsEnabled(bool enabled) {
+            m_statistics_enabled = enabled;
+        }
+
+        /**
+        \brief Check if statistics are collected.
+        */
+        bool IsStatisticsEnabled() const {
+            return m_statistics_enabled;
+        }
+
+        /**
+        \brief Add statistics collected since the last reset.
+
+        Statistics are read back from the device, so this call blocks until
+        submitted work completes.
+
+        \param stats Statistics to add ray counts and kernel times to.
+        */
+        virtual void GetStatistics(RenderStatistics& stats) const {
+        }
+
+        /**
+        \brief Reset collected statistics.
+        */
+        virtual void ResetStatistics() {
+        }
+
         Estimator(Estimator const&) = delete;
         Estimator& operator = (Estimator const&) = delete;
 
@@ -295,6 +448,11 @@ namespace Baikal
         std::shared_ptr<RadeonRays::IntersectionApi> m_intersector;
         std::uint32_t m_max_bounces;
         std::uint32_t m_max_shadow_ray_transmission_steps;
+        std::uint32_t m_path_regeneration_passes;
+        std::uint32_t m_frame;
+        RadeonRays::int2 m_camera_image_size;
+        bool m_material_sorting_enabled;
+        bool m_statistics_enabled;
         std::array<CLWBuffer<float3>, 
             static_cast<size_t>(IntermediateValue::kMax)> m_intermediate_value;
     };
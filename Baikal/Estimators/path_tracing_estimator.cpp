@@ -7,6 +7,8 @@
 #include <cstdint>
 #include <random>
 #include <algorithm>
+#include <functional>
+#include <type_traits>
 
 #include "Utils/sobol.h"
 
@@ -16,13 +18,20 @@
 
 namespace Baikal
 {
+    // Passes beyond this one are not counted in statistics
+    std::uint32_t constexpr kMaxStatisticsPasses = 64;
+
     struct PathTracingEstimator::PathState
     {
         float4 throughput;
         int volume;
         int flags;
-        int extra0;
-        int extra1;
+        int active;
+        int start_pass;
+        float cone_width;
+        float cone_spread;
+        int sample;
+        std::uint32_t light_normal;
     };
 
     struct PathTracingEstimator::RenderData
@@ -45,6 +54,14 @@ namespace Baikal
         CLWBuffer<std::uint32_t> random;
         CLWBuffer<std::uint32_t> sobolmat;
         CLWBuffer<int> hitcount;
+        // Path regeneration: terminated paths of a pass
+        CLWBuffer<int> terminated_indices;
+        CLWBuffer<int> terminated_count;
+        // Material sorting: keys before and after the sort, sorted lane order
+        CLWBuffer<int> material_keys[2];
+        CLWBuffer<int> material_order;
+        // Statistics: rays per pass followed by paths after compaction per pass
+        CLWBuffer<std::uint64_t> ray_counters;
         CLWParallelPrimitives pp;
 
         // RadeonRays stuff
@@ -58,6 +75,20 @@ namespace Baikal
         Collector mat_collector;
         Collector tex_collector;
 
+        // Visit every buffer holding one element per work item
+        template <typename F>
+        void ForEachWorkBuffer(F&& f)
+        {
+            f(rays[0]); f(rays[1]); f(hits);
+            f(shadowrays); f(shadowhits);
+            f(intersections); f(compacted_indices);
+            f(pixelindices[0]); f(pixelindices[1]);
+            f(output_indices); f(iota);
+            f(lightsamples); f(paths); f(random);
+            f(terminated_indices);
+            f(material_keys[0]); f(material_keys[1]); f(material_order);
+        }
+
         RenderData()
             : fr_shadowrays(nullptr)
             , fr_shadowhits(nullptr)
@@ -85,10 +116,14 @@ namespace Baikal
         ClwClass(context, program_manager, "../Baikal/Kernels/CL/path_tracing_estimator.cl", "")
 #endif
         , Estimator(api)
-        , m_sample_counter(0)
         , m_render_data(new RenderData)
+        , m_num_statistics_passes(0)
+        , m_random_seed(0)
     {
         // Create parallel primitives
+        // Atomic resolve is used when output indices contain duplicates
+        AddProgramVariant(" -D BAIKAL_ATOMIC_RESOLVE ");
+
         m_render_data->pp = CLWParallelPrimitives(context, GetFullBuildOpts().c_str());
         m_render_data->sobolmat = context.CreateBuffer<unsigned int>(1024 * 52, CL_MEM_READ_ONLY, &g_SobolMatrices[0]);
     }
@@ -110,31 +145,36 @@ namespace Baikal
         return m_render_data->rays[0].GetElementCount();
     }
 
+    std::size_t PathTracingEstimator::GetWorkBufferItemSize() const
+    {
+        std::size_t size = 0;
+        m_render_data->ForEachWorkBuffer([&size](auto const& buffer)
+        {
+            size += sizeof(typename BufferElement<std::decay_t<decltype(buffer)>>::type);
+        });
+
+        return size;
+    }
+
     void PathTracingEstimator::SetWorkBufferSize(std::size_t size)
     {
-        m_render_data->rays[0] = GetContext().CreateBuffer<ray>(size, CL_MEM_READ_WRITE);
-        m_render_data->rays[1] = GetContext().CreateBuffer<ray>(size, CL_MEM_READ_WRITE);
-        m_render_data->hits = GetContext().CreateBuffer<int>(size, CL_MEM_READ_WRITE);
-        m_render_data->intersections = GetContext().CreateBuffer<Intersection>(size, CL_MEM_READ_WRITE);
-        m_render_data->shadowrays = GetContext().CreateBuffer<ray>(size, CL_MEM_READ_WRITE);
-        m_render_data->shadowhits = GetContext().CreateBuffer<int>(size, CL_MEM_READ_WRITE);
-        m_render_data->lightsamples = GetContext().CreateBuffer<float3>(size, CL_MEM_READ_WRITE);
-        m_render_data->paths = GetContext().CreateBuffer<PathState>(size, CL_MEM_READ_WRITE);
+        auto context = GetContext();
+        m_render_data->ForEachWorkBuffer([&context, size](auto& buffer)
+        {
+            using T = typename BufferElement<std::decay_t<decltype(buffer)>>::type;
+            buffer = context.CreateBuffer<T>(size, CL_MEM_READ_WRITE);
+        });
 
         std::vector<std::uint32_t> random_buffer(size);
-        std::generate(random_buffer.begin(), random_buffer.end(), [](){return std::rand() + 3;});
-
-        m_render_data->random = GetContext().CreateBuffer<std::uint32_t>(size, CL_MEM_READ_WRITE, &random_buffer[0]);
+        GenerateRandomSeeds(m_random_seed, random_buffer);
+        context.WriteBuffer(0, m_render_data->random, &random_buffer[0], size).Wait();
 
         std::vector<int> initdata(size);
         std::iota(initdata.begin(), initdata.end(), 0);
+        context.WriteBuffer(0, m_render_data->iota, &initdata[0], size).Wait();
 
-        m_render_data->iota = GetContext().CreateBuffer<int>(size, CL_MEM_READ_WRITE | CL_MEM_COPY_HOST_PTR, &initdata[0]);
-        m_render_data->compacted_indices = GetContext().CreateBuffer<int>(size, CL_MEM_READ_WRITE);
-        m_render_data->pixelindices[0] = GetContext().CreateBuffer<int>(size, CL_MEM_READ_WRITE);
-        m_render_data->pixelindices[1] = GetContext().CreateBuffer<int>(size, CL_MEM_READ_WRITE);
-        m_render_data->output_indices = GetContext().CreateBuffer<int>(size, CL_MEM_READ_WRITE);
-        m_render_data->hitcount = GetContext().CreateBuffer<int>(1, CL_MEM_READ_WRITE);
+        m_render_data->hitcount = context.CreateBuffer<int>(1, CL_MEM_READ_WRITE);
+        m_render_data->terminated_count = context.CreateBuffer<int>(1, CL_MEM_READ_WRITE);
 
         // Recreate FR buffers
         GetIntersector()->DeleteBuffer(m_render_data->fr_rays[0]);
@@ -188,22 +228,32 @@ namespace Baikal
         auto has_visibility_buffer = HasIntermediateValueBuffer(IntermediateValue::kVisibility);
         auto visibility_buffer = GetIntermediateValueBuffer(IntermediateValue::kVisibility);
 
+        // Primary misses handled by the client and visibility output need all
+        // primary rays at pass 0, so only restart paths if there are none
+        auto regeneration_passes = (missedPrimaryRaysHandler || has_visibility_buffer) ?
+            0u : GetPathRegenerationPasses();
+        auto num_passes = GetMaxBounces() + regeneration_passes;
+
         InitPathData(num_estimates, scene.camera_volume_index);
 
         GetContext().CopyBuffer(0u, m_render_data->iota, m_render_data->pixelindices[0], 0, 0, num_estimates);
         GetContext().CopyBuffer(0u, m_render_data->iota, m_render_data->pixelindices[1], 0, 0, num_estimates);
 
+        auto count_rays = IsStatisticsEnabled();
+        if (count_rays)
+        {
+            m_num_statistics_passes = std::max(m_num_statistics_passes, std::min(num_passes, kMaxStatisticsPasses));
+        }
+
         // Initialize first pass
-        for (auto pass = 0u; pass < GetMaxBounces(); ++pass)
+        for (auto pass = 0u; pass < num_passes; ++pass)
         {
-            // Clear ray hits buffer
-            // TODO: make it a kernel
-            GetContext().FillBuffer(
-                0,
-                m_render_data->hits,
-                0,
-                m_render_data->hits.GetElementCount()
-            );
+            count_rays = count_rays && pass < kMaxStatisticsPasses;
+
+            if (count_rays)
+            {
+                CountRays(pass);
+            }
 
             // Intersect ray batch
             GetIntersector()->QueryIntersection(
@@ -243,9 +293,34 @@ namespace Baikal
                 m_render_data->hitcount
             );
 
+            if (count_rays)
+            {
+                CountRays(kMaxStatisticsPasses + pass);
+            }
+
+            bool regenerate = pass < regeneration_passes;
+
+            if (regenerate)
+            {
+                // Collect terminated paths to restart them after shading
+                m_render_data->pp.Compact(
+                    0,
+                    m_render_data->shadowhits,
+                    m_render_data->iota,
+                    m_render_data->terminated_indices,
+                    (std::uint32_t)num_estimates,
+                    m_render_data->terminated_count
+                );
+            }
+
             // Advance indices to keep pixel indices up to date
             RestorePixelIndices(pass, num_estimates);
 
+            if (IsMaterialSortingEnabled())
+            {
+                SortHitsByMaterial(scene, pass, num_estimates);
+            }
+
             // Shade missing rays
             if (pass == 0)
             {
@@ -269,7 +344,7 @@ namespace Baikal
             }
 
             // Shade hits
-            ShadeSurface(scene, pass, num_estimates, output, use_output_indices);
+            ShadeSurfaces(scene, pass, num_estimates, output, use_output_indices, IsMaterialSortingEnabled());
 
 
             if (has_some_volume && GetMaxShadowRayTransmissionSteps() > 0)
@@ -307,11 +382,14 @@ namespace Baikal
                 GatherVisibility(scene, pass, num_estimates, visibility_buffer, use_output_indices);
             }
 
-            GetContext().Flush(0);
-        }
+            if (regeneration_passes > 0 && pass + 1 < num_passes)
+            {
+                // Refill the batch with restarted paths
+                RegeneratePaths(scene, pass, regenerate, num_estimates, output, use_output_indices);
+            }
 
-        ++m_sample_counter;
-    }
+            GetContext().Flush(0);
+        }    }
 
     void PathTracingEstimator::InitPathData(std::size_t size, int volume_idx)
     {
@@ -325,7 +403,7 @@ namespace Baikal
         init_kernel.SetArg(argc++, m_render_data->paths);
 
         {
-            GetContext().Launch1D(0, ((size + 63) / 64) * 64, 64, init_kernel);
+            Launch1D("InitPathData", ((size + 63) / 64) * 64, 64, init_kernel);
         }
     }
 
@@ -334,11 +412,12 @@ namespace Baikal
         int pass,
         std::size_t size,
         CLWBuffer<RadeonRays::float3> output,
-        bool use_output_indices
+        bool use_output_indices,
+        std::string const& opts
     )
     {
         // Fetch kernel
-        auto shadekernel = GetKernel("ShadeSurface");
+        auto shadekernel = GetKernel("ShadeSurface", opts);
 
         auto output_indices = use_output_indices ? m_render_data->output_indices : m_render_data->iota;
 
@@ -358,6 +437,7 @@ namespace Baikal
         shadekernel.SetArg(argc++, scene.materials);
         shadekernel.SetArg(argc++, scene.textures);
         shadekernel.SetArg(argc++, scene.texturedata);
+        shadekernel.SetArg(argc++, scene.texturefeedback);
         shadekernel.SetArg(argc++, scene.envmapidx);
         shadekernel.SetArg(argc++, scene.lights);
         shadekernel.SetArg(argc++, scene.light_distributions);
@@ -366,7 +446,7 @@ namespace Baikal
         shadekernel.SetArg(argc++, m_render_data->random);
         shadekernel.SetArg(argc++, m_render_data->sobolmat);
         shadekernel.SetArg(argc++, pass);
-        shadekernel.SetArg(argc++, m_sample_counter);
+        shadekernel.SetArg(argc++, GetFirstSampleIndex());
         shadekernel.SetArg(argc++, scene.volumes);
         shadekernel.SetArg(argc++, m_render_data->shadowrays);
         shadekernel.SetArg(argc++, m_render_data->lightsamples);
@@ -377,8 +457,81 @@ namespace Baikal
 
         // Run shading kernel
         {
-            GetContext().Launch1D(0, ((size + 63) / 64) * 64, 64, shadekernel);
+            Launch1D("ShadeSurface", ((size + 63) / 64) * 64, 64, shadekernel);
+        }
+    }
+
+    void PathTracingEstimator::ShadeSurfaces(
+        ClwScene const& scene,
+        int pass,
+        std::size_t size,
+        CLWBuffer<RadeonRays::float3> output,
+        bool use_output_indices,
+        bool sorted
+    )
+    {
+#ifdef ENABLE_UBERV2
+        if (sorted)
+        {
+            // Material classes are contiguous in the sorted batch, so specialized
+            // kernels only diverge on wavefronts straddling a class boundary
+            for (auto material_class = 0; material_class < 2; ++material_class)
+            {
+                auto opts = GetDefaultBuildOpts() + " -D SHADE_MATERIAL_CLASS=" + std::to_string(material_class) + " ";
+                ShadeSurface(scene, pass, size, output, use_output_indices, opts);
+            }
+
+            return;
         }
+#endif
+
+        ShadeSurface(scene, pass, size, output, use_output_indices);
+    }
+
+    void PathTracingEstimator::SortHitsByMaterial(ClwScene const& scene, int pass, std::size_t size)
+    {
+        auto keys_kernel = GetKernel("ComputeMaterialKeys");
+
+        int argc = 0;
+        keys_kernel.SetArg(argc++, m_render_data->intersections);
+        keys_kernel.SetArg(argc++, m_render_data->compacted_indices);
+        keys_kernel.SetArg(argc++, m_render_data->hitcount);
+        keys_kernel.SetArg(argc++, (cl_int)size);
+        keys_kernel.SetArg(argc++, scene.shapes);
+        keys_kernel.SetArg(argc++, scene.materials);
+        keys_kernel.SetArg(argc++, m_render_data->material_keys[0]);
+
+        {
+            Launch1D("ComputeMaterialKeys", ((size + 63) / 64) * 64, 64, keys_kernel);
+        }
+
+        // Inactive lanes carry the largest key, so the whole buffer is sorted
+        m_render_data->pp.SortRadix(
+            0,
+            m_render_data->material_keys[0],
+            m_render_data->material_keys[1],
+            m_render_data->iota,
+            m_render_data->material_order,
+            (int)size
+        );
+
+        // Keys are not needed anymore, reuse them as scratch space
+        auto reorder_kernel = GetKernel("ReorderHits");
+
+        argc = 0;
+        reorder_kernel.SetArg(argc++, m_render_data->material_order);
+        reorder_kernel.SetArg(argc++, m_render_data->hitcount);
+        reorder_kernel.SetArg(argc++, m_render_data->compacted_indices);
+        reorder_kernel.SetArg(argc++, m_render_data->pixelindices[pass & 0x1]);
+        reorder_kernel.SetArg(argc++, m_render_data->material_keys[0]);
+        reorder_kernel.SetArg(argc++, m_render_data->material_keys[1]);
+
+        {
+            Launch1D("ReorderHits", ((size + 63) / 64) * 64, 64, reorder_kernel);
+        }
+
+        GetContext().CopyBuffer(0u, m_render_data->material_keys[0], m_render_data->compacted_indices, 0, 0, size);
+        GetContext().CopyBuffer(0u, m_render_data->material_keys[1], m_render_data->pixelindices[pass & 0x1], 0, 0, size);
     }
 
     void PathTracingEstimator::ShadeVolume(
@@ -410,6 +563,7 @@ namespace Baikal
         shadekernel.SetArg(argc++, scene.materials);
         shadekernel.SetArg(argc++, scene.textures);
         shadekernel.SetArg(argc++, scene.texturedata);
+        shadekernel.SetArg(argc++, scene.texturefeedback);
         shadekernel.SetArg(argc++, scene.envmapidx);
         shadekernel.SetArg(argc++, scene.lights);
         shadekernel.SetArg(argc++, scene.light_distributions);
@@ -418,7 +572,7 @@ namespace Baikal
         shadekernel.SetArg(argc++, m_render_data->random);
         shadekernel.SetArg(argc++, m_render_data->sobolmat);
         shadekernel.SetArg(argc++, pass);
-        shadekernel.SetArg(argc++, m_sample_counter);
+        shadekernel.SetArg(argc++, GetFirstSampleIndex());
         shadekernel.SetArg(argc++, scene.volumes);
         shadekernel.SetArg(argc++, m_render_data->shadowrays);
         shadekernel.SetArg(argc++, m_render_data->lightsamples);
@@ -428,7 +582,7 @@ namespace Baikal
 
         // Run shading kernel
         {
-            GetContext().Launch1D(0, ((size + 63) / 64) * 64, 64, shadekernel);
+            Launch1D("ShadeVolume", ((size + 63) / 64) * 64, 64, shadekernel);
         }
     }
 
@@ -454,18 +608,19 @@ namespace Baikal
         sample_kernel.SetArg(argc++, scene.volumes);
         sample_kernel.SetArg(argc++, scene.textures);
         sample_kernel.SetArg(argc++, scene.texturedata);
+        sample_kernel.SetArg(argc++, scene.texturefeedback);
         sample_kernel.SetArg(argc++, rand_uint());
         sample_kernel.SetArg(argc++, m_render_data->random);
         sample_kernel.SetArg(argc++, m_render_data->sobolmat);
         sample_kernel.SetArg(argc++, pass);
-        sample_kernel.SetArg(argc++, m_sample_counter);
+        sample_kernel.SetArg(argc++, GetFirstSampleIndex());
         sample_kernel.SetArg(argc++, m_render_data->intersections);
         sample_kernel.SetArg(argc++, m_render_data->paths);
         sample_kernel.SetArg(argc++, output);
 
         // Run shading kernel
         {
-            GetContext().Launch1D(0, ((size + 63) / 64) * 64, 64, sample_kernel);
+            Launch1D("SampleVolume", ((size + 63) / 64) * 64, 64, sample_kernel);
         }
     }
 
@@ -493,12 +648,13 @@ namespace Baikal
         misskernel.SetArg(argc++, scene.envmapidx);
         misskernel.SetArg(argc++, scene.textures);
         misskernel.SetArg(argc++, scene.texturedata);
+        misskernel.SetArg(argc++, scene.texturefeedback);
         misskernel.SetArg(argc++, m_render_data->paths);
         misskernel.SetArg(argc++, scene.volumes);
         misskernel.SetArg(argc++, output);
 
         {
-            GetContext().Launch1D(0, ((size + 63) / 64) * 64, 64, misskernel);
+            Launch1D("ShadeBackgroundEnvMap", ((size + 63) / 64) * 64, 64, misskernel);
         }
     }
 
@@ -527,7 +683,7 @@ namespace Baikal
 
         // Run shading kernel
         {
-            GetContext().Launch1D(0, ((size + 63) / 64) * 64, 64, gatherkernel);
+            Launch1D("GatherLightSamples", ((size + 63) / 64) * 64, 64, gatherkernel);
         }
     }
 
@@ -565,7 +721,7 @@ namespace Baikal
 
         // Run shading kernel
         {
-            GetContext().Launch1D(0, ((size + 63) / 64) * 64, 64, volumekernel);
+            Launch1D("ApplyVolumeTransmission", ((size + 63) / 64) * 64, 64, volumekernel);
         }
     }
 
@@ -592,7 +748,7 @@ namespace Baikal
 
         // Run shading kernel
         {
-            GetContext().Launch1D(0, ((size + 63) / 64) * 64, 64, gatherkernel);
+            Launch1D("GatherVisibility", ((size + 63) / 64) * 64, 64, gatherkernel);
         }
     }
 
@@ -611,7 +767,7 @@ namespace Baikal
 
         // Run shading kernel
         {
-            GetContext().Launch1D(0, ((size + 63) / 64) * 64, 64, restorekernel);
+            Launch1D("RestorePixelIndices", ((size + 63) / 64) * 64, 64, restorekernel);
         }
     }
 
@@ -622,12 +778,15 @@ namespace Baikal
         int argc = 0;
         restorekernel.SetArg(argc++, m_render_data->intersections);
         restorekernel.SetArg(argc++, m_render_data->hitcount);
+        restorekernel.SetArg(argc++, (cl_int)size);
         restorekernel.SetArg(argc++, m_render_data->pixelindices[(pass + 1) & 0x1]);
         restorekernel.SetArg(argc++, m_render_data->paths);
         restorekernel.SetArg(argc++, m_render_data->hits);
+        // Shadow hits are free until shadow rays are traced
+        restorekernel.SetArg(argc++, m_render_data->shadowhits);
 
         {
-            GetContext().Launch1D(0, ((size + 63) / 64) * 64, 64, restorekernel);
+            Launch1D("FilterPathStream", ((size + 63) / 64) * 64, 64, restorekernel);
         }
     }
 
@@ -649,31 +808,81 @@ namespace Baikal
         misskernel.SetArg(argc++, m_render_data->pixelindices[(pass + 1) & 0x1]);
         misskernel.SetArg(argc++, output_indices);
         misskernel.SetArg(argc++, m_render_data->hitcount);
+        misskernel.SetArg(argc++, pass);
         misskernel.SetArg(argc++, scene.lights);
         misskernel.SetArg(argc++, scene.light_distributions);
         misskernel.SetArg(argc++, scene.num_lights);
         misskernel.SetArg(argc++, scene.envmapidx);
         misskernel.SetArg(argc++, scene.textures);
         misskernel.SetArg(argc++, scene.texturedata);
+        misskernel.SetArg(argc++, scene.texturefeedback);
         misskernel.SetArg(argc++, m_render_data->paths);
         misskernel.SetArg(argc++, scene.volumes);
         misskernel.SetArg(argc++, output);
 
         {
-            GetContext().Launch1D(0, ((size + 63) / 64) * 64, 64, misskernel);
+            Launch1D("ShadeMiss", ((size + 63) / 64) * 64, 64, misskernel);
+        }
+    }
+
+    void PathTracingEstimator::RegeneratePaths(
+        ClwScene const& scene,
+        int pass,
+        bool regenerate,
+        std::size_t size,
+        CLWBuffer<RadeonRays::float3> output,
+        bool use_output_indices
+    )
+    {
+        auto regenerate_kernel = GetKernel("RegeneratePaths");
+
+        auto output_indices = use_output_indices ? m_render_data->output_indices : m_render_data->iota;
+
+        int argc = 0;
+        regenerate_kernel.SetArg(argc++, m_render_data->hitcount);
+        regenerate_kernel.SetArg(argc++, m_render_data->terminated_indices);
+        regenerate_kernel.SetArg(argc++, m_render_data->pixelindices[(pass + 1) & 0x1]);
+        regenerate_kernel.SetArg(argc++, scene.camera);
+        regenerate_kernel.SetArg(argc++, (cl_int)scene.camera_type);
+        regenerate_kernel.SetArg(argc++, GetCameraImageSize().x);
+        regenerate_kernel.SetArg(argc++, GetCameraImageSize().y);
+        regenerate_kernel.SetArg(argc++, m_render_data->output_indices);
+        regenerate_kernel.SetArg(argc++, output_indices);
+        regenerate_kernel.SetArg(argc++, (cl_int)size);
+        regenerate_kernel.SetArg(argc++, pass + 1);
+        regenerate_kernel.SetArg(argc++, (cl_int)GetMaxBounces());
+        regenerate_kernel.SetArg(argc++, regenerate ? 1 : 0);
+        regenerate_kernel.SetArg(argc++, scene.camera_volume_index);
+        regenerate_kernel.SetArg(argc++, rand_uint());
+        regenerate_kernel.SetArg(argc++, GetFirstSampleIndex());
+        regenerate_kernel.SetArg(argc++, m_render_data->random);
+        regenerate_kernel.SetArg(argc++, m_render_data->sobolmat);
+        regenerate_kernel.SetArg(argc++, m_render_data->pixelindices[pass & 0x1]);
+        regenerate_kernel.SetArg(argc++, m_render_data->paths);
+        regenerate_kernel.SetArg(argc++, m_render_data->rays[(pass + 1) & 0x1]);
+        regenerate_kernel.SetArg(argc++, output);
+
+        {
+            Launch1D("RegeneratePaths", ((size + 63) / 64) * 64, 64, regenerate_kernel);
+        }
+
+        if (regenerate)
+        {
+            // Next batch is full again
+            GetContext().FillBuffer(0, m_render_data->hitcount, (int)size, 1);
         }
     }
 
     void PathTracingEstimator::SetRandomSeed(std::uint32_t seed)
     {
-        std::srand(seed);
+        m_random_seed = seed;
 
         auto size = m_render_data->random.GetElementCount();
 
         if (size != 0)
         {
             std::vector<std::uint32_t> random_buffer(size);
-            std::generate(random_buffer.begin(), random_buffer.end(), []() {return std::rand() + 3; });
+            GenerateRandomSeeds(seed, random_buffer);
             GetContext().WriteBuffer(0, m_render_data->random, random_buffer.data(), size).Wait();
         }
     }
@@ -733,6 +942,12 @@ namespace Baikal
         auto temporary = GetContext().CreateBuffer<float3>(num_estimates, CL_MEM_WRITE_ONLY);
 
         auto num_passes = 100u;
+
+        // Start from fresh paths
+        InitPathData(num_estimates, scene.camera_volume_index);
+        GetContext().CopyBuffer(0u, m_render_data->iota, m_render_data->pixelindices[0], 0, 0, num_estimates);
+        GetContext().CopyBuffer(0u, m_render_data->iota, m_render_data->pixelindices[1], 0, 0, num_estimates);
+
         // Clear ray hits buffer
         GetContext().FillBuffer(0, m_render_data->hits, 0, num_estimates);
 
@@ -836,6 +1051,74 @@ namespace Baikal
             num_estimates / (((float)std::chrono::duration_cast<std::chrono::milliseconds>(delta).count()
                 / num_passes)
                 / 1000.f);
+
+        // Secondary hits have incoherent materials, compare shading them as is and sorted
+        FilterPathStream(1, num_estimates);
+
+        m_render_data->pp.Compact(
+            0,
+            m_render_data->hits,
+            m_render_data->iota,
+            m_render_data->compacted_indices,
+            (std::uint32_t)num_estimates,
+            m_render_data->hitcount);
+
+        RestorePixelIndices(1, num_estimates);
+
+        // Shading advances paths and writes the next ray batch and sorting reorders the hit
+        // indices, so every run starts from a saved copy. Throughput is measured in hits shaded.
+        auto saved_paths = GetContext().CreateBuffer<PathState>(num_estimates, CL_MEM_READ_WRITE);
+        auto saved_rays = GetContext().CreateBuffer<ray>(num_estimates, CL_MEM_READ_WRITE);
+        auto saved_indices = GetContext().CreateBuffer<int>(num_estimates, CL_MEM_READ_WRITE);
+        auto saved_pixel_indices = GetContext().CreateBuffer<int>(num_estimates, CL_MEM_READ_WRITE);
+        GetContext().CopyBuffer(0u, m_render_data->paths, saved_paths, 0, 0, num_estimates);
+        GetContext().CopyBuffer(0u, m_render_data->rays[0], saved_rays, 0, 0, num_estimates);
+        GetContext().CopyBuffer(0u, m_render_data->compacted_indices, saved_indices, 0, 0, num_estimates);
+        GetContext().CopyBuffer(0u, m_render_data->pixelindices[1], saved_pixel_indices, 0, 0, num_estimates);
+
+        int num_hits = 0;
+        GetContext().ReadBuffer(0, m_render_data->hitcount, &num_hits, 1).Wait();
+
+        auto restore_paths = [&]()
+        {
+            GetContext().CopyBuffer(0u, saved_paths, m_render_data->paths, 0, 0, num_estimates);
+            GetContext().CopyBuffer(0u, saved_rays, m_render_data->rays[0], 0, 0, num_estimates);
+            GetContext().CopyBuffer(0u, saved_indices, m_render_data->compacted_indices, 0, 0, num_estimates);
+            GetContext().CopyBuffer(0u, saved_pixel_indices, m_render_data->pixelindices[1], 0, 0, num_estimates);
+            GetContext().Finish(0);
+        };
+
+        auto shading_throughput = [&](std::function<void()> shade)
+        {
+            std::chrono::high_resolution_clock::duration total(0);
+
+            for (auto i = 0U; i < num_passes; ++i)
+            {
+                restore_paths();
+
+                auto shade_start = std::chrono::high_resolution_clock::now();
+                shade();
+                GetContext().Finish(0);
+                total += std::chrono::high_resolution_clock::now() - shade_start;
+            }
+
+            auto seconds = std::chrono::duration_cast<std::chrono::duration<float>>(total).count() / num_passes;
+            return seconds > 0.f ? num_hits / seconds : 0.f;
+        };
+
+        stats.shading_throughput = shading_throughput([&]()
+        {
+            ShadeSurface(scene, 1, num_estimates, temporary, false);
+        });
+
+        stats.sorted_shading_throughput = shading_throughput([&]()
+        {
+            // Sorting cost is included, it is paid on every bounce
+            SortHitsByMaterial(scene, 1, num_estimates);
+            ShadeSurfaces(scene, 1, num_estimates, temporary, false, true);
+        });
+
+        restore_paths();
     }
 
     bool PathTracingEstimator::SupportsIntermediateValue(IntermediateValue value) const
@@ -867,7 +1150,68 @@ namespace Baikal
         misskernel.SetArg(argc++, output);
 
         {
-            GetContext().Launch1D(0, ((size + 63) / 64) * 64, 64, misskernel);
+            Launch1D("AdvanceIterationCount", ((size + 63) / 64) * 64, 64, misskernel);
+        }
+    }
+
+    void PathTracingEstimator::SetStatisticsEnabled(bool enabled)
+    {
+        Estimator::SetStatisticsEnabled(enabled);
+        SetKernelTimingEnabled(enabled);
+
+        if (enabled && m_render_data->ray_counters.GetElementCount() == 0)
+        {
+            m_render_data->ray_counters = GetContext().CreateBuffer<std::uint64_t>(2 * kMaxStatisticsPasses, CL_MEM_READ_WRITE);
+            ResetStatistics();
+        }
+    }
+
+    void PathTracingEstimator::GetStatistics(RenderStatistics& stats) const
+    {
+        CollectKernelTimes(stats.kernel_times);
+
+        if (m_num_statistics_passes == 0)
+        {
+            return;
+        }
+
+        std::vector<std::uint64_t> counters(2 * kMaxStatisticsPasses);
+        GetContext().ReadBuffer(0, m_render_data->ray_counters, &counters[0], counters.size()).Wait();
+
+        auto num_passes = std::max<std::size_t>(m_num_statistics_passes, stats.rays_per_bounce.size());
+        stats.rays_per_bounce.resize(num_passes, 0);
+        stats.paths_per_bounce.resize(num_passes, 0);
+
+        for (auto i = 0u; i < m_num_statistics_passes; ++i)
+        {
+            stats.rays_per_bounce[i] += counters[i];
+            stats.paths_per_bounce[i] += counters[kMaxStatisticsPasses + i];
+        }
+    }
+
+    void PathTracingEstimator::ResetStatistics()
+    {
+        ResetKernelTimes();
+
+        if (m_render_data->ray_counters.GetElementCount() > 0)
+        {
+            GetContext().FillBuffer(0, m_render_data->ray_counters, (std::uint64_t)0, m_render_data->ray_counters.GetElementCount()).Wait();
+        }
+
+        m_num_statistics_passes = 0;
+    }
+
+    void PathTracingEstimator::CountRays(std::uint32_t counter)
+    {
+        auto count_kernel = GetKernel("AccumulateRayCount");
+
+        int argc = 0;
+        count_kernel.SetArg(argc++, m_render_data->hitcount);
+        count_kernel.SetArg(argc++, (cl_int)counter);
+        count_kernel.SetArg(argc++, m_render_data->ray_counters);
+
+        {
+            Launch1D("AccumulateRayCount", 1, 1, count_kernel);
         }
     }
 }
@@ -27,6 +27,7 @@ THE SOFTWARE.
 #include "Utils/cl_program_manager.h"
 
 #include <memory>
+#include <string>
 
 namespace Baikal
 {
@@ -60,6 +61,11 @@ namespace Baikal
         */
         std::size_t GetWorkBufferSize() const override;
 
+        /**
+        \brief Returns device memory footprint of a single work buffer entry in bytes.
+        */
+        std::size_t GetWorkBufferItemSize() const override;
+
         /**
         \brief Set random seed value for the estimator. Renders
         with the same random seed are guaranteed to be the same.
@@ -185,6 +191,21 @@ namespace Baikal
         */
         bool SupportsIntermediateValue(IntermediateValue value) const override;
 
+        /**
+        \brief Enable collection of per bounce ray counts and kernel times.
+        */
+        void SetStatisticsEnabled(bool enabled) override;
+
+        /**
+        \brief Add statistics collected since the last reset.
+        */
+        void GetStatistics(RenderStatistics& stats) const override;
+
+        /**
+        \brief Reset collected statistics.
+        */
+        void ResetStatistics() override;
+
     private:
         void InitPathData(std::size_t size, int volume_idx);
 
@@ -193,9 +214,23 @@ namespace Baikal
             int pass,
             std::size_t size,
             CLWBuffer<RadeonRays::float3> output,
-            bool use_output_indices
+            bool use_output_indices,
+            std::string const& opts = ""
+        );
+
+        // Shade surface hits, one specialized kernel per material class if hits are sorted
+        void ShadeSurfaces(
+            ClwScene const& scene,
+            int pass,
+            std::size_t size,
+            CLWBuffer<RadeonRays::float3> output,
+            bool use_output_indices,
+            bool sorted
         );
 
+        // Sort compacted hits by material
+        void SortHitsByMaterial(ClwScene const& scene, int pass, std::size_t size);
+
         void SampleVolume(
             ClwScene const& scene,
             int pass,
@@ -261,10 +296,26 @@ namespace Baikal
         // Convert intersection info to compaction predicate
         void FilterPathStream(int pass, std::size_t size);
 
+        // Restart terminated paths from camera rays to keep the batch full
+        void RegeneratePaths(
+            ClwScene const& scene,
+            int pass,
+            bool regenerate,
+            std::size_t size,
+            CLWBuffer<RadeonRays::float3> output,
+            bool use_output_indices
+        );
+
+        // Add the current ray count to a statistics counter
+        void CountRays(std::uint32_t counter);
+
         struct PathState;
         struct RenderData;
 
         std::unique_ptr<RenderData> m_render_data;
-        mutable std::uint32_t m_sample_counter;
+        // Max number of passes counted since statistics reset
+        std::uint32_t m_num_statistics_passes;
+        // Seed of per work item random generators
+        std::uint32_t m_random_seed;
     };
 }
@@ -0,0 +1,117 @@
+/**********************************************************************
+ Copyright (c) 2016 Advanced Micro Devices, Inc. All rights reserved.
+ 
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ 
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+ 
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+ ********************************************************************/
+#ifndef CAMERA_CL
+#define CAMERA_CL
+
+#include <../Baikal/Kernels/CL/common.cl>
+#include <../Baikal/Kernels/CL/ray.cl>
+#include <../Baikal/Kernels/CL/payload.cl>
+#include <../Baikal/Kernels/CL/sampling.cl>
+
+// Camera types, have to match ClwScene::CameraType
+#define CAMERA_PERSPECTIVE 0
+#define CAMERA_PHYSICAL_PERSPECTIVE 1
+#define CAMERA_ORTHOGRAPHIC 4
+
+/// Generate primary ray through pixel (x, y) of the image.
+/// Pixel sample (and lens sample for physical camera) is taken from the sampler.
+INLINE void Camera_GenerateRay(
+    // Camera
+    GLOBAL Camera const* restrict camera,
+    // Camera type
+    int camera_type,
+    // Pixel coordinates
+    int x,
+    int y,
+    // Image resolution
+    int output_width,
+    int output_height,
+    // Sampler
+    Sampler* sampler,
+    SAMPLER_ARG_LIST,
+    // Ray to generate
+    GLOBAL ray* my_ray
+)
+{
+    // Generate sample
+#ifndef BAIKAL_GENERATE_SAMPLE_AT_PIXEL_CENTER
+    float2 sample0 = Sampler_Sample2D(sampler, SAMPLER_ARGS);
+#else
+    float2 sample0 = make_float2(0.5f, 0.5f);
+#endif
+
+    // Calculate [0..1] image plane sample
+    float2 img_sample;
+    img_sample.x = (float)x / output_width + sample0.x / output_width;
+    img_sample.y = (float)y / output_height + sample0.y / output_height;
+
+    // Transform into [-0.5, 0.5]
+    float2 h_sample = img_sample - make_float2(0.5f, 0.5f);
+    // Transform into [-dim/2, dim/2]
+    float2 c_sample = h_sample * camera->dim;
+
+    if (camera_type == CAMERA_ORTHOGRAPHIC)
+    {
+        // Parallel rays, no cone spread
+        my_ray->d.xyz = normalize(camera->forward);
+        my_ray->o.xyz = camera->p + c_sample.x * camera->right + c_sample.y * camera->up;
+        Ray_SetExtra(my_ray, make_float2(1.f, 0.f));
+    }
+    else if (camera_type == CAMERA_PHYSICAL_PERSPECTIVE)
+    {
+        float2 sample1 = Sampler_Sample2D(sampler, SAMPLER_ARGS);
+
+        // Generate sample on the lens
+        float2 lens_sample = camera->aperture * Sample_MapToDiskConcentric(sample1);
+        // Calculate position on focal plane
+        float2 focal_plane_sample = c_sample * camera->focus_distance / camera->focal_length;
+        // Calculate ray direction
+        float2 camera_dir = focal_plane_sample - lens_sample;
+
+        // Calculate direction to image plane
+        my_ray->d.xyz = normalize(camera->forward * camera->focus_distance + camera->right * camera_dir.x + camera->up * camera_dir.y);
+        // Origin == camera position + lens offset
+        my_ray->o.xyz = camera->p + lens_sample.x * camera->right + lens_sample.y * camera->up;
+        // Store pixel cone spread angle for texture filtering
+        Ray_SetExtra(my_ray, make_float2(1.f, camera->dim.y / (output_height * camera->focal_length)));
+    }
+    else
+    {
+        // Calculate direction to image plane
+        my_ray->d.xyz = normalize(camera->focal_length * camera->forward + c_sample.x * camera->right + c_sample.y * camera->up);
+        // Origin == camera position + nearz * d
+        my_ray->o.xyz = camera->p + camera->zcap.x * my_ray->d.xyz;
+        // Store pixel cone spread angle for texture filtering
+        Ray_SetExtra(my_ray, make_float2(1.f, camera->dim.y / (output_height * camera->focal_length)));
+    }
+
+    // Max T value = zfar - znear since we moved origin to znear
+    my_ray->o.w = camera->zcap.y - camera->zcap.x;
+    // Generate random time from 0 to 1
+    my_ray->d.w = sample0.x;
+    // Set ray max
+    my_ray->extra.x = 0xFFFFFFFF;
+    my_ray->extra.y = 0xFFFFFFFF;
+    Ray_SetMask(my_ray, VISIBILITY_MASK_PRIMARY);
+}
+
+#endif // CAMERA_CL
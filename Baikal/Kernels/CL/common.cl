@@ -47,8 +47,12 @@ THE SOFTWARE.
 #define RANDOM 1
 #define SOBOL 2
 #define CMJ 3
+#define OWEN_SOBOL 4
 
+// Might be overridden with build options
+#ifndef SAMPLER
 #define SAMPLER CMJ
+#endif
 
 #define CMJ_DIM 16
 
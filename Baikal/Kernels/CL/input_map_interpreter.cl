@@ -0,0 +1,207 @@
+/**********************************************************************
+Copyright (c) 2017 Advanced Micro Devices, Inc. All rights reserved.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+********************************************************************/
+#ifndef INPUT_MAP_INTERPRETER_CL
+#define INPUT_MAP_INTERPRETER_CL
+
+#include <../Baikal/Kernels/CL/input_map_table.cl>
+
+/*
+ Interpreter for input maps flattened into InputMapData buffer (see CLInputMapCompiler).
+
+ Buffer layout:
+    [0]                          (number of programs, offset of leafs, 0, 0)
+    [1, number of programs + 1)  (input map id, offset of program, 0, 0) sorted by id (see input_map_table.cl)
+    ...                          program instructions
+    [offset of leafs, ...)       leaf values
+*/
+
+#define INPUT_MAP_MAX_REGISTERS 16
+
+float4 GetInputMapFloat4(uint input_id, DifferentialGeometry const* dg, GLOBAL InputMapData const* restrict input_map_values, TEXTURE_ARG_LIST)
+{
+    int pc = InputMap_FindEntry(input_id, input_map_values).y;
+
+    if (pc < 0)
+    {
+        return 0.0f;
+    }
+
+    int leafs = InputMap_ReadInt4(input_map_values, 0).y;
+
+    float4 registers[INPUT_MAP_MAX_REGISTERS];
+
+    for (;;)
+    {
+        int4 instruction = InputMap_ReadInt4(input_map_values, pc++);
+
+        int op = instruction.x;
+        int dst = instruction.y;
+
+        if (op == kInputMapOpReturn)
+        {
+            return registers[instruction.z];
+        }
+
+        float4 result = 0.0f;
+
+        switch (op)
+        {
+            // Leafs
+            case kInputMapOpConstant:
+                result = (float4)(input_map_values[leafs + instruction.z].float_value.value, 0.0f);
+                break;
+            case kInputMapOpSampler:
+                result = Texture_SampleFiltered2D(dg->uv, dg->uv_footprint, TEXTURE_ARGS_IDX(input_map_values[leafs + instruction.z].int_values.idx));
+                break;
+            case kInputMapOpSamplerBumpmap:
+                result = (float4)(Texture_SampleBump(dg->uv, TEXTURE_ARGS_IDX(input_map_values[leafs + instruction.z].int_values.idx)), 1.0f);
+                break;
+            // Two inputs
+            case kInputMapOpAdd:
+                result = registers[instruction.z] + registers[instruction.w];
+                break;
+            case kInputMapOpSub:
+                result = registers[instruction.z] - registers[instruction.w];
+                break;
+            case kInputMapOpMul:
+                result = registers[instruction.z] * registers[instruction.w];
+                break;
+            case kInputMapOpDiv:
+                result = registers[instruction.z] / registers[instruction.w];
+                break;
+            case kInputMapOpMin:
+                result = min(registers[instruction.z], registers[instruction.w]);
+                break;
+            case kInputMapOpMax:
+                result = max(registers[instruction.z], registers[instruction.w]);
+                break;
+            case kInputMapOpPow:
+                result = pow(registers[instruction.z], (float4)(registers[instruction.w].x));
+                break;
+            case kInputMapOpMod:
+                result = fmod(registers[instruction.z], registers[instruction.w]);
+                break;
+            case kInputMapOpDot3:
+                result = (float4)(dot(registers[instruction.z].xyz, registers[instruction.w].xyz), 0.0f, 0.0f, 0.0f);
+                break;
+            case kInputMapOpDot4:
+                result = (float4)(dot(registers[instruction.z], registers[instruction.w]), 0.0f, 0.0f, 0.0f);
+                break;
+            case kInputMapOpCross3:
+                result = (float4)(cross(registers[instruction.z].xyz, registers[instruction.w].xyz), 0.0f);
+                break;
+            case kInputMapOpCross4:
+                result = cross(registers[instruction.z], registers[instruction.w]);
+                break;
+            // Single input
+            case kInputMapOpSin:
+                result = sin(registers[instruction.z]);
+                break;
+            case kInputMapOpCos:
+                result = cos(registers[instruction.z]);
+                break;
+            case kInputMapOpTan:
+                result = tan(registers[instruction.z]);
+                break;
+            case kInputMapOpAsin:
+                result = asin(registers[instruction.z]);
+                break;
+            case kInputMapOpAcos:
+                result = acos(registers[instruction.z]);
+                break;
+            case kInputMapOpAtan:
+                result = atan(registers[instruction.z]);
+                break;
+            case kInputMapOpLength3:
+                result = (float4)(length(registers[instruction.z].xyz), 0.0f, 0.0f, 0.0f);
+                break;
+            case kInputMapOpNormalize3:
+                result = (float4)(normalize(registers[instruction.z].xyz), 0.0f);
+                break;
+            case kInputMapOpFloor:
+                result = floor(registers[instruction.z]);
+                break;
+            case kInputMapOpAbs:
+                result = fabs(registers[instruction.z]);
+                break;
+            // Specials
+            case kInputMapOpLerp:
+            {
+                int4 extra = InputMap_ReadInt4(input_map_values, pc++);
+                result = mix(registers[instruction.z], registers[instruction.w], registers[extra.x]);
+                break;
+            }
+            case kInputMapOpSelect:
+            {
+                float4 arg = registers[instruction.z];
+                float values[4] = { arg.x, arg.y, arg.z, arg.w };
+                result = (float4)(values[instruction.w & 3]);
+                break;
+            }
+            case kInputMapOpShuffle:
+            {
+                uint4 mask = as_uint4(InputMap_ReadInt4(input_map_values, pc++));
+                result = shuffle(registers[instruction.z], mask);
+                break;
+            }
+            case kInputMapOpShuffle2:
+            {
+                uint4 mask = as_uint4(InputMap_ReadInt4(input_map_values, pc++));
+                result = shuffle2(registers[instruction.z], registers[instruction.w], mask);
+                break;
+            }
+            case kInputMapOpMatMul:
+            {
+                matrix4x4 m = matrix_from_rows(
+                    InputMap_ReadFloat4(input_map_values, pc),
+                    InputMap_ReadFloat4(input_map_values, pc + 1),
+                    InputMap_ReadFloat4(input_map_values, pc + 2),
+                    InputMap_ReadFloat4(input_map_values, pc + 3));
+                pc += 4;
+                result = matrix_mul_vector4(m, registers[instruction.z]);
+                break;
+            }
+            case kInputMapOpRemap:
+            {
+                int4 extra = InputMap_ReadInt4(input_map_values, pc++);
+                float4 data = registers[instruction.z];
+                float4 source_range = registers[instruction.w];
+                float4 destination_range = registers[extra.x];
+                result = mix((float4)(destination_range.x), (float4)(destination_range.y),
+                    (data - (float4)(source_range.x)) / ((float4)(source_range.y) - (float4)(source_range.x)));
+                break;
+            }
+            default:
+                // Corrupted program
+                return 0.0f;
+        }
+
+        registers[dst] = result;
+    }
+}
+
+float GetInputMapFloat(uint input_id, DifferentialGeometry const* dg, GLOBAL InputMapData const* restrict input_map_values, TEXTURE_ARG_LIST)
+{
+    return GetInputMapFloat4(input_id, dg, input_map_values, TEXTURE_ARGS).x;
+}
+
+#endif
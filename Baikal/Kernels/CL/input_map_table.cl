@@ -0,0 +1,74 @@
+/**********************************************************************
+Copyright (c) 2017 Advanced Micro Devices, Inc. All rights reserved.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+********************************************************************/
+#ifndef INPUT_MAP_TABLE_CL
+#define INPUT_MAP_TABLE_CL
+
+/*
+ Lookup of input maps in InputMapData buffer, shared by generated input maps
+ and the interpreter.
+
+ Buffer starts with:
+    [0]                          (number of entries, backend specific, 0, 0)
+    [1, number of entries + 1)   (input map id, backend specific, backend specific, 0) sorted by id
+*/
+
+INLINE int4 InputMap_ReadInt4(GLOBAL InputMapData const* restrict input_map_values, int idx)
+{
+    return vload4(0, (GLOBAL int const*)(input_map_values + idx));
+}
+
+INLINE float4 InputMap_ReadFloat4(GLOBAL InputMapData const* restrict input_map_values, int idx)
+{
+    return vload4(0, (GLOBAL float const*)(input_map_values + idx));
+}
+
+// Find table entry of an input map, returns -1 in all components if there is none
+INLINE int4 InputMap_FindEntry(uint input_id, GLOBAL InputMapData const* restrict input_map_values)
+{
+    int num_entries = InputMap_ReadInt4(input_map_values, 0).x;
+
+    int begin = 0;
+    int end = num_entries;
+
+    while (begin < end)
+    {
+        int middle = (begin + end) >> 1;
+        int4 entry = InputMap_ReadInt4(input_map_values, middle + 1);
+
+        if ((uint)entry.x == input_id)
+        {
+            return entry;
+        }
+        else if ((uint)entry.x < input_id)
+        {
+            begin = middle + 1;
+        }
+        else
+        {
+            end = middle;
+        }
+    }
+
+    return -1;
+}
+
+#endif
@@ -123,6 +123,8 @@ KERNEL void GenerateLightVertices(
         }
 
         Sampler_Init(&sampler, frame, SAMPLE_DIM_CAMERA_OFFSET, scramble);
+#elif SAMPLER == OWEN_SOBOL
+        Sampler_Init(&sampler, frame, SAMPLE_DIM_CAMERA_OFFSET, random[global_id]);
 #elif SAMPLER == RANDOM
         uint scramble = global_id * rngseed;
         Sampler_Init(&sampler, scramble);
@@ -266,6 +268,8 @@ KERNEL void SampleSurface(
 #if SAMPLER == SOBOL
             uint scramble = random[pixel_idx] * 0x1fe3434f;
             Sampler_Init(&sampler, frame, SAMPLE_DIM_SURFACE_OFFSET + bounce * SAMPLE_DIMS_PER_BOUNCE, scramble);
+#elif SAMPLER == OWEN_SOBOL
+            Sampler_Init(&sampler, frame, SAMPLE_DIM_SURFACE_OFFSET + bounce * SAMPLE_DIMS_PER_BOUNCE, random[pixel_idx]);
 #elif SAMPLER == RANDOM
             uint scramble = pixel_idx * rngseed;
             Sampler_Init(&sampler, scramble);
@@ -480,6 +484,8 @@ KERNEL void SampleSurface(
 #if SAMPLER == SOBOL
             uint scramble = random[global_id] * 0x1fe3434f;
             Sampler_Init(&sampler, frame, SAMPLE_DIM_SURFACE_OFFSET + eye_vertex_index * SAMPLE_DIMS_PER_BOUNCE, scramble); 
+#elif SAMPLER == OWEN_SOBOL
+            Sampler_Init(&sampler, frame, SAMPLE_DIM_SURFACE_OFFSET + eye_vertex_index * SAMPLE_DIMS_PER_BOUNCE, random[global_id]);
 #elif SAMPLER == RANDOM
             uint scramble = global_id * rngseed;
             Sampler_Init(&sampler, scramble);
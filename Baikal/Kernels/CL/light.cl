@@ -84,6 +84,94 @@ INLINE int EnvironmentLight_GetBackgroundTexture(Light const* light)
 /*
  Environment light
  */
+/// Get environment map importance sampling distribution, 0 if there is none.
+/// It is stored right after light selection distribution and light BVH:
+/// width, height, marginal distribution over rows, conditional distribution for each row.
+INLINE GLOBAL int const* EnvironmentLight_GetDistribution(GLOBAL int const* light_distribution)
+{
+    GLOBAL int const* light_bvh = LightBvh_GetData(light_distribution);
+    GLOBAL int const* env_distribution = light_bvh + light_bvh[0];
+    return env_distribution[0] > 0 ? env_distribution : 0;
+}
+
+/// Get conditional distribution for a given row of environment map distribution
+INLINE GLOBAL int const* EnvironmentLight_GetConditional(GLOBAL int const* env_distribution, int row)
+{
+    int width = env_distribution[0];
+    int height = env_distribution[1];
+    return env_distribution + 2 + (2 * height + 2) + row * (2 * width + 2);
+}
+
+/// Sample direction proportional to environment map luminance, pdf is w.r.t. solid angle
+float3 EnvironmentLight_SampleDistribution(GLOBAL int const* env_distribution, float2 sample, float* pdf)
+{
+    int height = env_distribution[1];
+
+    // Sample row (theta) from marginal distribution first
+    float marginal_pdf;
+    float v = Distribution1D_Sample(sample.y, env_distribution + 2, &marginal_pdf);
+    int row = clamp((int)(v * height), 0, height - 1);
+
+    // Then sample column (phi) within the row
+    float conditional_pdf;
+    float u = Distribution1D_Sample(sample.x, EnvironmentLight_GetConditional(env_distribution, row), &conditional_pdf);
+
+    // Same mapping as in Texture_SampleEnvMap
+    float phi = u * 2.f * PI;
+    float theta = v * PI;
+    float sin_theta = sin(theta);
+
+    // Convert from (u, v) to solid angle measure
+    *pdf = sin_theta > 0.f ? marginal_pdf * conditional_pdf / (2.f * PI * PI * sin_theta) : 0.f;
+
+    return make_float3(sin_theta * sin(phi), cos(theta), sin_theta * cos(phi));
+}
+
+/// Get solid angle pdf of sampling a direction with EnvironmentLight_SampleDistribution
+float EnvironmentLight_GetDistributionPdf(GLOBAL int const* env_distribution, float3 d)
+{
+    int height = env_distribution[1];
+
+    float r, phi, theta;
+    CartesianToSpherical(d, &r, &phi, &theta);
+
+    float sin_theta = sin(theta);
+
+    if (sin_theta <= 0.f)
+    {
+        return 0.f;
+    }
+
+    float u = phi / (2.f * PI);
+    float v = theta / PI;
+    int row = clamp((int)(v * height), 0, height - 1);
+
+    float marginal_pdf = Distribution1D_GetPdfAt(v, env_distribution + 2);
+    float conditional_pdf = Distribution1D_GetPdfAt(u, EnvironmentLight_GetConditional(env_distribution, row));
+
+    return marginal_pdf * conditional_pdf / (2.f * PI * PI * sin_theta);
+}
+
+/// Get PDF of sampling a given direction to environment light
+float EnvironmentLight_GetDirectionPdf(GLOBAL int const* light_distribution, int interaction_type, float3 wo)
+{
+    GLOBAL int const* env_distribution = EnvironmentLight_GetDistribution(light_distribution);
+
+    if (env_distribution)
+    {
+        return EnvironmentLight_GetDistributionPdf(env_distribution, normalize(wo));
+    }
+
+    if (interaction_type != kLightInteractionVolume)
+    {
+        return 1.f / (2.f * PI);
+    }
+    else
+    {
+        return 1.f / (4.f * PI);
+    }
+}
+
 /// Get intensity for a given direction
 float3 EnvironmentLight_GetLe(// Light
                               Light const* light,
@@ -137,7 +225,14 @@ float3 EnvironmentLight_Sample(// Light
 {
     float3 d;
 
-    if (interaction_type != kLightInteractionVolume)
+    GLOBAL int const* env_distribution = EnvironmentLight_GetDistribution(scene->light_distribution);
+
+    if (env_distribution)
+    {
+        // Importance sample bright regions of the map
+        d = EnvironmentLight_SampleDistribution(env_distribution, sample, pdf);
+    }
+    else if (interaction_type != kLightInteractionVolume)
     {
         d = Sample_MapToHemisphere(sample, dg->n, 0.f);
         *pdf = 1.f / (2.f * PI);
@@ -181,14 +276,7 @@ float EnvironmentLight_GetPdf(
                               TEXTURE_ARG_LIST
                               )
 {
-    if (interaction_type != kLightInteractionVolume)
-    {
-        return 1.f / (2.f * PI);
-    }
-    else
-    {
-        return 1.f / (4.f * PI);
-    }
+    return EnvironmentLight_GetDirectionPdf(scene->light_distribution, interaction_type, wo);
 }
 
 
@@ -233,7 +321,7 @@ float3 AreaLight_GetLe(// Emissive object
         int mat_idx = Scene_GetMaterialIndex(scene, shapeidx, primidx);
         Material mat = scene->materials[mat_idx];
 
-        const float3 ke = Texture_GetValue3f(mat.simple.kx.xyz, tx, TEXTURE_ARGS_IDX(mat.simple.kxmapidx));
+        const float3 ke = Texture_GetValue3f(mat.simple.kx.xyz, tx, 0.f, TEXTURE_ARGS_IDX(mat.simple.kxmapidx));
         return ke;
     }
     else
@@ -282,7 +370,7 @@ float3 AreaLight_Sample(// Emissive object
     int mat_idx = Scene_GetMaterialIndex(scene, shapeidx, primidx);
     Material mat = scene->materials[mat_idx];
 
-    const float3 ke = Texture_GetValue3f(mat.simple.kx.xyz, tx, TEXTURE_ARGS_IDX(mat.simple.kxmapidx));
+    const float3 ke = Texture_GetValue3f(mat.simple.kx.xyz, tx, 0.f, TEXTURE_ARGS_IDX(mat.simple.kxmapidx));
 
     float3 v = -normalize(*wo);
 
@@ -383,7 +471,7 @@ float3 AreaLight_SampleVertex(
     int mat_idx = Scene_GetMaterialIndex(scene, shapeidx, primidx);
     Material mat = scene->materials[mat_idx];
 
-    const float3 ke = Texture_GetValue3f(mat.simple.kx.xyz, tx, TEXTURE_ARGS_IDX(mat.simple.kxmapidx));
+    const float3 ke = Texture_GetValue3f(mat.simple.kx.xyz, tx, 0.f, TEXTURE_ARGS_IDX(mat.simple.kxmapidx));
 
     *wo = Sample_MapToHemisphere(sample1, *n, 1.f);
     *pdf = (1.f / area) * fabs(dot(*n, *wo)) / PI;
@@ -0,0 +1,290 @@
+/**********************************************************************
+Copyright (c) 2017 Advanced Micro Devices, Inc. All rights reserved.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+********************************************************************/
+#ifndef LIGHT_BVH_CL
+#define LIGHT_BVH_CL
+
+#include <../Baikal/Kernels/CL/common.cl>
+
+/*
+ Light BVH follows light power distribution in the light distribution buffer:
+    [0, 5)                          block size, number of lights, number of nodes,
+                                    number of infinite lights, number of emissive primitives
+    [5, +number of lights)          leaf node of every light, -1 for infinite lights
+    [.., +number of infinite)       indices of infinite lights
+    [.., +3 * number of emissive)   (shape, primitive, light) sorted by shape and primitive
+    [.., +16 * number of nodes)     nodes, the root goes first
+
+ Empty tree along with no infinite lights means light BVH is disabled.
+ Infinite lights can't be bounded, so each of them is selected as often as the whole tree.
+*/
+
+#define LIGHT_BVH_HEADER_SIZE 5
+#define LIGHT_BVH_NODE_SIZE 16
+
+typedef struct
+{
+    // Power is kept in w
+    float4 bbox_min;
+    // Cosine of theta_o is kept in w
+    float4 bbox_max;
+    // Cosine of theta_e is kept in w
+    float4 axis;
+    // Left, right, parent, light
+    int4 links;
+} LightBvhNode;
+
+INLINE GLOBAL int const* LightBvh_GetData(GLOBAL int const* light_distribution)
+{
+    int num_segments = light_distribution[0];
+    return light_distribution + 2 * num_segments + 2;
+}
+
+INLINE bool LightBvh_IsEnabled(GLOBAL int const* light_distribution)
+{
+    GLOBAL int const* bvh = LightBvh_GetData(light_distribution);
+    return bvh[2] > 0 || bvh[3] > 0;
+}
+
+INLINE LightBvhNode LightBvh_GetNode(GLOBAL int const* bvh, int idx)
+{
+    int num_lights = bvh[1];
+    int num_infinite = bvh[3];
+    int num_emissive = bvh[4];
+    GLOBAL int const* nodes = bvh + LIGHT_BVH_HEADER_SIZE + num_lights + num_infinite + 3 * num_emissive;
+    GLOBAL int const* data = nodes + idx * LIGHT_BVH_NODE_SIZE;
+
+    LightBvhNode node;
+    node.bbox_min = vload4(0, (GLOBAL float const*)data);
+    node.bbox_max = vload4(1, (GLOBAL float const*)data);
+    node.axis = vload4(2, (GLOBAL float const*)data);
+    node.links = vload4(3, data);
+    return node;
+}
+
+// cos(max(0, a - b)) given sines and cosines of a and b
+INLINE float LightBvh_CosSubClamped(float sin_a, float cos_a, float sin_b, float cos_b)
+{
+    return cos_a > cos_b ? 1.f : cos_a * cos_b + sin_a * sin_b;
+}
+
+// sin(max(0, a - b)) given sines and cosines of a and b
+INLINE float LightBvh_SinSubClamped(float sin_a, float cos_a, float sin_b, float cos_b)
+{
+    return cos_a > cos_b ? 0.f : sin_a * cos_b - cos_a * sin_b;
+}
+
+// Conservative estimate of light coming from the node to point p, zero normal means
+// the point has no orientation (volume scattering)
+INLINE float LightBvh_GetImportance(LightBvhNode const* node, float3 p, float3 n)
+{
+    float power = node->bbox_min.w;
+    float cos_theta_o = node->bbox_max.w;
+    float cos_theta_e = node->axis.w;
+
+    float3 pc = 0.5f * (node->bbox_min.xyz + node->bbox_max.xyz);
+    float3 d = p - pc;
+    float dist2 = dot(d, d);
+    // Bounding sphere radius
+    float r = 0.5f * length(node->bbox_max.xyz - node->bbox_min.xyz);
+    // Keep the estimate finite close to the lights
+    float d2 = max(dist2, max(r * r, 1e-6f));
+
+    // Light might come from any direction inside the bounding sphere
+    if (dist2 <= r * r)
+    {
+        return power / d2;
+    }
+
+    float3 wi = d * native_rsqrt(dist2);
+    float cos_theta_w = dot(node->axis.xyz, wi);
+    float sin_theta_w = sqrt(max(0.f, 1.f - cos_theta_w * cos_theta_w));
+    float sin_theta_o = sqrt(max(0.f, 1.f - cos_theta_o * cos_theta_o));
+
+    // Half angle subtended by the bounding sphere
+    float sin2_theta_b = r * r / dist2;
+    float sin_theta_b = sqrt(sin2_theta_b);
+    float cos_theta_b = sqrt(max(0.f, 1.f - sin2_theta_b));
+
+    // Minimal angle between the emission cone and the direction to p
+    float cos_theta_x = LightBvh_CosSubClamped(sin_theta_w, cos_theta_w, sin_theta_o, cos_theta_o);
+    float sin_theta_x = LightBvh_SinSubClamped(sin_theta_w, cos_theta_w, sin_theta_o, cos_theta_o);
+    float cos_theta_p = LightBvh_CosSubClamped(sin_theta_x, cos_theta_x, sin_theta_b, cos_theta_b);
+
+    if (cos_theta_p <= cos_theta_e)
+    {
+        return 0.f;
+    }
+
+    float importance = power * cos_theta_p / d2;
+
+    // Minimal incident angle at p
+    if (dot(n, n) > 0.f)
+    {
+        float cos_theta_i = fabs(dot(wi, n));
+        float sin_theta_i = sqrt(max(0.f, 1.f - cos_theta_i * cos_theta_i));
+        importance *= LightBvh_CosSubClamped(sin_theta_i, cos_theta_i, sin_theta_b, cos_theta_b);
+    }
+
+    return max(importance, 0.f);
+}
+
+// Probability to descend into the left child
+INLINE float LightBvh_GetLeftProbability(GLOBAL int const* bvh, LightBvhNode const* node, float3 p, float3 n)
+{
+    LightBvhNode left = LightBvh_GetNode(bvh, node->links.x);
+    LightBvhNode right = LightBvh_GetNode(bvh, node->links.y);
+
+    float left_importance = LightBvh_GetImportance(&left, p, n);
+    float right_importance = LightBvh_GetImportance(&right, p, n);
+    float importance = left_importance + right_importance;
+
+    // Neither of the children reaches p, any choice is fine as long as pdf matches
+    return importance > 0.f ? left_importance / importance : 0.5f;
+}
+
+// Probability to select the whole tree or a single infinite light
+INLINE float LightBvh_GetGroupProbability(GLOBAL int const* bvh)
+{
+    int num_groups = bvh[3] + (bvh[2] > 0 ? 1 : 0);
+    return num_groups > 0 ? 1.f / num_groups : 0.f;
+}
+
+// Sample light index with probability following its estimated contribution to p
+INLINE int LightBvh_Sample(GLOBAL int const* light_distribution, float3 p, float3 n, float sample, float* pdf)
+{
+    GLOBAL int const* bvh = LightBvh_GetData(light_distribution);
+    int num_lights = bvh[1];
+    int num_nodes = bvh[2];
+    int num_infinite = bvh[3];
+
+    float group_pdf = LightBvh_GetGroupProbability(bvh);
+    float infinite_range = group_pdf * num_infinite;
+
+    if (sample < infinite_range)
+    {
+        GLOBAL int const* infinite_lights = bvh + LIGHT_BVH_HEADER_SIZE + num_lights;
+        *pdf = group_pdf;
+        return infinite_lights[min((int)(sample / group_pdf), num_infinite - 1)];
+    }
+
+    if (num_nodes == 0)
+    {
+        *pdf = 0.f;
+        return -1;
+    }
+
+    // Reuse the sample for every choice along the way down
+    sample = min((sample - infinite_range) / group_pdf, 0x1.fffffep-1f);
+
+    float selection_pdf = group_pdf;
+    LightBvhNode node = LightBvh_GetNode(bvh, 0);
+
+    while (node.links.w < 0)
+    {
+        float left_pdf = LightBvh_GetLeftProbability(bvh, &node, p, n);
+
+        if (sample < left_pdf)
+        {
+            sample = min(sample / left_pdf, 0x1.fffffep-1f);
+            selection_pdf *= left_pdf;
+            node = LightBvh_GetNode(bvh, node.links.x);
+        }
+        else
+        {
+            sample = min((sample - left_pdf) / (1.f - left_pdf), 0x1.fffffep-1f);
+            selection_pdf *= 1.f - left_pdf;
+            node = LightBvh_GetNode(bvh, node.links.y);
+        }
+    }
+
+    *pdf = selection_pdf;
+    return node.links.w;
+}
+
+// Probability of LightBvh_Sample to select a given light at p
+INLINE float LightBvh_GetPdf(GLOBAL int const* light_distribution, int light_idx, float3 p, float3 n)
+{
+    GLOBAL int const* bvh = LightBvh_GetData(light_distribution);
+    int node_idx = bvh[LIGHT_BVH_HEADER_SIZE + light_idx];
+
+    float pdf = LightBvh_GetGroupProbability(bvh);
+
+    if (node_idx < 0)
+    {
+        return pdf;
+    }
+
+    // Walk up to the root multiplying probabilities of choices made on the way down
+    LightBvhNode node = LightBvh_GetNode(bvh, node_idx);
+
+    while (node.links.z >= 0)
+    {
+        int parent_idx = node.links.z;
+        LightBvhNode parent = LightBvh_GetNode(bvh, parent_idx);
+
+        float left_pdf = LightBvh_GetLeftProbability(bvh, &parent, p, n);
+        pdf *= parent.links.x == node_idx ? left_pdf : 1.f - left_pdf;
+
+        node_idx = parent_idx;
+        node = parent;
+    }
+
+    return pdf;
+}
+
+// Find area light of a shape primitive, -1 if the primitive is not emissive
+INLINE int LightBvh_FindAreaLight(GLOBAL int const* light_distribution, int shape_idx, int prim_idx)
+{
+    GLOBAL int const* bvh = LightBvh_GetData(light_distribution);
+    int num_lights = bvh[1];
+    int num_infinite = bvh[3];
+    int num_emissive = bvh[4];
+    GLOBAL int const* emissives = bvh + LIGHT_BVH_HEADER_SIZE + num_lights + num_infinite;
+
+    int begin = 0;
+    int end = num_emissive;
+
+    while (begin < end)
+    {
+        int mid = (begin + end) / 2;
+        int mid_shape = emissives[3 * mid];
+        int mid_prim = emissives[3 * mid + 1];
+
+        if (mid_shape == shape_idx && mid_prim == prim_idx)
+        {
+            return emissives[3 * mid + 2];
+        }
+
+        if (mid_shape < shape_idx || (mid_shape == shape_idx && mid_prim < prim_idx))
+        {
+            begin = mid + 1;
+        }
+        else
+        {
+            end = mid;
+        }
+    }
+
+    return -1;
+}
+
+#endif // LIGHT_BVH_CL
@@ -37,6 +37,7 @@ THE SOFTWARE.
 #include <../Baikal/Kernels/CL/volumetrics.cl>
 #include <../Baikal/Kernels/CL/path.cl>
 #include <../Baikal/Kernels/CL/vertex.cl>
+#include <../Baikal/Kernels/CL/camera.cl>
 
 // Pinhole camera implementation.
 // This kernel is being used if aperture value = 0.
@@ -85,6 +86,8 @@ void PerspectiveCamera_GeneratePaths(
         }
 
         Sampler_Init(&sampler, frame, SAMPLE_DIM_CAMERA_OFFSET, scramble);
+#elif SAMPLER == OWEN_SOBOL
+        Sampler_Init(&sampler, frame, SAMPLE_DIM_CAMERA_OFFSET, random[x + output_width * y]);
 #elif SAMPLER == RANDOM
         uint scramble = x + output_width * y * rng_seed;
         Sampler_Init(&sampler, scramble);
@@ -94,36 +97,8 @@ void PerspectiveCamera_GeneratePaths(
         Sampler_Init(&sampler, frame % (CMJ_DIM * CMJ_DIM), SAMPLE_DIM_CAMERA_OFFSET, scramble);
 #endif
 
-        // Generate sample
-#ifndef BAIKAL_GENERATE_SAMPLE_AT_PIXEL_CENTER
-        float2 sample0 = Sampler_Sample2D(&sampler, SAMPLER_ARGS);
-#else
-        float2 sample0 = make_float2(0.5f, 0.5f);
-#endif
-
-        // Calculate [0..1] image plane sample
-        float2 img_sample;
-        img_sample.x = (float)x / output_width + sample0.x / output_width;
-        img_sample.y = (float)y / output_height + sample0.y / output_height;
-
-        // Transform into [-0.5, 0.5]
-        float2 h_sample = img_sample - make_float2(0.5f, 0.5f);
-        // Transform into [-dim/2, dim/2]
-        float2 c_sample = h_sample * camera->dim;
-
-        // Calculate direction to image plane
-        my_ray->d.xyz = normalize(camera->focal_length * camera->forward + c_sample.x * camera->right + c_sample.y * camera->up);
-        // Origin == camera position + nearz * d
-        my_ray->o.xyz = camera->p + camera->zcap.x * my_ray->d.xyz;
-        // Max T value = zfar - znear since we moved origin to znear
-        my_ray->o.w = camera->zcap.y - camera->zcap.x;
-        // Generate random time from 0 to 1
-        my_ray->d.w = sample0.x;
-        // Set ray max
-        my_ray->extra.x = 0xFFFFFFFF;
-        my_ray->extra.y = 0xFFFFFFFF;
-        Ray_SetExtra(my_ray, 1.f);
-        Ray_SetMask(my_ray, VISIBILITY_MASK_PRIMARY);
+        // Generate ray through the pixel
+        Camera_GenerateRay(camera, CAMERA_PERSPECTIVE, x, y, output_width, output_height, &sampler, SAMPLER_ARGS, my_ray);
     }
 }
 
@@ -173,6 +148,8 @@ KERNEL void PerspectiveCameraDof_GeneratePaths(
         }
 
         Sampler_Init(&sampler, frame, SAMPLE_DIM_CAMERA_OFFSET, scramble);
+#elif SAMPLER == OWEN_SOBOL
+        Sampler_Init(&sampler, frame, SAMPLE_DIM_CAMERA_OFFSET, random[x + output_width * y]);
 #elif SAMPLER == RANDOM
         uint scramble = x + output_width * y * rng_seed;
         Sampler_Init(&sampler, scramble);
@@ -182,44 +159,8 @@ KERNEL void PerspectiveCameraDof_GeneratePaths(
         Sampler_Init(&sampler, frame % (CMJ_DIM * CMJ_DIM), SAMPLE_DIM_CAMERA_OFFSET, scramble);
 #endif
 
-        // Generate pixel and lens samples
-#ifndef BAIKAL_GENERATE_SAMPLE_AT_PIXEL_CENTER
-        float2 sample0 = Sampler_Sample2D(&sampler, SAMPLER_ARGS);
-#else
-        float2 sample0 = make_float2(0.5f, 0.5f);
-#endif
-        float2 sample1 = Sampler_Sample2D(&sampler, SAMPLER_ARGS);
-
-        // Calculate [0..1] image plane sample
-        float2 img_sample;
-        img_sample.x = (float)x / output_width + sample0.x / output_width;
-        img_sample.y = (float)y / output_height + sample0.y / output_height;
-
-        // Transform into [-0.5, 0.5]
-        float2 h_sample = img_sample - make_float2(0.5f, 0.5f);
-        // Transform into [-dim/2, dim/2]
-        float2 c_sample = h_sample * camera->dim;
-
-        // Generate sample on the lens
-        float2 lens_sample = camera->aperture * Sample_MapToDiskConcentric(sample1);
-        // Calculate position on focal plane
-        float2 focal_plane_sample = c_sample * camera->focus_distance / camera->focal_length;
-        // Calculate ray direction
-        float2 camera_dir = focal_plane_sample - lens_sample;
-
-        // Calculate direction to image plane
-        my_ray->d.xyz = normalize(camera->forward * camera->focus_distance + camera->right * camera_dir.x + camera->up * camera_dir.y);
-        // Origin == camera position + nearz * d
-        my_ray->o.xyz = camera->p + lens_sample.x * camera->right + lens_sample.y * camera->up;
-        // Max T value = zfar - znear since we moved origin to znear
-        my_ray->o.w = camera->zcap.y - camera->zcap.x;
-        // Generate random time from 0 to 1
-        my_ray->d.w = sample0.x;
-        // Set ray max
-        my_ray->extra.x = 0xFFFFFFFF;
-        my_ray->extra.y = 0xFFFFFFFF;
-        Ray_SetExtra(my_ray, 1.f);
-        Ray_SetMask(my_ray, VISIBILITY_MASK_PRIMARY);
+        // Generate ray through the pixel
+        Camera_GenerateRay(camera, CAMERA_PHYSICAL_PERSPECTIVE, x, y, output_width, output_height, &sampler, SAMPLER_ARGS, my_ray);
     }
 }
 
@@ -280,6 +221,8 @@ void PerspectiveCamera_GenerateVertices(
         }
 
         Sampler_Init(&sampler, frame, SAMPLE_DIM_CAMERA_OFFSET, scramble);
+#elif SAMPLER == OWEN_SOBOL
+        Sampler_Init(&sampler, frame, SAMPLE_DIM_CAMERA_OFFSET, random[x + output_width * y]);
 #elif SAMPLER == RANDOM
         uint scramble = x + output_width * y * rng_seed;
         Sampler_Init(&sampler, scramble);
@@ -393,6 +336,8 @@ void PerspectiveCameraDof_GenerateVertices(
         }
 
         Sampler_Init(&sampler, frame, SAMPLE_DIM_CAMERA_OFFSET, scramble);
+#elif SAMPLER == OWEN_SOBOL
+        Sampler_Init(&sampler, frame, SAMPLE_DIM_CAMERA_OFFSET, random[x + output_width * y]);
 #elif SAMPLER == RANDOM
         uint scramble = x + output_width * y * rng_seed;
         Sampler_Init(&sampler, scramble);
@@ -525,86 +470,30 @@ KERNEL void GenerateTileDomain(
     }
 }
 
-KERNEL void GenerateTileDomain_Adaptive(
+// Collect pixels of a tile which have not converged yet, the caller compacts
+// candidates by predicates into the sample domain
+KERNEL void GenerateTileDomain_Active(
     int output_width,
-    int output_height,
     int offset_x,
     int offset_y,
     int width,
     int height,
-    uint rng_seed,
-    uint frame,
-    GLOBAL uint* restrict random,
-    GLOBAL uint const* restrict sobol_mat,
-    GLOBAL int const* restrict tile_distribution,
-    GLOBAL int* restrict indices,
-    GLOBAL int* restrict count
+    GLOBAL int const* restrict convergence_mask,
+    GLOBAL int* restrict candidates,
+    GLOBAL int* restrict predicates
 )
 {
     int2 global_id;
     global_id.x = get_global_id(0);
     global_id.y = get_global_id(1);
 
-    int2 local_id;
-    local_id.x = get_local_id(0);
-    local_id.y = get_local_id(1);
-
-    int2 group_id;
-    group_id.x = get_group_id(0);
-    group_id.y = get_group_id(1);
-
-    int2 tile_size;
-    tile_size.x = get_local_size(0);
-    tile_size.y = get_local_size(1);
-
-
-    // Initialize sampler  
-    Sampler sampler;
-    int x = global_id.x;
-    int y = global_id.y;
-#if SAMPLER == SOBOL
-    uint scramble = random[x + output_width * y] * 0x1fe3434f;
-
-    if (frame & 0xF)
-    {
-        random[x + output_width * y] = WangHash(scramble);
-    }
-
-    Sampler_Init(&sampler, frame, SAMPLE_DIM_IMG_PLANE_EVALUATE_OFFSET, scramble);
-#elif SAMPLER == RANDOM
-    uint scramble = x + output_width * y * rng_seed;
-    Sampler_Init(&sampler, scramble);
-#elif SAMPLER == CMJ
-    uint rnd = random[group_id.x + output_width *group_id.y];
-    uint scramble = rnd * 0x1fe3434f * ((frame + 133 * rnd) / (CMJ_DIM * CMJ_DIM));
-    Sampler_Init(&sampler, frame % (CMJ_DIM * CMJ_DIM), SAMPLE_DIM_IMG_PLANE_EVALUATE_OFFSET, scramble);
-#endif
-
-    float2 sample = Sampler_Sample2D(&sampler, SAMPLER_ARGS);
-
-    float pdf;
-    int tile = Distribution1D_SampleDiscrete(sample.x, tile_distribution, &pdf);
-
-    int num_tiles_x = output_width / tile_size.x;
-    int num_tiles_y = output_height / tile_size.y;
-
-    int tile_y = clamp(tile / num_tiles_x , 0, num_tiles_y - 1);
-    int tile_x = clamp(tile % num_tiles_x, 0, num_tiles_x - 1);
-
-    int start_idx = output_width * offset_y + offset_x;
-
     if (global_id.x < width && global_id.y < height)
     {
-        int idx = start_idx +
-            (tile_y * tile_size.y + local_id.y) * output_width +
-            (tile_x * tile_size.x + local_id.x);
-
-        indices[global_id.y * width + global_id.x] = idx;
-    }
+        int idx = output_width * (offset_y + global_id.y) + offset_x + global_id.x;
+        int i = global_id.y * width + global_id.x;
 
-    if (global_id.x == 0 && global_id.y == 0)
-    {
-        *count = width * height;
+        candidates[i] = idx;
+        predicates[i] = convergence_mask[idx] ? 0 : 1;
     }
 }
 
@@ -735,6 +624,8 @@ KERNEL void FillAOVs(
 #if SAMPLER == SOBOL 
             uint scramble = random[global_id] * 0x1fe3434f;
             Sampler_Init(&sampler, frame, SAMPLE_DIM_SURFACE_OFFSET, scramble);
+#elif SAMPLER == OWEN_SOBOL
+            Sampler_Init(&sampler, frame, SAMPLE_DIM_SURFACE_OFFSET, random[global_id]);
 #elif SAMPLER == RANDOM
             uint scramble = global_id * rngseed;
             Sampler_Init(&sampler, scramble);
@@ -831,7 +722,7 @@ KERNEL void FillAOVs(
                 // Select BxDF
                 Material_Select(&scene, wi, &sampler, TEXTURE_ARGS, SAMPLER_ARGS, &diffgeo);
 
-                const float3 kd = Texture_GetValue3f(diffgeo.mat.simple.kx.xyz, diffgeo.uv, TEXTURE_ARGS_IDX(diffgeo.mat.simple.kxmapidx));
+                const float3 kd = Texture_GetValue3f(diffgeo.mat.simple.kx.xyz, diffgeo.uv, diffgeo.uv_footprint, TEXTURE_ARGS_IDX(diffgeo.mat.simple.kxmapidx));
 
                 aov_albedo[idx].xyz += kd;
                 aov_albedo[idx].w += 1.f;
@@ -909,7 +800,7 @@ KERNEL void FillAOVs(
                 else if (type == kMicrofacetGGX || type == kMicrofacetBeckmann ||
                     type == kMicrofacetRefractionGGX || type == kMicrofacetRefractionBeckmann)
                 {
-                    gloss = 1.f - Texture_GetValue1f(diffgeo.mat.simple.ns, diffgeo.uv, TEXTURE_ARGS_IDX(diffgeo.mat.simple.nsmapidx));
+                    gloss = 1.f - Texture_GetValue1f(diffgeo.mat.simple.ns, diffgeo.uv, diffgeo.uv_footprint, TEXTURE_ARGS_IDX(diffgeo.mat.simple.nsmapidx));
                 }
 
 
@@ -962,6 +853,73 @@ KERNEL void AccumulateData(
     }
 }
 
+// Move samples accumulated in a tile of data into a tightly packed tile buffer,
+// leaving zeros behind. With half_float set tile holds half4 (average, count) values.
+KERNEL void ExtractTileData(
+    GLOBAL float4* restrict data,
+    int width,
+    int tile_x,
+    int tile_y,
+    int tile_width,
+    int tile_height,
+    int half_float,
+    GLOBAL float4* restrict tile
+)
+{
+    int global_id = get_global_id(0);
+
+    if (global_id < tile_width * tile_height)
+    {
+        int idx = (tile_y + global_id / tile_width) * width + tile_x + global_id % tile_width;
+        float4 v = data[idx];
+        data[idx] = 0.f;
+
+        if (half_float)
+        {
+            // Averages keep radiance sums within half range
+            float4 average = v.w > 0.f ? (float4)(v.xyz / v.w, v.w) : 0.f;
+            vstore_half4(average, global_id, (GLOBAL half*)tile);
+        }
+        else
+        {
+            tile[global_id] = v;
+        }
+    }
+}
+
+// Add samples from a tile buffer produced by ExtractTileData to a tile of data
+KERNEL void AccumulateTileData(
+    GLOBAL float4 const* restrict tile,
+    int width,
+    int tile_x,
+    int tile_y,
+    int tile_width,
+    int tile_height,
+    int half_float,
+    GLOBAL float4* restrict data
+)
+{
+    int global_id = get_global_id(0);
+
+    if (global_id < tile_width * tile_height)
+    {
+        int idx = (tile_y + global_id / tile_width) * width + tile_x + global_id % tile_width;
+
+        float4 v;
+        if (half_float)
+        {
+            v = vload_half4(global_id, (GLOBAL half const*)tile);
+            v.xyz *= v.w;
+        }
+        else
+        {
+            v = tile[global_id];
+        }
+
+        data[idx] += v;
+    }
+}
+
 //#define ADAPTIVITY_DEBUG
 // Copy data to interop texture if supported
 KERNEL void ApplyGammaAndCopyData(
@@ -991,126 +949,92 @@ KERNEL void ApplyGammaAndCopyData(
     }
 } 
 
-KERNEL void AccumulateSingleSample(
-    GLOBAL float4 const* restrict src_sample_data,
-    GLOBAL float4* restrict dst_accumulation_data,
-    GLOBAL int* restrict scatter_indices,
-    int num_elements
+// Apply gamma and quantize data to RGBA8 for readback
+KERNEL void ApplyGammaAndQuantizeData(
+    GLOBAL float4 const* data,
+    int num_elements,
+    float gamma,
+    GLOBAL uchar4* rgba8
 )
 {
     int global_id = get_global_id(0);
 
     if (global_id < num_elements)
     {
-        int idx = scatter_indices[global_id];
-        float4 sample = src_sample_data[global_id];
-        dst_accumulation_data[idx].xyz += sample.xyz;
-        dst_accumulation_data[idx].w += 1.f;
+        float4 v = data[global_id];
+        float4 val = clamp(native_powr(v / v.w, 1.f / gamma), 0.f, 1.f);
+        uchar4 rgba = convert_uchar4(val * 255.f);
+        rgba.w = 1;
+        rgba8[global_id] = rgba;
     }
 }
 
-INLINE void group_reduce_add(__local float* lds, int size, int lid)
+// Add the samples of a pixel and track the second moment of their luminance.
+// The estimator may put several samples into a slot (w holds their number), these
+// are weighted as w samples of their mean value.
+KERNEL void AccumulateSampleMoments(
+    GLOBAL float4 const* restrict src_sample_data,
+    GLOBAL float4* restrict dst_accumulation_data,
+    GLOBAL float* restrict dst_moments,
+    GLOBAL int const* restrict scatter_indices,
+    GLOBAL int const* restrict num_elements
+)
 {
-    for (int offset = (size >> 1); offset > 0; offset >>= 1)
-    {
-        if (lid < offset)
-        {
-            lds[lid] += lds[lid + offset];
-        }
-        barrier(CLK_LOCAL_MEM_FENCE);
-    }
-}
+    int global_id = get_global_id(0);
 
-INLINE void group_reduce_min(__local float* lds, int size, int lid)
-{
-    for (int offset = (size >> 1); offset > 0; offset >>= 1)
+    if (global_id < *num_elements)
     {
-        if (lid < offset)
-        {
-            lds[lid] = min(lds[lid], lds[lid + offset]);
-        }
-        barrier(CLK_LOCAL_MEM_FENCE);
-    }
-}
+        int idx = scatter_indices[global_id];
+        float4 sample = src_sample_data[global_id];
 
+        if (sample.w <= 0.f)
+            return;
 
-INLINE void group_reduce_max(__local float* lds, int size, int lid)
-{
-    for (int offset = (size >> 1); offset > 0; offset >>= 1)
-    {
-        if (lid < offset)
-        {
-            lds[lid] = max(lds[lid], lds[lid + offset]);
-        }
-        barrier(CLK_LOCAL_MEM_FENCE);
+        float value = luminance(sample.xyz);
+
+        dst_accumulation_data[idx] += sample;
+        dst_moments[idx] += value * value / sample.w;
     }
 }
 
-
-KERNEL void EstimateVariance(
-    GLOBAL float4 const* restrict image_buffer,
-    GLOBAL float* restrict variance_buffer,
-    int width,
-    int height
+// Mark pixels with low enough relative standard error of the mean as converged
+// and count the ones still being sampled
+KERNEL void UpdateConvergence(
+    GLOBAL float4 const* restrict accumulation_data,
+    GLOBAL float const* restrict moments,
+    int num_pixels,
+    int min_samples,
+    float threshold,
+    GLOBAL int* restrict convergence_mask,
+    GLOBAL int* restrict num_active
 )
 {
-    __local float lds[256];
-
-    int x = get_global_id(0);
-    int y = get_global_id(1);
-    int lx = get_local_id(0);
-    int ly = get_local_id(1);
-    int gx = get_group_id(0);
-    int gy = get_group_id(1);
-    int wx = get_local_size(0);
-    int wy = get_local_size(1);
-    int num_tiles = (width + wx - 1) / wx;
-    int lid = ly * wx + lx;
-
-    float value = 0.f;
-    if (x < width && y < height)
-    {
-        float4 rw = image_buffer[y * width + x]; rw /= rw.w;
-        value = 4*luminance(clamp(rw.xyz, 0.f, 1.f));
-        rw = y + 1 < height ? image_buffer[(y + 1) * width + x] : image_buffer[y * width + x]; rw /= rw.w;
-        value -= luminance(clamp(rw.xyz, 0.f, 1.f));
-        rw = y - 1 >= 0 ? image_buffer[(y - 1) * width + x] : image_buffer[y * width + x]; rw /= rw.w;
-        value -= luminance(clamp(rw.xyz, 0.f, 1.f));
-        rw = x + 1 < width ? image_buffer[y * width + x + 1] : image_buffer[y * width + x]; rw /= rw.w;
-        value -= luminance(clamp(rw.xyz, 0.f, 1.f));
-        rw = x - 1 >= 0 ? image_buffer[y * width + x - 1] : image_buffer[y * width + x]; rw /= rw.w;
-        value -= luminance(clamp(rw.xyz, 0.f, 1.f));
-        //rw = y + 1 < height && x + 1 < width ? image_buffer[(y + 1) * width + x + 1] : image_buffer[y * width + x]; rw /= rw.w;
-        //value -= luminance(clamp(rw.xyz, 0.f, 1.f));
-        //rw = y - 1 >= 0 && x - 1 >= 0 ? image_buffer[(y - 1) * width + x - 1] : image_buffer[y * width + x]; rw /= rw.w;
-        //value -= luminance(clamp(rw.xyz, 0.f, 1.f));
-        //rw = y + 1 < height && x - 1 >= 0 ? image_buffer[(y + 1) * width + x - 1] : image_buffer[y * width + x]; rw /= rw.w;
-        //value -= luminance(clamp(rw.xyz, 0.f, 1.f));
-        //rw = y - 1 >= 0 && x + 1 < width ? image_buffer[(y - 1) * width + x + 1] : image_buffer[y * width + x]; rw /= rw.w;
-        //value -= luminance(clamp(rw.xyz, 0.f, 1.f));
-    }
-
-    value = fabs(value);
-    lds[lid] = value;
-    barrier(CLK_LOCAL_MEM_FENCE);
-
-    group_reduce_add(lds, 256, lid);
-
-    float mean = lds[0] / (wx * wy);
-    barrier(CLK_LOCAL_MEM_FENCE);
+    int global_id = get_global_id(0);
 
-    /*lds[lid] = (mean - value) * (mean - value);
-    barrier(CLK_LOCAL_MEM_FENCE);
+    if (global_id < num_pixels)
+    {
+        // Converged pixels are never sampled again
+        if (convergence_mask[global_id])
+            return;
 
-    group_reduce_add(lds, 256, lid);*/
+        float4 value = accumulation_data[global_id];
+        float n = value.w;
 
-    if (x < width && y < height)
-    {
-        if (lx == 0 && ly == 0)
+        if (n >= (float)min_samples)
         {
-            //float dev = lds[0] / (wx * wy - 1);
-            variance_buffer[gy * num_tiles + gx] = mean;
+            float mean = luminance(value.xyz) / n;
+            float variance = max(moments[global_id] / n - mean * mean, 0.f);
+            // Floor the mean so that noise in near black pixels does not keep them alive
+            float error = native_sqrt(variance / n) / max(mean, 1e-2f);
+
+            if (error < threshold)
+            {
+                convergence_mask[global_id] = 1;
+                return;
+            }
         }
+
+        atomic_inc(num_active);
     }
 }
 
@@ -1159,6 +1083,8 @@ void  OrthographicCamera_GeneratePaths(
         }
         
         Sampler_Init(&sampler, frame, SAMPLE_DIM_CAMERA_OFFSET, scramble);
+#elif SAMPLER == OWEN_SOBOL
+        Sampler_Init(&sampler, frame, SAMPLE_DIM_CAMERA_OFFSET, random[x + output_width * y]);
 #elif SAMPLER == RANDOM
         uint scramble = x + output_width * y * rng_seed;
         Sampler_Init(&sampler, scramble);
@@ -1168,36 +1094,8 @@ void  OrthographicCamera_GeneratePaths(
         Sampler_Init(&sampler, frame % (CMJ_DIM * CMJ_DIM), SAMPLE_DIM_CAMERA_OFFSET, scramble);
 #endif
         
-        // Generate sample
-#ifndef BAIKAL_GENERATE_SAMPLE_AT_PIXEL_CENTER
-        float2 sample0 = Sampler_Sample2D(&sampler, SAMPLER_ARGS);
-#else
-        float2 sample0 = make_float2(0.5f, 0.5f);
-#endif
-        
-        // Calculate [0..1] image plane sample
-        float2 img_sample;
-        img_sample.x = (float)x / output_width + sample0.x / output_width;
-        img_sample.y = (float)y / output_height + sample0.y / output_height;
-        
-        // Transform into [-0.5, 0.5]
-        float2 h_sample = img_sample - make_float2(0.5f, 0.5f);
-        // Transform into [-dim/2, dim/2]
-        float2 c_sample = h_sample * camera->dim;
-        
-        // Calculate direction to image plane
-        my_ray->d.xyz = normalize(camera->forward);
-        // Origin == camera position + nearz * d
-        my_ray->o.xyz = camera->p + c_sample.x * camera->right + c_sample.y * camera->up;
-        // Max T value = zfar - znear since we moved origin to znear
-        my_ray->o.w = camera->zcap.y - camera->zcap.x;
-        // Generate random time from 0 to 1
-        my_ray->d.w = sample0.x;
-        // Set ray max
-        my_ray->extra.x = 0xFFFFFFFF;
-        my_ray->extra.y = 0xFFFFFFFF;
-        Ray_SetExtra(my_ray, 1.f);
-        Ray_SetMask(my_ray, VISIBILITY_MASK_PRIMARY);
+        // Generate ray through the pixel
+        Camera_GenerateRay(camera, CAMERA_ORTHOGRAPHIC, x, y, output_width, output_height, &sampler, SAMPLER_ARGS, my_ray);
     }
 }
 
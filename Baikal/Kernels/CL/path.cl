@@ -32,7 +32,15 @@ typedef struct _Path
     int volume;
     int flags;
     int active;
-    int extra1;
+    // Estimator pass the path has been (re)started at
+    int start_pass;
+    // Ray cone: width at the last vertex and spread angle
+    float cone_width;
+    float cone_spread;
+    // Sample index offset of a regenerated path within the frame
+    int sample;
+    // Packed normal at the last surface vertex, light selection pdf depends on it
+    uint light_normal;
 } Path;
 
 typedef enum _PathFlags
@@ -42,6 +50,13 @@ typedef enum _PathFlags
     kScattered = 0x2
 } PathFlags;
 
+// Advance ray cone by a given distance and get its width
+INLINE float Path_PropagateCone(__global Path* path, float distance)
+{
+    path->cone_width += path->cone_spread * distance;
+    return path->cone_width;
+}
+
 INLINE bool Path_IsScattered(__global Path const* path)
 {
     return path->flags & kScattered;
@@ -82,6 +97,19 @@ INLINE void Path_Restart(__global Path* path)
     path->flags = 0;
 }
 
+// Bounce index of the path at a given estimator pass
+INLINE int Path_GetBounce(__global Path const* path, int pass)
+{
+    return pass - path->start_pass;
+}
+
+// Sampler index of the path, frame is the sample index of camera rays of the frame
+// and every restart of the path within the frame takes the next one
+INLINE int Path_GetSampleIndex(__global Path const* path, int frame)
+{
+    return frame + path->sample;
+}
+
 INLINE int Path_GetVolumeIdx(__global Path const* path)
 {
     return path->volume;
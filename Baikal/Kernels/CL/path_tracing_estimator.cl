@@ -36,6 +36,25 @@ THE SOFTWARE.
 #include <../Baikal/Kernels/CL/material.cl>
 #include <../Baikal/Kernels/CL/volumetrics.cl>
 #include <../Baikal/Kernels/CL/path.cl>
+#include <../Baikal/Kernels/CL/camera.cl>
+
+// Material classes ShadeSurface can be specialized for
+#define MATERIAL_CLASS_STANDARD 0
+#define MATERIAL_CLASS_UBERV2 1
+
+// Specialized kernels resolve the UberV2 branch at compile time
+#if !defined(SHADE_MATERIAL_CLASS)
+#define SHADE_IS_UBERV2(type) ((type) == kUberV2)
+#elif SHADE_MATERIAL_CLASS == MATERIAL_CLASS_UBERV2
+#define SHADE_IS_UBERV2(type) true
+#else
+#define SHADE_IS_UBERV2(type) false
+#endif
+
+INLINE int Material_GetClass(int type)
+{
+    return type == kUberV2 ? MATERIAL_CLASS_UBERV2 : MATERIAL_CLASS_STANDARD;
+}
 
 
 KERNEL
@@ -60,6 +79,10 @@ void InitPathData(
         my_path->volume = world_volume_idx;
         my_path->flags = 0;
         my_path->active = 0xFF;
+        my_path->start_pass = 0;
+        my_path->cone_width = 0.f;
+        my_path->cone_spread = 0.f;
+        my_path->sample = 0;
     }
 }
 
@@ -107,8 +130,8 @@ KERNEL void ShadeVolume(
     GLOBAL uint* restrict random,
     // Sobol matrices
     GLOBAL uint const* restrict sobol_mat,
-    // Current bounce
-    int bounce,
+    // Current pass
+    int pass,
     // Current frame
     int frame,
     // Volume data
@@ -156,6 +179,10 @@ KERNEL void ShadeVolume(
             return;
         }
 
+        // Regenerated paths start at a later pass and sample a later index
+        int bounce = Path_GetBounce(path, pass);
+        int sample_index = Path_GetSampleIndex(path, frame);
+
         // Fetch incoming ray
         float3 o = rays[hit_idx].o.xyz;
         float3 wi = -rays[hit_idx].d.xyz;
@@ -163,14 +190,16 @@ KERNEL void ShadeVolume(
         Sampler sampler;
 #if SAMPLER == SOBOL
         uint scramble = random[pixel_idx] * 0x1fe3434f;
-        Sampler_Init(&sampler, frame, SAMPLE_DIM_SURFACE_OFFSET + bounce * SAMPLE_DIMS_PER_BOUNCE + SAMPLE_DIM_VOLUME_EVALUATE_OFFSET, scramble);
+        Sampler_Init(&sampler, sample_index, SAMPLE_DIM_SURFACE_OFFSET + bounce * SAMPLE_DIMS_PER_BOUNCE + SAMPLE_DIM_VOLUME_EVALUATE_OFFSET, scramble);
+#elif SAMPLER == OWEN_SOBOL
+        Sampler_Init(&sampler, sample_index, SAMPLE_DIM_SURFACE_OFFSET + bounce * SAMPLE_DIMS_PER_BOUNCE + SAMPLE_DIM_VOLUME_EVALUATE_OFFSET, random[pixel_idx]);
 #elif SAMPLER == RANDOM
         uint scramble = pixel_idx * rng_seed;
         Sampler_Init(&sampler, scramble);
 #elif SAMPLER == CMJ
         uint rnd = random[pixel_idx];
-        uint scramble = rnd * 0x1fe3434f * ((frame + 13 * rnd) / (CMJ_DIM * CMJ_DIM));
-        Sampler_Init(&sampler, frame % (CMJ_DIM * CMJ_DIM), SAMPLE_DIM_SURFACE_OFFSET + bounce * SAMPLE_DIMS_PER_BOUNCE + SAMPLE_DIM_VOLUME_EVALUATE_OFFSET, scramble);
+        uint scramble = rnd * 0x1fe3434f * ((sample_index + 13 * rnd) / (CMJ_DIM * CMJ_DIM));
+        Sampler_Init(&sampler, sample_index % (CMJ_DIM * CMJ_DIM), SAMPLE_DIM_SURFACE_OFFSET + bounce * SAMPLE_DIMS_PER_BOUNCE + SAMPLE_DIM_VOLUME_EVALUATE_OFFSET, scramble);
 #endif
 
 
@@ -183,13 +212,14 @@ KERNEL void ShadeVolume(
         float selection_pdf = 0.f;
         float3 wo;
 
-        int light_idx = Scene_SampleLight(&scene, Sampler_Sample1D(&sampler, SAMPLER_ARGS), &selection_pdf);
-
         // Here we need fake differential geometry for light sampling procedure
         DifferentialGeometry dg;
         // put scattering position in there (it is along the current ray at isect.distance
         // since EvaluateVolume has put it there
         dg.p = o - wi * Intersection_GetDistance(isects + hit_idx);
+
+        int light_idx = Scene_SampleLightAt(&scene, dg.p, (float3)(0.f), Sampler_Sample1D(&sampler, SAMPLER_ARGS), &selection_pdf);
+
         // Get light sample intencity
         int bxdf_flags = Path_GetBxdfFlags(path); 
         float3 le = Light_Sample(light_idx, &scene, &dg, TEXTURE_ARGS, Sampler_Sample2D(&sampler, SAMPLER_ARGS), bxdf_flags, kLightInteractionVolume, &wo, &pdf);
@@ -292,8 +322,8 @@ KERNEL void ShadeSurface(
     GLOBAL uint* restrict random,
     // Sobol matrices
     GLOBAL uint const* restrict sobol_mat,
-    // Current bounce
-    int bounce,
+    // Current pass
+    int pass,
     // Frame
     int frame,
     // Volume data
@@ -343,20 +373,36 @@ KERNEL void ShadeSurface(
             return;
         }
 
+#ifdef SHADE_MATERIAL_CLASS
+        // Leave other materials to their own kernel, with sorted
+        // hits only the wavefronts on class boundaries diverge here
+        int material_type = materials[shapes[isect.shapeid - 1].material_idx].type;
+        if (Material_GetClass(material_type) != SHADE_MATERIAL_CLASS)
+        {
+            return;
+        }
+#endif
+
+        // Regenerated paths start at a later pass and sample a later index
+        int bounce = Path_GetBounce(path, pass);
+        int sample_index = Path_GetSampleIndex(path, frame);
+
         // Fetch incoming ray direction
         float3 wi = -normalize(rays[hit_idx].d.xyz);
 
         Sampler sampler;
 #if SAMPLER == SOBOL
         uint scramble = random[pixel_idx] * 0x1fe3434f;
-        Sampler_Init(&sampler, frame, SAMPLE_DIM_SURFACE_OFFSET + bounce * SAMPLE_DIMS_PER_BOUNCE, scramble);
+        Sampler_Init(&sampler, sample_index, SAMPLE_DIM_SURFACE_OFFSET + bounce * SAMPLE_DIMS_PER_BOUNCE, scramble);
+#elif SAMPLER == OWEN_SOBOL
+        Sampler_Init(&sampler, sample_index, SAMPLE_DIM_SURFACE_OFFSET + bounce * SAMPLE_DIMS_PER_BOUNCE, random[pixel_idx]);
 #elif SAMPLER == RANDOM
         uint scramble = pixel_idx * rng_seed;
         Sampler_Init(&sampler, scramble);
 #elif SAMPLER == CMJ
         uint rnd = random[pixel_idx];
-        uint scramble = rnd * 0x1fe3434f * ((frame + 331 * rnd) / (CMJ_DIM * CMJ_DIM));
-        Sampler_Init(&sampler, frame % (CMJ_DIM * CMJ_DIM), SAMPLE_DIM_SURFACE_OFFSET + bounce * SAMPLE_DIMS_PER_BOUNCE, scramble);
+        uint scramble = rnd * 0x1fe3434f * ((sample_index + 331 * rnd) / (CMJ_DIM * CMJ_DIM));
+        Sampler_Init(&sampler, sample_index % (CMJ_DIM * CMJ_DIM), SAMPLE_DIM_SURFACE_OFFSET + bounce * SAMPLE_DIMS_PER_BOUNCE, scramble);
 #endif
 
         // Fill surface data
@@ -367,10 +413,20 @@ KERNEL void ShadeSurface(
         float ngdotwi = dot(diffgeo.ng, wi);
         bool backfacing = ngdotwi < 0.f;
 
+        // Primary rays carry pixel spread angle, it is kept constant along the path
+        if (bounce == 0)
+        {
+            path->cone_spread = Ray_GetExtra(&rays[hit_idx]).y;
+        }
+
+        // Project ray cone onto the surface to get texture filter footprint
+        float cone_width = Path_PropagateCone(path, isect.uvwt.w);
+        diffgeo.uv_footprint = cone_width * diffgeo.uv_density / max(fabs(ngdotwi), 0.1f);
+
         // Select BxDF
 #ifdef ENABLE_UBERV2
         UberV2ShaderData uber_shader_data;
-        if (diffgeo.mat.type == kUberV2)
+        if (SHADE_IS_UBERV2(diffgeo.mat.type))
         {
             uber_shader_data = UberV2PrepareInputs(&diffgeo, input_map_values, TEXTURE_ARGS);
             GetMaterialBxDFType(wi, &sampler, SAMPLER_ARGS, &diffgeo, &uber_shader_data);
@@ -398,8 +454,13 @@ KERNEL void ShadeSurface(
                     float2 extra = Ray_GetExtra(&rays[hit_idx]);
                     float ld = isect.uvwt.w;
                     float denom = fabs(dot(diffgeo.n, wi)) * diffgeo.area;
-                    // TODO: num_lights should be num_emissies instead, presence of analytical lights breaks this code
-                    float bxdf_light_pdf = denom > 0.f ? (ld * ld / denom / num_lights) : 0.f;
+                    // Selection pdf is evaluated at the previous vertex the same way light sampling did there,
+                    // emissive primitives without area lights are never sampled directly
+                    int light_idx = LightBvh_FindAreaLight(light_distribution, isect.shapeid - 1, isect.primid);
+                    float selection_pdf = light_idx >= 0 ?
+                        Scene_GetLightPdfAt(&scene, light_idx, rays[hit_idx].o.xyz, DecodeOctahedralNormal(path->light_normal)) :
+                        0.f;
+                    float bxdf_light_pdf = denom > 0.f ? (ld * ld / denom * selection_pdf) : 0.f;
                     weight = extra.x > 0.f ? BalanceHeuristic(1, extra.x, 1, bxdf_light_pdf) : 1.f;
                 }
 
@@ -433,7 +494,7 @@ KERNEL void ShadeSurface(
         }
 
 #ifdef ENABLE_UBERV2
-        if (diffgeo.mat.type == kUberV2)
+        if (SHADE_IS_UBERV2(diffgeo.mat.type))
         {
             UberV2_ApplyShadingNormal(&diffgeo, &uber_shader_data);
         }
@@ -460,7 +521,12 @@ KERNEL void ShadeSurface(
         float bxdf_weight = 1.f;
         float light_weight = 1.f;
 
-        int light_idx = Scene_SampleLight(&scene, Sampler_Sample1D(&sampler, SAMPLER_ARGS), &selection_pdf);
+        // Both shadow and indirect rays start here, emissive hits of the next bounce
+        // evaluate light selection pdf at this point with the stored normal
+        float3 vertex_p = diffgeo.p + CRAZY_LOW_DISTANCE * s * diffgeo.ng;
+        path->light_normal = EncodeOctahedralNormal(diffgeo.n);
+
+        int light_idx = Scene_SampleLightAt(&scene, vertex_p, DecodeOctahedralNormal(path->light_normal), Sampler_Sample1D(&sampler, SAMPLER_ARGS), &selection_pdf);
 
         float3 throughput = Path_GetThroughput(path);
 
@@ -502,7 +568,7 @@ KERNEL void ShadeSurface(
         if (NON_BLACK(radiance))
         {
             // Generate shadow ray
-            float3 shadow_ray_o = diffgeo.p + CRAZY_LOW_DISTANCE * s * diffgeo.ng;
+            float3 shadow_ray_o = vertex_p;
             float3 temp = diffgeo.p + wo - shadow_ray_o;
             float3 shadow_ray_dir = normalize(temp);
             float shadow_ray_length = length(temp);
@@ -544,7 +610,7 @@ KERNEL void ShadeSurface(
 
             // Generate ray
             float3 indirect_ray_dir = bxdfwo;
-            float3 indirect_ray_o = diffgeo.p + CRAZY_LOW_DISTANCE * s * diffgeo.ng;
+            float3 indirect_ray_o = vertex_p;
             int indirect_ray_mask = VISIBILITY_MASK_BOUNCE(bounce + 1);
 
             Ray_Init(indirect_rays + global_id, indirect_ray_o, indirect_ray_dir, CRAZY_HIGH_DISTANCE, 0.f, indirect_ray_mask);
@@ -874,18 +940,22 @@ KERNEL void RestorePixelIndices(
     }
 }
 
-///< Restore pixel indices after compaction
+///< Convert intersection info to compaction predicates
 KERNEL void FilterPathStream(
     // Intersections
     GLOBAL Intersection const* restrict isects,
     // Number of compacted indices
     GLOBAL int const* restrict num_elements,
+    // Size of predicate buffers
+    int num_rays,
     // Pixel indices
     GLOBAL int const* restrict pixel_indices,
     // Paths
     GLOBAL Path* restrict paths,
     // Predicate
-    GLOBAL int* restrict predicate
+    GLOBAL int* restrict predicate,
+    // Inverse predicate (terminated paths)
+    GLOBAL int* restrict terminated
 )
 {
     int global_id = get_global_id(0);
@@ -915,6 +985,83 @@ KERNEL void FilterPathStream(
         {
             predicate[global_id] = 0;
         }
+
+        terminated[global_id] = 1 - predicate[global_id];
+    }
+    else if (global_id < num_rays)
+    {
+        // Clear the tail, compaction runs over the whole buffer
+        predicate[global_id] = 0;
+        terminated[global_id] = 0;
+    }
+}
+
+///< Compute material sort keys of compacted hits
+KERNEL void ComputeMaterialKeys(
+    // Intersection data
+    GLOBAL Intersection const* restrict isects,
+    // Hit indices
+    GLOBAL int const* restrict hit_indices,
+    // Number of hits
+    GLOBAL int const* restrict num_hits,
+    // Size of key buffer
+    int num_rays,
+    // Shapes
+    GLOBAL Shape const* restrict shapes,
+    // Materials
+    GLOBAL Material const* restrict materials,
+    // Sort keys
+    GLOBAL int* restrict keys
+)
+{
+    int global_id = get_global_id(0);
+
+    if (global_id < *num_hits)
+    {
+        int shape_idx = isects[hit_indices[global_id]].shapeid - 1;
+
+        // Volume scattering events carry a fake shape, put them first
+        if (shape_idx == FAKE_SHAPE_SENTINEL - 1)
+        {
+            keys[global_id] = 0;
+            return;
+        }
+
+        // Group by material class, then by material
+        int material_idx = shapes[shape_idx].material_idx;
+        int material_class = Material_GetClass(materials[material_idx].type);
+        keys[global_id] = ((material_class << 24) | (material_idx & 0xFFFFFF)) + 1;
+    }
+    else if (global_id < num_rays)
+    {
+        // Inactive lanes go last
+        keys[global_id] = INT_MAX;
+    }
+}
+
+///< Reorder compacted hits and their pixel indices
+KERNEL void ReorderHits(
+    // Sorted lane order
+    GLOBAL int const* restrict order,
+    // Number of hits
+    GLOBAL int const* restrict num_hits,
+    // Hit indices
+    GLOBAL int const* restrict hit_indices,
+    // Pixel indices
+    GLOBAL int const* restrict pixel_indices,
+    // Reordered hit indices
+    GLOBAL int* restrict sorted_hit_indices,
+    // Reordered pixel indices
+    GLOBAL int* restrict sorted_pixel_indices
+)
+{
+    int global_id = get_global_id(0);
+
+    if (global_id < *num_hits)
+    {
+        int lane = order[global_id];
+        sorted_hit_indices[global_id] = hit_indices[lane];
+        sorted_pixel_indices[global_id] = pixel_indices[lane];
     }
 }
 
@@ -930,6 +1077,8 @@ KERNEL void ShadeMiss(
     GLOBAL int const*  restrict output_indices,
     // Number of rays
     GLOBAL int const* restrict num_rays,
+    // Current pass
+    int pass,
     GLOBAL Light const* restrict lights,
     // Light distribution
     GLOBAL int const* restrict light_distribution,
@@ -960,8 +1109,11 @@ KERNEL void ShadeMiss(
 
             // Apply MIS
             int bxdf_flags = Path_GetBxdfFlags(path);
-            float selection_pdf = Distribution1D_GetPdfDiscreet(env_light_idx, light_distribution);
-            float light_pdf = EnvironmentLight_GetPdf(&light, 0, 0, bxdf_flags, kLightInteractionSurface, rays[global_id].d.xyz, TEXTURE_ARGS);
+            // Selection of infinite lights does not depend on the shading point
+            float selection_pdf = LightBvh_IsEnabled(light_distribution) ?
+                LightBvh_GetPdf(light_distribution, env_light_idx, (float3)(0.f), (float3)(0.f)) :
+                Distribution1D_GetPdfDiscreet(env_light_idx, light_distribution);
+            float light_pdf = EnvironmentLight_GetDirectionPdf(light_distribution, kLightInteractionSurface, rays[global_id].d.xyz);
             float2 extra = Ray_GetExtra(&rays[global_id]);
             float weight = extra.x > 0.f ? BalanceHeuristic(1, extra.x, 1, light_pdf * selection_pdf) : 1.f;
 
@@ -969,6 +1121,14 @@ KERNEL void ShadeMiss(
             float4 v = 0.f;
 
             int tex = EnvironmentLight_GetTexture(&light, bxdf_flags);
+
+            // Regenerated camera rays see the background
+            if (Path_GetBounce(path, pass) == 0)
+            {
+                tex = EnvironmentLight_GetBackgroundTexture(&light);
+                weight = 1.f;
+            }
+
             if (tex != -1)
             {
                 v.xyz = weight * light.multiplier * Texture_SampleEnvMap(rays[global_id].d.xyz, TEXTURE_ARGS_IDX(tex)) * t;
@@ -980,6 +1140,115 @@ KERNEL void ShadeMiss(
     }
 }
 
+///< Terminate paths out of bounces and restart finished ones with new camera rays
+KERNEL void RegeneratePaths(
+    // Number of paths alive after compaction
+    GLOBAL int const* restrict num_hits,
+    // Batch indices of terminated paths
+    GLOBAL int const* restrict terminated_indices,
+    // Pixel indices of the batch
+    GLOBAL int const* restrict prev_indices,
+    // Camera
+    GLOBAL Camera const* restrict camera,
+    // Camera type
+    int camera_type,
+    // Image resolution
+    int output_width,
+    int output_height,
+    // Image pixels camera rays of the batch go through
+    GLOBAL int const* restrict camera_pixel_indices,
+    // Output indices
+    GLOBAL int const* restrict output_indices,
+    // Batch size
+    int num_rays,
+    // Pass the next batch is traced at
+    int next_pass,
+    // Max number of bounces
+    int max_bounces,
+    // Restart terminated paths
+    int regenerate,
+    // Camera volume index
+    int world_volume_idx,
+    // RNG seed
+    uint rng_seed,
+    // Frame
+    int frame,
+    // Sampler states
+    GLOBAL uint* restrict random,
+    // Sobol matrices
+    GLOBAL uint const* restrict sobol_mat,
+    // Pixel indices of the next batch
+    GLOBAL int* restrict new_indices,
+    // Paths
+    GLOBAL Path* restrict paths,
+    // Next ray batch
+    GLOBAL ray* restrict rays,
+    // Output values
+    GLOBAL float4* restrict output
+)
+{
+    int global_id = get_global_id(0);
+    int num_alive = *num_hits;
+
+    if (global_id < num_alive)
+    {
+        GLOBAL Path* path = paths + new_indices[global_id];
+
+        // Regenerated paths finish later than the batch, cap their length here
+        if (Path_GetBounce(path, next_pass) >= max_bounces)
+        {
+            Path_Kill(path);
+            Ray_SetInactive(rays + global_id);
+        }
+    }
+    else if (regenerate && global_id < num_rays)
+    {
+        // Batch is full, so terminated paths fill up exactly the free tail
+        int pixel_idx = prev_indices[terminated_indices[global_id - num_alive]];
+        int output_index = output_indices[pixel_idx];
+
+        GLOBAL Path* path = paths + pixel_idx;
+
+        path->throughput = make_float3(1.f, 1.f, 1.f);
+        path->volume = world_volume_idx;
+        path->flags = 0;
+        path->start_pass = next_pass;
+        path->cone_width = 0.f;
+        path->cone_spread = 0.f;
+        path->sample += 1;
+
+        new_indices[global_id] = pixel_idx;
+
+        // Restarted path is a new sample of the pixel, so it takes the next sample index
+        // and the camera sample dimensions of its own
+        int camera_pixel = camera_pixel_indices[pixel_idx];
+        int x = camera_pixel % output_width;
+        int y = camera_pixel / output_width;
+        int sample_index = Path_GetSampleIndex(path, frame);
+
+        Sampler sampler;
+#if SAMPLER == SOBOL
+        uint scramble = random[camera_pixel] * 0x1fe3434f;
+        Sampler_Init(&sampler, sample_index, SAMPLE_DIM_CAMERA_OFFSET, scramble);
+#elif SAMPLER == OWEN_SOBOL
+        Sampler_Init(&sampler, sample_index, SAMPLE_DIM_CAMERA_OFFSET, random[camera_pixel]);
+#elif SAMPLER == RANDOM
+        uint scramble = camera_pixel * rng_seed;
+        Sampler_Init(&sampler, scramble);
+#elif SAMPLER == CMJ
+        uint rnd = random[camera_pixel];
+        uint scramble = rnd * 0x1fe3434f * ((sample_index + 133 * rnd) / (CMJ_DIM * CMJ_DIM));
+        Sampler_Init(&sampler, sample_index % (CMJ_DIM * CMJ_DIM), SAMPLE_DIM_CAMERA_OFFSET, scramble);
+#endif
+
+        Camera_GenerateRay(camera, camera_type, x, y, output_width, output_height, &sampler, SAMPLER_ARGS, rays + global_id);
+
+        // Each restarted path is one more sample of the pixel
+        float4 v = make_float4(0.f, 0.f, 0.f, 1.f);
+        ADD_FLOAT4(&output[output_index], v);
+    }
+}
+
 ///< Advance iteration count. Used on missed rays
 KERNEL void AdvanceIterationCount(
     // Pixel indices
@@ -1003,5 +1272,21 @@ KERNEL void AdvanceIterationCount(
     }
 }
 
+// Add the number of rays in a batch to a statistics counter
+KERNEL void AccumulateRayCount(
+    // Number of rays
+    GLOBAL int const* restrict num_rays,
+    // Counter to add to
+    int counter,
+    // Statistics counters
+    GLOBAL ulong* restrict counters
+)
+{
+    if (get_global_id(0) == 0)
+    {
+        counters[counter] += (ulong)(*num_rays);
+    }
+}
+
 #endif
 
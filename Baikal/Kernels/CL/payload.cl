@@ -76,8 +76,12 @@ typedef struct
     matrix4x4 transform;
     // unique shape id
     int id;
+    // Layout of shape vertex attributes (VertexFormat)
+    int vertex_format;
+    // Number of triangles
+    int num_prims;
     // Follow fields for 16 byte allign
-    int offset[3];
+    int offset;
 } Shape;
 
 typedef enum
@@ -105,6 +109,45 @@ typedef struct _InputMapData
     };
 } InputMapData;
 
+// Instructions of interpreted input maps. Each instruction starts with
+// int4 (op, dst, a, b) entry of InputMapData, where dst, a and b are
+// register indices, some of them are followed by extra entries.
+typedef enum
+{
+    kInputMapOpReturn = 0,      // return a
+    kInputMapOpConstant,        // dst = leaf a
+    kInputMapOpSampler,         // dst = sample texture of leaf a
+    kInputMapOpSamplerBumpmap,  // dst = sample bump map of leaf a
+    kInputMapOpAdd,
+    kInputMapOpSub,
+    kInputMapOpMul,
+    kInputMapOpDiv,
+    kInputMapOpMin,
+    kInputMapOpMax,
+    kInputMapOpPow,
+    kInputMapOpMod,
+    kInputMapOpDot3,
+    kInputMapOpDot4,
+    kInputMapOpCross3,
+    kInputMapOpCross4,
+    kInputMapOpSin,
+    kInputMapOpCos,
+    kInputMapOpTan,
+    kInputMapOpAsin,
+    kInputMapOpAcos,
+    kInputMapOpAtan,
+    kInputMapOpLength3,
+    kInputMapOpNormalize3,
+    kInputMapOpFloor,
+    kInputMapOpAbs,
+    kInputMapOpLerp,            // dst = mix(a, b, c), c is in the next entry
+    kInputMapOpSelect,          // dst = a[b], b is a component index
+    kInputMapOpShuffle,         // dst = shuffle(a, mask), mask is in the next entry
+    kInputMapOpShuffle2,        // dst = shuffle2(a, b, mask), mask is in the next entry
+    kInputMapOpMatMul,          // dst = matrix * a, matrix rows are in 4 next entries
+    kInputMapOpRemap            // dst = remap a from range b to range c, c is in the next entry
+} InputMapOp;
+
 enum Bxdf
 {
     kZero,
@@ -323,6 +366,17 @@ typedef struct _Volume
     TEXTURED_INPUT(sigma_e);
 } Volume;
 
+/// Vertex attribute layouts
+enum VertexFormat
+{
+    // float3 positions and normals, float2 UVs
+    VERTEX_FORMAT_FLOAT,
+    // Tightly packed float positions, octahedral 2x16 bit normals, half2 UVs
+    VERTEX_FORMAT_COMPACT,
+    // Same as VERTEX_FORMAT_COMPACT with float2 UVs, used if UVs are out of half precision range
+    VERTEX_FORMAT_COMPACT_FLOAT_UV
+};
+
 /// Supported formats
 enum TextureFormat
 {
@@ -344,7 +398,14 @@ struct _Texture
     int dataoffset;
     // Format
     int fmt;
-    int extra;
+    // Number of mip levels stored one after another starting at dataoffset
+    int num_levels;
+    // Streamed textures: byte offset of page table in texture data array
+    // and index of the first feedback entry (-1 otherwise)
+    int pagetable;
+    int feedback;
+    // Streamed textures: number of mip levels split into tiles, dataoffset holds the rest
+    int num_tiled_levels;
 } Texture;
 
 
@@ -363,6 +424,10 @@ typedef struct _DifferentialGeometry
     float3 dpdu;
     float3 dpdv;
     float  area;
+    // Square root of UV to world space area ratio of the triangle
+    float  uv_density;
+    // Texture space footprint of the sample (ray cone width), 0 disables filtering
+    float  uv_footprint;
 
     matrix4x4 world_to_tangent;
     matrix4x4 tangent_to_world;
@@ -0,0 +1,78 @@
+/**********************************************************************
+Copyright (c) 2017 Advanced Micro Devices, Inc. All rights reserved.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+********************************************************************/
+#ifndef SAMPLER_BENCHMARK_CL
+#define SAMPLER_BENCHMARK_CL
+
+#include <../Baikal/Kernels/CL/common.cl>
+#include <../Baikal/Kernels/CL/sampling.cl>
+
+// Estimate integrals of test functions over the unit square with 2D samples
+// taken at a given dimension, sampler is chosen with SAMPLER build option
+KERNEL void EstimateIntegrals(
+    // Number of independent estimates
+    int num_estimates,
+    // Number of samples per estimate
+    int num_samples,
+    // Sampler dimension
+    int dimension,
+    // Per estimate seeds
+    GLOBAL uint const* restrict random,
+    // Sobol matrices
+    GLOBAL uint const* restrict sobol_mat,
+    // Quarter disk indicator (pi / 4) and smooth bump (4 / pi^2) estimates
+    GLOBAL float2* restrict estimates
+)
+{
+    int global_id = get_global_id(0);
+
+    if (global_id < num_estimates)
+    {
+        float2 sum = 0.f;
+
+        for (int i = 0; i < num_samples; ++i)
+        {
+            Sampler sampler;
+#if SAMPLER == SOBOL
+            uint scramble = random[global_id] * 0x1fe3434f;
+            Sampler_Init(&sampler, i, dimension, scramble);
+#elif SAMPLER == OWEN_SOBOL
+            Sampler_Init(&sampler, i, dimension, random[global_id]);
+#elif SAMPLER == RANDOM
+            uint scramble = WangHash(random[global_id] + i);
+            Sampler_Init(&sampler, scramble);
+#elif SAMPLER == CMJ
+            uint rnd = random[global_id];
+            uint scramble = rnd * 0x1fe3434f * ((i + 331 * rnd) / (CMJ_DIM * CMJ_DIM));
+            Sampler_Init(&sampler, i % (CMJ_DIM * CMJ_DIM), dimension, scramble);
+#endif
+
+            float2 sample = Sampler_Sample2D(&sampler, SAMPLER_ARGS);
+
+            sum.x += (sample.x * sample.x + sample.y * sample.y < 1.f) ? 1.f : 0.f;
+            sum.y += sin(PI * sample.x) * sin(PI * sample.y);
+        }
+
+        estimates[global_id] = sum / (float)num_samples;
+    }
+}
+
+#endif
@@ -56,6 +56,9 @@ typedef struct _Sampler
 #elif SAMPLER == CMJ
 #define SAMPLER_ARG_LIST int unused
 #define SAMPLER_ARGS 0
+#elif SAMPLER == OWEN_SOBOL
+#define SAMPLER_ARG_LIST int unused
+#define SAMPLER_ARGS 0
 #endif
 
 /**
@@ -176,6 +179,97 @@ float2 CmjSampler_Sample2D(Sampler* sampler)
     return cmj(idx, CMJ_DIM, sampler->dimension * sampler->scramble);
 }
 
+/**
+    Owen scrambled Sobol sampler
+
+    Only the first two Sobol dimensions are used. Every 1D or 2D sample takes them
+    at its own shuffled sample index and scrambles the result, both with seeds
+    hashed from the per pixel scramble and the dimension (see "Practical Hash-based
+    Owen Scrambling", Burley 2020). Cost does not depend on the dimension, there is
+    no dimension limit and 2D samples keep (0,2)-sequence stratification.
+**/
+
+uint ReverseBits(uint x)
+{
+    x = (x << 16) | (x >> 16);
+    x = ((x & 0x00ff00ff) << 8) | ((x & 0xff00ff00) >> 8);
+    x = ((x & 0x0f0f0f0f) << 4) | ((x & 0xf0f0f0f0) >> 4);
+    x = ((x & 0x33333333) << 2) | ((x & 0xcccccccc) >> 2);
+    x = ((x & 0x55555555) << 1) | ((x & 0xaaaaaaaa) >> 1);
+    return x;
+}
+
+/// Random permutation of bit reversed value, each bit only depends on lower bits
+uint LaineKarrasPermutation(uint x, uint seed)
+{
+    x ^= x * 0x3d20adea;
+    x += seed;
+    x *= (seed >> 16) | 1;
+    x ^= x * 0x05526c56;
+    x ^= x * 0x53a22864;
+    return x;
+}
+
+/// Nested uniform (Owen) scramble, each bit is flipped depending on higher bits
+uint NestedUniformScramble(uint x, uint seed)
+{
+    return ReverseBits(LaineKarrasPermutation(ReverseBits(x), seed));
+}
+
+uint HashCombine(uint seed, uint value)
+{
+    return seed ^ (value + 0x9e3779b9 + (seed << 6) + (seed >> 2));
+}
+
+/// Second Sobol dimension, its direction numbers follow v[i + 1] = v[i] ^ (v[i] >> 1)
+uint Sobol_Dimension1(uint index)
+{
+    uint result = 0;
+
+    for (uint v = 1U << 31; index; index >>= 1, v ^= v >> 1)
+    {
+        if (index & 1)
+            result ^= v;
+    }
+
+    return result;
+}
+
+float OwenSobolSampler_ToFloat(uint value)
+{
+    // Keep 24 bits, so the result never rounds up to 1
+    return (value >> 8) * (1.f / (1U << 24));
+}
+
+/// Seed of a sample dimension for the pixel
+uint OwenSobolSampler_GetSeed(Sampler* sampler, uint dimension)
+{
+    return WangHash(HashCombine(sampler->scramble, dimension));
+}
+
+float OwenSobolSampler_Sample1D(Sampler* sampler)
+{
+    uint seed = OwenSobolSampler_GetSeed(sampler, sampler->dimension);
+    uint index = NestedUniformScramble(sampler->index, seed);
+
+    // First Sobol dimension is a bit reversal, so scrambling both is a single permutation
+    return OwenSobolSampler_ToFloat(ReverseBits(LaineKarrasPermutation(index, WangHash(seed))));
+}
+
+/// Occupies two dimensions like a 2D SOBOL sample: x is the 1D sample of the first one,
+/// y is scrambled with the seed of the second. Both share the index shuffled by the
+/// first dimension, which keeps the pair a (0,2)-sequence.
+float2 OwenSobolSampler_Sample2D(Sampler* sampler)
+{
+    uint seed = OwenSobolSampler_GetSeed(sampler, sampler->dimension);
+    uint index = NestedUniformScramble(sampler->index, seed);
+
+    uint x = ReverseBits(LaineKarrasPermutation(index, WangHash(seed)));
+    uint y = NestedUniformScramble(Sobol_Dimension1(index), WangHash(OwenSobolSampler_GetSeed(sampler, sampler->dimension + 1)));
+
+    return make_float2(OwenSobolSampler_ToFloat(x), OwenSobolSampler_ToFloat(y));
+}
+
 #if SAMPLER == SOBOL
 void Sampler_Init(Sampler* sampler, uint index, uint start_dimension, uint scramble)
 {
@@ -197,6 +291,15 @@ void Sampler_Init(Sampler* sampler, uint index, uint dimension, uint scramble)
     sampler->scramble = scramble;
     sampler->dimension = dimension;
 }
+#elif SAMPLER == OWEN_SOBOL
+// Seed is the per pixel random value, unlike SOBOL it is not rerandomized between
+// frames since sample indices stay stratified for any scramble
+void Sampler_Init(Sampler* sampler, uint index, uint start_dimension, uint seed)
+{
+    sampler->index = index;
+    sampler->scramble = seed * 0x1fe3434f;
+    sampler->dimension = start_dimension;
+}
 #endif
 
 
@@ -219,6 +322,10 @@ float2 Sampler_Sample2D(Sampler* sampler, SAMPLER_ARG_LIST)
     sample = CmjSampler_Sample2D(sampler);
     ++(sampler->dimension);
     return sample;
+#elif SAMPLER == OWEN_SOBOL
+    float2 sample = OwenSobolSampler_Sample2D(sampler);
+    sampler->dimension += 2;
+    return sample;
 #endif
 }
 
@@ -235,6 +342,10 @@ float Sampler_Sample1D(Sampler* sampler, SAMPLER_ARG_LIST)
     sample = CmjSampler_Sample2D(sampler);
     ++(sampler->dimension);
     return sample.x;
+#elif SAMPLER == OWEN_SOBOL
+    float sample = OwenSobolSampler_Sample1D(sampler);
+    ++(sampler->dimension);
+    return sample;
 #endif
 }
 
@@ -422,6 +533,19 @@ float Distribution1D_GetPdf(float s, GLOBAL int const* data)
     return pdf_data[segment_idx - 1];
 }
 
+/// PDF of 1D distribution at a given point of [0, 1) domain
+float Distribution1D_GetPdfAt(float x, GLOBAL int const* data)
+{
+    int num_segments = data[0];
+    GLOBAL float const* cdf_data = (GLOBAL float const*)&data[1];
+    GLOBAL float const* pdf_data = cdf_data + num_segments + 1;
+
+    int segment_idx = clamp((int)(x * num_segments), 0, num_segments - 1);
+
+    // Calc pdf
+    return pdf_data[segment_idx];
+}
+
 /// PDF of  1D distribution
 float Distribution1D_GetPdfDiscreet(int d, GLOBAL int const* data)
 {
@@ -25,6 +25,7 @@ THE SOFTWARE.
 #include <../Baikal/Kernels/CL/common.cl>
 #include <../Baikal/Kernels/CL/utils.cl>
 #include <../Baikal/Kernels/CL/payload.cl>
+#include <../Baikal/Kernels/CL/light_bvh.cl>
 
 typedef struct
 {
@@ -50,6 +51,65 @@ typedef struct
     GLOBAL int const* restrict light_distribution;
 } Scene;
 
+// Decode normal stored as two 16 bit snorm octahedral coordinates
+INLINE float3 DecodeOctahedralNormal(uint packed)
+{
+    float2 e = max((float2)((short)(packed & 0xFFFF), (short)(packed >> 16)) / 32767.f, -1.f);
+    float3 n = (float3)(e.x, e.y, 1.f - fabs(e.x) - fabs(e.y));
+    float t = max(-n.z, 0.f);
+    n.x += n.x >= 0.f ? -t : t;
+    n.y += n.y >= 0.f ? -t : t;
+    return normalize(n);
+}
+
+// Encode normal as two 16 bit snorm octahedral coordinates
+INLINE uint EncodeOctahedralNormal(float3 n)
+{
+    n /= fabs(n.x) + fabs(n.y) + fabs(n.z);
+    float2 e = n.z >= 0.f ? n.xy : (1.f - fabs(n.yx)) * (float2)(n.x >= 0.f ? 1.f : -1.f, n.y >= 0.f ? 1.f : -1.f);
+    int2 q = convert_int2_rte(clamp(e, -1.f, 1.f) * 32767.f);
+    return ((uint)q.x & 0xFFFF) | ((uint)q.y << 16);
+}
+
+// Fetch object space position of a shape vertex
+INLINE float3 Scene_GetVertexPosition(Scene const* scene, Shape const* shape, int i)
+{
+    int idx = shape->startvtx + i;
+
+    if (shape->vertex_format != VERTEX_FORMAT_FLOAT)
+    {
+        return vload3(idx, (GLOBAL float const*)scene->vertices);
+    }
+
+    return scene->vertices[idx];
+}
+
+// Fetch object space normal of a shape vertex
+INLINE float3 Scene_GetVertexNormal(Scene const* scene, Shape const* shape, int i)
+{
+    int idx = shape->startvtx + i;
+
+    if (shape->vertex_format != VERTEX_FORMAT_FLOAT)
+    {
+        return DecodeOctahedralNormal(((GLOBAL uint const*)scene->normals)[idx]);
+    }
+
+    return scene->normals[idx];
+}
+
+// Fetch UV of a shape vertex
+INLINE float2 Scene_GetVertexUV(Scene const* scene, Shape const* shape, int i)
+{
+    int idx = shape->startvtx + i;
+
+    if (shape->vertex_format == VERTEX_FORMAT_COMPACT)
+    {
+        return vload_half2(idx, (GLOBAL half const*)scene->uvs);
+    }
+
+    return scene->uvs[idx];
+}
+
 // Get triangle vertices given scene, shape index and prim index
 INLINE void Scene_GetTriangleVertices(Scene const* scene, int shape_idx, int prim_idx, float3* v0, float3* v1, float3* v2)
 {
@@ -62,9 +122,9 @@ INLINE void Scene_GetTriangleVertices(Scene const* scene, int shape_idx, int pri
     int i2 = scene->indices[shape.startidx + 3 * prim_idx + 2];
 
     // Fetch positions and transform to world space
-    *v0 = matrix_mul_point3(shape.transform, scene->vertices[shape.startvtx + i0]);
-    *v1 = matrix_mul_point3(shape.transform, scene->vertices[shape.startvtx + i1]);
-    *v2 = matrix_mul_point3(shape.transform, scene->vertices[shape.startvtx + i2]);
+    *v0 = matrix_mul_point3(shape.transform, Scene_GetVertexPosition(scene, &shape, i0));
+    *v1 = matrix_mul_point3(shape.transform, Scene_GetVertexPosition(scene, &shape, i1));
+    *v2 = matrix_mul_point3(shape.transform, Scene_GetVertexPosition(scene, &shape, i2));
 }
 
 // Get triangle uvs given scene, shape index and prim index
@@ -79,9 +139,9 @@ INLINE void Scene_GetTriangleUVs(Scene const* scene, int shape_idx, int prim_idx
     int i2 = scene->indices[shape.startidx + 3 * prim_idx + 2];
 
     // Fetch positions and transform to world space
-    *uv0 = scene->uvs[shape.startvtx + i0];
-    *uv1 = scene->uvs[shape.startvtx + i1];
-    *uv2 = scene->uvs[shape.startvtx + i2];
+    *uv0 = Scene_GetVertexUV(scene, &shape, i0);
+    *uv1 = Scene_GetVertexUV(scene, &shape, i1);
+    *uv2 = Scene_GetVertexUV(scene, &shape, i2);
 }
 
 
@@ -97,19 +157,19 @@ INLINE void Scene_InterpolateAttributes(Scene const* scene, int shape_idx, int p
     int i2 = scene->indices[shape.startidx + 3 * prim_idx + 2];
 
     // Fetch normals
-    float3 n0 = scene->normals[shape.startvtx + i0];
-    float3 n1 = scene->normals[shape.startvtx + i1];
-    float3 n2 = scene->normals[shape.startvtx + i2];
+    float3 n0 = Scene_GetVertexNormal(scene, &shape, i0);
+    float3 n1 = Scene_GetVertexNormal(scene, &shape, i1);
+    float3 n2 = Scene_GetVertexNormal(scene, &shape, i2);
 
     // Fetch positions and transform to world space
-    float3 v0 = matrix_mul_point3(shape.transform, scene->vertices[shape.startvtx + i0]);
-    float3 v1 = matrix_mul_point3(shape.transform, scene->vertices[shape.startvtx + i1]);
-    float3 v2 = matrix_mul_point3(shape.transform, scene->vertices[shape.startvtx + i2]);
+    float3 v0 = matrix_mul_point3(shape.transform, Scene_GetVertexPosition(scene, &shape, i0));
+    float3 v1 = matrix_mul_point3(shape.transform, Scene_GetVertexPosition(scene, &shape, i1));
+    float3 v2 = matrix_mul_point3(shape.transform, Scene_GetVertexPosition(scene, &shape, i2));
 
     // Fetch UVs
-    float2 uv0 = scene->uvs[shape.startvtx + i0];
-    float2 uv1 = scene->uvs[shape.startvtx + i1];
-    float2 uv2 = scene->uvs[shape.startvtx + i2];
+    float2 uv0 = Scene_GetVertexUV(scene, &shape, i0);
+    float2 uv1 = Scene_GetVertexUV(scene, &shape, i1);
+    float2 uv2 = Scene_GetVertexUV(scene, &shape, i2);
 
     // Calculate barycentric position and normal
     *p = (1.f - barycentrics.x - barycentrics.y) * v0 + barycentrics.x * v1 + barycentrics.y * v2;
@@ -130,9 +190,9 @@ INLINE void Scene_InterpolateVertices(Scene const* scene, int shape_idx, int pri
     int i2 = scene->indices[shape.startidx + 3 * prim_idx + 2];
 
     // Fetch positions and transform to world space
-    float3 v0 = matrix_mul_point3(shape.transform, scene->vertices[shape.startvtx + i0]);
-    float3 v1 = matrix_mul_point3(shape.transform, scene->vertices[shape.startvtx + i1]);
-    float3 v2 = matrix_mul_point3(shape.transform, scene->vertices[shape.startvtx + i2]);
+    float3 v0 = matrix_mul_point3(shape.transform, Scene_GetVertexPosition(scene, &shape, i0));
+    float3 v1 = matrix_mul_point3(shape.transform, Scene_GetVertexPosition(scene, &shape, i1));
+    float3 v2 = matrix_mul_point3(shape.transform, Scene_GetVertexPosition(scene, &shape, i2));
 
     // Calculate barycentric position and normal
     *p = (1.f - barycentrics.x - barycentrics.y) * v0 + barycentrics.x * v1 + barycentrics.y * v2;
@@ -154,9 +214,9 @@ INLINE void Scene_InterpolateVerticesFromIntersection(Scene const* scene, Inters
     int i2 = scene->indices[shape.startidx + 3 * prim_idx + 2];
 
     // Fetch positions and transform to world space
-    float3 v0 = matrix_mul_point3(shape.transform, scene->vertices[shape.startvtx + i0]);
-    float3 v1 = matrix_mul_point3(shape.transform, scene->vertices[shape.startvtx + i1]);
-    float3 v2 = matrix_mul_point3(shape.transform, scene->vertices[shape.startvtx + i2]);
+    float3 v0 = matrix_mul_point3(shape.transform, Scene_GetVertexPosition(scene, &shape, i0));
+    float3 v1 = matrix_mul_point3(shape.transform, Scene_GetVertexPosition(scene, &shape, i1));
+    float3 v2 = matrix_mul_point3(shape.transform, Scene_GetVertexPosition(scene, &shape, i2));
 
     // Calculate barycentric position and normal
     *p = (1.f - barycentrics.x - barycentrics.y) * v0 + barycentrics.x * v1 + barycentrics.y * v2;
@@ -178,9 +238,9 @@ INLINE void Scene_InterpolateNormalsFromIntersection(Scene const* scene, Interse
     int i2 = scene->indices[shape.startidx + 3 * prim_idx + 2];
 
     // Fetch normals
-    float3 n0 = scene->normals[shape.startvtx + i0];
-    float3 n1 = scene->normals[shape.startvtx + i1];
-    float3 n2 = scene->normals[shape.startvtx + i2];
+    float3 n0 = Scene_GetVertexNormal(scene, &shape, i0);
+    float3 n1 = Scene_GetVertexNormal(scene, &shape, i1);
+    float3 n2 = Scene_GetVertexNormal(scene, &shape, i2);
 
     // Calculate barycentric position and normal
     *n = normalize(matrix_mul_vector3(shape.transform, (1.f - barycentrics.x - barycentrics.y) * n0 + barycentrics.x * n1 + barycentrics.y * n2));
@@ -263,6 +323,12 @@ void Scene_FillDifferentialGeometry(// Scene
     float3 dp2 = v1 - v2;
     float det = du1 * dv2 - dv1 * du2;
 
+    // Texel density used to convert ray cone width into texture space,
+    // footprint is left for the caller to fill in
+    float world_area = length(cross(dp1, dp2));
+    diffgeo->uv_density = world_area > 0.f ? sqrt(fabs(det) / world_area) : 0.f;
+    diffgeo->uv_footprint = 0.f;
+
     if (0 && det != 0.f)
     {
         float invdet = 1.f / det;
@@ -319,4 +385,31 @@ INLINE int Scene_SampleLight(Scene const* scene, float sample, float* pdf)
 #endif
 }
 
+// Sample light index taking into account its contribution at point p,
+// zero normal means the point has no orientation (volume scattering)
+INLINE int Scene_SampleLightAt(Scene const* scene, float3 p, float3 n, float sample, float* pdf)
+{
+    if (LightBvh_IsEnabled(scene->light_distribution))
+    {
+        return LightBvh_Sample(scene->light_distribution, p, n, sample, pdf);
+    }
+
+    return Scene_SampleLight(scene, sample, pdf);
+}
+
+// Probability of Scene_SampleLightAt to select a given light at point p
+INLINE float Scene_GetLightPdfAt(Scene const* scene, int light_idx, float3 p, float3 n)
+{
+    if (LightBvh_IsEnabled(scene->light_distribution))
+    {
+        return LightBvh_GetPdf(scene->light_distribution, light_idx, p, n);
+    }
+
+#ifndef POWER_SAMPLING
+    return 1.f / scene->num_lights;
+#else
+    return Distribution1D_GetPdfDiscreet(light_idx, scene->light_distribution);
+#endif
+}
+
 #endif
@@ -28,22 +28,47 @@ THE SOFTWARE.
 
 
 /// To simplify a bit
-#define TEXTURE_ARG_LIST __global Texture const* textures, __global char const* texturedata
-#define TEXTURE_ARG_LIST_IDX(x) int x, __global Texture const* textures, __global char const* texturedata
-#define TEXTURE_ARGS textures, texturedata
-#define TEXTURE_ARGS_IDX(x) x, textures, texturedata
+#define TEXTURE_ARG_LIST __global Texture const* textures, __global char const* texturedata, __global int* texturefeedback
+#define TEXTURE_ARG_LIST_IDX(x) int x, __global Texture const* textures, __global char const* texturedata, __global int* texturefeedback
+#define TEXTURE_ARGS textures, texturedata, texturefeedback
+#define TEXTURE_ARGS_IDX(x) x, textures, texturedata, texturefeedback
 
-/// Sample 2D texture
+/// Tile size of streamed textures, has to match ClwTextureStreamer::kTileSize
+#define TEXTURE_TILE_SIZE 64
+
+/// Read a single texel of texture data
 inline
-float4 Texture_Sample2D(float2 uv, TEXTURE_ARG_LIST_IDX(texidx))
+float4 TextureData_LoadTexel(__global char const* data, int fmt, int idx)
 {
-    // Get width and height
-    int width = textures[texidx].w;
-    int height = textures[texidx].h;
+    switch (fmt)
+    {
+        case RGBA32:
+        {
+            return *((__global float4 const*)data + idx);
+        }
 
-    // Find the origin of the data in the pool
-    __global char const* mydata = texturedata + textures[texidx].dataoffset;
+        case RGBA16:
+        {
+            return vload_half4(idx, (__global half const*)data);
+        }
 
+        case RGBA8:
+        {
+            uchar4 valu = *((__global uchar4 const*)data + idx);
+            return make_float4((float)valu.x / 255.f, (float)valu.y / 255.f, (float)valu.z / 255.f, (float)valu.w / 255.f);
+        }
+
+        default:
+        {
+            return make_float4(0.f, 0.f, 0.f, 0.f);
+        }
+    }
+}
+
+/// Sample 2D texture data of given dimensions and format
+inline
+float4 TextureData_Sample2D(float2 uv, __global char const* mydata, int width, int height, int fmt)
+{
     // Handle UV wrap
     // TODO: need UV mode support
     uv -= floor(uv);
@@ -65,7 +90,7 @@ float4 Texture_Sample2D(float2 uv, TEXTURE_ARG_LIST_IDX(texidx))
     float wx = uv.x * width - floor(uv.x * width);
     float wy = uv.y * height - floor(uv.y * height);
 
-    switch (textures[texidx].fmt)
+    switch (fmt)
     {
         case RGBA32:
         {
@@ -121,6 +146,158 @@ float4 Texture_Sample2D(float2 uv, TEXTURE_ARG_LIST_IDX(texidx))
     }
 }
 
+/// Find the tile holding texel (x, y) of a tiled mip level of a streamed texture.
+/// Marks the page as used, returns 0 if the tile is not resident.
+inline
+__global char const* Texture_GetTile(int x, int y, int level, TEXTURE_ARG_LIST_IDX(texidx))
+{
+    int width = textures[texidx].w;
+    int height = textures[texidx].h;
+    int page = 0;
+
+    // Pages of all the tiled levels follow each other
+    for (int i = 0; i < level; ++i)
+    {
+        page += ((width + TEXTURE_TILE_SIZE - 1) / TEXTURE_TILE_SIZE) * ((height + TEXTURE_TILE_SIZE - 1) / TEXTURE_TILE_SIZE);
+        width = max(width / 2, 1);
+        height = max(height / 2, 1);
+    }
+
+    page += (y / TEXTURE_TILE_SIZE) * ((width + TEXTURE_TILE_SIZE - 1) / TEXTURE_TILE_SIZE) + x / TEXTURE_TILE_SIZE;
+
+    // Host reads usage back to keep used tiles resident and load missing ones
+    __global int* feedback = texturefeedback + textures[texidx].feedback;
+    if (!feedback[page])
+    {
+        feedback[page] = 1;
+    }
+
+    int offset = ((__global int const*)(texturedata + textures[texidx].pagetable))[page];
+    return offset >= 0 ? texturedata + offset : 0;
+}
+
+/// Sample tiled mip level of a streamed texture, returns false if any of the tiles is not resident
+inline
+bool Texture_SampleTiled2D(float2 uv, int level, TEXTURE_ARG_LIST_IDX(texidx), float4* value)
+{
+    int width = max(textures[texidx].w >> level, 1);
+    int height = max(textures[texidx].h >> level, 1);
+    int fmt = textures[texidx].fmt;
+
+    // Handle UV wrap and reverse Y the same way as for resident textures
+    uv -= floor(uv);
+    uv.y = 1.f - uv.y;
+
+    int x0 = clamp((int)floor(uv.x * width), 0, width - 1);
+    int y0 = clamp((int)floor(uv.y * height), 0, height - 1);
+    int x1 = clamp(x0 + 1, 0, width - 1);
+    int y1 = clamp(y0 + 1, 0, height - 1);
+
+    float wx = uv.x * width - floor(uv.x * width);
+    float wy = uv.y * height - floor(uv.y * height);
+
+    // Filter footprint might span up to 4 tiles
+    __global char const* tile00 = Texture_GetTile(x0, y0, level, TEXTURE_ARGS_IDX(texidx));
+    __global char const* tile01 = Texture_GetTile(x1, y0, level, TEXTURE_ARGS_IDX(texidx));
+    __global char const* tile10 = Texture_GetTile(x0, y1, level, TEXTURE_ARGS_IDX(texidx));
+    __global char const* tile11 = Texture_GetTile(x1, y1, level, TEXTURE_ARGS_IDX(texidx));
+
+    if (!tile00 || !tile01 || !tile10 || !tile11)
+    {
+        return false;
+    }
+
+    int tx0 = x0 % TEXTURE_TILE_SIZE;
+    int ty0 = (y0 % TEXTURE_TILE_SIZE) * TEXTURE_TILE_SIZE;
+    int tx1 = x1 % TEXTURE_TILE_SIZE;
+    int ty1 = (y1 % TEXTURE_TILE_SIZE) * TEXTURE_TILE_SIZE;
+
+    float4 val00 = TextureData_LoadTexel(tile00, fmt, ty0 + tx0);
+    float4 val01 = TextureData_LoadTexel(tile01, fmt, ty0 + tx1);
+    float4 val10 = TextureData_LoadTexel(tile10, fmt, ty1 + tx0);
+    float4 val11 = TextureData_LoadTexel(tile11, fmt, ty1 + tx1);
+
+    *value = lerp(lerp(val00, val01, wx), lerp(val10, val11, wx), wy);
+    return true;
+}
+
+/// Sample given mip level of 2D texture
+inline
+float4 Texture_SampleLevel2D(float2 uv, int level, TEXTURE_ARG_LIST_IDX(texidx))
+{
+    // Get width and height
+    int width = textures[texidx].w;
+    int height = textures[texidx].h;
+    int first_level = 0;
+
+    // Streamed textures only keep the levels past the tiled ones in the pool,
+    // the top resident level is used while the tiles are being loaded
+    if (textures[texidx].pagetable >= 0)
+    {
+        float4 value;
+        first_level = textures[texidx].num_tiled_levels;
+
+        if (level < first_level && Texture_SampleTiled2D(uv, level, TEXTURE_ARGS_IDX(texidx), &value))
+        {
+            return value;
+        }
+
+        level = max(level, first_level);
+        width = max(width >> first_level, 1);
+        height = max(height >> first_level, 1);
+    }
+
+    // Find the origin of the data in the pool
+    __global char const* mydata = texturedata + textures[texidx].dataoffset;
+
+    // Mip levels are stored one after another, skip the preceding ones
+    int texel_size = textures[texidx].fmt == RGBA32 ? 16 : (textures[texidx].fmt == RGBA16 ? 8 : 4);
+    for (int i = first_level; i < level; ++i)
+    {
+        mydata += texel_size * width * height;
+        width = max(width / 2, 1);
+        height = max(height / 2, 1);
+    }
+
+    return TextureData_Sample2D(uv, mydata, width, height, textures[texidx].fmt);
+}
+
+/// Sample 2D texture (top mip level)
+inline
+float4 Texture_Sample2D(float2 uv, TEXTURE_ARG_LIST_IDX(texidx))
+{
+    return Texture_SampleLevel2D(uv, 0, TEXTURE_ARGS_IDX(texidx));
+}
+
+/// Sample 2D texture with trilinear filtering,
+/// mip level is selected based on texture space footprint of a sample
+inline
+float4 Texture_SampleFiltered2D(float2 uv, float footprint, TEXTURE_ARG_LIST_IDX(texidx))
+{
+    int num_levels = textures[texidx].num_levels;
+
+    if (footprint <= 0.f || num_levels <= 1)
+    {
+        return Texture_SampleLevel2D(uv, 0, TEXTURE_ARGS_IDX(texidx));
+    }
+
+    // Footprint in texels of the top level
+    float texels = footprint * max(textures[texidx].w, textures[texidx].h);
+    float lod = clamp(log2(max(texels, 1.f)), 0.f, (float)(num_levels - 1));
+
+    int level = (int)floor(lod);
+    float t = lod - level;
+
+    float4 value = Texture_SampleLevel2D(uv, level, TEXTURE_ARGS_IDX(texidx));
+
+    if (t > 0.f && level + 1 < num_levels)
+    {
+        value = lerp(value, Texture_SampleLevel2D(uv, level + 1, TEXTURE_ARGS_IDX(texidx)), t);
+    }
+
+    return value;
+}
+
 /// Sample lattitue-longitude environment map using 3d vector
 inline
 float3 Texture_SampleEnvMap(float3 d, TEXTURE_ARG_LIST_IDX(texidx))
@@ -145,6 +322,8 @@ float3 Texture_GetValue3f(
                 float3 v,
                 // Texture coordinate
                 float2 uv,
+                // Texture space footprint for filtering (0 samples top level)
+                float footprint,
                 // Texture args
                 TEXTURE_ARG_LIST_IDX(texidx)
                 )
@@ -153,7 +332,7 @@ float3 Texture_GetValue3f(
     if (texidx != -1)
     {
         // Sample texture
-        return native_powr(Texture_Sample2D(uv, TEXTURE_ARGS_IDX(texidx)).xyz, 2.2f);
+        return native_powr(Texture_SampleFiltered2D(uv, footprint, TEXTURE_ARGS_IDX(texidx)).xyz, 2.2f);
     }
 
     // Return fixed color otherwise
@@ -167,6 +346,8 @@ float4 Texture_GetValue4f(
                 float4 v,
                 // Texture coordinate
                 float2 uv,
+                // Texture space footprint for filtering (0 samples top level)
+                float footprint,
                 // Texture args
                 TEXTURE_ARG_LIST_IDX(texidx)
                 )
@@ -175,7 +356,7 @@ float4 Texture_GetValue4f(
     if (texidx != -1)
     {
         // Sample texture
-        return native_powr(Texture_Sample2D(uv, TEXTURE_ARGS_IDX(texidx)), 2.2f);
+        return native_powr(Texture_SampleFiltered2D(uv, footprint, TEXTURE_ARGS_IDX(texidx)), 2.2f);
     }
 
     // Return fixed color otherwise
@@ -189,6 +370,8 @@ float Texture_GetValue1f(
                         float v,
                         // Texture coordinate
                         float2 uv,
+                        // Texture space footprint for filtering (0 samples top level)
+                        float footprint,
                         // Texture args
                         TEXTURE_ARG_LIST_IDX(texidx)
                         )
@@ -197,7 +380,7 @@ float Texture_GetValue1f(
     if (texidx != -1)
     {
         // Sample texture
-        return Texture_Sample2D(uv, TEXTURE_ARGS_IDX(texidx)).x;
+        return Texture_SampleFiltered2D(uv, footprint, TEXTURE_ARGS_IDX(texidx)).x;
     }
 
     // Return fixed color otherwise
@@ -298,6 +481,13 @@ float3 Texture_SampleBump(float2 uv, TEXTURE_ARG_LIST_IDX(texidx))
     int width = textures[texidx].w;
     int height = textures[texidx].h;
 
+    // Streamed textures only have their mip tail in the pool
+    if (textures[texidx].pagetable >= 0)
+    {
+        width = max(width >> textures[texidx].num_tiled_levels, 1);
+        height = max(height >> textures[texidx].num_tiled_levels, 1);
+    }
+
     // Find the origin of the data in the pool
     __global char const* mydata = texturedata + textures[texidx].dataoffset;
 
@@ -157,8 +157,8 @@ KERNEL void SampleVolume(
     GLOBAL uint* random,
     // Sobol matrices
     GLOBAL uint const* sobol_mat,
-    // Current bounce 
-    int bounce,
+    // Current pass
+    int pass,
     // Current frame
     int frame,
     // Intersection data
@@ -188,17 +188,23 @@ KERNEL void SampleVolume(
         // Check if we are inside some volume
         if (volidx != -1)
         {
+            // Regenerated paths start at a later pass and sample a later index
+            int bounce = Path_GetBounce(path, pass);
+            int sample_index = Path_GetSampleIndex(path, frame);
+
             Sampler sampler;
 #if SAMPLER == SOBOL
             uint scramble = random[pixelidx] * 0x1fe3434f;
-            Sampler_Init(&sampler, frame, SAMPLE_DIM_SURFACE_OFFSET + bounce * SAMPLE_DIMS_PER_BOUNCE + SAMPLE_DIM_VOLUME_APPLY_OFFSET, scramble);
+            Sampler_Init(&sampler, sample_index, SAMPLE_DIM_SURFACE_OFFSET + bounce * SAMPLE_DIMS_PER_BOUNCE + SAMPLE_DIM_VOLUME_APPLY_OFFSET, scramble);
+#elif SAMPLER == OWEN_SOBOL
+            Sampler_Init(&sampler, sample_index, SAMPLE_DIM_SURFACE_OFFSET + bounce * SAMPLE_DIMS_PER_BOUNCE + SAMPLE_DIM_VOLUME_APPLY_OFFSET, random[pixelidx]);
 #elif SAMPLER == RANDOM
             uint scramble = pixelidx * rngseed;
             Sampler_Init(&sampler, scramble);
 #elif SAMPLER == CMJ
             uint rnd = random[pixelidx];
-            uint scramble = rnd * 0x1fe3434f * ((frame + 71 * rnd) / (CMJ_DIM * CMJ_DIM));
-            Sampler_Init(&sampler, frame % (CMJ_DIM * CMJ_DIM), SAMPLE_DIM_SURFACE_OFFSET + bounce * SAMPLE_DIMS_PER_BOUNCE + SAMPLE_DIM_VOLUME_APPLY_OFFSET, scramble);
+            uint scramble = rnd * 0x1fe3434f * ((sample_index + 71 * rnd) / (CMJ_DIM * CMJ_DIM));
+            Sampler_Init(&sampler, sample_index % (CMJ_DIM * CMJ_DIM), SAMPLE_DIM_SURFACE_OFFSET + bounce * SAMPLE_DIMS_PER_BOUNCE + SAMPLE_DIM_VOLUME_APPLY_OFFSET, scramble);
 #endif
 
             // Try sampling volume for a next scattering event
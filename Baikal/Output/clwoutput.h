@@ -1,8 +1,11 @@
 #pragma once
 
 #include "output.h"
+#include "clwreadback.h"
 #include "CLW.h"
 
+#include <memory>
+
 namespace Baikal
 {
     class ClwOutput : public Output
@@ -30,6 +33,17 @@ namespace Baikal
                 elems_count).Wait();
         }
 
+        std::future<void> GetDataAsync(RadeonRays::float3* data) const
+        {
+            // Pinned staging memory is only allocated for outputs read asynchronously
+            if (!m_readback)
+            {
+                m_readback.reset(new ClwReadbackRing<RadeonRays::float3>(m_context, m_data.GetElementCount()));
+            }
+
+            return m_readback->Read(m_data, data, 0, m_data.GetElementCount());
+        }
+
         void Clear(RadeonRays::float3 const& val)
         {
             m_context.FillBuffer(0, m_data, val, m_data.GetElementCount()).Wait();
@@ -40,5 +54,6 @@ namespace Baikal
     private:
         CLWBuffer<RadeonRays::float3> m_data;
         CLWContext m_context;
+        mutable std::unique_ptr<ClwReadbackRing<RadeonRays::float3>> m_readback;
     };
 }
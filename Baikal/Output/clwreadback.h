@@ -0,0 +1,119 @@
+#pragma once
+
+#include "CLW.h"
+
+#include <cstdint>
+#include <cstring>
+#include <future>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+namespace Baikal
+{
+    /**
+     \brief Ring of pinned host staging buffers for asynchronous readback.
+
+     Read enqueues a device copy into the next staging buffer and maps it without
+     blocking. Data lands in the destination when the returned future is waited on,
+     so the transfer overlaps with the work submitted in between. If a slot is needed
+     again before its future has been waited on, the earlier readback is completed into
+     its destination first. Destinations have to stay valid and futures have to be
+     waited on before the ring is destroyed.
+     */
+    template <typename T>
+    class ClwReadbackRing
+    {
+    public:
+        ClwReadbackRing(CLWContext context, std::size_t size, std::size_t num_slots = 2)
+        : m_context(context)
+        , m_slots(num_slots)
+        , m_next(0)
+        {
+            for (auto& slot : m_slots)
+            {
+                slot.staging = context.CreateBuffer<T>(size, CL_MEM_READ_WRITE | CL_MEM_ALLOC_HOST_PTR);
+            }
+        }
+
+        ~ClwReadbackRing()
+        {
+            for (auto& slot : m_slots)
+            {
+                Release(slot);
+            }
+        }
+
+        ClwReadbackRing(ClwReadbackRing const&) = delete;
+        ClwReadbackRing& operator = (ClwReadbackRing const&) = delete;
+
+        // Start reading count elements at offset of a buffer into data
+        std::future<void> Read(CLWBuffer<T> buffer, T* data, std::size_t offset, std::size_t count)
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+
+            auto& slot = m_slots[m_next];
+            m_next = (m_next + 1) % m_slots.size();
+
+            // Nobody waited for the previous readback of this slot yet, finish it before reuse
+            Complete(slot);
+
+            m_context.CopyBuffer(0, buffer, slot.staging, offset, 0, count);
+            slot.event = m_context.MapBuffer(0, slot.staging, CL_MAP_READ, &slot.mapped);
+            slot.destination = data;
+            slot.count = count;
+
+            auto generation = ++slot.generation;
+
+            return std::async(std::launch::deferred, [this, &slot, generation]()
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+
+                // Otherwise the readback has been completed when the slot was reused
+                if (slot.generation == generation)
+                {
+                    Complete(slot);
+                }
+            });
+        }
+
+    private:
+        struct Slot
+        {
+            CLWBuffer<T> staging;
+            CLWEvent event;
+            T* mapped = nullptr;
+            // Destination of the readback in flight
+            T* destination = nullptr;
+            std::size_t count = 0;
+            std::uint64_t generation = 0;
+        };
+
+        // Copy readback in flight into its destination and release the slot
+        void Complete(Slot& slot)
+        {
+            if (slot.mapped)
+            {
+                slot.event.Wait();
+                std::memcpy(slot.destination, slot.mapped, slot.count * sizeof(T));
+                Release(slot);
+            }
+        }
+
+        void Release(Slot& slot)
+        {
+            if (slot.mapped)
+            {
+                slot.event.Wait();
+                m_context.UnmapBuffer(0, slot.staging, slot.mapped);
+                slot.mapped = nullptr;
+                slot.destination = nullptr;
+            }
+        }
+
+        CLWContext m_context;
+        std::vector<Slot> m_slots;
+        std::size_t m_next;
+        std::mutex m_mutex;
+    };
+}
@@ -32,6 +32,7 @@
 #include "math/float3.h"
 
 #include <cstdint>
+#include <future>
 
 namespace Baikal
 {
@@ -66,6 +67,15 @@ namespace Baikal
         virtual void GetData(RadeonRays::float3* data) const = 0;
         virtual void GetData(RadeonRays::float3* data, /* offset in elems */ size_t offset, /* read elems */size_t elems_count) const = 0;
 
+        /**
+         \brief Start reading surface data without blocking.
+
+         Data is written once the returned future is waited on, or earlier if
+         later reads need its staging slot. The destination has to stay valid
+         until then, and futures should be waited on before the output is destroyed.
+         */
+        virtual std::future<void> GetDataAsync(RadeonRays::float3* data) const = 0;
+
         // Get surface width
         std::uint32_t width() const;
         // Get surface height
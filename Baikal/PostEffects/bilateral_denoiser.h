@@ -114,7 +114,7 @@ namespace Baikal
             size_t gs[] = { static_cast<size_t>((output.width() + 7) / 8 * 8), static_cast<size_t>((output.height() + 7) / 8 * 8) };
             size_t ls[] = { 8, 8 };
 
-            GetContext().Launch2D(0, gs, ls, denoise_kernel);
+            Launch2D("BilateralDenoise_main", gs, ls, denoise_kernel);
         }
     }
 
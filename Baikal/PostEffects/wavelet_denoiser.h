@@ -324,7 +324,7 @@ namespace Baikal
                 size_t gs[] = { static_cast<size_t>((output.width() + 7) / 8 * 8), static_cast<size_t>((output.height() + 7) / 8 * 8) };
                 size_t ls[] = { 8, 8 };
 
-                GetContext().Launch2D(0, gs, ls, copy_buffers_kernel);
+                Launch2D("CopyBuffers_main", gs, ls, copy_buffers_kernel);
             }
         }
 
@@ -347,7 +347,7 @@ namespace Baikal
                 size_t gs[] = { static_cast<size_t>((output.width() + 7) / 8 * 8), static_cast<size_t>((output.height() + 7) / 8 * 8) };
                 size_t ls[] = { 8, 8 };
 
-                GetContext().Launch2D(0, gs, ls, generate_motion_kernel);
+                Launch2D("WaveletGenerateMotionBuffer_main", gs, ls, generate_motion_kernel);
             }
         }
 
@@ -377,7 +377,7 @@ namespace Baikal
                 size_t gs[] = { static_cast<size_t>((output.width() + 7) / 8 * 8), static_cast<size_t>((output.height() + 7) / 8 * 8) };
                 size_t ls[] = { 8, 8 };
 
-                GetContext().Launch2D(0, gs, ls, accumulation_kernel);
+                Launch2D("TemporalAccumulation_main", gs, ls, accumulation_kernel);
             }
         }
 
@@ -397,7 +397,7 @@ namespace Baikal
                 size_t gs[] = { static_cast<size_t>((output.width() + 7) / 8 * 8), static_cast<size_t>((output.height() + 7) / 8 * 8) };
                 size_t ls[] = { 8, 8 };
 
-                GetContext().Launch2D(0, gs, ls, copy_buffer_kernel);
+                Launch2D("CopyBuffer_main", gs, ls, copy_buffer_kernel);
             }
         }
 
@@ -449,7 +449,7 @@ namespace Baikal
                     size_t gs[] = { static_cast<size_t>((output.width() + 7) / 8 * 8), static_cast<size_t>((output.height() + 7) / 8 * 8) };
                     size_t ls[] = { 8, 8 };
 
-                    GetContext().Launch2D(0, gs, ls, filter_kernel);
+                    Launch2D("WaveletFilter_main", gs, ls, filter_kernel);
                 }
 
                 argc = 0;
@@ -466,7 +466,7 @@ namespace Baikal
                     size_t gs[] = { static_cast<size_t>((output.width() + 7) / 8 * 8), static_cast<size_t>((output.height() + 7) / 8 * 8) };
                     size_t ls[] = { 8, 8 };
 
-                    GetContext().Launch2D(0, gs, ls, update_variance_kernel);
+                    Launch2D("UpdateVariance_main", gs, ls, update_variance_kernel);
                 }
             }
 
@@ -484,7 +484,7 @@ namespace Baikal
                 size_t gs[] = { static_cast<size_t>((output.width() + 7) / 8 * 8), static_cast<size_t>((output.height() + 7) / 8 * 8) };
                 size_t ls[] = { 8, 8 };
 
-                GetContext().Launch2D(0, gs, ls, edge_detection_kernel);
+                Launch2D("EdgeDetectionMLAA", gs, ls, edge_detection_kernel);
             }
 
             argc = 0;
@@ -501,7 +501,7 @@ namespace Baikal
                 size_t gs[] = { static_cast<size_t>((output.width() + 7) / 8 * 8), static_cast<size_t>((output.height() + 7) / 8 * 8) };
                 size_t ls[] = { 8, 8 };
 
-                GetContext().Launch2D(0, gs, ls, blending_weight_calclulation_kernel);
+                Launch2D("BlendingWeightCalculationMLAA", gs, ls, blending_weight_calclulation_kernel);
             }
 
             argc = 0;
@@ -518,7 +518,7 @@ namespace Baikal
                 size_t gs[] = { static_cast<size_t>((output.width() + 7) / 8 * 8), static_cast<size_t>((output.height() + 7) / 8 * 8) };
                 size_t ls[] = { 8, 8 };
 
-                GetContext().Launch2D(0, gs, ls, neighborhood_blending_kernel);
+                Launch2D("NeighborhoodBlendingMLAA", gs, ls, neighborhood_blending_kernel);
             }
         }
     }
@@ -40,6 +40,13 @@ namespace Baikal
                         &m_program_manager,
                         std::make_unique<PathTracingEstimator>(m_context, m_intersector, &m_program_manager)
                         ));
+            case RendererType::kAdaptivePathTracer:
+                return std::unique_ptr<Renderer>(
+                    new AdaptiveRenderer(
+                        m_context, 
+                        &m_program_manager,
+                        std::make_unique<PathTracingEstimator>(m_context, m_intersector, &m_program_manager)
+                        ));
             default:
                 throw std::runtime_error("Renderer not supported");
         }
@@ -72,4 +79,14 @@ namespace Baikal
     {
         return std::make_unique<ClwSceneController>(m_context, m_intersector.get(), &m_program_manager);
     }
+
+    void ClwRenderFactory::WarmUp() const
+    {
+        m_program_manager.WarmUp();
+    }
+
+    bool ClwRenderFactory::IsReady() const
+    {
+        return m_program_manager.AreProgramsReady();
+    }
 }
@@ -60,7 +60,15 @@ namespace Baikal
         std::unique_ptr<SceneController<ClwScene>>
             CreateSceneController() const override;
 
-    private:
+        // Compile known program variants of created entities on worker threads
+        void WarmUp() const override;
+        // Check if all known program variants are compiled
+        bool IsReady() const override;
+
+        // Program manager shared by created entities
+        CLProgramManager const& GetProgramManager() const { return m_program_manager; }
+
+    protected:
         CLWContext m_context;
         std::string m_cache_path;
         CLProgramManager m_program_manager;
@@ -0,0 +1,32 @@
+#include "cpu_render_factory.h"
+
+#include "Renderers/monte_carlo_renderer.h"
+#include "Estimators/cpu_path_tracing_estimator.h"
+
+#include <memory>
+
+namespace Baikal
+{
+    CpuRenderFactory::CpuRenderFactory(CLWContext context, std::string const& cache_path)
+    : ClwRenderFactory(context, cache_path)
+    {
+    }
+
+    // Create a renderer of specified type
+    std::unique_ptr<Renderer> CpuRenderFactory::CreateRenderer(
+                                                    RendererType type) const
+    {
+        switch (type)
+        {
+            case RendererType::kUnidirectionalPathTracer:
+                return std::unique_ptr<Renderer>(
+                    new MonteCarloRenderer(
+                        m_context,
+                        &m_program_manager,
+                        std::make_unique<CpuPathTracingEstimator>(m_context, m_intersector)
+                        ));
+            default:
+                throw std::runtime_error("Renderer not supported");
+        }
+    }
+}
@@ -0,0 +1,45 @@
+
+/**********************************************************************
+ Copyright (c) 2017 Advanced Micro Devices, Inc. All rights reserved.
+ 
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ 
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+ 
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+#pragma once
+
+#include "clw_render_factory.h"
+
+namespace Baikal
+{
+    /**
+     \brief Render factory for host side path tracing.
+
+     \details Scene compilation, outputs and post effects are the ones of
+     ClwRenderFactory, renderers trace paths with CpuPathTracingEstimator.
+     Meant to be used with a context of a CPU OpenCL device, where the
+     buffers shared with the estimator live in host memory.
+     */
+    class CpuRenderFactory : public ClwRenderFactory
+    {
+    public:
+        CpuRenderFactory(CLWContext context, std::string const& cache_path="");
+
+        // Create a renderer of specified type
+        std::unique_ptr<Renderer>
+            CreateRenderer(RendererType type) const override;
+    };
+}
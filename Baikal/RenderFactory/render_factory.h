@@ -45,7 +45,8 @@ namespace Baikal
     public:
         enum class RendererType
         {
-            kUnidirectionalPathTracer
+            kUnidirectionalPathTracer,
+            kAdaptivePathTracer
         };
         
         enum class PostEffectType
@@ -69,6 +70,14 @@ namespace Baikal
         virtual
         std::unique_ptr<SceneController<Scene>> CreateSceneController() const = 0;
 
+        // Start preparing device programs of created entities in background
+        virtual
+        void WarmUp() const {}
+
+        // Check if device programs of created entities are ready without blocking
+        virtual
+        bool IsReady() const { return true; }
+
         RenderFactory(RenderFactory<Scene> const&) = delete;
         RenderFactory const& operator = (RenderFactory<Scene> const&) = delete;
     };
@@ -1,17 +1,71 @@
 #include "adaptive_renderer.h"
 #include "Output/clwoutput.h"
 
+#include <stdexcept>
+
 namespace Baikal
 {
+    // Relative standard error a pixel has to reach to stop sampling
+    float constexpr kDefaultNoiseThreshold = 0.01f;
+    // Samples taken everywhere before the first convergence update
+    std::uint32_t constexpr kDefaultMinSamples = 16u;
+    // Iterations between convergence updates
+    std::uint32_t constexpr kDefaultUpdateInterval = 4u;
     
     AdaptiveRenderer::AdaptiveRenderer(
         CLWContext context,
         const CLProgramManager *program_manager,
         std::unique_ptr<Estimator> estimator
     ) : MonteCarloRenderer(context, program_manager, std::move(estimator))
+        , m_pp(context, GetFullBuildOpts().c_str())
+        , m_noise_threshold(kDefaultNoiseThreshold)
+        , m_min_samples(kDefaultMinSamples)
+        , m_update_interval(kDefaultUpdateInterval)
+        , m_readback(context, 1)
+        , m_num_active_pixels(0)
+        , m_converged(false)
+    {
+        m_num_active = context.CreateBuffer<int>(1, CL_MEM_READ_WRITE);
+    }
+
+    void AdaptiveRenderer::SetNoiseThreshold(float threshold)
+    {
+        m_noise_threshold = threshold;
+    }
+
+    void AdaptiveRenderer::SetMinSamples(std::uint32_t min_samples)
+    {
+        m_min_samples = min_samples;
+    }
+
+    void AdaptiveRenderer::SetUpdateInterval(std::uint32_t interval)
+    {
+        if (interval == 0)
+        {
+            throw std::runtime_error("AdaptiveRenderer: update interval should be positive");
+        }
+
+        m_update_interval = interval;
+    }
+
+    std::uint32_t AdaptiveRenderer::GetNumActivePixels() const
+    {
+        CollectConvergence();
+        return static_cast<std::uint32_t>(m_num_active_pixels);
+    }
+
+    void AdaptiveRenderer::UpdateWorkBufferSize(int2 const& output_size)
     {
-        auto samples_buffer_size = GetEstimator().GetWorkBufferSize();
-        m_sample_buffer = GetContext().CreateBuffer<float3>(samples_buffer_size, CL_MEM_READ_WRITE);
+        MonteCarloRenderer::UpdateWorkBufferSize(output_size);
+
+        // Sample and compaction buffers mirror estimator work buffer
+        auto work_buffer_size = GetEstimator().GetWorkBufferSize();
+        if (m_sample_buffer.GetElementCount() != work_buffer_size)
+        {
+            m_sample_buffer = GetContext().CreateBuffer<float3>(work_buffer_size, CL_MEM_READ_WRITE);
+            m_candidates = GetContext().CreateBuffer<int>(work_buffer_size, CL_MEM_READ_WRITE);
+            m_predicates = GetContext().CreateBuffer<int>(work_buffer_size, CL_MEM_READ_WRITE);
+        }
     }
 
     void AdaptiveRenderer::Clear(RadeonRays::float3 const& val,
@@ -19,7 +73,40 @@ namespace Baikal
     {
         MonteCarloRenderer::Clear(val, output);
 
-        GetContext().FillBuffer(0u, m_variance_buffer, 0.f, m_variance_buffer.GetElementCount()).Wait();
+        // Drop the pending update, it belongs to the old image
+        CollectConvergence();
+
+        GetContext().FillBuffer(0u, m_moments, 0.f, m_moments.GetElementCount()).Wait();
+        GetContext().FillBuffer(0u, m_convergence_mask, 0, m_convergence_mask.GetElementCount()).Wait();
+
+        m_num_active_pixels = static_cast<int>(m_convergence_mask.GetElementCount());
+        m_converged = false;
+    }
+
+    bool AdaptiveRenderer::Render(ClwScene const& scene)
+    {
+        CollectConvergence();
+
+        if (m_converged)
+        {
+            return true;
+        }
+
+        MonteCarloRenderer::Render(scene);
+
+        auto output = static_cast<ClwOutput*>(GetOutput(OutputType::kColor));
+
+        if (output &&
+            m_sample_counter >= m_min_samples &&
+            m_sample_counter % m_update_interval == 0)
+        {
+            UpdateConvergence(output->data(), output->width() * output->height());
+
+            // Do not stall the queue here, the count is picked up by the next call
+            m_active_readback = m_readback.Read(m_num_active, &m_num_active_pixels, 0, 1);
+        }
+
+        return false;
     }
 
     // Render single tile
@@ -29,25 +116,16 @@ namespace Baikal
     {
         // Number of rays to generate
         auto output = static_cast<ClwOutput*>(GetOutput(OutputType::kColor));
-        auto width = output->width();
-        auto height = output->height();
-
-        GetContext().FillBuffer(0u, m_sample_buffer, float3(), m_sample_buffer.GetElementCount()).Wait();
 
         if (output)
         {
             auto num_rays = tile_size.x * tile_size.y;
-            auto output_size = int2(width, height);
+            auto output_size = int2(output->width(), output->height());
 
-            if (m_sample_counter < 32)
-            {
-                MonteCarloRenderer::GenerateTileDomain(output_size, tile_origin, tile_size);
-            }
-            else
-            {
-                GenerateTileDomain(output_size, tile_origin, tile_size);
-            }
+            GetContext().FillBuffer(0u, m_sample_buffer, float3(), num_rays);
 
+            // Only pixels which have not converged yet are in the domain
+            GenerateTileDomain(output_size, tile_origin, tile_size);
             GeneratePrimaryRays(scene, *output, tile_size);
 
             m_estimator->Estimate(
@@ -56,25 +134,10 @@ namespace Baikal
                 Estimator::QualityLevel::kStandard,
                 m_sample_buffer,
                 false,
-                true
+                false
             );
 
-            AccumulateSamples(m_sample_buffer, output->data(), num_rays);
-
-            if (m_sample_counter > 0 && m_sample_counter % 32 == 0)
-            {
-                auto variance_buffer_size = m_variance_buffer.GetElementCount();
-                EstimateVariance(output->data(), output->width(), output->height());
-
-                std::vector<float> probabilities(variance_buffer_size);
-                GetContext().ReadBuffer(0u, m_variance_buffer, &probabilities[0], variance_buffer_size).Wait();
-
-                m_tile_distribution.Set(&probabilities[0],
-                                        (std::uint32_t)variance_buffer_size);
-
-                UpdateTileDistribution();
-            }
-
+            AccumulateSamples(m_sample_buffer, output->data());
         }
 
         // Check if we have other outputs, than color
@@ -88,99 +151,80 @@ namespace Baikal
 
     void AdaptiveRenderer::AccumulateSamples(
         CLWBuffer<float3> sample_buffer,
-        CLWBuffer<float3> accumulation_buffer,
-        std::uint32_t num_elements
+        CLWBuffer<float3> accumulation_buffer
     )
     {
-        auto accumulate_kernel = GetKernel("AccumulateSingleSample");
+        auto accumulate_kernel = GetKernel("AccumulateSampleMoments");
 
         int argc = 0;
         accumulate_kernel.SetArg(argc++, sample_buffer);
         accumulate_kernel.SetArg(argc++, accumulation_buffer);
+        accumulate_kernel.SetArg(argc++, m_moments);
         accumulate_kernel.SetArg(argc++, m_estimator->GetOutputIndexBuffer());
-        accumulate_kernel.SetArg(argc++, num_elements);
+        accumulate_kernel.SetArg(argc++, m_estimator->GetRayCountBuffer());
 
+        // Number of active pixels is only known on the device, cover the whole tile
         {
-            GetContext().Launch1D(0, ((num_elements + 63) / 64) * 64, 64, accumulate_kernel);
+            auto num_elements = sample_buffer.GetElementCount();
+            Launch1D("AccumulateSampleMoments", ((num_elements + 63) / 64) * 64, 64, accumulate_kernel);
         }
     }
 
-    void AdaptiveRenderer::EstimateVariance(
+    void AdaptiveRenderer::UpdateConvergence(
         CLWBuffer<float3> accumulation_buffer,
-        std::uint32_t width,
-        std::uint32_t height
+        std::uint32_t num_pixels
     )
     {
-        auto estimate_kernel = GetKernel("EstimateVariance");
+        GetContext().FillBuffer(0u, m_num_active, 0, 1);
+
+        auto update_kernel = GetKernel("UpdateConvergence");
 
         int argc = 0;
-        estimate_kernel.SetArg(argc++, accumulation_buffer);
-        estimate_kernel.SetArg(argc++, m_variance_buffer);
-        estimate_kernel.SetArg(argc++, width);
-        estimate_kernel.SetArg(argc++, height);
+        update_kernel.SetArg(argc++, accumulation_buffer);
+        update_kernel.SetArg(argc++, m_moments);
+        update_kernel.SetArg(argc++, num_pixels);
+        update_kernel.SetArg(argc++, m_min_samples);
+        update_kernel.SetArg(argc++, m_noise_threshold);
+        update_kernel.SetArg(argc++, m_convergence_mask);
+        update_kernel.SetArg(argc++, m_num_active);
 
-        // Run shading kernel
         {
-            size_t gs[] = { static_cast<size_t>((width + 15) / 16 * 16), static_cast<size_t>((width + 15) / 16 * 16) };
-            size_t ls[] = { 16, 16 };
-
-            GetContext().Launch2D(0, gs, ls, estimate_kernel);
+            Launch1D("UpdateConvergence", ((num_pixels + 63) / 64) * 64, 64, update_kernel);
         }
     }
 
-    void AdaptiveRenderer::SetOutput(OutputType type, Output* output)
+    void AdaptiveRenderer::CollectConvergence() const
     {
-        // Intermediate variance buffer
-        MonteCarloRenderer::SetOutput(type, output);
-
-        if (output)
+        if (m_active_readback.valid())
         {
-            auto width = output->width();
-            auto height = output->height();
-
-            auto variance_buffer_size = ((width + 15) / 16) * ((height + 15) / 16);
-            m_variance_buffer = GetContext().CreateBuffer<float>(variance_buffer_size, CL_MEM_READ_WRITE);
-
-            std::vector<float> probabilities(variance_buffer_size, 1.f);
-            m_tile_distribution.Set(&probabilities[0], variance_buffer_size);
-
-            UpdateTileDistribution();
+            m_active_readback.get();
+            m_converged = (m_num_active_pixels == 0);
         }
     }
 
-    void AdaptiveRenderer::UpdateTileDistribution()
+    void AdaptiveRenderer::SetOutput(OutputType type, Output* output)
     {
-        // Write distribution data
-        int* distribution_ptr = nullptr;
-        auto num_tiles = m_variance_buffer.GetElementCount();
-        auto required_size = (1 + 1 + num_tiles + num_tiles);
-        if (m_tile_distribution_buffer.GetElementCount() < required_size)
-        {
-            m_tile_distribution_buffer = GetContext().CreateBuffer<int>(required_size, CL_MEM_READ_ONLY);
-        }
+        MonteCarloRenderer::SetOutput(type, output);
 
-        GetContext().MapBuffer(0, m_tile_distribution_buffer, CL_MAP_WRITE, &distribution_ptr).Wait();
-        auto current = distribution_ptr;
+        if (output)
+        {
+            auto num_pixels = output->width() * output->height();
 
-        // Write the number of segments first
-        *current++ = (int)m_tile_distribution.m_num_segments;
+            // Per pixel convergence state
+            if (m_convergence_mask.GetElementCount() != num_pixels)
+            {
+                CollectConvergence();
 
-        // Then write num_segments  + 1 CDF values
-        auto values = reinterpret_cast<float*>(current);
-        for (auto i = 0u; i < m_tile_distribution.m_num_segments + 1; ++i)
-        {
-            values[i] = m_tile_distribution.m_cdf[i];
-        }
+                m_moments = GetContext().CreateBuffer<float>(num_pixels, CL_MEM_READ_WRITE);
+                m_convergence_mask = GetContext().CreateBuffer<int>(num_pixels, CL_MEM_READ_WRITE);
 
-        // Then write num_segments PDF values
-        values += m_tile_distribution.m_num_segments + 1;
+                GetContext().FillBuffer(0u, m_moments, 0.f, num_pixels).Wait();
+                GetContext().FillBuffer(0u, m_convergence_mask, 0, num_pixels).Wait();
 
-        for (auto i = 0u; i < m_tile_distribution.m_num_segments; ++i)
-        {
-            values[i] = m_tile_distribution.m_func_values[i] / m_tile_distribution.m_func_sum;
+                m_num_active_pixels = static_cast<int>(num_pixels);
+                m_converged = false;
+            }
         }
-
-        GetContext().UnmapBuffer(0, m_tile_distribution_buffer, distribution_ptr);
     }
 
     void AdaptiveRenderer::GenerateTileDomain(
@@ -190,31 +234,36 @@ namespace Baikal
     )
     {
         // Fetch kernel
-        CLWKernel generate_kernel = GetKernel("GenerateTileDomain_Adaptive");
+        CLWKernel generate_kernel = GetKernel("GenerateTileDomain_Active");
 
         // Set kernel parameters
         int argc = 0;
         generate_kernel.SetArg(argc++, output_size.x);
-        generate_kernel.SetArg(argc++, output_size.y);
         generate_kernel.SetArg(argc++, tile_origin.x);
         generate_kernel.SetArg(argc++, tile_origin.y);
         generate_kernel.SetArg(argc++, tile_size.x);
         generate_kernel.SetArg(argc++, tile_size.y);
-        generate_kernel.SetArg(argc++, rand_uint());
-        generate_kernel.SetArg(argc++, m_sample_counter);
-        generate_kernel.SetArg(argc++, m_estimator->GetRandomBuffer(Estimator::RandomBufferType::kRandomSeed));
-        generate_kernel.SetArg(argc++, m_estimator->GetRandomBuffer(Estimator::RandomBufferType::kSobolLUT));
-        generate_kernel.SetArg(argc++, m_tile_distribution_buffer);
-        generate_kernel.SetArg(argc++, m_estimator->GetOutputIndexBuffer());
-        generate_kernel.SetArg(argc++, m_estimator->GetRayCountBuffer());
-
-        // Run shading kernel
+        generate_kernel.SetArg(argc++, m_convergence_mask);
+        generate_kernel.SetArg(argc++, m_candidates);
+        generate_kernel.SetArg(argc++, m_predicates);
+
         {
             size_t gs[] = { static_cast<size_t>((tile_size.x + 15) / 16 * 16), static_cast<size_t>((tile_size.y + 15) / 16 * 16) };
             size_t ls[] = { 16, 16 };
 
-            GetContext().Launch2D(0, gs, ls, generate_kernel);
+            Launch2D("GenerateTileDomain_Active", gs, ls, generate_kernel);
         }
+
+        // Pack active pixels into the sample domain, this also sets the ray count
+        auto num_pixels = static_cast<std::uint32_t>(tile_size.x * tile_size.y);
+        m_pp.Compact(
+            0,
+            m_predicates,
+            m_candidates,
+            m_estimator->GetOutputIndexBuffer(),
+            num_pixels,
+            m_estimator->GetRayCountBuffer()
+        );
     }
     
 }
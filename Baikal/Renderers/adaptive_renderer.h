@@ -23,9 +23,10 @@ THE SOFTWARE.
 
 #include "math/int2.h"
 #include "monte_carlo_renderer.h"
+#include "Output/clwreadback.h"
 #include "CLW.h"
-#include "Utils/distribution1d.h"
 
+#include <future>
 #include <memory>
 
 
@@ -35,7 +36,15 @@ namespace Baikal
     class ClwOutput;
     struct ClwScene;
     
-    ///< Renderer implementation
+    /**
+     \brief Renderer which stops sampling pixels once they have converged.
+
+     Per pixel luminance moments and a convergence mask are kept on the device.
+     Every few iterations pixels with relative standard error below the noise
+     threshold are masked out and only the remaining ones get new samples.
+     Number of active pixels is read back asynchronously, so convergence of the
+     whole output is reported by Render one update late.
+     */
     class AdaptiveRenderer : public MonteCarloRenderer
     {
     public:
@@ -51,6 +60,9 @@ namespace Baikal
         void Clear(RadeonRays::float3 const& val,
             Output& output) const override;
 
+        // Render the scene into the output, returns true once all pixels have converged
+        bool Render(ClwScene const& scene) override;
+
         // Render single tile
         void RenderTile(ClwScene const& scene,
             RadeonRays::int2 const& tile_origin,
@@ -59,19 +71,27 @@ namespace Baikal
         // Set output
         void SetOutput(OutputType type, Output* output) override;
 
+        // Set max relative standard error of a converged pixel
+        void SetNoiseThreshold(float threshold);
+        // Set number of samples taken in every pixel before checking its convergence
+        void SetMinSamples(std::uint32_t min_samples);
+        // Set number of iterations between convergence updates
+        void SetUpdateInterval(std::uint32_t interval);
+
+        // Number of pixels still sampled as of the last completed update
+        std::uint32_t GetNumActivePixels() const;
+
         // DEBUG STUFF
-        CLWBuffer<float> GetVarianceBuffer() const { return m_variance_buffer; }
+        CLWBuffer<int> GetConvergenceMask() const { return m_convergence_mask; }
     protected:
         void AccumulateSamples(
             CLWBuffer<float3> sample_buffer,
-            CLWBuffer<float3> accumulation_buffer,
-            std::uint32_t num_elements
+            CLWBuffer<float3> accumulation_buffer
         );
 
-        void EstimateVariance(
+        void UpdateConvergence(
             CLWBuffer<float3> accumulation_buffer,
-            std::uint32_t width,
-            std::uint32_t height
+            std::uint32_t num_pixels
         );
 
         void GenerateTileDomain(
@@ -80,13 +100,29 @@ namespace Baikal
             int2 const& tile_size
         ) override;
 
-        void UpdateTileDistribution();
+        void UpdateWorkBufferSize(int2 const& output_size) override;
 
     private:
-        mutable CLWBuffer<float> m_variance_buffer;
-        mutable CLWBuffer<float3> m_sample_buffer;
-        CLWBuffer<int> m_tile_distribution_buffer;
-        Distribution1D m_tile_distribution;
+        // Wait for pending active pixel count readback
+        void CollectConvergence() const;
+
+        mutable CLWBuffer<float> m_moments;
+        mutable CLWBuffer<int> m_convergence_mask;
+        CLWBuffer<int> m_num_active;
+        CLWBuffer<float3> m_sample_buffer;
+        CLWBuffer<int> m_candidates;
+        CLWBuffer<int> m_predicates;
+        CLWParallelPrimitives m_pp;
+
+        float m_noise_threshold;
+        std::uint32_t m_min_samples;
+        std::uint32_t m_update_interval;
+
+        // Readback has to outlive pending futures
+        ClwReadbackRing<int> m_readback;
+        mutable std::future<void> m_active_readback;
+        mutable int m_num_active_pixels;
+        mutable bool m_converged;
     };
     
 }
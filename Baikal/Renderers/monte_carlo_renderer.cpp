@@ -30,6 +30,7 @@
 #include <cstdint>
 #include <random>
 #include <algorithm>
+#include <cmath>
 
 #include "Utils/sobol.h"
 #include "math/int2.h"
@@ -39,13 +40,17 @@
 #endif
 
 #include "Utils/cl_program_manager.h"
+#include "Utils/kernel_profiler.h"
 
 namespace Baikal
 {
     using namespace RadeonRays;
 
-    int constexpr kTileSizeX = 1920;
-    int constexpr kTileSizeY = 1080;
+    // Default upper bound for the number of rays per launch (1080p frame)
+    std::size_t constexpr kDefaultMaxRaysPerLaunch = 1920 * 1080;
+    // Tiles are aligned to generation kernel work group size
+    int constexpr kTileAlignment = 16;
+    std::size_t constexpr kMinRaysPerLaunch = kTileAlignment * kTileAlignment;
 
     // Constructor
     MonteCarloRenderer::MonteCarloRenderer(
@@ -64,8 +69,12 @@ namespace Baikal
 #endif
         , m_estimator(std::move(estimator))
         , m_sample_counter(0u)
+        , m_max_rays_per_launch(kDefaultMaxRaysPerLaunch)
+        , m_work_buffer_memory_budget(0u)
+        , m_random_seed(0u)
     {
-        m_estimator->SetWorkBufferSize(kTileSizeX * kTileSizeY);
+        // AOV pass generates primary rays at pixel centers
+        AddProgramVariant("-D BAIKAL_GENERATE_SAMPLE_AT_PIXEL_CENTER ");
     }
 
     void MonteCarloRenderer::Clear(RadeonRays::float3 const& val, Output& output) const
@@ -74,7 +83,7 @@ namespace Baikal
         m_sample_counter = 0u;
     }
 
-    void MonteCarloRenderer::Render(ClwScene const& scene)
+    bool MonteCarloRenderer::Render(ClwScene const& scene)
     {
         auto output = FindFirstNonZeroOutput();
 
@@ -90,26 +99,57 @@ namespace Baikal
             }
         }
 
+        RenderRegion(scene, int2(), int2(output->width(), output->height()));
+
+        if (auto profiler = KernelProfiler::Get())
+        {
+            profiler->EndFrame();
+        }
+
+        // Uniform sampling never converges
+        return false;
+    }
+
+    void MonteCarloRenderer::RenderRegion(ClwScene const& scene, int2 const& region_origin, int2 const& region_size)
+    {
+        auto output = FindFirstNonZeroOutput();
+
+        if (!output)
+        {
+            throw std::runtime_error("No outputs set");
+        }
+
         auto output_size = int2(output->width(), output->height());
 
-        if (output_size.x > kTileSizeX || output_size.y > kTileSizeY)
+        // Budget might have changed since the output was set
+        UpdateWorkBufferSize(output_size);
+
+        auto tile_size = GetTileSize(output_size);
+
+        // Primary and restarted paths derive their sample indices from the frame
+        m_estimator->SetFrame(m_sample_counter);
+
+        if (tile_size.x < region_size.x || tile_size.y < region_size.y)
         {
-            auto num_tiles_x = (output_size.x + kTileSizeX - 1) / kTileSizeX;
-            auto num_tiles_y = (output_size.y + kTileSizeY - 1) / kTileSizeY;
+            auto num_tiles_x = (region_size.x + tile_size.x - 1) / tile_size.x;
+            auto num_tiles_y = (region_size.y + tile_size.y - 1) / tile_size.y;
 
-            for (auto x = 0; x < num_tiles_x; ++x)
-                for (auto y = 0; y < num_tiles_y; ++y)
+            // Walk tiles in serpentine order, so that consecutive tiles are
+            // adjacent and share scene data in caches
+            for (auto y = 0; y < num_tiles_y; ++y)
+                for (auto i = 0; i < num_tiles_x; ++i)
                 {
-                    auto tile_offset = int2(x * kTileSizeX, y * kTileSizeY);
-                    auto tile_size = int2(std::min(kTileSizeX, output_size.x - tile_offset.x),
-                        std::min(kTileSizeY, output_size.y - tile_offset.y));
+                    auto x = (y & 0x1) ? (num_tiles_x - 1 - i) : i;
+                    auto tile_offset = int2(x * tile_size.x, y * tile_size.y);
+                    auto current_tile_size = int2(std::min(tile_size.x, region_size.x - tile_offset.x),
+                        std::min(tile_size.y, region_size.y - tile_offset.y));
 
-                    RenderTile(scene, tile_offset, tile_size);
+                    RenderTile(scene, int2(region_origin.x + tile_offset.x, region_origin.y + tile_offset.y), current_tile_size);
                 }
         }
         else
         {
-            RenderTile(scene, int2(), output_size);
+            RenderTile(scene, region_origin, region_size);
         }
 
         ++m_sample_counter;
@@ -178,7 +218,7 @@ namespace Baikal
         generate_kernel.SetArg(argc++, tile_size.x);
         generate_kernel.SetArg(argc++, tile_size.y);
         generate_kernel.SetArg(argc++, rand_uint());
-        generate_kernel.SetArg(argc++, m_sample_counter);
+        generate_kernel.SetArg(argc++, m_estimator->GetFirstSampleIndex());
         generate_kernel.SetArg(argc++, m_estimator->GetRandomBuffer(Estimator::RandomBufferType::kRandomSeed));
         generate_kernel.SetArg(argc++, m_estimator->GetRandomBuffer(Estimator::RandomBufferType::kSobolLUT));
         generate_kernel.SetArg(argc++, m_estimator->GetOutputIndexBuffer());
@@ -189,7 +229,7 @@ namespace Baikal
             size_t gs[] = { static_cast<size_t>((tile_size.x + 15) / 16 * 16), static_cast<size_t>((tile_size.y + 15) / 16 * 16) };
             size_t ls[] = { 16, 16 };
 
-            GetContext().Launch2D(0, gs, ls, generate_kernel);
+            Launch2D("GenerateTileDomain", gs, ls, generate_kernel);
         }
     }
 
@@ -228,6 +268,110 @@ namespace Baikal
         }
 
         Renderer::SetOutput(type, output);
+
+        if (output)
+        {
+            UpdateWorkBufferSize(int2(output->width(), output->height()));
+        }
+    }
+
+    void MonteCarloRenderer::SetMaxRaysPerLaunch(std::size_t max_rays)
+    {
+        m_max_rays_per_launch = max_rays;
+    }
+
+    void MonteCarloRenderer::SetWorkBufferMemoryBudget(std::size_t budget)
+    {
+        m_work_buffer_memory_budget = budget;
+    }
+
+    std::size_t MonteCarloRenderer::GetMaxRaysPerLaunch() const
+    {
+        auto max_rays = m_max_rays_per_launch;
+
+        if (m_work_buffer_memory_budget > 0)
+        {
+            auto budget_rays = m_work_buffer_memory_budget / m_estimator->GetWorkBufferItemSize();
+            max_rays = std::min(max_rays, budget_rays);
+        }
+
+        return std::max(max_rays, kMinRaysPerLaunch);
+    }
+
+    int2 MonteCarloRenderer::GetTileSize(int2 const& output_size) const
+    {
+        auto max_rays = GetMaxRaysPerLaunch();
+        auto num_pixels = static_cast<std::size_t>(output_size.x) * static_cast<std::size_t>(output_size.y);
+
+        if (num_pixels <= max_rays)
+        {
+            return output_size;
+        }
+
+        // Prefer square tiles: they keep primary rays coherent
+        auto side = static_cast<int>(std::sqrt(static_cast<double>(max_rays)));
+        side = std::max(kTileAlignment, side / kTileAlignment * kTileAlignment);
+
+        auto tile_size_x = std::min(output_size.x, side);
+        auto tile_size_y = static_cast<int>(max_rays / tile_size_x);
+        tile_size_y = std::max(kTileAlignment, tile_size_y / kTileAlignment * kTileAlignment);
+
+        return int2(tile_size_x, std::min(output_size.y, tile_size_y));
+    }
+
+    void MonteCarloRenderer::SetStatisticsEnabled(bool enabled)
+    {
+        m_estimator->SetStatisticsEnabled(enabled);
+    }
+
+    void MonteCarloRenderer::ResetStatistics()
+    {
+        m_estimator->ResetStatistics();
+    }
+
+    template <typename T>
+    static std::size_t GetBufferSize(CLWBuffer<T> const& buffer)
+    {
+        return buffer.GetElementCount() * sizeof(T);
+    }
+
+    RenderStatistics MonteCarloRenderer::GetStatistics(ClwScene const& scene) const
+    {
+        RenderStatistics stats;
+
+        stats.geometry_memory = GetBufferSize(scene.vertices) + GetBufferSize(scene.normals) +
+            GetBufferSize(scene.uvs) + GetBufferSize(scene.indices) + GetBufferSize(scene.shapes) +
+            GetBufferSize(scene.camera);
+        stats.texture_memory = GetBufferSize(scene.textures) + GetBufferSize(scene.texturedata) + GetBufferSize(scene.texturefeedback);
+        stats.material_memory = GetBufferSize(scene.materials) + GetBufferSize(scene.volumes) +
+            GetBufferSize(scene.input_map_data);
+        stats.light_memory = GetBufferSize(scene.lights) + GetBufferSize(scene.light_distributions);
+        stats.work_buffer_memory = m_estimator->GetWorkBufferSize() * m_estimator->GetWorkBufferItemSize();
+
+        for (auto i = 0U; i < static_cast<std::uint32_t>(Renderer::OutputType::kMax); ++i)
+        {
+            if (auto output = static_cast<ClwOutput*>(GetOutput(static_cast<Renderer::OutputType>(i))))
+            {
+                stats.output_memory += GetBufferSize(output->data());
+            }
+        }
+
+        stats.num_samples = m_sample_counter;
+
+        m_estimator->GetStatistics(stats);
+
+        return stats;
+    }
+
+    void MonteCarloRenderer::UpdateWorkBufferSize(int2 const& output_size)
+    {
+        auto tile_size = GetTileSize(output_size);
+        auto required_size = static_cast<std::size_t>(tile_size.x) * static_cast<std::size_t>(tile_size.y);
+
+        if (m_estimator->GetWorkBufferSize() != required_size)
+        {
+            m_estimator->SetWorkBufferSize(required_size);
+        }
     }
 
 
@@ -263,13 +407,14 @@ namespace Baikal
         fill_kernel.SetArg(argc++, scene.materials);
         fill_kernel.SetArg(argc++, scene.textures);
         fill_kernel.SetArg(argc++, scene.texturedata);
+        fill_kernel.SetArg(argc++, scene.texturefeedback);
         fill_kernel.SetArg(argc++, scene.envmapidx);
         fill_kernel.SetArg(argc++, scene.lights);
         fill_kernel.SetArg(argc++, scene.num_lights);
         fill_kernel.SetArg(argc++, rand_uint());
         fill_kernel.SetArg(argc++, m_estimator->GetRandomBuffer(Estimator::RandomBufferType::kRandomSeed));
         fill_kernel.SetArg(argc++, m_estimator->GetRandomBuffer(Estimator::RandomBufferType::kSobolLUT));
-        fill_kernel.SetArg(argc++, m_sample_counter);
+        fill_kernel.SetArg(argc++, m_estimator->GetFirstSampleIndex());
         for (auto i = 1U; i < static_cast<std::uint32_t>(Renderer::OutputType::kMax); ++i)
         {
             if (auto aov = static_cast<ClwOutput*>(GetOutput(static_cast<Renderer::OutputType>(i))))
@@ -289,7 +434,7 @@ namespace Baikal
         // Run AOV kernel
         {
             int globalsize = tile_size.x * tile_size.y;
-            GetContext().Launch1D(0, ((globalsize + 63) / 64) * 64, 64, fill_kernel);
+            Launch1D("FillAOVs", ((globalsize + 63) / 64) * 64, 64, fill_kernel);
         }
     }
     
@@ -319,6 +464,9 @@ namespace Baikal
         auto kernel_name = GetCameraKernelName(scene.camera_type);
         auto genkernel = GetKernel(kernel_name, generate_at_pixel_center ? "-D BAIKAL_GENERATE_SAMPLE_AT_PIXEL_CENTER " : "");
 
+        // Estimator restarts paths through the same image pixels
+        m_estimator->SetCameraImageSize(int2(output.width(), output.height()));
+
         // Set kernel parameters
         int argc = 0;
         genkernel.SetArg(argc++, scene.camera);
@@ -327,14 +475,14 @@ namespace Baikal
         genkernel.SetArg(argc++, m_estimator->GetOutputIndexBuffer());
         genkernel.SetArg(argc++, m_estimator->GetRayCountBuffer());
         genkernel.SetArg(argc++, (int)rand_uint());
-        genkernel.SetArg(argc++, m_sample_counter);
+        genkernel.SetArg(argc++, m_estimator->GetFirstSampleIndex());
         genkernel.SetArg(argc++, m_estimator->GetRayBuffer());
         genkernel.SetArg(argc++, m_estimator->GetRandomBuffer(Estimator::RandomBufferType::kRandomSeed));
         genkernel.SetArg(argc++, m_estimator->GetRandomBuffer(Estimator::RandomBufferType::kSobolLUT));
 
         {
             int globalsize = tile_size.x * tile_size.y;
-            GetContext().Launch1D(0, ((globalsize + 63) / 64) * 64, 64, genkernel);
+            Launch1D(kernel_name, ((globalsize + 63) / 64) * 64, 64, genkernel);
         }
     }
 
@@ -343,24 +491,78 @@ namespace Baikal
         return GetKernel("ApplyGammaAndCopyData");
     }
 
+    CLWKernel MonteCarloRenderer::GetQuantizeKernel()
+    {
+        return GetKernel("ApplyGammaAndQuantizeData");
+    }
+
     CLWKernel MonteCarloRenderer::GetAccumulateKernel()
     {
         return GetKernel("AccumulateData");
     }
 
+    CLWEvent MonteCarloRenderer::ExtractTile(Output& output, int band_y, int band_height, bool half_float, CLWBuffer<char> tile)
+    {
+        auto clw_output = static_cast<ClwOutput*>(&output);
+        auto kernel = GetKernel("ExtractTileData");
+
+        int width = output.width();
+
+        int argc = 0;
+        kernel.SetArg(argc++, clw_output->data());
+        kernel.SetArg(argc++, width);
+        kernel.SetArg(argc++, 0);
+        kernel.SetArg(argc++, band_y);
+        kernel.SetArg(argc++, width);
+        kernel.SetArg(argc++, band_height);
+        kernel.SetArg(argc++, half_float ? 1 : 0);
+        kernel.SetArg(argc++, tile);
+
+        int globalsize = width * band_height;
+        return Launch1D("ExtractTileData", ((globalsize + 63) / 64) * 64, 64, kernel);
+    }
+
+    CLWEvent MonteCarloRenderer::AccumulateTile(CLWBuffer<char> tile, int band_y, int band_height, bool half_float, Output& output)
+    {
+        auto clw_output = static_cast<ClwOutput*>(&output);
+        auto kernel = GetKernel("AccumulateTileData");
+
+        int width = output.width();
+
+        int argc = 0;
+        kernel.SetArg(argc++, tile);
+        kernel.SetArg(argc++, width);
+        kernel.SetArg(argc++, 0);
+        kernel.SetArg(argc++, band_y);
+        kernel.SetArg(argc++, width);
+        kernel.SetArg(argc++, band_height);
+        kernel.SetArg(argc++, half_float ? 1 : 0);
+        kernel.SetArg(argc++, clw_output->data());
+
+        int globalsize = width * band_height;
+        return Launch1D("AccumulateTileData", ((globalsize + 63) / 64) * 64, 64, kernel);
+    }
+
     void MonteCarloRenderer::SetRandomSeed(std::uint32_t seed)
     {
+        m_random_seed = seed;
         m_estimator->SetRandomSeed(seed);
     }
 
+    std::uint32_t MonteCarloRenderer::GetRandomSeed() const
+    {
+        return m_random_seed;
+    }
+
     void MonteCarloRenderer::Benchmark(ClwScene const& scene, Estimator::RayTracingStats& stats)
     {
         auto output = static_cast<ClwOutput*>(GetOutput(OutputType::kColor));
 
-        int num_rays = output->width() * output->height();
-        int2 tile_size = int2(output->width(), output->height());
+        auto output_size = int2(output->width(), output->height());
+        auto tile_size = GetTileSize(output_size);
+        int num_rays = tile_size.x * tile_size.y;
 
-        GenerateTileDomain(tile_size, int2(), tile_size);
+        GenerateTileDomain(output_size, int2(), tile_size);
         GeneratePrimaryRays(scene, *output, tile_size);
 
         m_estimator->Benchmark(scene, num_rays, stats);
@@ -371,6 +573,16 @@ namespace Baikal
         m_estimator->SetMaxBounces(max_bounces);
     }
 
+    void MonteCarloRenderer::SetPathRegenerationPasses(std::uint32_t num_passes)
+    {
+        m_estimator->SetPathRegenerationPasses(num_passes);
+    }
+
+    void MonteCarloRenderer::SetMaterialSortingEnabled(bool enabled)
+    {
+        m_estimator->SetMaterialSortingEnabled(enabled);
+    }
+
     void MonteCarloRenderer::HandleMissedRays(const ClwScene &scene , uint32_t w, uint32_t h,
         CLWBuffer<ray> rays, CLWBuffer<Intersection> intersections, CLWBuffer<int> pixel_indices,
         CLWBuffer<int> output_indices, std::size_t size, CLWBuffer<RadeonRays::float3> output)
@@ -390,10 +602,11 @@ namespace Baikal
         misskernel.SetArg(argc++, h);
         misskernel.SetArg(argc++, scene.textures);
         misskernel.SetArg(argc++, scene.texturedata);
+        misskernel.SetArg(argc++, scene.texturefeedback);
         misskernel.SetArg(argc++, output);
 
         {
-            GetContext().Launch1D(0, ((size + 63) / 64) * 64, 64, misskernel);
+            Launch1D("ShadeBackgroundImage", ((size + 63) / 64) * 64, 64, misskernel);
         }
     }
     
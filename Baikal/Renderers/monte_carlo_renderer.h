@@ -28,6 +28,7 @@ THE SOFTWARE.
 #include "Controllers/clw_scene_controller.h"
 #include "Utils/clw_class.h"
 #include "Estimators/estimator.h"
+#include "Utils/render_statistics.h"
 
 #include "CLW.h"
 
@@ -58,7 +59,12 @@ namespace Baikal
                    Output& output) const override;
 
         // Render the scene into the output
-        void Render(ClwScene const& scene) override;
+        bool Render(ClwScene const& scene) override;
+
+        // Render single iteration of an output region, splitting it into tiles if needed
+        void RenderRegion(ClwScene const& scene,
+                          RadeonRays::int2 const& region_origin,
+                          RadeonRays::int2 const& region_size);
 
         // Render single tile
         void RenderTile(ClwScene const& scene,
@@ -69,18 +75,49 @@ namespace Baikal
         void SetOutput(OutputType type, Output* output) override;
 
         void SetRandomSeed(std::uint32_t seed) override;
+        // Seed set by the last SetRandomSeed call
+        std::uint32_t GetRandomSeed() const;
 
         // Interop function
         CLWKernel GetCopyKernel();
+        // Gamma and RGBA8 quantization function
+        CLWKernel GetQuantizeKernel();
         // Add function
         CLWKernel GetAccumulateKernel();
+        // Move accumulated samples of an output band into a packed tile buffer, leaving zeros behind
+        CLWEvent ExtractTile(Output& output, int band_y, int band_height, bool half_float, CLWBuffer<char> tile);
+        // Add a packed tile buffer produced by ExtractTile to an output band
+        CLWEvent AccumulateTile(CLWBuffer<char> tile, int band_y, int band_height, bool half_float, Output& output);
         // Run render benchmark
         void Benchmark(ClwScene const& scene, Estimator::RayTracingStats& stats);
 
         // Set max number of light bounces
         void SetMaxBounces(std::uint32_t max_bounces);
+        // Set number of passes restarting finished paths, 0 disables regeneration
+        void SetPathRegenerationPasses(std::uint32_t num_passes);
+        // Sort hits by material before shading
+        void SetMaterialSortingEnabled(bool enabled);
+
+        // Set max number of rays traced in a single estimator launch
+        void SetMaxRaysPerLaunch(std::size_t max_rays);
+        // Set device memory budget (in bytes) for estimator work buffers, 0 means no budget
+        void SetWorkBufferMemoryBudget(std::size_t budget);
+        // Get max number of rays per launch taking memory budget into account
+        std::size_t GetMaxRaysPerLaunch() const;
+        // Get tile size used to render the output of a given size
+        int2 GetTileSize(int2 const& output_size) const;
+
+        // Enable collection of ray counts and kernel times
+        void SetStatisticsEnabled(bool enabled);
+        // Get memory usage for a compiled scene along with statistics collected since the last reset
+        RenderStatistics GetStatistics(ClwScene const& scene) const;
+        // Reset collected ray counts and kernel times
+        void ResetStatistics();
         
     protected:
+        // Resize estimator work buffers to fit a single tile of the output
+        virtual void UpdateWorkBufferSize(int2 const& output_size);
+
         void GeneratePrimaryRays(
             ClwScene const& scene,
             Output const& output,
@@ -113,6 +150,11 @@ namespace Baikal
     public:
         std::unique_ptr<Estimator> m_estimator;
         mutable std::uint32_t m_sample_counter;
+
+    private:
+        std::size_t m_max_rays_per_launch;
+        std::size_t m_work_buffer_memory_budget;
+        std::uint32_t m_random_seed;
     };
 
 }
@@ -0,0 +1,439 @@
+/**********************************************************************
+Copyright (c) 2017 Advanced Micro Devices, Inc. All rights reserved.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+********************************************************************/
+#include "Renderers/multi_device_scheduler.h"
+#include "Renderers/monte_carlo_renderer.h"
+#include "Output/output.h"
+#include "Output/clwreadback.h"
+#include "Utils/kernel_profiler.h"
+#include "Utils/log.h"
+
+#include <algorithm>
+#include <future>
+#include <numeric>
+#include <stdexcept>
+#include <thread>
+
+namespace Baikal
+{
+    using namespace RadeonRays;
+
+    struct MultiDeviceScheduler::Worker
+    {
+        Device device;
+        std::thread thread;
+
+        std::atomic<bool> stop;
+        std::atomic<bool> clear;
+
+        // Band of the frame rendered by the device
+        std::atomic<int> band_y;
+        std::atomic<int> band_height;
+        // Rows rendered per second since the last clear, 0 until measured
+        std::atomic<float> throughput;
+
+        // Packed tile on the device and its readback
+        CLWBuffer<char> tile_buffer;
+        std::unique_ptr<ClwReadbackRing<char>> readback;
+        Tile pending_tile;
+        std::future<void> pending_readback;
+    };
+
+    namespace
+    {
+        std::size_t GetTileElementSize(bool half_float)
+        {
+            return half_float ? 4 * sizeof(cl_half) : sizeof(RadeonRays::float3);
+        }
+    }
+
+    MultiDeviceScheduler::MultiDeviceScheduler(Device const& primary,
+                                               std::vector<Device> const& secondary,
+                                               Scene1::Ptr scene)
+    : m_primary(primary)
+    , m_scene(scene)
+    , m_half_float(false)
+    , m_transfer_interval(1000)
+    , m_generation(0)
+    , m_transferred_bytes(0)
+    {
+        if (!m_primary.output)
+        {
+            throw std::runtime_error("MultiDeviceScheduler: primary device has no output");
+        }
+
+        auto frame_size = std::size_t(m_primary.output->width()) * m_primary.output->height() * sizeof(float3);
+
+        auto primary_seed = m_primary.renderer->GetRandomSeed();
+
+        for (auto& device : secondary)
+        {
+            if (!device.output ||
+                device.output->width() != m_primary.output->width() ||
+                device.output->height() != m_primary.output->height())
+            {
+                throw std::runtime_error("MultiDeviceScheduler: secondary output does not match primary output");
+            }
+
+            std::unique_ptr<Worker> worker(new Worker);
+            worker->device = device;
+            worker->stop.store(false);
+            worker->clear.store(true);
+            worker->band_y.store(0);
+            worker->band_height.store(0);
+            worker->throughput.store(0.f);
+            worker->tile_buffer = device.context.CreateBuffer<char>(frame_size, CL_MEM_READ_WRITE);
+            worker->readback.reset(new ClwReadbackRing<char>(device.context, frame_size));
+
+            // Devices would trace the same paths otherwise
+            device.renderer->SetRandomSeed(GetDeviceSeed(primary_seed, static_cast<std::uint32_t>(m_workers.size())));
+
+            m_workers.push_back(std::move(worker));
+        }
+
+        UpdateBands();
+    }
+
+    std::uint32_t MultiDeviceScheduler::GetDeviceSeed(std::uint32_t primary_seed, std::uint32_t index)
+    {
+        // Multiplication by an odd constant is a bijection modulo 2^32,
+        // so seeds of different devices never collide with each other or the primary one
+        return primary_seed + (index + 1u) * 0x9E3779B9u;
+    }
+
+    MultiDeviceScheduler::~MultiDeviceScheduler()
+    {
+        Stop();
+    }
+
+    void MultiDeviceScheduler::SetHalfFloatTransfer(bool enabled)
+    {
+        m_half_float.store(enabled);
+    }
+
+    void MultiDeviceScheduler::SetTransferInterval(std::chrono::milliseconds interval)
+    {
+        m_transfer_interval.store(interval.count());
+    }
+
+    void MultiDeviceScheduler::Start()
+    {
+        for (auto& worker : m_workers)
+        {
+            if (!worker->thread.joinable())
+            {
+                worker->stop.store(false);
+                worker->thread = std::thread(&MultiDeviceScheduler::WorkerMain, this, std::ref(*worker));
+            }
+        }
+    }
+
+    void MultiDeviceScheduler::Stop()
+    {
+        for (auto& worker : m_workers)
+        {
+            worker->stop.store(true);
+        }
+
+        for (auto& worker : m_workers)
+        {
+            if (worker->thread.joinable())
+            {
+                worker->thread.join();
+            }
+        }
+    }
+
+    void MultiDeviceScheduler::Clear()
+    {
+        ++m_generation;
+
+        {
+            std::lock_guard<std::mutex> lock(m_tiles_mutex);
+            m_tiles.clear();
+        }
+
+        UpdateBands();
+
+        for (auto& worker : m_workers)
+        {
+            worker->clear.store(true);
+        }
+    }
+
+    std::size_t MultiDeviceScheduler::Merge()
+    {
+        std::vector<Tile> tiles;
+
+        {
+            std::lock_guard<std::mutex> lock(m_tiles_mutex);
+            tiles.swap(m_tiles);
+        }
+
+        auto generation = m_generation.load();
+
+        std::size_t num_merged = 0;
+        CLWEvent last_write;
+
+        for (auto const& tile : tiles)
+        {
+            // Samples of a scene state which is gone
+            if (tile.generation != generation)
+            {
+                continue;
+            }
+
+            if (m_tile_buffer.GetElementCount() < tile.data.size())
+            {
+                m_tile_buffer = m_primary.context.CreateBuffer<char>(tile.data.size(), CL_MEM_READ_ONLY);
+            }
+
+            // Tiles share the buffer, in-order queue keeps writes and kernels apart
+            last_write = m_primary.context.WriteBuffer(0, m_tile_buffer, tile.data.data(), tile.data.size());
+
+            m_primary.renderer->AccumulateTile(m_tile_buffer, tile.y, tile.height, tile.half_float, *m_primary.output);
+
+            ++num_merged;
+        }
+
+        // Host copies of the tiles go away on return
+        if (num_merged)
+        {
+            last_write.Wait();
+        }
+
+        return num_merged;
+    }
+
+    std::vector<std::uint32_t> MultiDeviceScheduler::GetBandHeights() const
+    {
+        std::vector<std::uint32_t> heights;
+
+        for (auto& worker : m_workers)
+        {
+            heights.push_back(worker->band_height.load());
+        }
+
+        return heights;
+    }
+
+    std::size_t MultiDeviceScheduler::GetNumTransferredBytes() const
+    {
+        return m_transferred_bytes.load();
+    }
+
+    void MultiDeviceScheduler::UpdateBands()
+    {
+        if (m_workers.empty())
+        {
+            return;
+        }
+
+        auto height = static_cast<int>(m_primary.output->height());
+        auto num_workers = static_cast<int>(m_workers.size());
+
+        // Fall back to equal bands until every device has been measured
+        std::vector<float> weights;
+        bool measured = true;
+
+        for (auto& worker : m_workers)
+        {
+            auto throughput = worker->throughput.load();
+            measured = measured && throughput > 0.f;
+            weights.push_back(throughput);
+        }
+
+        if (!measured)
+        {
+            std::fill(weights.begin(), weights.end(), 1.f);
+        }
+
+        auto total = std::accumulate(weights.cbegin(), weights.cend(), 0.f);
+
+        int y = 0;
+        for (int i = 0; i < num_workers; ++i)
+        {
+            // Last band takes rows lost to rounding
+            int band_height = (i == num_workers - 1) ?
+                height - y : std::min(static_cast<int>(height * weights[i] / total), height - y);
+
+            m_workers[i]->band_y.store(y);
+            m_workers[i]->band_height.store(band_height);
+
+            y += band_height;
+        }
+    }
+
+    void MultiDeviceScheduler::Ship(Worker& worker, std::uint32_t generation, int band_y, int band_height)
+    {
+        auto output = worker.device.output;
+        auto half_float = m_half_float.load();
+
+        // Band the device rendered since its last clear, UpdateBands may have moved the shared one
+        Tile tile;
+        tile.y = band_y;
+        tile.width = output->width();
+        tile.height = band_height;
+        tile.half_float = half_float;
+        tile.generation = generation;
+        tile.data.resize(std::size_t(tile.width) * tile.height * GetTileElementSize(half_float));
+
+        worker.device.renderer->ExtractTile(*output, tile.y, tile.height, half_float, worker.tile_buffer);
+
+        worker.pending_readback = worker.readback->Read(worker.tile_buffer, tile.data.data(), 0, tile.data.size());
+        // Moving the vector keeps its storage, so the readback destination stays valid
+        worker.pending_tile = std::move(tile);
+
+        m_transferred_bytes += worker.pending_tile.data.size();
+    }
+
+    void MultiDeviceScheduler::WorkerMain(Worker& worker)
+    {
+        auto renderer = worker.device.renderer;
+        auto controller = worker.device.controller;
+        auto output = worker.device.output;
+        auto& context = worker.device.context;
+
+        // Marker to keep a single frame in flight instead of draining the queue every frame
+        auto frame_marker = context.CreateBuffer<int>(1, CL_MEM_READ_WRITE);
+        CLWEvent prev_frame;
+        bool has_prev_frame = false;
+
+        std::uint32_t generation = 0;
+        int band_y = 0;
+        int band_height = 0;
+        std::uint64_t rows_rendered = 0;
+
+        auto start_time = std::chrono::high_resolution_clock::now();
+        auto ship_time = start_time;
+
+        while (!worker.stop.load())
+        {
+            if (worker.clear.exchange(false))
+            {
+                // Tile in flight belongs to the previous accumulation
+                if (worker.pending_readback.valid())
+                {
+                    worker.pending_readback.get();
+                }
+
+                generation = m_generation.load();
+                band_y = worker.band_y.load();
+                band_height = worker.band_height.load();
+
+                renderer->Clear(float3(0, 0, 0), *output);
+                controller->CompileScene(m_scene);
+
+                rows_rendered = 0;
+                start_time = ship_time = std::chrono::high_resolution_clock::now();
+            }
+
+            if (band_height > 0)
+            {
+                auto& scene = controller->GetCachedScene(m_scene);
+                renderer->RenderRegion(scene, int2(0, band_y), int2(output->width(), band_height));
+                rows_rendered += band_height;
+            }
+
+            // Tile requested on the previous transfer has arrived by now
+            if (worker.pending_readback.valid())
+            {
+                worker.pending_readback.get();
+
+                std::lock_guard<std::mutex> lock(m_tiles_mutex);
+                m_tiles.push_back(std::move(worker.pending_tile));
+            }
+
+            auto now = std::chrono::high_resolution_clock::now();
+
+            if (band_height > 0 &&
+                std::chrono::duration_cast<std::chrono::milliseconds>(now - ship_time).count() >= m_transfer_interval.load())
+            {
+                Ship(worker, generation, band_y, band_height);
+
+                auto seconds = std::chrono::duration<float>(now - start_time).count();
+                worker.throughput.store(rows_rendered / std::max(seconds, 1e-3f));
+
+                ship_time = now;
+            }
+
+            auto frame = context.FillBuffer(0, frame_marker, 0, 1);
+            context.Flush(0);
+
+            if (has_prev_frame)
+            {
+                prev_frame.Wait();
+            }
+
+            prev_frame = frame;
+            has_prev_frame = true;
+        }
+
+        if (worker.pending_readback.valid())
+        {
+            worker.pending_readback.get();
+        }
+
+        context.Finish(0);
+    }
+
+    std::vector<CLWContext> MultiDeviceScheduler::CreateSubDeviceContexts(CLWDevice device,
+                                                                          std::uint32_t num_sub_devices)
+    {
+        cl_device_id device_id = device;
+
+        cl_uint num_compute_units = 0;
+        clGetDeviceInfo(device_id, CL_DEVICE_MAX_COMPUTE_UNITS, sizeof(num_compute_units), &num_compute_units, nullptr);
+
+        if (num_sub_devices == 0 || num_compute_units < num_sub_devices)
+        {
+            throw std::runtime_error("MultiDeviceScheduler: not enough compute units to partition the device");
+        }
+
+        cl_device_partition_property props[] =
+        {
+            CL_DEVICE_PARTITION_EQUALLY,
+            static_cast<cl_device_partition_property>(num_compute_units / num_sub_devices),
+            0
+        };
+
+        std::vector<cl_device_id> sub_devices(num_sub_devices);
+        cl_uint num_created = 0;
+
+        auto status = clCreateSubDevices(device_id, props, num_sub_devices, sub_devices.data(), &num_created);
+
+        if (status != CL_SUCCESS || num_created == 0)
+        {
+            throw std::runtime_error("MultiDeviceScheduler: device partitioning is not supported");
+        }
+
+        std::vector<CLWContext> contexts;
+
+        for (cl_uint i = 0; i < num_created; ++i)
+        {
+            contexts.push_back(KernelProfiler::CreateContext(CLWDevice::Create(sub_devices[i])));
+        }
+
+        LogInfo("Partitioned ", device.GetName(), " into ", num_created, " sub-devices\n");
+
+        return contexts;
+    }
+}
@@ -0,0 +1,134 @@
+/**********************************************************************
+Copyright (c) 2017 Advanced Micro Devices, Inc. All rights reserved.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+********************************************************************/
+#pragma once
+
+#include "CLW.h"
+#include "Controllers/scene_controller.h"
+#include "SceneGraph/clwscene.h"
+#include "SceneGraph/scene1.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace Baikal
+{
+    class MonteCarloRenderer;
+    class Output;
+
+    /**
+     \brief Splits rendering of a frame between several OpenCL devices.
+
+     The primary device renders the whole frame on the caller's thread. Every secondary
+     device renders a horizontal band of the frame on its own thread and periodically
+     moves the samples it has accumulated since the previous transfer into a packed tile,
+     leaving its output zeroed. Merge adds these tiles to the primary output, so each
+     sample crosses the bus exactly once and only the band of the device is transferred.
+     Band heights are rebalanced on Clear according to the measured device throughput.
+     */
+    class MultiDeviceScheduler
+    {
+    public:
+        // Rendering setup of a single device, owned by the caller
+        struct Device
+        {
+            CLWContext context;
+            SceneController<ClwScene>* controller;
+            MonteCarloRenderer* renderer;
+            Output* output;
+        };
+
+        MultiDeviceScheduler(Device const& primary,
+                             std::vector<Device> const& secondary,
+                             Scene1::Ptr scene);
+        ~MultiDeviceScheduler();
+
+        MultiDeviceScheduler(MultiDeviceScheduler const&) = delete;
+        MultiDeviceScheduler& operator = (MultiDeviceScheduler const&) = delete;
+
+        // Transfer tiles as half precision (average, count) values instead of float sums
+        void SetHalfFloatTransfer(bool enabled);
+        // Minimum time between two tile transfers of a secondary device
+        void SetTransferInterval(std::chrono::milliseconds interval);
+
+        // Start and stop secondary render threads
+        void Start();
+        void Stop();
+
+        // Restart accumulation, called after the primary output has been cleared
+        void Clear();
+        // Add tiles arrived from secondary devices to the primary output,
+        // returns the number of merged tiles
+        std::size_t Merge();
+
+        // Heights of the bands rendered by secondary devices
+        std::vector<std::uint32_t> GetBandHeights() const;
+        // Number of bytes transferred from secondary devices since construction
+        std::size_t GetNumTransferredBytes() const;
+
+        // Random seed of a secondary device given the seed of the primary one
+        static std::uint32_t GetDeviceSeed(std::uint32_t primary_seed, std::uint32_t index);
+
+        // Partition a device into equal sub-devices, each with its own context
+        static std::vector<CLWContext> CreateSubDeviceContexts(CLWDevice device,
+                                                               std::uint32_t num_sub_devices);
+
+    private:
+        // Samples of a band moved out of a secondary output
+        struct Tile
+        {
+            int y;
+            int width;
+            int height;
+            bool half_float;
+            std::uint32_t generation;
+            std::vector<char> data;
+        };
+
+        struct Worker;
+
+        void WorkerMain(Worker& worker);
+        // Extract and read back the band captured by the worker on its last clear
+        void Ship(Worker& worker, std::uint32_t generation, int band_y, int band_height);
+        void UpdateBands();
+
+        Device m_primary;
+        Scene1::Ptr m_scene;
+        std::vector<std::unique_ptr<Worker>> m_workers;
+
+        std::atomic<bool> m_half_float;
+        std::atomic<std::int64_t> m_transfer_interval;
+        // Incremented by Clear, tiles of previous generations are dropped
+        std::atomic<std::uint32_t> m_generation;
+        std::atomic<std::size_t> m_transferred_bytes;
+
+        // Tiles ready to be merged
+        std::mutex m_tiles_mutex;
+        std::vector<Tile> m_tiles;
+
+        // Primary device copy of a tile
+        CLWBuffer<char> m_tile_buffer;
+    };
+}
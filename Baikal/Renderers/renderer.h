@@ -84,9 +84,10 @@ namespace Baikal
          \brief Render single iteration.
 
          \param scene Scene to render
+         \return true if the output has converged and further iterations do not change it
          */
         virtual
-        void Render(ClwScene const& scene) = 0;
+        bool Render(ClwScene const& scene) = 0;
 
         /**
         \brief Render single iteration.
@@ -1,14 +1,21 @@
 #include "image_io.h"
 #include "../texture.h"
+#include "Utils/half.h"
 
 #include "OpenImageIO/imageio.h"
 
+#include <algorithm>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
 namespace Baikal
 {
     class Oiio : public ImageIo
     {
     public:
         Texture::Ptr LoadImage(std::string const& filename) const override;
+        Texture::Ptr LoadImageStreamed(std::string const& filename, int preview_size) const override;
         void SaveImage(std::string const& filename, Texture::Ptr texture) const override;
     };
     
@@ -107,6 +114,223 @@ namespace Baikal
         return Texture::Create(texturedata, RadeonRays::int3(spec.width, spec.height, spec.depth), fmt);;
     }
 
+    // Expand texels with an arbitrary number of channels into RGBA,
+    // single channel images are replicated into all four channels
+    template <typename T>
+    static void ExpandToRgba(T const* src, int num_channels, int num_texels, T one, T* dst)
+    {
+        for (auto i = 0; i < num_texels; ++i)
+        {
+            auto texel = src + i * num_channels;
+
+            if (num_channels == 1)
+            {
+                dst[4 * i] = dst[4 * i + 1] = dst[4 * i + 2] = dst[4 * i + 3] = texel[0];
+            }
+            else
+            {
+                dst[4 * i] = texel[0];
+                dst[4 * i + 1] = texel[1];
+                dst[4 * i + 2] = num_channels > 2 ? texel[2] : T(0);
+                dst[4 * i + 3] = num_channels > 3 ? texel[3] : one;
+            }
+        }
+    }
+
+    /**
+     \brief Reads full resolution texels of an image file on demand.
+
+     Tiled files are read one row of tiles at a time, scanline files one row at a time.
+     The last band read is kept, since texture tiles are assembled row by row.
+     */
+    class OiioTextureSource : public TextureSource
+    {
+    public:
+        OiioTextureSource(std::unique_ptr<OIIO_NAMESPACE::ImageInput> input, Texture::Format format)
+            : m_input(std::move(input))
+            , m_format(format)
+            , m_band_begin(0)
+            , m_band_end(0)
+        {
+        }
+
+        RadeonRays::int3 GetSize() const override
+        {
+            auto const& spec = m_input->spec();
+            return RadeonRays::int3(spec.width, spec.height, 1);
+        }
+
+        void ReadRow(int x, int y, int width, char* data) const override
+        {
+            OIIO_NAMESPACE_USING
+
+            std::lock_guard<std::mutex> lock(m_mutex);
+
+            auto const& spec = m_input->spec();
+            auto type = GetTextureFormat(m_format);
+            auto texel_size = type.size() * spec.nchannels;
+
+            if (y < m_band_begin || y >= m_band_end)
+            {
+                auto band_height = spec.tile_width > 0 ? spec.tile_height : 1;
+
+                m_band_begin = y - y % band_height;
+                m_band_end = std::min(m_band_begin + band_height, spec.height);
+                m_band.resize(texel_size * spec.width * (m_band_end - m_band_begin));
+
+                bool success = spec.tile_width > 0 ?
+                    m_input->read_tiles(spec.x, spec.x + spec.width,
+                                        spec.y + m_band_begin, spec.y + m_band_end,
+                                        spec.z, spec.z + 1, type, m_band.data()) :
+                    m_input->read_scanlines(spec.y + m_band_begin, spec.y + m_band_end,
+                                            spec.z, type, m_band.data());
+
+                if (!success)
+                {
+                    m_band_begin = m_band_end = 0;
+                    throw std::runtime_error("Can't read image data: " + m_input->geterror());
+                }
+            }
+
+            auto src = m_band.data() + texel_size * ((y - m_band_begin) * spec.width + x);
+
+            switch (m_format)
+            {
+            case Texture::Format::kRgba8:
+                ExpandToRgba(reinterpret_cast<std::uint8_t const*>(src), spec.nchannels, width,
+                             std::uint8_t(0xFF), reinterpret_cast<std::uint8_t*>(data));
+                break;
+            case Texture::Format::kRgba16:
+                ExpandToRgba(reinterpret_cast<std::uint16_t const*>(src), spec.nchannels, width,
+                             half(1.f).bits(), reinterpret_cast<std::uint16_t*>(data));
+                break;
+            default:
+                ExpandToRgba(reinterpret_cast<float const*>(src), spec.nchannels, width,
+                             1.f, reinterpret_cast<float*>(data));
+                break;
+            }
+        }
+
+    private:
+        mutable std::mutex m_mutex;
+        std::unique_ptr<OIIO_NAMESPACE::ImageInput> m_input;
+        Texture::Format m_format;
+        // Cached band of rows [m_band_begin, m_band_end)
+        mutable int m_band_begin;
+        mutable int m_band_end;
+        mutable std::vector<char> m_band;
+    };
+
+    Texture::Ptr Oiio::LoadImageStreamed(std::string const& filename, int preview_size) const
+    {
+        OIIO_NAMESPACE_USING
+
+        std::unique_ptr<ImageInput> input{ImageInput::open(filename)};
+
+        if (!input)
+        {
+            throw std::runtime_error("Can't load " + filename + " image");
+        }
+
+        ImageSpec const& spec = input->spec();
+
+        if (spec.depth > 1)
+        {
+            throw std::runtime_error("Can't stream volume image " + filename);
+        }
+
+        auto fmt = GetTextureFormat(spec);
+        auto source = std::make_shared<OiioTextureSource>(std::move(input), fmt);
+
+        // Preview is the first level of the mip chain fitting into preview_size
+        auto width = spec.width;
+        auto height = spec.height;
+        auto scale = 1;
+
+        while (std::max(width, height) > std::max(preview_size, 1))
+        {
+            width = std::max(width / 2, 1);
+            height = std::max(height / 2, 1);
+            scale *= 2;
+        }
+
+        // Box filter full resolution rows into the preview
+        std::vector<char> texels(4 * sizeof(float) * spec.width);
+        std::vector<float> accum(4 * width);
+
+        auto texel_size = 4 * GetTextureFormat(fmt).size();
+        auto texturedata = new char[texel_size * width * height];
+
+        for (auto y = 0; y < height; ++y)
+        {
+            std::fill(accum.begin(), accum.end(), 0.f);
+
+            auto row_begin = y * scale;
+            auto row_end = y == height - 1 ? spec.height : std::min(row_begin + scale, spec.height);
+
+            for (auto src_y = row_begin; src_y < row_end; ++src_y)
+            {
+                source->ReadRow(0, src_y, spec.width, texels.data());
+
+                for (auto src_x = 0; src_x < spec.width; ++src_x)
+                {
+                    auto x = std::min(src_x / scale, width - 1);
+
+                    for (auto c = 0; c < 4; ++c)
+                    {
+                        switch (fmt)
+                        {
+                        case Texture::Format::kRgba8:
+                            accum[4 * x + c] += reinterpret_cast<std::uint8_t const*>(texels.data())[4 * src_x + c] / 255.f;
+                            break;
+                        case Texture::Format::kRgba16:
+                        {
+                            half value;
+                            value.setBits(reinterpret_cast<std::uint16_t const*>(texels.data())[4 * src_x + c]);
+                            accum[4 * x + c] += value;
+                            break;
+                        }
+                        default:
+                            accum[4 * x + c] += reinterpret_cast<float const*>(texels.data())[4 * src_x + c];
+                            break;
+                        }
+                    }
+                }
+            }
+
+            for (auto x = 0; x < width; ++x)
+            {
+                auto column_begin = x * scale;
+                auto column_end = x == width - 1 ? spec.width : std::min(column_begin + scale, spec.width);
+                auto weight = 1.f / ((column_end - column_begin) * (row_end - row_begin));
+
+                for (auto c = 0; c < 4; ++c)
+                {
+                    auto value = accum[4 * x + c] * weight;
+                    auto idx = 4 * (y * width + x) + c;
+
+                    switch (fmt)
+                    {
+                    case Texture::Format::kRgba8:
+                        reinterpret_cast<std::uint8_t*>(texturedata)[idx] =
+                            static_cast<std::uint8_t>(std::min(std::max(value, 0.f), 1.f) * 255.f + 0.5f);
+                        break;
+                    case Texture::Format::kRgba16:
+                        reinterpret_cast<std::uint16_t*>(texturedata)[idx] = half(value).bits();
+                        break;
+                    default:
+                        reinterpret_cast<float*>(texturedata)[idx] = value;
+                        break;
+                    }
+                }
+            }
+        }
+
+        auto texture = Texture::Create(texturedata, RadeonRays::int3(width, height, 1), fmt);
+        texture->SetSource(source);
+        return texture;
+    }
+
     void Oiio::SaveImage(std::string const& filename, Texture::Ptr texture) const
     {
         OIIO_NAMESPACE_USING;
@@ -55,6 +55,9 @@ namespace Baikal
         
         // Load texture from file
         virtual Texture::Ptr LoadImage(std::string const& filename) const = 0;
+        // Load texture for streaming: only a preview no larger than preview_size
+        // is loaded into memory, full resolution texels are read from the file on demand
+        virtual Texture::Ptr LoadImageStreamed(std::string const& filename, int preview_size) const = 0;
         virtual void SaveImage(std::string const& filename, Texture::Ptr texture) const = 0;
         
         // Disallow copying
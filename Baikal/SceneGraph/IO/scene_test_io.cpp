@@ -232,6 +232,45 @@ namespace Baikal
             , false);
             scene->AttachShape(floor);
         }
+        else if (filename == "sphere+plane+10k_lights")
+        {
+            auto mesh = CreateSphere(64, 32, 2.f, float3(0.f, 2.5f, 0.f));
+            scene->AttachShape(mesh);
+
+            auto floor = CreateQuad(
+            {
+                RadeonRays::float3(-24, 0, -24),
+                RadeonRays::float3(24, 0, -24),
+                RadeonRays::float3(24, 0, 24),
+                RadeonRays::float3(-24, 0, 24),
+            }
+            , false);
+            scene->AttachShape(floor);
+
+            // 100x100 grid of dim colored lights close to the floor
+            int const grid_size = 100;
+            float const spacing = 0.4f;
+
+            for (int i = 0; i < grid_size; ++i)
+            {
+                for (int j = 0; j < grid_size; ++j)
+                {
+                    auto x = (i - 0.5f * (grid_size - 1)) * spacing;
+                    auto z = (j - 0.5f * (grid_size - 1)) * spacing;
+
+                    auto hash = static_cast<std::uint32_t>(i * grid_size + j) * 2654435761u;
+                    auto color = float3(
+                        0.2f + ((hash >> 8) & 0xff) / 255.f,
+                        0.2f + ((hash >> 16) & 0xff) / 255.f,
+                        0.2f + ((hash >> 24) & 0xff) / 255.f);
+
+                    auto light = PointLight::Create();
+                    light->SetPosition(float3(x, 0.3f, z));
+                    light->SetEmittedRadiance(0.05f * color);
+                    scene->AttachLight(light);
+                }
+            }
+        }
         else if (filename == "sphere+plane+area")
         {
             auto mesh = CreateSphere(64, 32, 2.f, float3(0.f, 2.5f, 0.f));
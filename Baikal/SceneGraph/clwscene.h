@@ -6,11 +6,19 @@
 #include "radeon_rays.h"
 #include "SceneGraph/Collector/collector.h"
 
+#include <array>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
 
 namespace Baikal
 {
     using namespace RadeonRays;
 
+    class ClwTextureStreamer;
+
     enum class CameraType
     {
         kPerspective,
@@ -24,9 +32,14 @@ namespace Baikal
     {
         #include "Kernels/CL/payload.cl"
 
-        CLWBuffer<RadeonRays::float3> vertices;
-        CLWBuffer<RadeonRays::float3> normals;
-        CLWBuffer<RadeonRays::float2> uvs;
+        // Raw InputMapData, the union itself is not default constructible on the host
+        using InputMapDataStorage = std::array<std::int32_t, 4>;
+        static_assert(sizeof(InputMapDataStorage) == sizeof(InputMapData), "InputMapDataStorage should match InputMapData");
+
+        // Vertex attributes, encoded according to vertex_format
+        CLWBuffer<char> vertices;
+        CLWBuffer<char> normals;
+        CLWBuffer<char> uvs;
         CLWBuffer<int> indices;
 
         CLWBuffer<Shape> shapes;
@@ -36,6 +49,8 @@ namespace Baikal
         CLWBuffer<Volume> volumes;
         CLWBuffer<Texture> textures;
         CLWBuffer<char> texturedata;
+        // Tile usage of streamed textures written by kernels
+        CLWBuffer<int> texturefeedback;
 
         CLWBuffer<Camera> camera;
         CLWBuffer<int> light_distributions;
@@ -47,14 +62,52 @@ namespace Baikal
         std::unique_ptr<Bundle> input_map_leafs_bundle;
         std::unique_ptr<Bundle> input_map_bundle;
 
+        // inputmaps.cl source for this scene, reapplied when the scene becomes current
+        std::string input_map_header;
+        // Input map table (and bytecode for interpreted input maps) followed by leafs,
+        // uploaded together into input_map_data
+        std::vector<InputMapDataStorage> input_map_program;
+        std::vector<InputMapDataStorage> input_map_leafs;
+        // Leafs gathered into per input slots for generated input maps, empty if leafs go as is
+        std::vector<std::uint32_t> input_map_leaf_indices;
+
+        // Byte offsets of texture data within texturedata buffer,
+        // has an extra entry holding the total size
+        std::vector<std::size_t> texture_data_offsets;
+
+        // Tile streaming state of large textures (null if streaming is disabled)
+        std::shared_ptr<ClwTextureStreamer> texture_streamer;
+
+        // Environment light importance sampling distribution (host copy)
+        // and the texture it has been built for
+        std::vector<int> env_light_distribution;
+        std::weak_ptr<Baikal::Texture> env_light_distribution_texture;
+
+        // SceneObject change counter the scene has been compiled at,
+        // host side copies of compiled data are refreshed once it moves
+        std::uint64_t revision = 0;
+
         int num_lights;
         int num_volumes;
         int envmapidx;
         int background_idx;
+        VertexFormat vertex_format;
         int camera_volume_index;
         CameraType camera_type;
 
+        // Intersector shape created for a scene shape
+        struct IntersectorShape
+        {
+            RadeonRays::Shape* shape;
+            // Base mesh intersector shape for instances, geometry version for meshes,
+            // the shape is recreated if either of them changes.
+            RadeonRays::Shape* base_shape;
+            std::uint32_t geometry_version;
+        };
+
         std::vector<RadeonRays::Shape*> isect_shapes;
         std::vector<RadeonRays::Shape*> visible_shapes;
+        // Persistent mapping used to update intersector incrementally
+        std::map<Baikal::Shape::Ptr, IntersectorShape> isect_shape_map;
     };
 }
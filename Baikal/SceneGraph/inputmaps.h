@@ -135,6 +135,7 @@ namespace Baikal
             m_texture = texture;
             assert(m_texture);
             SetDirty(true);
+            NotifyStructureChanged();
         }
 
         virtual Texture::Ptr GetTexture() const
@@ -205,6 +206,7 @@ namespace Baikal
             m_a = a;
             assert(m_a);
             SetDirty(true);
+            NotifyStructureChanged();
         }
 
         void SetB(InputMap::Ptr b)
@@ -212,6 +214,7 @@ namespace Baikal
             m_b = b;
             assert(m_b);
             SetDirty(true);
+            NotifyStructureChanged();
         }
 
         InputMap::Ptr GetA() const
@@ -294,6 +297,7 @@ namespace Baikal
             m_arg = arg;
             assert(m_arg);
             SetDirty(true);
+            NotifyStructureChanged();
         }
 
         InputMap::Ptr GetArg() const
@@ -355,6 +359,7 @@ namespace Baikal
             m_control = control;
             assert(m_control);
             SetDirty(true);
+            NotifyStructureChanged();
         }
 
         InputMap::Ptr GetControl() const
@@ -555,6 +560,7 @@ namespace Baikal
             m_source_range = source_range;
             assert(m_source_range);
             SetDirty(true);
+            NotifyStructureChanged();
         }
 
         void SetDestinationRange(InputMap::Ptr destination_range)
@@ -562,6 +568,7 @@ namespace Baikal
             m_destination_range = destination_range;
             assert(m_destination_range);
             SetDirty(true);
+            NotifyStructureChanged();
         }
 
         InputMap::Ptr GetSourceRange() const
@@ -579,6 +586,7 @@ namespace Baikal
             m_data = data;
             assert(m_data);
             SetDirty(true);
+            NotifyStructureChanged();
         }
 
         InputMap::Ptr GetData() const
@@ -63,6 +63,7 @@ namespace Baikal
     {
         m_texture = texture;
         SetDirty(true);
+        NotifyStructureChanged();
     }
 
     Texture::Ptr ImageBasedLight::GetTexture() const
@@ -106,6 +107,7 @@ namespace Baikal
     {
         m_reflection_texture = texture;
         SetDirty(true);
+        NotifyStructureChanged();
     }
 
     Texture::Ptr ImageBasedLight::GetReflectionTexture() const
@@ -117,6 +119,7 @@ namespace Baikal
     {
         m_refraction_texture = texture;
         SetDirty(true);
+        NotifyStructureChanged();
     }
 
     Texture::Ptr ImageBasedLight::GetRefractionTexture() const
@@ -128,6 +131,7 @@ namespace Baikal
     {
         m_transparency_texture = texture;
         SetDirty(true);
+        NotifyStructureChanged();
     }
 
     Texture::Ptr ImageBasedLight::GetTransparencyTexture() const
@@ -139,6 +143,7 @@ namespace Baikal
     {
         m_background_texture = texture;
         SetDirty(true);
+        NotifyStructureChanged();
     }
 
     Texture::Ptr ImageBasedLight::GetBackgroundTexture() const
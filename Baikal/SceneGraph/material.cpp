@@ -6,6 +6,17 @@
 
 namespace Baikal
 {
+    namespace
+    {
+        // Inputs of these types reference other scene objects
+        bool IsReference(Material::InputType type)
+        {
+            return type == Material::InputType::kTexture ||
+                   type == Material::InputType::kMaterial ||
+                   type == Material::InputType::kInputMap;
+        }
+    }
+
     Material::Material()
     : m_thin(false)
     {
@@ -149,17 +160,31 @@ namespace Baikal
     void Material::SetInputValue(std::string const& name, uint32_t value)
     {
         auto& input = GetInput(name, InputType::kUint);
+        bool was_reference = IsReference(input.value.type);
         input.value.type = InputType::kUint;
         input.value.uint_value = value;
         SetDirty(true);
+
+        // Replacing a texture or a material changes the set of used objects
+        if (was_reference)
+        {
+            NotifyStructureChanged();
+        }
     }
 
     void Material::SetInputValue(std::string const& name, RadeonRays::float4 const& value)
     {
         auto& input = GetInput(name, InputType::kFloat4);
+        bool was_reference = IsReference(input.value.type);
         input.value.type = InputType::kFloat4;
         input.value.float_value = value;
         SetDirty(true);
+
+        // Replacing a texture or a material changes the set of used objects
+        if (was_reference)
+        {
+            NotifyStructureChanged();
+        }
     }
 
     void Material::SetInputValue(std::string const& name, Texture::Ptr texture)
@@ -168,6 +193,7 @@ namespace Baikal
         input.value.type = InputType::kTexture;
         input.value.tex_value = texture;
         SetDirty(true);
+        NotifyStructureChanged();
     }
 
     void Material::SetInputValue(std::string const& name, Material::Ptr material)
@@ -176,6 +202,7 @@ namespace Baikal
         input.value.type = InputType::kMaterial;
         input.value.mat_value = material;
         SetDirty(true);
+        NotifyStructureChanged();
     }
 
     void Material::SetInputValue(std::string const& name, Baikal::InputMap::Ptr inputMap)
@@ -184,6 +211,7 @@ namespace Baikal
         input.value.type = InputType::kInputMap;
         input.value.input_map_value = inputMap;
         SetDirty(true);
+        NotifyStructureChanged();
     }
 
     Material::InputValue Material::GetInputValue(std::string const& name) const
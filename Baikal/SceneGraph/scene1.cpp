@@ -22,6 +22,8 @@ namespace Baikal
         Camera::Ptr m_camera;
         Baikal::Texture::Ptr m_background_texture;
         EnvironmentOverride m_environment_override;
+        InputMapMode m_input_map_mode;
+        LightSamplingMode m_light_sampling_mode;
 
         DirtyFlags m_dirty_flags;
     };
@@ -30,6 +32,8 @@ namespace Baikal
     : m_impl(new SceneImpl)
     {
         m_impl->m_camera = nullptr;
+        m_impl->m_input_map_mode = InputMapMode::kGenerated;
+        m_impl->m_light_sampling_mode = LightSamplingMode::kPower;
         ClearDirtyFlags();
     }
 
@@ -48,6 +52,7 @@ namespace Baikal
     void Scene1::SetDirtyFlag(DirtyFlags flag) const
     {
         m_impl->m_dirty_flags = m_impl->m_dirty_flags | flag;
+        SceneObject::NotifyChanged();
     }
 
     void Scene1::SetCamera(Camera::Ptr camera)
@@ -212,12 +217,41 @@ namespace Baikal
         check_and_set_light(m_impl->m_environment_override.m_refraction, env_override.m_refraction);
         check_and_set_light(m_impl->m_environment_override.m_transparency, env_override.m_transparency);
         m_impl->m_environment_override = env_override;
+        SetDirtyFlag(kLights);
     }
     const Scene1::EnvironmentOverride& Scene1::GetEnvironmentOverride() const
     {
         return m_impl->m_environment_override;
     }
 
+    void Scene1::SetInputMapMode(InputMapMode mode)
+    {
+        if (m_impl->m_input_map_mode != mode)
+        {
+            m_impl->m_input_map_mode = mode;
+            SetDirtyFlag(kInputMaps);
+        }
+    }
+
+    Scene1::InputMapMode Scene1::GetInputMapMode() const
+    {
+        return m_impl->m_input_map_mode;
+    }
+
+    void Scene1::SetLightSamplingMode(LightSamplingMode mode)
+    {
+        if (m_impl->m_light_sampling_mode != mode)
+        {
+            m_impl->m_light_sampling_mode = mode;
+            SetDirtyFlag(kLights);
+        }
+    }
+
+    Scene1::LightSamplingMode Scene1::GetLightSamplingMode() const
+    {
+        return m_impl->m_light_sampling_mode;
+    }
+
     namespace {
         struct Scene1Concrete : public Scene1 {
         };
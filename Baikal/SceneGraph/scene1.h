@@ -55,16 +55,36 @@ namespace Baikal
         using Ptr = std::shared_ptr<Scene1>;
         static Ptr Create();
         
-        // Dirty flags are used to perform partial buffer updates to save traffic
+        // Dirty flags are used to perform partial buffer updates to save traffic.
+        // Flags are combined into a bitmask, so each of them occupies a separate bit.
         using DirtyFlags = std::uint32_t;
-        enum
+        enum : DirtyFlags
         {
-            kNone,
-            kLights,
-            kShapes,
-            kShapeTransforms,
-            kCamera,
-            kBackground
+            kNone = 0,
+            kLights = 0x1 << 0,
+            kShapes = 0x1 << 1,
+            kShapeTransforms = 0x1 << 2,
+            kCamera = 0x1 << 3,
+            kBackground = 0x1 << 4,
+            kInputMaps = 0x1 << 5
+        };
+
+        // Input maps are either compiled into kernel source, which requires
+        // program rebuild on graph change, or evaluated by a kernel side interpreter.
+        // Graphs too large for the interpreter fall back to kernel source.
+        enum class InputMapMode
+        {
+            kGenerated,
+            kInterpreted
+        };
+
+        // Lights are selected either proportionally to their power or by descending
+        // light BVH, which accounts for their distance and orientation to a shading point.
+        // Power sampling is the default.
+        enum class LightSamplingMode
+        {
+            kPower,
+            kBvh
         };
 
         struct EnvironmentOverride
@@ -122,6 +142,14 @@ namespace Baikal
 
         void SetEnvironmentOverride(const EnvironmentOverride& env_override);
         const EnvironmentOverride& GetEnvironmentOverride() const;
+
+        // Input map evaluation mode
+        void SetInputMapMode(InputMapMode mode);
+        InputMapMode GetInputMapMode() const;
+
+        // Light selection mode
+        void SetLightSamplingMode(LightSamplingMode mode);
+        LightSamplingMode GetLightSamplingMode() const;
         
         // Forbidden stuff
         Scene1(Scene1 const&) = delete;
@@ -1,3 +1,57 @@
 #include "scene_object.h"
 
-std::uint32_t Baikal::SceneObject::m_next_id = 0;
\ No newline at end of file
+#include <deque>
+#include <mutex>
+#include <utility>
+
+std::uint32_t Baikal::SceneObject::m_next_id = 0;
+std::atomic<std::uint64_t> Baikal::SceneObject::m_change_counter(0);
+std::atomic<std::uint64_t> Baikal::SceneObject::m_structure_counter(0);
+
+namespace
+{
+    // Longer edit sequences fall back to dirty flag scans
+    std::size_t constexpr kMaxChangeLogSize = 4096;
+
+    std::mutex g_change_log_mutex;
+    // (change counter, object id) pairs in counter order
+    std::deque<std::pair<std::uint64_t, std::uint32_t>> g_change_log;
+    // All changes after this counter value are in the log
+    std::uint64_t g_change_log_start = 0;
+}
+
+namespace Baikal
+{
+    void SceneObject::RecordChange(std::uint32_t id)
+    {
+        std::lock_guard<std::mutex> lock(g_change_log_mutex);
+
+        auto counter = m_change_counter.fetch_add(1, std::memory_order_acq_rel) + 1;
+        g_change_log.emplace_back(counter, id);
+
+        if (g_change_log.size() > kMaxChangeLogSize)
+        {
+            g_change_log_start = g_change_log.front().first;
+            g_change_log.pop_front();
+        }
+    }
+
+    bool SceneObject::GetChangedObjects(std::uint64_t since, std::vector<std::uint32_t>& ids)
+    {
+        std::lock_guard<std::mutex> lock(g_change_log_mutex);
+
+        if (since < g_change_log_start)
+        {
+            return false;
+        }
+
+        // Counters only grow, so the entries we need are at the back
+        auto iter = g_change_log.crbegin();
+        for (; iter != g_change_log.crend() && iter->first > since; ++iter)
+        {
+            ids.push_back(iter->second);
+        }
+
+        return true;
+    }
+}
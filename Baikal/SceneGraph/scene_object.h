@@ -28,6 +28,8 @@
  */
 #pragma once
 
+#include <atomic>
+#include <cstdint>
 #include <string>
 #include <memory>
 #include <vector>
@@ -57,21 +59,48 @@ namespace Baikal
         inline std::uint32_t GetId() const
         { return m_id; }
 
+        // Number of times the object has been marked dirty. Together with the id
+        // it identifies object state without looking at the data.
+        inline std::uint32_t GetRevision() const
+        { return m_revision; }
+
+        // Global counter of edits, incremented each time any object is marked dirty.
+        // Equal values mean no scene object has been changed in between.
+        static std::uint64_t GetChangeCounter();
+        // Bump the counter for changes not tracked by object dirty flags
+        static void NotifyChanged();
+        // Ids of objects marked dirty after the change counter had a given value.
+        // Returns false if the log does not reach back that far, callers have to
+        // look at dirty flags of all their objects then.
+        static bool GetChangedObjects(std::uint64_t since, std::vector<std::uint32_t>& ids);
+
+        // Global counter of structural edits, incremented each time a reference
+        // between objects (shape material, material texture, etc) is reassigned.
+        static std::uint64_t GetStructureCounter();
+        // Bump the structure counter, called along with marking the object dirty
+        static void NotifyStructureChanged();
+
     protected:
         // Constructor
         SceneObject();
         
     private:
         mutable bool m_dirty;
+        mutable std::uint32_t m_revision;
 
         std::string m_name;
         std::uint32_t m_id;
         static std::uint32_t m_next_id;
+        static std::atomic<std::uint64_t> m_change_counter;
+        static std::atomic<std::uint64_t> m_structure_counter;
+
+        // Add object id to the change log and bump the change counter
+        static void RecordChange(std::uint32_t id);
         
     };
 
     inline SceneObject::SceneObject()
-    : m_dirty(false), m_id(m_next_id++)
+    : m_dirty(false), m_revision(0), m_id(m_next_id++)
     {
     }
     
@@ -87,6 +116,32 @@ namespace Baikal
     inline void SceneObject::SetDirty(bool dirty) const
     {
         m_dirty = dirty;
+
+        if (dirty)
+        {
+            ++m_revision;
+            RecordChange(m_id);
+        }
+    }
+
+    inline std::uint64_t SceneObject::GetChangeCounter()
+    {
+        return m_change_counter.load(std::memory_order_acquire);
+    }
+
+    inline void SceneObject::NotifyChanged()
+    {
+        m_change_counter.fetch_add(1, std::memory_order_acq_rel);
+    }
+
+    inline std::uint64_t SceneObject::GetStructureCounter()
+    {
+        return m_structure_counter.load(std::memory_order_acquire);
+    }
+
+    inline void SceneObject::NotifyStructureChanged()
+    {
+        m_structure_counter.fetch_add(1, std::memory_order_acq_rel);
     }
     
     inline std::string SceneObject::GetName() const
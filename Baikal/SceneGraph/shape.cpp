@@ -4,12 +4,14 @@
 namespace Baikal
 {
     Mesh::Mesh() :
-    m_aabb_cached(false)
+    m_aabb_cached(false),
+    m_geometry_version(0)
     {
     }
     
     void Mesh::SetIndices(std::uint32_t const* indices, std::size_t num_indices)
     {
+        ++m_geometry_version;
         assert(indices);
         assert(num_indices != 0);
         
@@ -23,6 +25,7 @@ namespace Baikal
 
     void Mesh::SetIndices(std::vector<std::uint32_t>&& indices)
     {
+        ++m_geometry_version;
         m_indices = std::move(indices);
     }
 
@@ -38,6 +41,7 @@ namespace Baikal
     
     void Mesh::SetVertices(RadeonRays::float3 const* vertices, std::size_t num_vertices)
     {
+        ++m_geometry_version;
         assert(vertices);
         assert(num_vertices != 0);
         
@@ -51,6 +55,7 @@ namespace Baikal
     
     void Mesh::SetVertices(float const* vertices, std::size_t num_vertices)
     {
+        ++m_geometry_version;
         assert(vertices);
         assert(num_vertices != 0);
         
@@ -70,6 +75,7 @@ namespace Baikal
 
     void Mesh::SetVertices(std::vector<RadeonRays::float3>&& vertices)
     {
+        ++m_geometry_version;
         m_vertices = std::move(vertices);
     }
 
@@ -86,6 +92,7 @@ namespace Baikal
     
     void Mesh::SetNormals(RadeonRays::float3 const* normals, std::size_t num_normals)
     {
+        ++m_geometry_version;
         assert(normals);
         assert(num_normals != 0);
         
@@ -99,6 +106,7 @@ namespace Baikal
     
     void Mesh::SetNormals(float const* normals, std::size_t num_normals)
     {
+        ++m_geometry_version;
         assert(normals);
         assert(num_normals != 0);
         
@@ -118,6 +126,7 @@ namespace Baikal
 
     void Mesh::SetNormals(std::vector<RadeonRays::float3>&& normals)
     {
+        ++m_geometry_version;
         m_normals = std::move(normals);
     }
 
@@ -134,6 +143,7 @@ namespace Baikal
 
     void Mesh::SetUVs(RadeonRays::float2 const* uvs, std::size_t num_uvs)
     {
+        ++m_geometry_version;
         assert(uvs);
         assert(num_uvs != 0);
         
@@ -147,6 +157,7 @@ namespace Baikal
     
     void Mesh::SetUVs(float const* uvs, std::size_t num_uvs)
     {
+        ++m_geometry_version;
         assert(uvs);
         assert(num_uvs != 0);
         
@@ -164,6 +175,7 @@ namespace Baikal
 
     void Mesh::SetUVs(std::vector<RadeonRays::float2>&& uvs)
     {
+        ++m_geometry_version;
         m_uvs = std::move(uvs);
     }
 
@@ -158,6 +158,9 @@ namespace Baikal
         // Local space AABB
         RadeonRays::bbox GetLocalAABB() const override;
 
+        // Incremented each time vertices, normals, uvs or indices are replaced
+        std::uint32_t GetGeometryVersion() const { return m_geometry_version; }
+
         // We need to override it since mesh changes trigger
         // m_aabb_cached flag reset
         void SetDirty(bool dirty) const override;
@@ -177,6 +180,7 @@ namespace Baikal
 
         mutable RadeonRays::bbox m_aabb;
         mutable bool m_aabb_cached;
+        std::uint32_t m_geometry_version;
     };
     
     inline Shape::~Shape()
@@ -194,6 +198,7 @@ namespace Baikal
     {
         m_material = material;
         SetDirty(true);
+        NotifyStructureChanged();
     }
     
     inline Material::Ptr Shape::GetMaterial() const
@@ -205,6 +210,7 @@ namespace Baikal
     {
         m_volume = volume_mat;
         SetDirty(true);
+        NotifyStructureChanged();
     }
 
     inline VolumeMaterial::Ptr Shape::GetVolumeMaterial() const
@@ -40,6 +40,28 @@ namespace Baikal
 {
     class Material;
 
+    /**
+     \brief Source of full resolution texel data for out-of-core textures.
+
+     A texture with a source keeps only a downscaled preview of the image in memory.
+     Renderers supporting texture streaming read full resolution texels from the source on demand.
+     */
+    class TextureSource
+    {
+    public:
+        using Ptr = std::shared_ptr<TextureSource>;
+
+        // Destructor
+        virtual ~TextureSource() = default;
+
+        // Get full resolution image dimensions
+        virtual RadeonRays::int3 GetSize() const = 0;
+        // Read texels [x, x + width) of full resolution row y into data.
+        // Texels are RGBA in the format of the texture owning the source.
+        // Might be called from a background thread.
+        virtual void ReadRow(int x, int y, int width, char* data) const = 0;
+    };
+
     /**
      \brief Texture class.
 
@@ -77,6 +99,11 @@ namespace Baikal
         // Average normalized value
         RadeonRays::float3 ComputeAverageValue() const;
 
+        // Set full resolution texel source, texture data is treated as a preview then
+        void SetSource(TextureSource::Ptr source);
+        // Get full resolution texel source (nullptr if texture data is all there is)
+        TextureSource::Ptr GetSource() const;
+
         // Disallow copying
         Texture(Texture const&) = delete;
         Texture& operator = (Texture const&) = delete;
@@ -94,6 +121,8 @@ namespace Baikal
         RadeonRays::int3 m_size;
         // Format
         Format m_format;
+        // Full resolution source (optional)
+        TextureSource::Ptr m_source;
     };
 
     inline Texture::Texture()
@@ -148,6 +177,17 @@ namespace Baikal
         return m_format;
     }
 
+    inline void Texture::SetSource(TextureSource::Ptr source)
+    {
+        m_source = source;
+        SetDirty(true);
+    }
+
+    inline TextureSource::Ptr Texture::GetSource() const
+    {
+        return m_source;
+    }
+
     inline std::size_t Texture::GetSizeInBytes() const
     {
         std::uint32_t component_size = 1;
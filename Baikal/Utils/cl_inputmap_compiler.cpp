@@ -0,0 +1,371 @@
+/**********************************************************************
+Copyright (c) 2017 Advanced Micro Devices, Inc. All rights reserved.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+********************************************************************/
+
+
+#include <assert.h>
+
+#include <cstring>
+#include <algorithm>
+#include <map>
+
+#include "cl_inputmap_compiler.h"
+#include "SceneGraph/inputmaps.h"
+
+
+using namespace Baikal;
+
+const std::string& CLInputMapCompiler::GetInterpreterPath()
+{
+    static const std::string path = "../Baikal/Kernels/CL/input_map_interpreter.cl";
+    return path;
+}
+
+std::string CLInputMapCompiler::GetInterpreterSource()
+{
+    return "#ifndef INPUTMAPS_CL\n#define INPUTMAPS_CL\n\n"
+        "#include <" + GetInterpreterPath() + ">\n\n"
+        "#endif\n\n";
+}
+
+bool CLInputMapCompiler::Compile(const Collector& input_map_collector, const Collector& input_map_leaf_collector)
+{
+    m_program.clear();
+    m_register_counts.clear();
+
+    // Interpreter does a binary search over program table, so sort it by id using map
+    std::map <uint32_t, InputMap::Ptr> inputs;
+
+    auto mat_iter = input_map_collector.CreateIterator();
+    for (; mat_iter->IsValid(); mat_iter->Next())
+    {
+        auto input = mat_iter->ItemAs<InputMap>();
+        inputs.insert(std::make_pair(input->GetId(), input));
+    }
+
+    // Check register pressure before emitting anything, so a failed compile leaves no partial program
+    for (auto &input : inputs)
+    {
+        if (GetRegisterCount(input.second) > kMaxRegisters)
+        {
+            m_program.clear();
+            return false;
+        }
+    }
+
+    // Header and program table are filled once program offsets are known
+    m_program.resize(1 + inputs.size());
+
+    std::uint32_t table_index = 1;
+    for (auto &input : inputs)
+    {
+        auto offset = static_cast<int>(m_program.size());
+
+        CompileInput(input.second, input_map_leaf_collector, 0);
+        Emit(ClwScene::kInputMapOpReturn, 0, 0);
+
+        m_program[table_index++] = { { static_cast<std::int32_t>(input.first), offset, 0, 0 } };
+    }
+
+    // Leafs follow the program
+    m_program[0] = { { static_cast<std::int32_t>(inputs.size()), static_cast<std::int32_t>(m_program.size()), 0, 0 } };
+
+    return true;
+}
+
+void CLInputMapCompiler::Emit(int op, std::uint32_t dst, std::uint32_t a, std::uint32_t b)
+{
+    EmitInt4(op, static_cast<int>(dst), static_cast<int>(a), static_cast<int>(b));
+}
+
+void CLInputMapCompiler::EmitInt4(int x, int y, int z, int w)
+{
+    m_program.push_back({ { x, y, z, w } });
+}
+
+void CLInputMapCompiler::EmitFloat4(float x, float y, float z, float w)
+{
+    float values[4] = { x, y, z, w };
+    ClwScene::InputMapDataStorage data;
+    std::memcpy(data.data(), values, sizeof(values));
+    m_program.push_back(data);
+}
+
+std::vector<InputMap::Ptr> CLInputMapCompiler::GetArguments(const InputMap& input)
+{
+    switch (input.m_type)
+    {
+        // Two inputs
+        case InputMap::InputMapType::kAdd:
+        case InputMap::InputMapType::kSub:
+        case InputMap::InputMapType::kMul:
+        case InputMap::InputMapType::kDiv:
+        case InputMap::InputMapType::kMin:
+        case InputMap::InputMapType::kMax:
+        case InputMap::InputMapType::kPow:
+        case InputMap::InputMapType::kMod:
+        case InputMap::InputMapType::kDot3:
+        case InputMap::InputMapType::kDot4:
+        case InputMap::InputMapType::kCross3:
+        case InputMap::InputMapType::kCross4:
+        case InputMap::InputMapType::kShuffle2:
+        {
+            // All two argument input maps share layout
+            const InputMap_Add &i = static_cast<const InputMap_Add&>(input);
+            return { i.GetA(), i.GetB() };
+        }
+        // Single input
+        case InputMap::InputMapType::kSin:
+        case InputMap::InputMapType::kCos:
+        case InputMap::InputMapType::kTan:
+        case InputMap::InputMapType::kAsin:
+        case InputMap::InputMapType::kAcos:
+        case InputMap::InputMapType::kAtan:
+        case InputMap::InputMapType::kLength3:
+        case InputMap::InputMapType::kNormalize3:
+        case InputMap::InputMapType::kFloor:
+        case InputMap::InputMapType::kAbs:
+        case InputMap::InputMapType::kSelect:
+        case InputMap::InputMapType::kShuffle:
+        case InputMap::InputMapType::kMatMul:
+        {
+            // All single argument input maps share layout
+            const InputMap_Sin &i = static_cast<const InputMap_Sin&>(input);
+            return { i.GetArg() };
+        }
+        case InputMap::InputMapType::kLerp:
+        {
+            const InputMap_Lerp &i = static_cast<const InputMap_Lerp&>(input);
+            return { i.GetA(), i.GetB(), i.GetControl() };
+        }
+        case InputMap::InputMapType::kRemap:
+        {
+            const InputMap_Remap &i = static_cast<const InputMap_Remap&>(input);
+            return { i.GetData(), i.GetSourceRange(), i.GetDestinationRange() };
+        }
+        default:
+            // Leafs
+            return {};
+    }
+}
+
+std::vector<std::size_t> CLInputMapCompiler::GetEvaluationOrder(const std::vector<InputMap::Ptr>& args)
+{
+    std::vector<std::size_t> order(args.size());
+    for (std::size_t i = 0; i < order.size(); ++i)
+    {
+        order[i] = i;
+    }
+
+    // Most demanding argument goes first, while nothing else is held in registers
+    std::stable_sort(order.begin(), order.end(), [&](std::size_t a, std::size_t b)
+    {
+        return GetRegisterCount(args[a]) > GetRegisterCount(args[b]);
+    });
+
+    return order;
+}
+
+std::uint32_t CLInputMapCompiler::GetRegisterCount(const InputMap::Ptr& input)
+{
+    auto iter = m_register_counts.find(input.get());
+    if (iter != m_register_counts.end())
+    {
+        return iter->second;
+    }
+
+    // Sethi-Ullman numbering: k-th evaluated argument keeps k results of previous ones alive
+    auto args = GetArguments(*input);
+    auto order = GetEvaluationOrder(args);
+
+    std::uint32_t count = 1;
+    for (std::size_t k = 0; k < order.size(); ++k)
+    {
+        count = std::max(count, GetRegisterCount(args[order[k]]) + static_cast<std::uint32_t>(k));
+    }
+
+    m_register_counts[input.get()] = count;
+    return count;
+}
+
+void CLInputMapCompiler::CompileInput(std::shared_ptr<Baikal::InputMap> input, const Collector& input_map_leaf_collector, std::uint32_t reg)
+{
+    // Compile checks register pressure up front
+    assert(reg + GetRegisterCount(input) <= kMaxRegisters);
+
+    switch (input->m_type)
+    {
+        // Leafs
+        case InputMap::InputMapType::kConstantFloat:
+        case InputMap::InputMapType::kConstantFloat3:
+        {
+            auto index = input_map_leaf_collector.GetItemIndex(input);
+            Emit(ClwScene::kInputMapOpConstant, reg, index);
+            return;
+        }
+        case InputMap::InputMapType::kSampler:
+        {
+            auto index = input_map_leaf_collector.GetItemIndex(input);
+            Emit(ClwScene::kInputMapOpSampler, reg, index);
+            return;
+        }
+        case InputMap::InputMapType::kSamplerBumpmap:
+        {
+            auto index = input_map_leaf_collector.GetItemIndex(input);
+            Emit(ClwScene::kInputMapOpSamplerBumpmap, reg, index);
+            return;
+        }
+        default:
+            break;
+    }
+
+    // Arguments are placed starting from the destination register: the interpreter
+    // reads operands before writing the result, so the first one can be overwritten
+    auto args = GetArguments(*input);
+    auto order = GetEvaluationOrder(args);
+    std::vector<std::uint32_t> regs(args.size());
+
+    for (std::size_t k = 0; k < order.size(); ++k)
+    {
+        regs[order[k]] = reg + static_cast<std::uint32_t>(k);
+        CompileInput(args[order[k]], input_map_leaf_collector, regs[order[k]]);
+    }
+
+    switch (input->m_type)
+    {
+        // Two inputs
+        case InputMap::InputMapType::kAdd:
+        case InputMap::InputMapType::kSub:
+        case InputMap::InputMapType::kMul:
+        case InputMap::InputMapType::kDiv:
+        case InputMap::InputMapType::kMin:
+        case InputMap::InputMapType::kMax:
+        case InputMap::InputMapType::kPow:
+        case InputMap::InputMapType::kMod:
+        case InputMap::InputMapType::kDot3:
+        case InputMap::InputMapType::kDot4:
+        case InputMap::InputMapType::kCross3:
+        case InputMap::InputMapType::kCross4:
+        {
+            static const std::map<InputMap::InputMapType, int> ops =
+            {
+                { InputMap::InputMapType::kAdd, ClwScene::kInputMapOpAdd },
+                { InputMap::InputMapType::kSub, ClwScene::kInputMapOpSub },
+                { InputMap::InputMapType::kMul, ClwScene::kInputMapOpMul },
+                { InputMap::InputMapType::kDiv, ClwScene::kInputMapOpDiv },
+                { InputMap::InputMapType::kMin, ClwScene::kInputMapOpMin },
+                { InputMap::InputMapType::kMax, ClwScene::kInputMapOpMax },
+                { InputMap::InputMapType::kPow, ClwScene::kInputMapOpPow },
+                { InputMap::InputMapType::kMod, ClwScene::kInputMapOpMod },
+                { InputMap::InputMapType::kDot3, ClwScene::kInputMapOpDot3 },
+                { InputMap::InputMapType::kDot4, ClwScene::kInputMapOpDot4 },
+                { InputMap::InputMapType::kCross3, ClwScene::kInputMapOpCross3 },
+                { InputMap::InputMapType::kCross4, ClwScene::kInputMapOpCross4 }
+            };
+
+            Emit(ops.at(input->m_type), reg, regs[0], regs[1]);
+            break;
+        }
+        // Single input
+        case InputMap::InputMapType::kSin:
+        case InputMap::InputMapType::kCos:
+        case InputMap::InputMapType::kTan:
+        case InputMap::InputMapType::kAsin:
+        case InputMap::InputMapType::kAcos:
+        case InputMap::InputMapType::kAtan:
+        case InputMap::InputMapType::kLength3:
+        case InputMap::InputMapType::kNormalize3:
+        case InputMap::InputMapType::kFloor:
+        case InputMap::InputMapType::kAbs:
+        {
+            static const std::map<InputMap::InputMapType, int> ops =
+            {
+                { InputMap::InputMapType::kSin, ClwScene::kInputMapOpSin },
+                { InputMap::InputMapType::kCos, ClwScene::kInputMapOpCos },
+                { InputMap::InputMapType::kTan, ClwScene::kInputMapOpTan },
+                { InputMap::InputMapType::kAsin, ClwScene::kInputMapOpAsin },
+                { InputMap::InputMapType::kAcos, ClwScene::kInputMapOpAcos },
+                { InputMap::InputMapType::kAtan, ClwScene::kInputMapOpAtan },
+                { InputMap::InputMapType::kLength3, ClwScene::kInputMapOpLength3 },
+                { InputMap::InputMapType::kNormalize3, ClwScene::kInputMapOpNormalize3 },
+                { InputMap::InputMapType::kFloor, ClwScene::kInputMapOpFloor },
+                { InputMap::InputMapType::kAbs, ClwScene::kInputMapOpAbs }
+            };
+
+            Emit(ops.at(input->m_type), reg, regs[0]);
+            break;
+        }
+        // Specials
+        case InputMap::InputMapType::kLerp:
+        {
+            Emit(ClwScene::kInputMapOpLerp, reg, regs[0], regs[1]);
+            EmitInt4(regs[2], 0, 0, 0);
+            break;
+        }
+        case InputMap::InputMapType::kSelect:
+        {
+            InputMap_Select *i = static_cast<InputMap_Select*>(input.get());
+            assert(static_cast<uint32_t>(i->GetSelection()) < 4);
+
+            Emit(ClwScene::kInputMapOpSelect, reg, regs[0], static_cast<std::uint32_t>(i->GetSelection()));
+            break;
+        }
+        case InputMap::InputMapType::kShuffle:
+        {
+            InputMap_Shuffle *i = static_cast<InputMap_Shuffle*>(input.get());
+            auto mask = i->GetMask();
+
+            Emit(ClwScene::kInputMapOpShuffle, reg, regs[0]);
+            EmitInt4(mask[0], mask[1], mask[2], mask[3]);
+            break;
+        }
+        case InputMap::InputMapType::kShuffle2:
+        {
+            InputMap_Shuffle2 *i = static_cast<InputMap_Shuffle2*>(input.get());
+            auto mask = i->GetMask();
+
+            Emit(ClwScene::kInputMapOpShuffle2, reg, regs[0], regs[1]);
+            EmitInt4(mask[0], mask[1], mask[2], mask[3]);
+            break;
+        }
+        case InputMap::InputMapType::kMatMul:
+        {
+            InputMap_MatMul *i = static_cast<InputMap_MatMul*>(input.get());
+            auto mat4 = i->GetMatrix();
+
+            Emit(ClwScene::kInputMapOpMatMul, reg, regs[0]);
+            EmitFloat4(mat4.m00, mat4.m01, mat4.m02, mat4.m03);
+            EmitFloat4(mat4.m10, mat4.m11, mat4.m12, mat4.m13);
+            EmitFloat4(mat4.m20, mat4.m21, mat4.m22, mat4.m23);
+            EmitFloat4(mat4.m30, mat4.m31, mat4.m32, mat4.m33);
+            break;
+        }
+        case InputMap::InputMapType::kRemap:
+        {
+            Emit(ClwScene::kInputMapOpRemap, reg, regs[0], regs[1]);
+            EmitInt4(regs[2], 0, 0, 0);
+            break;
+        }
+        default:
+            //Shouldn't happen
+            assert(false);
+    }
+}
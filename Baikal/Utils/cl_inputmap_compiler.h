@@ -0,0 +1,97 @@
+/**********************************************************************
+Copyright (c) 2017 Advanced Micro Devices, Inc. All rights reserved.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+********************************************************************/
+
+
+
+#pragma once
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "SceneGraph/Collector/collector.h"
+#include "SceneGraph/clwscene.h"
+#include "SceneGraph/inputmap.h"
+
+namespace Baikal
+{
+    /**
+     * @brief Flattens input map graphs into bytecode for the kernel side interpreter.
+     *
+     * Unlike CLInputMapGenerator, output does not depend on graph structure from
+     * the kernel point of view: the interpreter source is fixed, so graph edits
+     * only require a buffer upload instead of program recompilation.
+     * Instruction set is described by InputMapOp in payload.cl, buffer layout in
+     * input_map_interpreter.cl. Each graph node gets its result in a register,
+     * registers are assigned with Sethi-Ullman numbering so a graph needs about
+     * log2 of its size of them. Graphs that still do not fit make Compile fail,
+     * callers are expected to fall back to CLInputMapGenerator then.
+     */
+    class CLInputMapCompiler
+    {
+    public:
+        // Max number of registers used by a single input map, must match the interpreter
+        static std::uint32_t constexpr kMaxRegisters = 16;
+
+        /**
+        * @brief Compiles input maps into program table and bytecode.
+        *
+        * Leafs are referenced by their index in the leaf collector, leaf values
+        * are expected to follow the program in the buffer.
+        *
+        * @param input_map_collector set of input maps for compilation
+        * @param input_map_leaf_collector list of leaf nodes that holds values
+        * @return false if some input map needs more than kMaxRegisters registers
+        */
+        bool Compile(const Collector& input_map_collector, const Collector& input_map_leaf_collector);
+
+        // Returns header, program table and instructions
+        const std::vector<ClwScene::InputMapDataStorage>& GetProgram() const
+        {
+            return m_program;
+        }
+
+        // Returns inputmaps.cl source which evaluates input maps with the interpreter
+        static std::string GetInterpreterSource();
+        // Path to the interpreter source, has to be loaded into program manager
+        static const std::string& GetInterpreterPath();
+
+    private:
+        // Returns input map arguments in operand order
+        static std::vector<InputMap::Ptr> GetArguments(const InputMap& input);
+        // Returns argument indices sorted by register count, most demanding first
+        std::vector<std::size_t> GetEvaluationOrder(const std::vector<InputMap::Ptr>& args);
+        // Number of registers needed to evaluate input
+        std::uint32_t GetRegisterCount(const InputMap::Ptr& input);
+        // Emits instructions evaluating input into register
+        void CompileInput(std::shared_ptr<Baikal::InputMap> input, const Collector& input_map_leaf_collector, std::uint32_t reg);
+        // Appends instruction
+        void Emit(int op, std::uint32_t dst, std::uint32_t a = 0, std::uint32_t b = 0);
+        // Appends extra instruction entry
+        void EmitInt4(int x, int y, int z, int w);
+        void EmitFloat4(float x, float y, float z, float w);
+
+        std::vector<ClwScene::InputMapDataStorage> m_program;
+        // Register counts of visited nodes, shared subgraphs are counted once
+        std::map<const InputMap*, std::uint32_t> m_register_counts;
+    };
+}
@@ -23,6 +23,7 @@ THE SOFTWARE.
 #include <assert.h>
 
 #include <array>
+#include <map>
 
 #include "cl_inputmap_generator.h"
 #include "SceneGraph/uberv2material.h"
@@ -36,24 +37,28 @@ const std::string footer = "#endif\n\n";
 
 const std::string float4_selector_header =
     "float4 GetInputMapFloat4(uint input_id, DifferentialGeometry const* dg, GLOBAL InputMapData const* restrict input_map_values, TEXTURE_ARG_LIST)\n{\n"
-    "\tswitch(input_id)\n\t{\n";
+    "\tint4 entry = InputMap_FindEntry(input_id, input_map_values);\n"
+    "\tswitch(entry.y)\n\t{\n";
 const std::string float4_selector_footer = "\t}\n\treturn 0.0f;\n}\n";
 
-const std::string float_selector_header =
+const std::string float_selector =
     "float GetInputMapFloat(uint input_id, DifferentialGeometry const* dg, GLOBAL InputMapData const* restrict input_map_values, TEXTURE_ARG_LIST)\n{\n"
-    "\tswitch(input_id)\n\t{\n";
-const std::string float_selector_footer = "\t}\n\treturn 0.0f;\n}\n";
+    "\treturn GetInputMapFloat4(input_id, dg, input_map_values, TEXTURE_ARGS).x;\n}\n";
+
+const std::string& CLInputMapGenerator::GetTablePath()
+{
+    static const std::string path = "../Baikal/Kernels/CL/input_map_table.cl";
+    return path;
+}
 
 void CLInputMapGenerator::Generate(const Collector& input_map_collector, const Collector& input_map_leaf_collector)
 {
     m_source_code = header;
-    m_read_functions.clear();
-    m_float4_selector = float4_selector_header;
-    m_float_selector = float_selector_header;
+    m_source_code += "#include <" + GetTablePath() + ">\n\n";
+    m_table.clear();
+    m_leaf_indices.clear();
 
-    m_generated_inputs.clear();
-
-    // We need to guarantee order. So sort it by id using map
+    // Sort inputs by id, lookup table is searched with binary search
     std::map <uint32_t, InputMap::Ptr> inputs;
 
     auto mat_iter = input_map_collector.CreateIterator();
@@ -63,35 +68,68 @@ void CLInputMapGenerator::Generate(const Collector& input_map_collector, const C
         inputs.insert(std::make_pair(input->GetId(), input));
     }
 
+    // Function body depends only on graph structure since leafs are addressed
+    // relative to per input slots, so inputs of the same structure share a function
+    std::map<std::string, std::uint32_t> functions;
+    std::vector<std::string> input_functions;
+
+    auto table_size = static_cast<std::int32_t>(1 + inputs.size());
+    m_table.resize(table_size);
+
+    std::uint32_t table_index = 1;
     for (auto &input : inputs)
     {
-        GenerateSingleInput(input.second, input_map_leaf_collector);
+        m_read_functions.clear();
+        m_leaf_slots.clear();
+
+        auto leafs_offset = table_size + static_cast<std::int32_t>(m_leaf_indices.size());
+        GenerateInputSource(input.second, input_map_leaf_collector);
+
+        functions.emplace(m_read_functions, 0);
+        input_functions.push_back(m_read_functions);
+        m_table[table_index++] = { { static_cast<std::int32_t>(input.first), 0, leafs_offset, 0 } };
     }
 
-    m_source_code += m_read_functions;
-    m_source_code += m_float4_selector + float4_selector_footer;
-    m_source_code += m_float_selector + float_selector_footer;
-    m_source_code += footer;
-}
+    // Number functions in the order of their bodies, so the source does not depend on ids
+    std::uint32_t function_index = 0;
+    std::string float4_selector = float4_selector_header;
+    for (auto &function : functions)
+    {
+        function.second = function_index++;
+        std::string function_id = std::to_string(function.second);
 
-void CLInputMapGenerator::GenerateSingleInput(std::shared_ptr<Baikal::InputMap> input, const Collector& input_map_leaf_collector)
-{
-    if (m_generated_inputs.find(input->GetId()) != m_generated_inputs.end()) return;
+        m_source_code += "float4 ReadInputMap" + function_id + "(DifferentialGeometry const* dg, GLOBAL InputMapData const* restrict input_map_values, TEXTURE_ARG_LIST)\n{\n"
+            "\treturn (float4)(\n\t";
+        m_source_code += function.first;
+        m_source_code += "\t);\n}\n";
+
+        float4_selector += "\t\tcase " + function_id + ": return ReadInputMap" + function_id + "(dg, input_map_values + entry.z, TEXTURE_ARGS);\n";
+    }
 
-    std::string input_id = std::to_string(input->GetId());
+    for (std::size_t i = 0; i < input_functions.size(); ++i)
+    {
+        m_table[i + 1][1] = static_cast<std::int32_t>(functions[input_functions[i]]);
+    }
 
-    //Generate code for selectors
-    m_float4_selector += "\t\tcase " + input_id + ": return ReadInputMap" + input_id + "(dg, input_map_values, TEXTURE_ARGS);\n";
-    m_float_selector += "\t\tcase " + input_id + ": return ReadInputMap" + input_id + "(dg, input_map_values, TEXTURE_ARGS).x;\n";
+    m_table[0] = { { static_cast<std::int32_t>(inputs.size()), 0, 0, 0 } };
 
-    m_read_functions += "float4 ReadInputMap" + input_id + "(DifferentialGeometry const* dg, GLOBAL InputMapData const* restrict input_map_values, TEXTURE_ARG_LIST)\n{\n"
-        "\treturn (float4)(\n\t";
+    m_source_code += float4_selector + float4_selector_footer;
+    m_source_code += float_selector;
+    m_source_code += footer;
+}
 
-    GenerateInputSource(input, input_map_leaf_collector);
+std::int32_t CLInputMapGenerator::GetLeafSlot(std::int32_t leaf_index)
+{
+    auto iter = m_leaf_slots.find(leaf_index);
 
-    m_read_functions += "\t);\n}\n";
+    if (iter == m_leaf_slots.end())
+    {
+        auto slot = static_cast<std::int32_t>(m_leaf_slots.size());
+        iter = m_leaf_slots.emplace(leaf_index, slot).first;
+        m_leaf_indices.push_back(static_cast<std::uint32_t>(leaf_index));
+    }
 
-    m_generated_inputs.insert(input->GetId());
+    return iter->second;
 }
 
 void CLInputMapGenerator::GenerateInputSource(std::shared_ptr<Baikal::InputMap> input, const Collector& input_map_leaf_collector)
@@ -105,7 +143,7 @@ void CLInputMapGenerator::GenerateInputSource(std::shared_ptr<Baikal::InputMap>
 
             int32_t index = input_map_leaf_collector.GetItemIndex(input);
 
-            m_read_functions += "((float4)(input_map_values[" + std::to_string(index) + "].float_value.value, 0.0f))\n";
+            m_read_functions += "((float4)(input_map_values[" + std::to_string(GetLeafSlot(index)) + "].float_value.value, 0.0f))\n";
             break;
         }
         case InputMap::InputMapType::kConstantFloat3:
@@ -114,7 +152,7 @@ void CLInputMapGenerator::GenerateInputSource(std::shared_ptr<Baikal::InputMap>
 
             int32_t index = input_map_leaf_collector.GetItemIndex(input);
 
-            m_read_functions += "((float4)(input_map_values[" + std::to_string(index) + "].float_value.value, 0.0f))\n";
+            m_read_functions += "((float4)(input_map_values[" + std::to_string(GetLeafSlot(index)) + "].float_value.value, 0.0f))\n";
             break;
         }
         case InputMap::InputMapType::kSampler:
@@ -123,7 +161,7 @@ void CLInputMapGenerator::GenerateInputSource(std::shared_ptr<Baikal::InputMap>
 
             int32_t index = input_map_leaf_collector.GetItemIndex(input);
 
-            m_read_functions += "Texture_Sample2D(dg->uv, TEXTURE_ARGS_IDX(input_map_values[" + std::to_string(index) + "].int_values.idx))\n";
+            m_read_functions += "Texture_SampleFiltered2D(dg->uv, dg->uv_footprint, TEXTURE_ARGS_IDX(input_map_values[" + std::to_string(GetLeafSlot(index)) + "].int_values.idx))\n";
             break;
         }
         case InputMap::InputMapType::kSamplerBumpmap:
@@ -132,7 +170,7 @@ void CLInputMapGenerator::GenerateInputSource(std::shared_ptr<Baikal::InputMap>
 
             int32_t index = input_map_leaf_collector.GetItemIndex(input);
 
-            m_read_functions += "(float4)(Texture_SampleBump(dg->uv, TEXTURE_ARGS_IDX(input_map_values[" + std::to_string(index) + "].int_values.idx)), 1.0f)\n";
+            m_read_functions += "(float4)(Texture_SampleBump(dg->uv, TEXTURE_ARGS_IDX(input_map_values[" + std::to_string(GetLeafSlot(index)) + "].int_values.idx)), 1.0f)\n";
             break;
         }
         // Two inputs
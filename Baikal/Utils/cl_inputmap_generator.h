@@ -23,7 +23,10 @@ THE SOFTWARE.
 
 #pragma once
 
-#include <set>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
 
 #include "SceneGraph/scene1.h"
 #include "SceneGraph/Collector/collector.h"
@@ -40,7 +43,9 @@ namespace Baikal
         *
         * Code stored inside Generator object.
         * Makes lookups into leaf collectors to get parameters
-        * Each input map will create single function that will output float4 value
+        * Each distinct input map structure will create single function that will output float4 value.
+        * Generated source does not depend on input map ids or leaf indices, those go
+        * to the lookup table, so scenes sharing input map topology share kernels.
         *
         * @param input_map_collector set of input maps for generation
         * @param input_map_leaf_collector list of leaf nodes that holds values
@@ -53,15 +58,32 @@ namespace Baikal
             return m_source_code;
         }
 
+        // Returns header and lookup table (input map id, function, offset of leaf slots),
+        // leaf slots are expected to follow the table in the buffer
+        const std::vector<ClwScene::InputMapDataStorage>& GetTable() const
+        {
+            return m_table;
+        }
+
+        // Returns indices of leafs in the leaf collector for each leaf slot
+        const std::vector<std::uint32_t>& GetLeafIndices() const
+        {
+            return m_leaf_indices;
+        }
+
+        // Path to the lookup table source, has to be loaded into program manager
+        static const std::string& GetTablePath();
+
     private:
-        // Proceed single input, writes function header and function call
-        void GenerateSingleInput(std::shared_ptr<Baikal::InputMap> input, const Collector& input_map_leaf_collector);
         // Writes source code for single input map. Called recursively.
         void GenerateInputSource(std::shared_ptr<Baikal::InputMap> input, const Collector& input_map_leaf_collector);
+        // Returns slot of a leaf relative to the slots of current input map
+        std::int32_t GetLeafSlot(std::int32_t leaf_index);
+
         std::string m_source_code;
         std::string m_read_functions;
-        std::string m_float4_selector;
-        std::string m_float_selector;
-        std::set<uint32_t> m_generated_inputs;
+        std::map<std::int32_t, std::int32_t> m_leaf_slots;
+        std::vector<std::uint32_t> m_leaf_indices;
+        std::vector<ClwScene::InputMapDataStorage> m_table;
     };
 }
@@ -25,84 +25,95 @@ THE SOFTWARE.
 #include <assert.h>
 #include <chrono>
 #include <iostream>
-#include <algorithm>
 #include <fstream>
 #include <sstream>
-#include <regex>
+#include <atomic>
 
 #include "cl_program_manager.h"
-#include "version.h"
+#include "kernel_cache.h"
 
 using namespace Baikal;
 
-inline std::uint32_t jenkins_one_at_a_time_hash(char const *key, size_t len)
+// Compiles program source. In case of error dumps source into current folder
+inline CLWProgram CompileSource(CLWContext context, std::string const& program_name,
+                                std::string const& source, std::string const& opts)
 {
-    std::uint32_t hash, i;
-    for (hash = i = 0; i < len; ++i)
+    std::chrono::time_point<std::chrono::high_resolution_clock> start, end;
+    start = std::chrono::high_resolution_clock::now();
+
+    CLWProgram compiled_program;
+    try
     {
-        hash += key[i];
-        hash += (hash << 10);
-        hash ^= (hash >> 6);
+        compiled_program = CLWProgram::CreateFromSource(source.c_str(), source.size(), opts.c_str(), context);
+        /*
+         * Code below usable for cache debugging
+         */
+        /*int e = std::chrono::duration_cast<std::chrono::seconds>(std::chrono::high_resolution_clock::now().time_since_epoch()).count();
+        std::ofstream file(std::to_string(e));
+        file << source;
+        file.close();*/
     }
-    hash += (hash << 3);
-    hash ^= (hash >> 11);
-    hash += (hash << 15);
-    return hash;
-}
-
-// Computting check sum algo
-// Copy from here: https://codereview.stackexchange.com/questions/104948/32-bit-checksum-of-a-file
-inline std::uint32_t CheckSum(const std::string &source)
-{
-    std::uint32_t check_sum = 0;
-    unsigned shift = 0;
-    for (uint32_t ch : source)
+    catch (CLWException exception)
     {
-        check_sum += (ch << shift);
-        shift += 8;
-        if (shift == 32) {
-            shift = 0;
-        }
+        std::cerr<<"Compilation failed!"<<std::endl;
+        std::cerr<<"Dumping source to file:"<<program_name<<".cl.failed"<<std::endl;
+        std::string fname = program_name + ".cl.failed";
+        std::ofstream file(fname);
+        file << source;
+        file.close();
+        throw;
     }
-    return check_sum;
+
+    end = std::chrono::high_resolution_clock::now();
+    int elapsed_ms = std::chrono::duration_cast<std::chrono::milliseconds>(end-start).count();
+
+    // Programs are compiled concurrently, print the whole line at once
+    std::ostringstream oss;
+    oss<<"Program compilation time ("<<program_name<<"): "<<elapsed_ms<<" ms"<<std::endl;
+    std::cerr<<oss.str();
+
+    return compiled_program;
 }
 
-inline bool LoadBinaries(std::string const& name, std::vector<std::uint8_t>& data)
+// Loads program from disk cache or compiles it and stores its binaries there
+inline CLWProgram LoadOrCompile(CLWContext context, std::string const& program_name,
+                                std::string const& source, std::string const& opts,
+                                std::shared_ptr<KernelCache> cache)
 {
-    std::ifstream in(name, std::ios::in | std::ios::binary);
-    if (in)
-    {
-        data.clear();
-        std::streamoff beg = in.tellg();
-        in.seekg(0, std::ios::end);
-        std::streamoff fileSize = in.tellg() - beg;
-        in.seekg(0, std::ios::beg);
-        data.resize(static_cast<unsigned>(fileSize));
-        in.read((char*)&data[0], fileSize);
-        return true;
-    }
-    else
+    std::vector<std::uint8_t> binary;
+    KernelCache::Key key;
+
+    //check if we can get it from cache
+    if (cache)
     {
-        return false;
+        key = KernelCache::GetKey(context, program_name, source, opts);
+
+        if (cache->Load(program_name, key, binary))
+        {
+            // Create from binary
+            std::size_t size = binary.size();
+            auto binaries = &binary[0];
+            return CLWProgram::CreateFromBinary(&binaries, &size, context);
+        }
     }
-}
 
-inline void SaveBinaries(std::string const& name, std::vector<std::uint8_t>& data)
-{
-    std::ofstream out(name, std::ios::out | std::ios::binary);
+    auto result = CompileSource(context, program_name, source, opts);
 
-    if (out)
+    if (cache)
     {
-        out.write((char*)&data[0], data.size());
+        // Save binaries
+        result.GetBinaries(0, binary);
+        cache->Save(program_name, key, binary);
     }
-}
 
+    return result;
+}
 
 CLProgram::CLProgram(const CLProgramManager *program_manager, uint32_t id, CLWContext context,
-                     const std::string &program_name, const std::string &cache_path) :
+                     const std::string &program_name, std::shared_ptr<KernelCache> cache) :
     m_program_manager(program_manager),
     m_program_name(program_name),
-    m_cache_path(cache_path),
+    m_cache(cache),
     m_id(id),
     m_context(context)
 {
@@ -110,7 +121,6 @@ CLProgram::CLProgram(const CLProgramManager *program_manager, uint32_t id, CLWCo
 
 void CLProgram::SetSource(const std::string &source)
 {
-    m_compiled_source.reserve(1024 * 1024); //Just reserve 1M for now
     m_program_source = source;
     ParseSource(m_program_source);
 }
@@ -146,7 +156,7 @@ void CLProgram::BuildSource(const std::string &source)
     {
         // Append not-include part of source
         if (position != offset)
-            m_compiled_source += source.substr(offset, position - offset - 1);
+            *m_compiled_source += source.substr(offset, position - offset - 1);
 
         // Get include file name
         std::string::size_type end_position = source.find(">", position);
@@ -166,43 +176,28 @@ void CLProgram::BuildSource(const std::string &source)
     }
 
     // Append rest of the file
-    m_compiled_source += source.substr(offset);
+    *m_compiled_source += source.substr(offset);
 }
 
-CLWProgram CLProgram::Compile(const std::string &opts)
+void CLProgram::RebuildSource()
 {
-    std::chrono::time_point<std::chrono::high_resolution_clock> start, end;
-    start = std::chrono::high_resolution_clock::now();
+    // Builds which are still running keep the old source alive
+    m_programs.clear();
+    m_compiled_source = std::make_shared<std::string>();
+    m_compiled_source->reserve(1024 * 1024); //Just reserve 1M for now
+    m_included_headers.clear();
+    BuildSource(m_program_source);
+    m_is_dirty = false;
+}
 
-    CLWProgram compiled_program;
-    try
+CLWProgram CLProgram::Compile(const std::string &opts)
+{
+    if (m_is_dirty)
     {
-        compiled_program = CLWProgram::CreateFromSource(m_compiled_source.c_str(), m_compiled_source.size(), opts.c_str(), m_context);
-        /*
-         * Code below usable for cache debugging
-         */
-        /*int e = std::chrono::duration_cast<std::chrono::seconds>(std::chrono::high_resolution_clock::now().time_since_epoch()).count();
-        std::ofstream file(std::to_string(e));
-        file << m_compiled_source;
-        file.close();*/
+        RebuildSource();
     }
-    catch (CLWException exception)
-    {
-        std::cerr<<"Compilation failed!"<<std::endl;
-        std::cerr<<"Dumping source to file:"<<m_program_name<<".cl.failed"<<std::endl;
-        std::string fname = m_program_name + ".cl.failed";
-        std::ofstream file(fname);
-        file << m_compiled_source;
-        file.close();
-        throw;
-    }
-
-    end = std::chrono::high_resolution_clock::now();
-    int elapsed_ms = std::chrono::duration_cast<std::chrono::milliseconds>(end-start).count();
-    std::cerr<<"Program compilation time: "<<elapsed_ms<<" ms"<<std::endl;
 
-    m_is_dirty = false;
-    return compiled_program;
+    return CompileSource(m_context, m_program_name, *m_compiled_source, opts);
 }
 
 bool CLProgram::IsHeaderNeeded(const std::string &header_name) const
@@ -210,15 +205,12 @@ bool CLProgram::IsHeaderNeeded(const std::string &header_name) const
     return (m_required_headers.find(header_name) != m_required_headers.end());
 }
 
-CLWProgram CLProgram::GetCLWProgram(const std::string &opts)
+CLProgram::Build CLProgram::RequestCLWProgram(const std::string &opts)
 {
     // global dirty flag
     if (m_is_dirty)
     {
-        m_programs.clear();
-        m_compiled_source.clear();
-        m_included_headers.clear();
-        BuildSource(m_program_source);
+        RebuildSource();
     }
 
     auto it = m_programs.find(opts);
@@ -227,72 +219,47 @@ CLWProgram CLProgram::GetCLWProgram(const std::string &opts)
         return it->second;
     }
 
-    CLWProgram result;
-    //check if we can get it from cache
-    if (!m_cache_path.empty())
+    // Build task owns everything it needs, so source changes do not affect it
+    struct Task
     {
-        std::string filename = GetFilenameHash(opts);
-
-        auto cached_program_path = m_cache_path;
-        cached_program_path.append("/");
-        cached_program_path.append(filename);
-        cached_program_path.append(".bin");
+        std::packaged_task<CLWProgram()> task;
+        std::atomic<bool> started;
+    };
+
+    auto context = m_context;
+    auto program_name = m_program_name;
+    auto source = m_compiled_source;
+    auto cache = m_cache;
+
+    auto task = std::make_shared<Task>();
+    task->started = false;
+    task->task = std::packaged_task<CLWProgram()>([context, program_name, source, opts, cache]()
+    {
+        return LoadOrCompile(context, program_name, *source, opts, cache);
+    });
 
-        std::vector<std::uint8_t> binary;
-        if (LoadBinaries(cached_program_path, binary))
-        {
-            // Create from binary
-            std::size_t size = binary.size();
-            auto binaries = &binary[0];
-            result = CLWProgram::CreateFromBinary(&binaries, &size, m_context);
-            m_programs[opts] = result;
-        }
-        else
+    Build build;
+    build.program = task->task.get_future().share();
+    build.run = [task]()
+    {
+        if (!task->started.exchange(true))
         {
-            result = Compile(opts);
-            m_programs[opts] = result;
-
-            // Save binaries
-            result.GetBinaries(0, binary);
-            SaveBinaries(cached_program_path, binary);
+            task->task();
         }
-    }
+    };
 
-    m_is_dirty = false;
-    return result;
+    m_programs[opts] = build;
+    return build;
 }
 
-std::string CLProgram::GetFilenameHash(std::string const& opts) const
+bool CLProgram::IsReady(const std::string &opts) const
 {
-    auto name = m_program_name;
-    auto device_name = m_context.GetDevice(0).GetName();
-
-    std::regex forbidden("(\\\\)|[\\./:<>\\\"\\|\\?\\*]");
-
-    device_name = std::regex_replace(device_name, forbidden, "_");
-    device_name.erase(
-        std::remove_if(device_name.begin(), device_name.end(), isspace),
-                      device_name.end());
-
-    name.append("_");
-    name.append(device_name);
-
-    auto extra = m_context.GetDevice(0).GetVersion();
-    extra.append(opts);
-
-    std::ostringstream oss;
-    oss << jenkins_one_at_a_time_hash(extra.c_str(), extra.size());
-
-    name.append("_");
-    name.append(oss.str());
-
-
-    std::uint32_t file_hash = CheckSum(m_compiled_source);
-
-    name.append("_");
-    name.append(std::to_string(file_hash));
-
-    name.append(BAIKAL_VERSION);
+    if (m_is_dirty)
+    {
+        return false;
+    }
 
-    return name;
+    auto it = m_programs.find(opts);
+    return it != m_programs.end() &&
+        it->second.program.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
 }
@@ -22,6 +22,9 @@ THE SOFTWARE.
 
 #pragma once
 
+#include <functional>
+#include <future>
+#include <memory>
 #include <string>
 #include <vector>
 #include <set>
@@ -33,12 +36,14 @@ THE SOFTWARE.
 namespace Baikal
 {
     class CLProgramManager;
+    class KernelCache;
+
     class CLProgram
     {
     public:
         CLProgram() = default;
         // Constructs CLProgram empty object
-        CLProgram(const CLProgramManager *program_manager, uint32_t id, CLWContext context, const std::string &program_name, const std::string &cache_path);
+        CLProgram(const CLProgramManager *program_manager, uint32_t id, CLWContext context, const std::string &program_name, std::shared_ptr<KernelCache> cache);
         // Check if program should be recompiled
         bool IsDirty() const { return m_is_dirty; }
         // Sets dirty flag on program
@@ -54,14 +59,36 @@ namespace Baikal
          */
         void SetSource(const std::string &source);
         /**
-         * @brief returns CLWProgram object
+         * @brief Program variant which is either built or being built
+         */
+        struct Build
+        {
+            std::shared_future<CLWProgram> program;
+            // Loads program from disk cache or compiles it. Only the first call
+            // does the work, so it can be submitted to several threads.
+            std::function<void()> run;
+        };
+
+        /**
+         * @brief returns build of CLWProgram object for given options
          * 
-         * This function will build program and compile it if it's durty.
-         * This function respronsible for shader cache handling. If required program
-         * already exists in disk or in-memory cache returns it.
-         * For caching uses simple uint32 crc of source code.
+         * This function will rebuild program source if it's durty. Program is
+         * not compiled here: a new build is created unless the variant is already in
+         * in-memory cache, and it's up to the caller when and where to run it.
+         * Build task is responsible for shader cache handling. If required program
+         * already exists in disk cache it's loaded from there.
+         * Cache entries are keyed by KernelCache::GetKey.
+         * Not thread safe, CLProgramManager serializes the calls.
          */
-        CLWProgram GetCLWProgram(const std::string &opts);
+        Build RequestCLWProgram(const std::string &opts);
+
+        // Checks if program variant has been built without blocking
+        bool IsReady(const std::string &opts) const;
+
+        // Adds build options program is known to be used with
+        void AddVariant(const std::string &opts) { m_variants.insert(opts); }
+        // Returns build options program is known to be used with
+        const std::set<std::string>& GetVariants() const { return m_variants; }
 
         // Checks if specified header required by program
         bool IsHeaderNeeded(const std::string &header_name) const;
@@ -78,17 +105,18 @@ namespace Baikal
          * Duplicate includes removed.
          */
         void BuildSource(const std::string &source);
-        // Returns hash for file name
-        std::string GetFilenameHash(std::string const& opts) const;
+        // Rebuilds full program source and drops compiled programs
+        void RebuildSource();
 
         const CLProgramManager *m_program_manager;
         std::string m_program_name;    ///< Program name
-        std::string m_cache_path;      ///< Cache folder path
-        std::string m_compiled_source; ///< Final program source with all headers
+        std::shared_ptr<KernelCache> m_cache; ///< Disk cache for program binaries, might be null
+        std::shared_ptr<std::string> m_compiled_source; ///< Final program source with all headers, shared with pending builds
         std::string m_program_source;  ///< Program source code without modifications
         std::unordered_set<std::string> m_required_headers; ///< Set of required headers
 
-        std::unordered_map<std::string, CLWProgram> m_programs; ///< In-memory cache for compiled programs
+        std::unordered_map<std::string, Build> m_programs; ///< In-memory cache for compiled programs
+        std::set<std::string> m_variants; ///< Known build options
 
         bool m_is_dirty = true;
         uint32_t m_id;
@@ -21,6 +21,8 @@ THE SOFTWARE.
 ********************************************************************/
 
 #include "cl_program_manager.h"
+#include "kernel_cache.h"
+#include "thread_pool.h"
 
 #include <fstream>
 #include <regex>
@@ -47,13 +49,17 @@ std::string ReadFile(const std::string &fname)
     return str;
 }
 CLProgramManager::CLProgramManager(const std::string &cache_path) :
-    m_cache_path(cache_path)
+    m_cache(cache_path.empty() ? nullptr : std::make_shared<KernelCache>(cache_path))
 {
 
 }
 
+CLProgramManager::~CLProgramManager() = default;
+
 uint32_t CLProgramManager::CreateProgram(CLWContext context, const std::string &fname) const
 {
+    std::lock_guard<std::recursive_mutex> lock(m_mutex);
+
     std::regex delimiter("\\\\");
     auto fullpath = std::regex_replace(fname, delimiter, "/");
 
@@ -72,7 +78,7 @@ uint32_t CLProgramManager::CreateProgram(CLWContext context, const std::string &
     auto name = fullpath.substr(filename_start, filename_end - filename_start);
 
 
-    CLProgram prg(this, m_next_program_id++, context, name, m_cache_path);
+    CLProgram prg(this, m_next_program_id++, context, name, m_cache);
     prg.SetSource(ReadFile(fname));
     m_programs.insert(std::make_pair(prg.GetId(), prg));
     return prg.GetId();
@@ -80,6 +86,8 @@ uint32_t CLProgramManager::CreateProgram(CLWContext context, const std::string &
 
 void CLProgramManager::AddHeader(const std::string &header, const std::string &source) const
 {
+    std::lock_guard<std::recursive_mutex> lock(m_mutex);
+
     std::string currect_header_code = m_headers[header];
     if (currect_header_code != source)
     {
@@ -90,6 +98,13 @@ void CLProgramManager::AddHeader(const std::string &header, const std::string &s
             if (program.second.IsHeaderNeeded(header))
             {
                 program.second.SetDirty();
+                ++m_num_invalidations;
+
+                // Keep warmed up programs warm
+                if (m_thread_pool)
+                {
+                    CompileAsync(program.second);
+                }
             }
         }
     }
@@ -103,17 +118,153 @@ void CLProgramManager::LoadHeader(const std::string &header) const
 
 const std::string& CLProgramManager::ReadHeader(const std::string &header) const
 {
+    std::lock_guard<std::recursive_mutex> lock(m_mutex);
     return m_headers[header];
 }
 
 CLWProgram CLProgramManager::GetProgram(uint32_t id, const std::string &opts) const
 {
-    CLProgram &program = m_programs[id];
-    return program.GetCLWProgram(opts);
+    CLProgram::Build build;
+
+    {
+        std::lock_guard<std::recursive_mutex> lock(m_mutex);
+        CLProgram &program = m_programs[id];
+        program.AddVariant(opts);
+        build = program.RequestCLWProgram(opts);
+    }
+
+    // Build in this thread unless somebody has started it already
+    build.run();
+    return build.program.get();
+}
+
+bool CLProgramManager::TryGetProgram(uint32_t id, const std::string &opts, CLWProgram &program) const
+{
+    std::lock_guard<std::recursive_mutex> lock(m_mutex);
+
+    CLProgram &clprogram = m_programs[id];
+    clprogram.AddVariant(opts);
+
+    auto build = clprogram.RequestCLWProgram(opts);
+    if (build.program.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+    {
+        if (!m_thread_pool)
+        {
+            m_thread_pool.reset(new ThreadPool());
+        }
+
+        m_thread_pool->Submit(build.run);
+        return false;
+    }
+
+    program = build.program.get();
+    return true;
 }
 
 void CLProgramManager::CompileProgram(uint32_t id, const std::string &opts) const
 {
+    std::lock_guard<std::recursive_mutex> lock(m_mutex);
     CLProgram &program = m_programs[id];
     program.Compile(opts);
 }
+
+void CLProgramManager::SetCacheMaxSize(std::uint64_t max_size) const
+{
+    if (m_cache)
+    {
+        m_cache->SetMaxSize(max_size);
+    }
+}
+
+void CLProgramManager::AddProgramVariant(uint32_t id, const std::string &opts) const
+{
+    std::lock_guard<std::recursive_mutex> lock(m_mutex);
+    m_programs[id].AddVariant(opts);
+}
+
+void CLProgramManager::CompileAsync(CLProgram &program) const
+{
+    for (auto const& opts : program.GetVariants())
+    {
+        if (!program.IsReady(opts))
+        {
+            // Builds which are already running ignore the second run
+            m_thread_pool->Submit(program.RequestCLWProgram(opts).run);
+        }
+    }
+}
+
+void CLProgramManager::WarmUp() const
+{
+    std::lock_guard<std::recursive_mutex> lock(m_mutex);
+
+    if (!m_thread_pool)
+    {
+        m_thread_pool.reset(new ThreadPool());
+    }
+
+    for (auto &program : m_programs)
+    {
+        CompileAsync(program.second);
+    }
+}
+
+void CLProgramManager::WaitForPrograms() const
+{
+    std::vector<CLProgram::Build> builds;
+
+    {
+        std::lock_guard<std::recursive_mutex> lock(m_mutex);
+
+        for (auto &program : m_programs)
+        {
+            for (auto const& opts : program.second.GetVariants())
+            {
+                builds.push_back(program.second.RequestCLWProgram(opts));
+            }
+        }
+    }
+
+    // Help workers with builds nobody has started yet
+    for (auto &build : builds)
+    {
+        build.run();
+    }
+
+    for (auto &build : builds)
+    {
+        build.program.get();
+    }
+}
+
+bool CLProgramManager::IsProgramReady(uint32_t id, const std::string &opts) const
+{
+    std::lock_guard<std::recursive_mutex> lock(m_mutex);
+
+    auto it = m_programs.find(id);
+    return it != m_programs.end() && it->second.IsReady(opts);
+}
+
+bool CLProgramManager::AreProgramsReady() const
+{
+    std::lock_guard<std::recursive_mutex> lock(m_mutex);
+
+    for (auto const& program : m_programs)
+    {
+        for (auto const& opts : program.second.GetVariants())
+        {
+            if (!program.second.IsReady(opts))
+            {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+uint32_t CLProgramManager::GetNumInvalidations() const
+{
+    std::lock_guard<std::recursive_mutex> lock(m_mutex);
+    return m_num_invalidations;
+}
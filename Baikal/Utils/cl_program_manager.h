@@ -25,6 +25,8 @@ THE SOFTWARE.
 #include <string>
 #include <stdint.h>
 #include <map>
+#include <memory>
+#include <mutex>
 #include <vector>
 
 #include "CLWProgram.h"
@@ -34,11 +36,23 @@ THE SOFTWARE.
 
 namespace Baikal
 {
+    class ThreadPool;
+    class KernelCache;
+
+    /**
+     \brief Owns OpenCL programs and their compiled variants.
+
+     Every program is compiled once per option string. Programs can be compiled
+     lazily by GetProgram or ahead of time on worker threads by WarmUp, which
+     compiles all variants registered by AddProgramVariant or requested before.
+     Methods are thread safe.
+     */
     class CLProgramManager
     {
     public:
-        // Constructor
+        // Constructor, binaries are not cached on disk if cache path is empty
         explicit CLProgramManager(const std::string &cache_path);
+        ~CLProgramManager();
         // Creates program from file and returns its id
         uint32_t CreateProgram(CLWContext context, const std::string &fname) const;
         // Loads header from file into map of headers
@@ -47,15 +61,42 @@ namespace Baikal
         void AddHeader(const std::string &header, const std::string &source) const;
         // Reads header from disk and returns its source
         const std::string& ReadHeader(const std::string &header) const;
-        // Returns compiled program
+        // Returns compiled program, blocks until it is compiled
         CLWProgram GetProgram(uint32_t id, const std::string &opts) const;
+        // Returns compiled program if it is ready, otherwise starts compiling it in background and returns false
+        bool TryGetProgram(uint32_t id, const std::string &opts, CLWProgram &program) const;
         // Compiles program
         void CompileProgram(uint32_t id, const std::string &opts) const;
+        // Sets max size of disk cache in bytes, least recently used binaries are evicted above it
+        void SetCacheMaxSize(std::uint64_t max_size) const;
+
+        // Registers options program is going to be compiled with
+        void AddProgramVariant(uint32_t id, const std::string &opts) const;
+        // Starts compiling all known program variants on worker threads. Afterwards
+        // variants invalidated by header changes are recompiled in background as well.
+        void WarmUp() const;
+        // Blocks until all known program variants are compiled, rethrows compilation errors
+        void WaitForPrograms() const;
+        // Checks if program variant is compiled without blocking
+        bool IsProgramReady(uint32_t id, const std::string &opts) const;
+        // Checks if all known program variants are compiled without blocking
+        bool AreProgramsReady() const;
+        // Number of times a program was marked for recompilation by a header change
+        uint32_t GetNumInvalidations() const;
 
     private:
-        mutable std::string m_cache_path; ///< Path to cache folder
+        // Starts compiling program variants on worker threads
+        void CompileAsync(CLProgram &program) const;
+
+        std::shared_ptr<KernelCache> m_cache; ///< Disk cache for program binaries
         mutable std::map<uint32_t, CLProgram> m_programs; ///< Cache of programs by id
         mutable std::map<std::string, std::string> m_headers; ///< Headers map
         static uint32_t m_next_program_id;
+        mutable uint32_t m_num_invalidations = 0;
+
+        // Programs parse headers while being created, so the lock is reentrant
+        mutable std::recursive_mutex m_mutex;
+        // Workers for background compilation, created by WarmUp
+        mutable std::unique_ptr<ThreadPool> m_thread_pool;
     };
 }
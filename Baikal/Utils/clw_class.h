@@ -7,10 +7,13 @@
 #include <regex>
 #include <sstream>
 #include <unordered_map>
+#include <map>
 
 #include "CLW.h"
 #include "version.h"
 #include "cl_program_manager.h"
+#include "render_statistics.h"
+#include "kernel_profiler.h"
 
 namespace Baikal
 {
@@ -29,12 +32,30 @@ namespace Baikal
     protected:
         CLWContext GetContext() const { return m_context; }
         CLWKernel GetKernel(std::string const& name, std::string const& opts = "");
+        // Non-blocking GetKernel, returns false and compiles the program in background if it is not ready
+        bool TryGetKernel(std::string const& name, CLWKernel& kernel, std::string const& opts = "");
+        // Register options GetKernel is going to be called with, so the program variant can be warmed up
+        void AddProgramVariant(std::string const& opts);
         void SetDefaultBuildOptions(std::string const& opts);
         std::string GetDefaultBuildOpts() const { return m_default_opts; }
         std::string GetFullBuildOpts() const;
 
+        // Launch a kernel, its event is kept for timing if kernel timing or profiling is enabled
+        CLWEvent Launch1D(std::string const& name, std::size_t global_size, std::size_t local_size, CLWKernel kernel);
+        CLWEvent Launch2D(std::string const& name, std::size_t* global_size, std::size_t* local_size, CLWKernel kernel);
+        // Enable kernel timing, has no effect unless the command queue has profiling enabled
+        void SetKernelTimingEnabled(bool enabled);
+        bool IsKernelTimingEnabled() const { return m_kernel_timing_enabled; }
+        // Wait for timed launches and add their times to statistics
+        void CollectKernelTimes(std::map<std::string, RenderStatistics::KernelTime>& times) const;
+        void ResetKernelTimes();
+
     private:
         void AddCommonOptions(std::string& opts) const;
+        // Move execution times of finished launches out of the event list
+        void ResolveKernelEvents() const;
+        // Keep launch event for timing and profiling
+        void RecordLaunch(std::string const& name, CLWEvent event);
 
         // Context to build programs for
         CLWContext m_context;
@@ -44,6 +65,10 @@ namespace Baikal
         uint32_t m_program_id;
         // Default build options
         std::string m_default_opts;
+        // Kernel timing state
+        bool m_kernel_timing_enabled = false;
+        mutable std::vector<std::pair<std::string, CLWEvent>> m_kernel_events;
+        mutable std::map<std::string, RenderStatistics::KernelTime> m_kernel_times;
     };
 
     inline ClwClass::ClwClass(
@@ -58,6 +83,7 @@ namespace Baikal
         AddCommonOptions(options);
 
         m_program_id = m_program_manager->CreateProgram(context, cl_file);
+        m_program_manager->AddProgramVariant(m_program_id, GetFullBuildOpts());
     }
 
     inline CLWKernel ClwClass::GetKernel(std::string const& name, std::string const& opts)
@@ -67,6 +93,28 @@ namespace Baikal
         return m_program_manager->GetProgram(m_program_id, options).GetKernel(name);
     }
 
+    inline bool ClwClass::TryGetKernel(std::string const& name, CLWKernel& kernel, std::string const& opts)
+    {
+        std::string options = opts.empty() ? m_default_opts : opts;
+        AddCommonOptions(options);
+
+        CLWProgram program;
+        if (!m_program_manager->TryGetProgram(m_program_id, options, program))
+        {
+            return false;
+        }
+
+        kernel = program.GetKernel(name);
+        return true;
+    }
+
+    inline void ClwClass::AddProgramVariant(std::string const& opts)
+    {
+        std::string options = opts.empty() ? m_default_opts : opts;
+        AddCommonOptions(options);
+        m_program_manager->AddProgramVariant(m_program_id, options);
+    }
+
 
     inline void ClwClass::AddCommonOptions(std::string& opts) const
     {
@@ -99,5 +147,79 @@ namespace Baikal
     inline void ClwClass::SetDefaultBuildOptions(std::string const& opts)
     {
         m_default_opts = opts;
+        AddProgramVariant(opts);
+    }
+
+    inline CLWEvent ClwClass::Launch1D(std::string const& name, std::size_t global_size, std::size_t local_size, CLWKernel kernel)
+    {
+        auto event = m_context.Launch1D(0, global_size, local_size, kernel);
+        RecordLaunch(name, event);
+        return event;
+    }
+
+    inline CLWEvent ClwClass::Launch2D(std::string const& name, std::size_t* global_size, std::size_t* local_size, CLWKernel kernel)
+    {
+        auto event = m_context.Launch2D(0, global_size, local_size, kernel);
+        RecordLaunch(name, event);
+        return event;
+    }
+
+    inline void ClwClass::RecordLaunch(std::string const& name, CLWEvent event)
+    {
+        if (m_kernel_timing_enabled)
+        {
+            // Do not let the list grow unbounded if nobody collects times
+            if (m_kernel_events.size() >= 4096)
+            {
+                ResolveKernelEvents();
+            }
+
+            m_kernel_events.emplace_back(name, event);
+        }
+
+        if (auto profiler = KernelProfiler::Get())
+        {
+            profiler->AddLaunch(name, event);
+        }
+    }
+
+    inline void ClwClass::SetKernelTimingEnabled(bool enabled)
+    {
+        cl_command_queue_properties properties = 0;
+        clGetCommandQueueInfo(m_context.GetCommandQueue(0), CL_QUEUE_PROPERTIES,
+            sizeof(properties), &properties, nullptr);
+
+        m_kernel_timing_enabled = enabled && (properties & CL_QUEUE_PROFILING_ENABLE) != 0;
+    }
+
+    inline void ClwClass::ResolveKernelEvents() const
+    {
+        for (auto& event : m_kernel_events)
+        {
+            event.second.Wait();
+
+            auto& time = m_kernel_times[event.first];
+            time.time += event.second.GetDuration();
+            ++time.num_launches;
+        }
+
+        m_kernel_events.clear();
+    }
+
+    inline void ClwClass::CollectKernelTimes(std::map<std::string, RenderStatistics::KernelTime>& times) const
+    {
+        ResolveKernelEvents();
+
+        for (auto& time : m_kernel_times)
+        {
+            times[time.first].time += time.second.time;
+            times[time.first].num_launches += time.second.num_launches;
+        }
+    }
+
+    inline void ClwClass::ResetKernelTimes()
+    {
+        m_kernel_events.clear();
+        m_kernel_times.clear();
     }
 }
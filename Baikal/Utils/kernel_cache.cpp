@@ -0,0 +1,521 @@
+#include "kernel_cache.h"
+#include "log.h"
+#include "version.h"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <iomanip>
+#include <random>
+#include <sstream>
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#include <direct.h>
+#include <sys/utime.h>
+#else
+#include <dirent.h>
+#include <sys/stat.h>
+#include <utime.h>
+#endif
+
+namespace Baikal
+{
+    // Bump whenever on-disk layout or key contents change
+    std::uint32_t constexpr kKernelCacheVersion = 1;
+    char constexpr kKernelCacheMagic[4] = { 'B', 'K', 'K', 'C' };
+    char constexpr kKernelCacheExtension[] = ".kbin";
+    // Temporary files older than this are left by crashed writers
+    std::time_t constexpr kStaleTempFileAge = 60 * 60;
+
+    std::uint64_t constexpr kHashSeed = 0xcbf29ce484222325ull;
+    std::uint64_t constexpr kHashPrime = 0x100000001b3ull;
+
+    struct KernelCacheHeader
+    {
+        char magic[4];
+        std::uint32_t version;
+        std::uint8_t key[32];
+        std::uint64_t size;
+        std::uint64_t checksum;
+    };
+
+    // FNV-1a style hash, consuming 8 bytes per step
+    static std::uint64_t HashBytes(void const* data, std::size_t size, std::uint64_t hash)
+    {
+        auto bytes = static_cast<unsigned char const*>(data);
+
+        std::size_t i = 0;
+        for (; i + sizeof(std::uint64_t) <= size; i += sizeof(std::uint64_t))
+        {
+            std::uint64_t word;
+            std::memcpy(&word, bytes + i, sizeof(word));
+            hash = (hash ^ word) * kHashPrime;
+            hash ^= hash >> 29;
+        }
+
+        for (; i < size; ++i)
+        {
+            hash = (hash ^ bytes[i]) * kHashPrime;
+        }
+
+        return hash;
+    }
+
+    // Straightforward SHA-256 (FIPS 180-4)
+    class Sha256
+    {
+    public:
+        Sha256()
+            : m_state{ 0x6a09e667u, 0xbb67ae85u, 0x3c6ef372u, 0xa54ff53au,
+                       0x510e527fu, 0x9b05688cu, 0x1f83d9abu, 0x5be0cd19u }
+            , m_size(0)
+        {
+        }
+
+        void Update(void const* data, std::size_t size)
+        {
+            auto bytes = static_cast<std::uint8_t const*>(data);
+
+            for (std::size_t i = 0; i < size; ++i)
+            {
+                m_block[m_size++ % 64] = bytes[i];
+
+                if (m_size % 64 == 0)
+                {
+                    Transform();
+                }
+            }
+        }
+
+        // Strings are length prefixed, so concatenated fields can't alias
+        void Update(std::string const& str)
+        {
+            std::uint64_t size = str.size();
+            Update(&size, sizeof(size));
+            Update(str.data(), str.size());
+        }
+
+        KernelCache::Key Finish()
+        {
+            std::uint64_t bit_size = m_size * 8;
+
+            std::uint8_t padding = 0x80;
+            Update(&padding, 1);
+
+            padding = 0;
+            while (m_size % 64 != 56)
+            {
+                Update(&padding, 1);
+            }
+
+            std::uint8_t length[8];
+            for (int i = 0; i < 8; ++i)
+            {
+                length[i] = static_cast<std::uint8_t>(bit_size >> (56 - 8 * i));
+            }
+            Update(length, sizeof(length));
+
+            KernelCache::Key digest(32);
+            for (int i = 0; i < 32; ++i)
+            {
+                digest[i] = static_cast<std::uint8_t>(m_state[i / 4] >> (24 - 8 * (i % 4)));
+            }
+
+            return digest;
+        }
+
+    private:
+        static std::uint32_t Rotr(std::uint32_t x, int n)
+        {
+            return (x >> n) | (x << (32 - n));
+        }
+
+        void Transform()
+        {
+            static std::uint32_t const k[64] =
+            {
+                0x428a2f98u, 0x71374491u, 0xb5c0fbcfu, 0xe9b5dba5u, 0x3956c25bu, 0x59f111f1u, 0x923f82a4u, 0xab1c5ed5u,
+                0xd807aa98u, 0x12835b01u, 0x243185beu, 0x550c7dc3u, 0x72be5d74u, 0x80deb1feu, 0x9bdc06a7u, 0xc19bf174u,
+                0xe49b69c1u, 0xefbe4786u, 0x0fc19dc6u, 0x240ca1ccu, 0x2de92c6fu, 0x4a7484aau, 0x5cb0a9dcu, 0x76f988dau,
+                0x983e5152u, 0xa831c66du, 0xb00327c8u, 0xbf597fc7u, 0xc6e00bf3u, 0xd5a79147u, 0x06ca6351u, 0x14292967u,
+                0x27b70a85u, 0x2e1b2138u, 0x4d2c6dfcu, 0x53380d13u, 0x650a7354u, 0x766a0abbu, 0x81c2c92eu, 0x92722c85u,
+                0xa2bfe8a1u, 0xa81a664bu, 0xc24b8b70u, 0xc76c51a3u, 0xd192e819u, 0xd6990624u, 0xf40e3585u, 0x106aa070u,
+                0x19a4c116u, 0x1e376c08u, 0x2748774cu, 0x34b0bcb5u, 0x391c0cb3u, 0x4ed8aa4au, 0x5b9cca4fu, 0x682e6ff3u,
+                0x748f82eeu, 0x78a5636fu, 0x84c87814u, 0x8cc70208u, 0x90befffau, 0xa4506cebu, 0xbef9a3f7u, 0xc67178f2u
+            };
+
+            std::uint32_t w[64];
+            for (int i = 0; i < 16; ++i)
+            {
+                w[i] = (std::uint32_t(m_block[4 * i]) << 24) | (std::uint32_t(m_block[4 * i + 1]) << 16) |
+                       (std::uint32_t(m_block[4 * i + 2]) << 8) | std::uint32_t(m_block[4 * i + 3]);
+            }
+
+            for (int i = 16; i < 64; ++i)
+            {
+                auto s0 = Rotr(w[i - 15], 7) ^ Rotr(w[i - 15], 18) ^ (w[i - 15] >> 3);
+                auto s1 = Rotr(w[i - 2], 17) ^ Rotr(w[i - 2], 19) ^ (w[i - 2] >> 10);
+                w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+            }
+
+            auto a = m_state[0], b = m_state[1], c = m_state[2], d = m_state[3];
+            auto e = m_state[4], f = m_state[5], g = m_state[6], h = m_state[7];
+
+            for (int i = 0; i < 64; ++i)
+            {
+                auto s1 = Rotr(e, 6) ^ Rotr(e, 11) ^ Rotr(e, 25);
+                auto ch = (e & f) ^ (~e & g);
+                auto t1 = h + s1 + ch + k[i] + w[i];
+                auto s0 = Rotr(a, 2) ^ Rotr(a, 13) ^ Rotr(a, 22);
+                auto maj = (a & b) ^ (a & c) ^ (b & c);
+                auto t2 = s0 + maj;
+
+                h = g; g = f; f = e; e = d + t1;
+                d = c; c = b; b = a; a = t1 + t2;
+            }
+
+            m_state[0] += a; m_state[1] += b; m_state[2] += c; m_state[3] += d;
+            m_state[4] += e; m_state[5] += f; m_state[6] += g; m_state[7] += h;
+        }
+
+        std::array<std::uint32_t, 8> m_state;
+        std::uint8_t m_block[64];
+        std::uint64_t m_size;
+    };
+
+    static std::string GetDeviceInfoString(cl_device_id device, cl_device_info info)
+    {
+        std::size_t size = 0;
+        if (clGetDeviceInfo(device, info, 0, nullptr, &size) != CL_SUCCESS || size == 0)
+        {
+            return "";
+        }
+
+        std::vector<char> value(size);
+        clGetDeviceInfo(device, info, size, value.data(), nullptr);
+        return std::string(value.data());
+    }
+
+    static std::string GetPlatformInfoString(cl_platform_id platform, cl_platform_info info)
+    {
+        std::size_t size = 0;
+        if (clGetPlatformInfo(platform, info, 0, nullptr, &size) != CL_SUCCESS || size == 0)
+        {
+            return "";
+        }
+
+        std::vector<char> value(size);
+        clGetPlatformInfo(platform, info, size, value.data(), nullptr);
+        return std::string(value.data());
+    }
+
+    // Cache entry found while scanning the cache folder
+    struct CacheFile
+    {
+        std::string name;
+        std::uint64_t size;
+        std::time_t time;
+    };
+
+    static bool EndsWith(std::string const& str, std::string const& suffix)
+    {
+        return str.size() >= suffix.size() &&
+            str.compare(str.size() - suffix.size(), suffix.size(), suffix) == 0;
+    }
+
+    static std::vector<CacheFile> ListFiles(std::string const& path)
+    {
+        std::vector<CacheFile> files;
+
+#if defined(_WIN32)
+        WIN32_FIND_DATAA data;
+        auto handle = FindFirstFileA((path + "/*").c_str(), &data);
+
+        if (handle == INVALID_HANDLE_VALUE)
+        {
+            return files;
+        }
+
+        do
+        {
+            if (data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+            {
+                continue;
+            }
+
+            // FILETIME counts 100ns intervals since 1601
+            ULARGE_INTEGER time;
+            time.LowPart = data.ftLastWriteTime.dwLowDateTime;
+            time.HighPart = data.ftLastWriteTime.dwHighDateTime;
+
+            CacheFile file;
+            file.name = data.cFileName;
+            file.size = (std::uint64_t(data.nFileSizeHigh) << 32) | data.nFileSizeLow;
+            file.time = static_cast<std::time_t>(time.QuadPart / 10000000ull - 11644473600ull);
+            files.push_back(file);
+        }
+        while (FindNextFileA(handle, &data));
+
+        FindClose(handle);
+#else
+        auto dir = opendir(path.c_str());
+
+        if (!dir)
+        {
+            return files;
+        }
+
+        while (auto entry = readdir(dir))
+        {
+            struct stat info;
+            auto full_name = path + "/" + entry->d_name;
+
+            if (stat(full_name.c_str(), &info) != 0 || !S_ISREG(info.st_mode))
+            {
+                continue;
+            }
+
+            CacheFile file;
+            file.name = entry->d_name;
+            file.size = static_cast<std::uint64_t>(info.st_size);
+            file.time = info.st_mtime;
+            files.push_back(file);
+        }
+
+        closedir(dir);
+#endif
+
+        return files;
+    }
+
+    // Mark cache entry as recently used
+    static void Touch(std::string const& file_name)
+    {
+#if defined(_WIN32)
+        _utime(file_name.c_str(), nullptr);
+#else
+        utime(file_name.c_str(), nullptr);
+#endif
+    }
+
+    static void CreateFolder(std::string const& path)
+    {
+        // Fails if the folder exists already, which is fine
+#if defined(_WIN32)
+        _mkdir(path.c_str());
+#else
+        mkdir(path.c_str(), 0755);
+#endif
+    }
+
+    KernelCache::KernelCache(std::string const& cache_path, std::uint64_t max_size)
+        : m_cache_path(cache_path)
+        , m_max_size(max_size)
+    {
+        CreateFolder(m_cache_path);
+    }
+
+    KernelCache::Key KernelCache::GetKey(CLWContext context, std::string const& program_name,
+        std::string const& source, std::string const& opts)
+    {
+        auto device = context.GetDevice(0).GetID();
+
+        cl_platform_id platform = nullptr;
+        clGetDeviceInfo(device, CL_DEVICE_PLATFORM, sizeof(platform), &platform, nullptr);
+
+        Sha256 sha;
+        sha.Update(&kKernelCacheVersion, sizeof(kKernelCacheVersion));
+        sha.Update(std::string(BAIKAL_VERSION));
+        sha.Update(GetPlatformInfoString(platform, CL_PLATFORM_NAME));
+        sha.Update(GetPlatformInfoString(platform, CL_PLATFORM_VERSION));
+        sha.Update(GetDeviceInfoString(device, CL_DEVICE_NAME));
+        sha.Update(GetDeviceInfoString(device, CL_DEVICE_VERSION));
+        sha.Update(GetDeviceInfoString(device, CL_DRIVER_VERSION));
+        sha.Update(program_name);
+        sha.Update(opts);
+        sha.Update(source);
+        return sha.Finish();
+    }
+
+    std::string KernelCache::GetFileName(std::string const& program_name, Key const& key) const
+    {
+        std::ostringstream oss;
+        oss << m_cache_path << "/" << program_name << "_";
+
+        for (auto byte : key)
+        {
+            oss << std::hex << std::setw(2) << std::setfill('0') << static_cast<int>(byte);
+        }
+
+        oss << kKernelCacheExtension;
+        return oss.str();
+    }
+
+    bool KernelCache::Load(std::string const& program_name, Key const& key, std::vector<std::uint8_t>& binary) const
+    {
+        auto file_name = GetFileName(program_name, key);
+        std::ifstream in(file_name, std::ios::in | std::ios::binary);
+
+        if (!in)
+        {
+            return false;
+        }
+
+        KernelCacheHeader header;
+        in.read(reinterpret_cast<char*>(&header), sizeof(header));
+
+        if (in.fail() ||
+            std::memcmp(header.magic, kKernelCacheMagic, sizeof(kKernelCacheMagic)) != 0 ||
+            header.version != kKernelCacheVersion ||
+            key.size() != sizeof(header.key) ||
+            std::memcmp(header.key, key.data(), sizeof(header.key)) != 0 ||
+            header.size == 0)
+        {
+            LogInfo("Ignoring stale kernel cache entry: ", file_name, "\n");
+            return false;
+        }
+
+        binary.resize(static_cast<std::size_t>(header.size));
+        in.read(reinterpret_cast<char*>(binary.data()), binary.size());
+
+        // Trailing data means the entry is not what header says either
+        if (in.fail() || in.peek() != std::ifstream::traits_type::eof() ||
+            HashBytes(binary.data(), binary.size(), kHashSeed) != header.checksum)
+        {
+            LogInfo("Ignoring corrupted kernel cache entry: ", file_name, "\n");
+            in.close();
+            // Do not let other processes trip over it
+            std::remove(file_name.c_str());
+            binary.clear();
+            return false;
+        }
+
+        in.close();
+        Touch(file_name);
+        return true;
+    }
+
+    void KernelCache::Save(std::string const& program_name, Key const& key, std::vector<std::uint8_t> const& binary) const
+    {
+        if (binary.empty() || key.size() != sizeof(KernelCacheHeader::key))
+        {
+            return;
+        }
+
+        auto file_name = GetFileName(program_name, key);
+
+        // Write into a unique temporary file first and then rename it,
+        // so concurrent readers never observe partially written entries.
+        std::random_device rd;
+        std::ostringstream oss;
+        oss << file_name << ".tmp" << std::hex << rd() << rd();
+        auto tmp_file_name = oss.str();
+
+        {
+            std::ofstream out(tmp_file_name, std::ios::out | std::ios::binary);
+
+            if (!out)
+            {
+                LogError("Cannot open kernel cache file for writing: ", tmp_file_name, "\n");
+                return;
+            }
+
+            KernelCacheHeader header;
+            std::memcpy(header.magic, kKernelCacheMagic, sizeof(kKernelCacheMagic));
+            header.version = kKernelCacheVersion;
+            std::memcpy(header.key, key.data(), sizeof(header.key));
+            header.size = binary.size();
+            header.checksum = HashBytes(binary.data(), binary.size(), kHashSeed);
+
+            out.write(reinterpret_cast<char const*>(&header), sizeof(header));
+            out.write(reinterpret_cast<char const*>(binary.data()), binary.size());
+
+            if (out.fail())
+            {
+                out.close();
+                std::remove(tmp_file_name.c_str());
+                LogError("Failed to write kernel cache file: ", tmp_file_name, "\n");
+                return;
+            }
+        }
+
+#if defined(_WIN32)
+        // Windows rename does not replace existing files
+        std::remove(file_name.c_str());
+#endif
+
+        if (std::rename(tmp_file_name.c_str(), file_name.c_str()) != 0)
+        {
+            // Another process might have won the race, its entry is equally valid
+            std::remove(tmp_file_name.c_str());
+        }
+
+        Evict(file_name);
+    }
+
+    void KernelCache::Evict(std::string const& keep_file_name) const
+    {
+        auto files = ListFiles(m_cache_path);
+        auto now = std::time(nullptr);
+
+        std::vector<CacheFile> entries;
+        std::uint64_t total_size = 0;
+
+        for (auto const& file : files)
+        {
+            if (EndsWith(file.name, kKernelCacheExtension) &&
+                m_cache_path + "/" + file.name == keep_file_name)
+            {
+                // Time stamps have coarse resolution, make sure the new entry survives
+                total_size += file.size;
+            }
+            else if (EndsWith(file.name, kKernelCacheExtension))
+            {
+                entries.push_back(file);
+                total_size += file.size;
+            }
+            else if (file.name.find(std::string(kKernelCacheExtension) + ".tmp") != std::string::npos &&
+                now - file.time > kStaleTempFileAge)
+            {
+                std::remove((m_cache_path + "/" + file.name).c_str());
+            }
+        }
+
+        std::uint64_t max_size = m_max_size;
+
+        if (total_size <= max_size)
+        {
+            return;
+        }
+
+        // Shrink below the limit a bit, so the folder is not rescanned on every save
+        auto target_size = max_size - max_size / 4;
+
+        std::sort(entries.begin(), entries.end(), [](CacheFile const& lhs, CacheFile const& rhs)
+        {
+            return lhs.time < rhs.time;
+        });
+
+        for (auto const& entry : entries)
+        {
+            if (total_size <= target_size)
+            {
+                break;
+            }
+
+            // Entry might be removed by another process at the same time
+            std::remove((m_cache_path + "/" + entry.name).c_str());
+            total_size -= entry.size;
+        }
+
+        LogInfo("Kernel cache evicted down to ", total_size, " bytes\n");
+    }
+}
@@ -0,0 +1,84 @@
+/**********************************************************************
+Copyright (c) 2017 Advanced Micro Devices, Inc. All rights reserved.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+********************************************************************/
+
+/**
+ \file kernel_cache.h
+ \brief Contains KernelCache class declaration.
+ */
+#pragma once
+
+#include "CLW.h"
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace Baikal
+{
+    /**
+     \brief Persistent on-disk cache for compiled OpenCL program binaries.
+
+     Entries are content addressed: the key is a SHA-256 digest of program source,
+     build options, device, driver and platform, so programs built for another
+     device or driver never collide. Each entry has a versioned header with the
+     full key, payload size and payload checksum, and is validated on load. Entries
+     are written into a temporary file and renamed, so processes sharing a cache
+     folder never observe partially written binaries. Total size of the cache is
+     capped, least recently used entries are evicted once it is exceeded.
+     */
+    class KernelCache
+    {
+    public:
+        // SHA-256 digest
+        using Key = std::vector<std::uint8_t>;
+
+        // Constructor, the cache folder is created if it does not exist
+        explicit KernelCache(std::string const& cache_path,
+            std::uint64_t max_size = 512ull * 1024ull * 1024ull);
+
+        // Compute key of a program built for the first device of the context
+        static Key GetKey(CLWContext context, std::string const& program_name,
+            std::string const& source, std::string const& opts);
+
+        // Load binary for a given key, returns false if there is no valid entry
+        bool Load(std::string const& program_name, Key const& key, std::vector<std::uint8_t>& binary) const;
+        // Save binary for a given key and evict old entries if the cache is too large
+        void Save(std::string const& program_name, Key const& key, std::vector<std::uint8_t> const& binary) const;
+
+        // Set max total size of cache entries in bytes
+        void SetMaxSize(std::uint64_t max_size) { m_max_size = max_size; }
+        std::uint64_t GetMaxSize() const { return m_max_size; }
+
+        // Get cache folder path
+        std::string const& GetCachePath() const { return m_cache_path; }
+
+    private:
+        std::string GetFileName(std::string const& program_name, Key const& key) const;
+        // Remove least recently used entries until the cache fits into its size limit
+        void Evict(std::string const& keep_file_name) const;
+
+        std::string m_cache_path;
+        // Can be changed while other threads store entries
+        std::atomic<std::uint64_t> m_max_size;
+    };
+}
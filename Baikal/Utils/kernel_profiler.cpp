@@ -0,0 +1,337 @@
+/**********************************************************************
+Copyright (c) 2017 Advanced Micro Devices, Inc. All rights reserved.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+********************************************************************/
+#include "kernel_profiler.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <limits>
+#include <stdexcept>
+
+namespace Baikal
+{
+    std::size_t constexpr KernelProfiler::kMaxRecords;
+    std::size_t constexpr KernelProfiler::kMaxPendingLaunches;
+
+    // Launches hold the instance through shared pointers, so Enable and Disable
+    // swap it atomically instead of destroying it under a launch
+    static std::shared_ptr<KernelProfiler>& GetProfilerInstance()
+    {
+        static std::shared_ptr<KernelProfiler> instance;
+        return instance;
+    }
+
+    std::shared_ptr<KernelProfiler> KernelProfiler::Get()
+    {
+        static std::once_flag env_flag;
+        std::call_once(env_flag, []()
+        {
+            if (auto trace_path = std::getenv("BAIKAL_KERNEL_PROFILE"))
+            {
+                Enable(trace_path);
+
+                // The OpenCL runtime might be gone at exit, so launches in flight
+                // are dropped and only completed ones are written
+                std::atexit([]()
+                {
+                    auto profiler = std::atomic_exchange(&GetProfilerInstance(), std::shared_ptr<KernelProfiler>());
+
+                    if (profiler)
+                    {
+                        profiler->WriteTraceFile();
+                    }
+                });
+            }
+        });
+
+        return std::atomic_load(&GetProfilerInstance());
+    }
+
+    void KernelProfiler::Enable(std::string const& trace_path)
+    {
+        std::shared_ptr<KernelProfiler> profiler(new KernelProfiler(trace_path));
+        std::atomic_store(&GetProfilerInstance(), profiler);
+    }
+
+    void KernelProfiler::Disable()
+    {
+        auto profiler = std::atomic_exchange(&GetProfilerInstance(), std::shared_ptr<KernelProfiler>());
+
+        if (profiler)
+        {
+            {
+                std::lock_guard<std::mutex> lock(profiler->m_mutex);
+                profiler->ResolveLaunches(true);
+            }
+
+            profiler->WriteTraceFile();
+        }
+    }
+
+    CLWContext KernelProfiler::CreateContext(CLWDevice device, cl_context_properties* props, bool profiling)
+    {
+        if (!profiling && !Get())
+        {
+            return CLWContext::Create(device, props);
+        }
+
+        cl_device_id id = device.GetID();
+        cl_int status = CL_SUCCESS;
+
+        auto context = clCreateContext(props, 1, &id, nullptr, nullptr, &status);
+        if (status != CL_SUCCESS)
+        {
+            throw std::runtime_error("KernelProfiler: cannot create OpenCL context");
+        }
+
+        auto queue = clCreateCommandQueue(context, id, CL_QUEUE_PROFILING_ENABLE, &status);
+        if (status != CL_SUCCESS)
+        {
+            clReleaseContext(context);
+            throw std::runtime_error("KernelProfiler: cannot create profiling command queue");
+        }
+
+        return CLWContext::Create(context, &id, &queue, 1);
+    }
+
+    KernelProfiler::KernelProfiler(std::string const& trace_path)
+        : m_trace_path(trace_path)
+        , m_next_record(0)
+        , m_num_dropped(0)
+        , m_frame(0)
+    {
+    }
+
+    void KernelProfiler::AddLaunch(std::string const& name, CLWEvent event)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        m_pending.push_back({ name, event, m_frame });
+
+        if (m_pending.size() >= kMaxPendingLaunches)
+        {
+            // Throttle only if the device is that far behind
+            ResolveLaunches(false);
+
+            if (m_pending.size() >= kMaxPendingLaunches)
+            {
+                ResolveLaunches(true);
+            }
+        }
+    }
+
+    void KernelProfiler::EndFrame()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        ResolveLaunches(false);
+        ++m_frame;
+    }
+
+    std::size_t KernelProfiler::GetNumDroppedRecords()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_num_dropped;
+    }
+
+    void KernelProfiler::ResolveLaunches(bool wait)
+    {
+        auto iter = std::remove_if(m_pending.begin(), m_pending.end(), [this, wait](Launch& launch)
+        {
+            cl_event event = launch.event;
+
+            if (wait)
+            {
+                launch.event.Wait();
+            }
+            else
+            {
+                cl_int status = CL_QUEUED;
+                clGetEventInfo(event, CL_EVENT_COMMAND_EXECUTION_STATUS, sizeof(status), &status, nullptr);
+
+                // Failed commands report negative status and are dropped as well
+                if (status > CL_COMPLETE)
+                {
+                    return false;
+                }
+            }
+
+            cl_ulong start = 0;
+            cl_ulong end = 0;
+            cl_command_queue queue = nullptr;
+
+            // Queues created without profiling do not provide time stamps
+            if (clGetEventProfilingInfo(event, CL_PROFILING_COMMAND_START, sizeof(start), &start, nullptr) != CL_SUCCESS ||
+                clGetEventProfilingInfo(event, CL_PROFILING_COMMAND_END, sizeof(end), &end, nullptr) != CL_SUCCESS)
+            {
+                return true;
+            }
+
+            clGetEventInfo(event, CL_EVENT_COMMAND_QUEUE, sizeof(queue), &queue, nullptr);
+
+            auto queue_iter = m_queues.find(queue);
+            if (queue_iter == m_queues.end())
+            {
+                queue_iter = m_queues.emplace(queue, static_cast<std::uint32_t>(m_queues.size())).first;
+            }
+
+            AddRecord({ launch.name, start, end, launch.frame, queue_iter->second });
+            return true;
+        });
+
+        m_pending.erase(iter, m_pending.end());
+    }
+
+    void KernelProfiler::AddRecord(Record&& record)
+    {
+        if (m_records.size() < kMaxRecords)
+        {
+            m_records.push_back(std::move(record));
+        }
+        else
+        {
+            m_records[m_next_record] = std::move(record);
+            ++m_num_dropped;
+        }
+
+        m_next_record = (m_next_record + 1) % kMaxRecords;
+    }
+
+    template <typename F>
+    void KernelProfiler::ForEachRecord(F&& f) const
+    {
+        // Until the ring is full the oldest record is the first one
+        auto first = m_records.size() < kMaxRecords ? 0 : m_next_record;
+
+        for (auto i = 0u; i < m_records.size(); ++i)
+        {
+            f(m_records[(first + i) % m_records.size()]);
+        }
+    }
+
+    void KernelProfiler::WriteTraceFile()
+    {
+        if (m_trace_path.empty())
+        {
+            return;
+        }
+
+        std::ofstream trace(m_trace_path);
+
+        if (trace)
+        {
+            WriteTrace(trace);
+        }
+    }
+
+    void KernelProfiler::WriteTrace(std::ostream& stream)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        std::uint64_t origin = std::numeric_limits<std::uint64_t>::max();
+        ForEachRecord([&origin](Record const& record)
+        {
+            origin = std::min(origin, record.start);
+        });
+
+        // Kernel names are identifiers, so they are written without escaping
+        stream << "{\"traceEvents\":[";
+        bool first = true;
+        ForEachRecord([&stream, &first, origin](Record const& record)
+        {
+            stream << (first ? "\n" : ",\n")
+                << "{\"name\":\"" << record.name << "\",\"cat\":\"kernel\",\"ph\":\"X\""
+                << ",\"ts\":" << std::fixed << std::setprecision(3) << (record.start - origin) * 1e-3
+                << ",\"dur\":" << (record.end - record.start) * 1e-3
+                << ",\"pid\":0,\"tid\":" << record.queue
+                << ",\"args\":{\"frame\":" << record.frame << "}}";
+            first = false;
+        });
+        stream << "\n],\"displayTimeUnit\":\"ms\"}\n";
+    }
+
+    void KernelProfiler::WriteSummary(std::ostream& stream)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        struct KernelSummary
+        {
+            std::uint32_t num_launches = 0;
+            double total = 0.0;
+            // Launches of different queues complete out of order, so times are kept per frame
+            std::map<std::uint32_t, double> frame_times;
+        };
+
+        std::map<std::string, KernelSummary> kernels;
+        double total = 0.0;
+        std::uint32_t first_frame = std::numeric_limits<std::uint32_t>::max();
+        std::uint32_t last_frame = 0;
+
+        ForEachRecord([&](Record const& record)
+        {
+            auto time = (record.end - record.start) * 1e-6;
+            auto& kernel = kernels[record.name];
+
+            kernel.frame_times[record.frame] += time;
+            kernel.total += time;
+            ++kernel.num_launches;
+
+            total += time;
+            first_frame = std::min(first_frame, record.frame);
+            last_frame = std::max(last_frame, record.frame);
+        });
+
+        auto num_frames = m_records.empty() ? 0u : last_frame - first_frame + 1;
+
+        std::vector<std::pair<std::string, KernelSummary>> sorted(kernels.begin(), kernels.end());
+        std::sort(sorted.begin(), sorted.end(), [](auto const& lhs, auto const& rhs)
+        {
+            return lhs.second.total > rhs.second.total;
+        });
+
+        stream << "Kernel profile: " << num_frames << " frame(s), " << std::fixed << std::setprecision(3) << total << " ms\n";
+        stream << std::left << std::setw(40) << "Kernel" << std::right
+            << std::setw(10) << "Launches"
+            << std::setw(14) << "Total, ms"
+            << std::setw(14) << "Frame, ms"
+            << std::setw(14) << "Max frame, ms"
+            << std::setw(8) << "%" << "\n";
+
+        for (auto& kernel : sorted)
+        {
+            auto max_frame = 0.0;
+            for (auto& frame : kernel.second.frame_times)
+            {
+                max_frame = std::max(max_frame, frame.second);
+            }
+
+            stream << std::left << std::setw(40) << kernel.first << std::right
+                << std::setw(10) << kernel.second.num_launches
+                << std::setw(14) << kernel.second.total
+                << std::setw(14) << kernel.second.total / std::max(num_frames, 1u)
+                << std::setw(14) << max_frame
+                << std::setw(8) << std::setprecision(1) << (total > 0.0 ? 100.0 * kernel.second.total / total : 0.0)
+                << std::setprecision(3) << "\n";
+        }
+    }
+}
@@ -0,0 +1,133 @@
+/**********************************************************************
+Copyright (c) 2017 Advanced Micro Devices, Inc. All rights reserved.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+********************************************************************/
+
+/**
+ \file kernel_profiler.h
+ \brief Contains KernelProfiler class declaration.
+ */
+#pragma once
+
+#include "CLW.h"
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace Baikal
+{
+    /**
+     \brief Collects execution timeline of OpenCL kernels.
+
+     Profiling is opt-in: it is turned on by setting BAIKAL_KERNEL_PROFILE environment
+     variable to a trace file name or by calling Enable. While a profiler is active
+     kernels launched through ClwClass are recorded, this requires command queues
+     with profiling enabled, so contexts should be created with CreateContext.
+     Contexts which report kernel times in render statistics regardless of the
+     profiler ask CreateContext for profiling queues explicitly.
+
+     Launches are grouped into frames by EndFrame. Time stamps of launches are picked
+     up once they complete, rendering only waits for them if too many are in flight.
+     The timeline keeps the most recent kMaxRecords launches. Disable writes a Chrome
+     trace (chrome://tracing) to the trace file, in environment variable mode this
+     also happens at exit. Per kernel summary is available through WriteSummary.
+     */
+    class KernelProfiler
+    {
+    public:
+        // Number of launches kept in the timeline, older ones are dropped
+        static std::size_t constexpr kMaxRecords = 1u << 18;
+        // Number of launches in flight before AddLaunch waits for them
+        static std::size_t constexpr kMaxPendingLaunches = 16384;
+
+        // Active profiler, nullptr if profiling is off. The profiler stays alive
+        // while the returned pointer is held, even if profiling is disabled meanwhile
+        static std::shared_ptr<KernelProfiler> Get();
+        // Start profiling
+        static void Enable(std::string const& trace_path);
+        // Stop profiling, wait for launches in flight and write the trace
+        static void Disable();
+        // Create a context for a device, command queues have profiling enabled if profiling is on
+        // or requested explicitly (kernel times in render statistics need it too)
+        static CLWContext CreateContext(CLWDevice device, cl_context_properties* props = nullptr, bool profiling = false);
+
+        // Record kernel launch
+        void AddLaunch(std::string const& name, CLWEvent event);
+        // Finish current frame, picks up launches completed so far without waiting
+        void EndFrame();
+
+        // Write timeline in Chrome trace event format
+        void WriteTrace(std::ostream& stream);
+        // Write per kernel summary table
+        void WriteSummary(std::ostream& stream);
+        // Number of launches dropped from the timeline
+        std::size_t GetNumDroppedRecords();
+
+        KernelProfiler(KernelProfiler const&) = delete;
+        KernelProfiler& operator = (KernelProfiler const&) = delete;
+
+    private:
+        explicit KernelProfiler(std::string const& trace_path);
+
+        struct Launch
+        {
+            std::string name;
+            CLWEvent event;
+            std::uint32_t frame;
+        };
+
+        struct Record
+        {
+            std::string name;
+            // Device time stamps in nanoseconds
+            std::uint64_t start;
+            std::uint64_t end;
+            std::uint32_t frame;
+            std::uint32_t queue;
+        };
+
+        // Move time stamps of pending launches to records, only completed ones
+        // unless wait is set, m_mutex should be locked
+        void ResolveLaunches(bool wait);
+        // Add record to the timeline, m_mutex should be locked
+        void AddRecord(Record&& record);
+        // Visit records from the oldest one, m_mutex should be locked
+        template <typename F>
+        void ForEachRecord(F&& f) const;
+        // Write trace to the trace file if there is one
+        void WriteTraceFile();
+
+        std::string m_trace_path;
+        std::mutex m_mutex;
+        std::vector<Launch> m_pending;
+        // Ring buffer of kMaxRecords records
+        std::vector<Record> m_records;
+        std::size_t m_next_record;
+        std::size_t m_num_dropped;
+        // Queues are numbered in order of appearance
+        std::map<cl_command_queue, std::uint32_t> m_queues;
+        std::uint32_t m_frame;
+    };
+}
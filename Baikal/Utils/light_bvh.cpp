@@ -0,0 +1,243 @@
+/**********************************************************************
+Copyright (c) 2017 Advanced Micro Devices, Inc. All rights reserved.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+********************************************************************/
+#include "light_bvh.h"
+
+#include "math/mathutils.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace Baikal
+{
+    // Number of buckets split candidates are evaluated at along each axis
+    int constexpr kNumSplitBuckets = 12;
+
+    static float SafeAcos(float x)
+    {
+        return std::acos(std::min(std::max(x, -1.f), 1.f));
+    }
+
+    // Rotate vector around unit axis
+    static RadeonRays::float3 Rotate(RadeonRays::float3 const& v, RadeonRays::float3 const& axis, float angle)
+    {
+        auto cos_angle = std::cos(angle);
+        auto sin_angle = std::sin(angle);
+        return v * cos_angle + RadeonRays::cross(axis, v) * sin_angle + axis * RadeonRays::dot(axis, v) * (1.f - cos_angle);
+    }
+
+    // Surface area orientation heuristic from Conty Estevez and Kulla,
+    // "Importance Sampling of Many Lights with Adaptive Tree Splitting"
+    static float GetSplitCost(LightBvh::LightBounds const& bounds, float extent_ratio)
+    {
+        auto theta_o = SafeAcos(bounds.cos_theta_o);
+        auto theta_e = SafeAcos(bounds.cos_theta_e);
+        auto theta_w = std::min(theta_o + theta_e, RadeonRays::PI);
+        auto sin_theta_o = std::sqrt(std::max(0.f, 1.f - bounds.cos_theta_o * bounds.cos_theta_o));
+
+        // Solid angle measure of the emission cone
+        auto m_omega = 2.f * RadeonRays::PI * (1.f - bounds.cos_theta_o) +
+            0.5f * RadeonRays::PI * (2.f * theta_w * sin_theta_o - std::cos(theta_o - 2.f * theta_w) -
+            2.f * theta_o * sin_theta_o + bounds.cos_theta_o);
+
+        return bounds.power * m_omega * extent_ratio * bounds.bounds.surface_area();
+    }
+
+    LightBvh::LightBounds LightBvh::Union(LightBounds const& a, LightBounds const& b)
+    {
+        LightBounds result;
+        result.bounds = a.bounds;
+        result.bounds.grow(b.bounds);
+        result.power = a.power + b.power;
+        result.cos_theta_e = std::min(a.cos_theta_e, b.cos_theta_e);
+
+        auto theta_a = SafeAcos(a.cos_theta_o);
+        auto theta_b = SafeAcos(b.cos_theta_o);
+        auto theta_d = SafeAcos(RadeonRays::dot(a.axis, b.axis));
+
+        // One of the cones contains the other one
+        if (std::min(theta_d + theta_b, RadeonRays::PI) <= theta_a)
+        {
+            result.axis = a.axis;
+            result.cos_theta_o = a.cos_theta_o;
+            return result;
+        }
+
+        if (std::min(theta_d + theta_a, RadeonRays::PI) <= theta_b)
+        {
+            result.axis = b.axis;
+            result.cos_theta_o = b.cos_theta_o;
+            return result;
+        }
+
+        // Otherwise rotate the axis of the first cone towards the second one
+        auto theta_o = 0.5f * (theta_a + theta_d + theta_b);
+        auto rotation_axis = RadeonRays::cross(a.axis, b.axis);
+
+        if (theta_o >= RadeonRays::PI || rotation_axis.sqnorm() == 0.f)
+        {
+            result.axis = a.axis;
+            result.cos_theta_o = -1.f;
+            return result;
+        }
+
+        result.axis = RadeonRays::normalize(Rotate(a.axis, RadeonRays::normalize(rotation_axis), theta_o - theta_a));
+        result.cos_theta_o = std::cos(theta_o);
+        return result;
+    }
+
+    void LightBvh::Build(std::vector<Emitter> emitters)
+    {
+        m_nodes.clear();
+
+        if (emitters.empty())
+        {
+            return;
+        }
+
+        m_nodes.reserve(2 * emitters.size() - 1);
+        BuildNode(emitters, 0, emitters.size(), -1);
+    }
+
+    int LightBvh::BuildNode(std::vector<Emitter>& emitters, std::size_t begin, std::size_t end, int parent)
+    {
+        auto idx = static_cast<int>(m_nodes.size());
+        m_nodes.emplace_back();
+
+        auto bounds = emitters[begin].bounds;
+        RadeonRays::bbox centroid_bounds(bounds.bounds.center());
+
+        for (auto i = begin + 1; i < end; ++i)
+        {
+            bounds = Union(bounds, emitters[i].bounds);
+            centroid_bounds.grow(emitters[i].bounds.bounds.center());
+        }
+
+        Node node;
+        node.bbox_min = bounds.bounds.pmin;
+        node.bbox_min.w = bounds.power;
+        node.bbox_max = bounds.bounds.pmax;
+        node.bbox_max.w = bounds.cos_theta_o;
+        node.axis = bounds.axis;
+        node.axis.w = bounds.cos_theta_e;
+        node.parent = parent;
+
+        if (end - begin == 1)
+        {
+            node.left = -1;
+            node.right = -1;
+            node.light = emitters[begin].light;
+            m_nodes[idx] = node;
+            return idx;
+        }
+
+        auto extents = bounds.bounds.extents();
+        auto max_extent = std::max(extents.x, std::max(extents.y, extents.z));
+        auto centroid_min = centroid_bounds.pmin;
+        auto centroid_extents = centroid_bounds.extents();
+
+        auto best_cost = std::numeric_limits<float>::max();
+        auto best_axis = -1;
+        auto best_bucket = 0;
+
+        auto get_bucket = [&](Emitter const& emitter, int axis)
+        {
+            auto offset = (emitter.bounds.bounds.center()[axis] - centroid_min[axis]) / centroid_extents[axis];
+            return std::min(static_cast<int>(kNumSplitBuckets * offset), kNumSplitBuckets - 1);
+        };
+
+        for (auto axis = 0; axis < 3; ++axis)
+        {
+            if (centroid_extents[axis] <= 0.f)
+            {
+                continue;
+            }
+
+            LightBounds buckets[kNumSplitBuckets];
+            int counts[kNumSplitBuckets] = {};
+
+            for (auto i = begin; i < end; ++i)
+            {
+                auto bucket = get_bucket(emitters[i], axis);
+                buckets[bucket] = counts[bucket] ? Union(buckets[bucket], emitters[i].bounds) : emitters[i].bounds;
+                ++counts[bucket];
+            }
+
+            // Prefer splits along the longer sides of the node
+            auto extent_ratio = extents[axis] > 0.f ? max_extent / extents[axis] : 1.f;
+
+            for (auto split = 1; split < kNumSplitBuckets; ++split)
+            {
+                LightBounds left, right;
+                auto num_left = 0;
+                auto num_right = 0;
+
+                for (auto i = 0; i < kNumSplitBuckets; ++i)
+                {
+                    if (!counts[i])
+                    {
+                        continue;
+                    }
+
+                    if (i < split)
+                    {
+                        left = num_left++ ? Union(left, buckets[i]) : buckets[i];
+                    }
+                    else
+                    {
+                        right = num_right++ ? Union(right, buckets[i]) : buckets[i];
+                    }
+                }
+
+                if (!num_left || !num_right)
+                {
+                    continue;
+                }
+
+                auto cost = GetSplitCost(left, extent_ratio) + GetSplitCost(right, extent_ratio);
+
+                if (cost < best_cost)
+                {
+                    best_cost = cost;
+                    best_axis = axis;
+                    best_bucket = split;
+                }
+            }
+        }
+
+        auto mid = begin + (end - begin) / 2;
+
+        // Lights sharing the same centroid are split in halves
+        if (best_axis >= 0)
+        {
+            auto iter = std::partition(emitters.begin() + begin, emitters.begin() + end,
+                [&](Emitter const& emitter) { return get_bucket(emitter, best_axis) < best_bucket; });
+            mid = static_cast<std::size_t>(iter - emitters.begin());
+        }
+
+        node.left = BuildNode(emitters, begin, mid, idx);
+        node.right = BuildNode(emitters, mid, end, idx);
+        node.light = -1;
+        m_nodes[idx] = node;
+        return idx;
+    }
+}
@@ -0,0 +1,99 @@
+/**********************************************************************
+Copyright (c) 2017 Advanced Micro Devices, Inc. All rights reserved.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+********************************************************************/
+
+/**
+ \file light_bvh.h
+ \brief Contains LightBvh class declaration.
+ */
+#pragma once
+
+#include "math/bbox.h"
+#include "math/float3.h"
+
+#include <vector>
+
+namespace Baikal
+{
+    /**
+     \brief Bounding volume hierarchy over light sources.
+
+     Every node keeps spatial bounds of its lights, a cone bounding their emission
+     directions and their total power, which is enough to conservatively estimate
+     node contribution at a shading point. Kernels descend the tree choosing children
+     proportionally to these estimates, so the selection pdf of a light is the product
+     of choices along its path from the root. Every leaf holds a single light.
+     */
+    class LightBvh
+    {
+    public:
+        // Emission bounds of a light or a group of lights
+        struct LightBounds
+        {
+            RadeonRays::bbox bounds;
+            // Surface normals are within theta_o from the axis,
+            // light is emitted up to theta_e away from the normals
+            RadeonRays::float3 axis;
+            float cos_theta_o;
+            float cos_theta_e;
+            float power;
+        };
+
+        // Light index along with its bounds
+        struct Emitter
+        {
+            int light;
+            LightBounds bounds;
+        };
+
+        // Node in GPU layout, has to match LightBvhNode in light_bvh.cl
+        struct Node
+        {
+            // Power is kept in w
+            RadeonRays::float3 bbox_min;
+            // Cosine of theta_o is kept in w
+            RadeonRays::float3 bbox_max;
+            // Cosine of theta_e is kept in w
+            RadeonRays::float3 axis;
+            // Children are -1 for leafs, parent is -1 for the root
+            int left;
+            int right;
+            int parent;
+            // Light index for leafs, -1 for inner nodes
+            int light;
+        };
+
+        // Build the tree, previous one is discarded
+        void Build(std::vector<Emitter> emitters);
+
+        // Nodes in depth first order, the root goes first
+        std::vector<Node> const& GetNodes() const { return m_nodes; }
+
+        // Bounds of both groups of lights
+        static LightBounds Union(LightBounds const& a, LightBounds const& b);
+
+    private:
+        // Build subtree over emitters in [begin, end), returns its root index
+        int BuildNode(std::vector<Emitter>& emitters, std::size_t begin, std::size_t end, int parent);
+
+        std::vector<Node> m_nodes;
+    };
+}
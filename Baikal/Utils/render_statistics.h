@@ -0,0 +1,78 @@
+/**********************************************************************
+Copyright (c) 2017 Advanced Micro Devices, Inc. All rights reserved.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+********************************************************************/
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace Baikal
+{
+    /**
+     \brief Render statistics used for profiling and capacity planning.
+
+     Memory sizes are in bytes and cover the buffers Baikal allocates itself,
+     intersector acceleration structures are not included. Ray counts and kernel
+     times are accumulated since the statistics have been reset.
+     */
+    struct RenderStatistics
+    {
+        // Kernel execution time in milliseconds and number of launches
+        struct KernelTime
+        {
+            float time = 0.f;
+            std::uint32_t num_launches = 0;
+        };
+
+        // Vertices, indices, shapes and camera
+        std::size_t geometry_memory = 0;
+        // Texture descriptors and texel data
+        std::size_t texture_memory = 0;
+        // Materials, volumes and input maps
+        std::size_t material_memory = 0;
+        // Lights and light sampling distributions
+        std::size_t light_memory = 0;
+        // Estimator work buffers
+        std::size_t work_buffer_memory = 0;
+        // Output accumulation buffers
+        std::size_t output_memory = 0;
+
+        // Number of iterations rendered
+        std::uint32_t num_samples = 0;
+
+        // Rays traced at each bounce
+        std::vector<std::uint64_t> rays_per_bounce;
+        // Paths left at each bounce after compaction
+        std::vector<std::uint64_t> paths_per_bounce;
+
+        // Kernel times by kernel name
+        std::map<std::string, KernelTime> kernel_times;
+
+        std::size_t GetDeviceMemory() const
+        {
+            return geometry_memory + texture_memory + material_memory + light_memory +
+                work_buffer_memory + output_memory;
+        }
+    };
+}
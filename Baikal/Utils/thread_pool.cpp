@@ -0,0 +1,169 @@
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <memory>
+
+namespace Baikal
+{
+    ThreadPool::ThreadPool(std::size_t num_threads)
+    : m_stop(false)
+    {
+        if (num_threads == 0)
+        {
+            num_threads = std::thread::hardware_concurrency();
+        }
+
+        // Calling thread is a worker too
+        for (auto i = 1u; i < num_threads; ++i)
+        {
+            m_workers.emplace_back(&ThreadPool::WorkerMain, this);
+        }
+    }
+
+    ThreadPool::~ThreadPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stop = true;
+        }
+
+        m_cv.notify_all();
+
+        for (auto& worker : m_workers)
+        {
+            worker.join();
+        }
+    }
+
+    void ThreadPool::WorkerMain()
+    {
+        for (;;)
+        {
+            std::function<void()> task;
+
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_cv.wait(lock, [this]() { return m_stop || !m_tasks.empty(); });
+
+                if (m_stop && m_tasks.empty())
+                {
+                    return;
+                }
+
+                task = std::move(m_tasks.front());
+                m_tasks.pop_front();
+            }
+
+            task();
+        }
+    }
+
+    void ThreadPool::Submit(std::function<void()> task)
+    {
+        if (m_workers.empty())
+        {
+            task();
+            return;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_tasks.emplace_back(std::move(task));
+        }
+
+        m_cv.notify_one();
+    }
+
+    void ThreadPool::ParallelFor(std::size_t count, std::function<void(std::size_t)> const& func)
+    {
+        if (count == 0)
+        {
+            return;
+        }
+
+        // Shared between the caller and the helper tasks,
+        // tasks which start after the loop is over do nothing.
+        struct Loop
+        {
+            std::atomic<std::size_t> next;
+            std::mutex mutex;
+            std::condition_variable cv;
+            std::size_t active = 0;
+            bool closed = false;
+            std::exception_ptr error;
+        };
+
+        auto loop = std::make_shared<Loop>();
+        loop->next = 0;
+
+        auto run = [loop, count, &func]()
+        {
+            for (auto i = loop->next++; i < count; i = loop->next++)
+            {
+                try
+                {
+                    func(i);
+                }
+                catch (...)
+                {
+                    std::lock_guard<std::mutex> lock(loop->mutex);
+
+                    if (!loop->error)
+                    {
+                        loop->error = std::current_exception();
+                    }
+
+                    // Skip the rest of the range
+                    loop->next = count;
+                }
+            }
+        };
+
+        auto num_helpers = std::min(m_workers.size(), count - 1);
+
+        if (num_helpers > 0)
+        {
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+
+                for (auto i = 0u; i < num_helpers; ++i)
+                {
+                    m_tasks.emplace_back([loop, run]()
+                    {
+                        {
+                            std::lock_guard<std::mutex> lock(loop->mutex);
+
+                            if (loop->closed)
+                            {
+                                return;
+                            }
+
+                            ++loop->active;
+                        }
+
+                        run();
+
+                        std::lock_guard<std::mutex> lock(loop->mutex);
+                        --loop->active;
+                        loop->cv.notify_all();
+                    });
+                }
+            }
+
+            m_cv.notify_all();
+        }
+
+        run();
+
+        std::unique_lock<std::mutex> lock(loop->mutex);
+        loop->closed = true;
+        loop->cv.wait(lock, [&loop]() { return loop->active == 0; });
+
+        if (loop->error)
+        {
+            std::rethrow_exception(loop->error);
+        }
+    }
+}
@@ -0,0 +1,76 @@
+/**********************************************************************
+ Copyright (c) 2016 Advanced Micro Devices, Inc. All rights reserved.
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+ ********************************************************************/
+
+/**
+ \file thread_pool.h
+ \brief Contains ThreadPool class declaration.
+ */
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Baikal
+{
+    /**
+     \brief Fixed set of worker threads for data parallel CPU work.
+
+     ParallelFor splits an index range between the workers and the calling thread
+     and blocks until the whole range has been processed. The calling thread takes
+     part in the loop, so nested calls from worker threads do not deadlock.
+     */
+    class ThreadPool
+    {
+    public:
+        // Create a pool with a given number of workers (0 means one per hardware thread)
+        explicit ThreadPool(std::size_t num_threads = 0);
+        ~ThreadPool();
+
+        ThreadPool(ThreadPool const&) = delete;
+        ThreadPool& operator = (ThreadPool const&) = delete;
+
+        // Number of threads participating in ParallelFor including the calling one
+        std::size_t GetNumThreads() const { return m_workers.size() + 1; }
+
+        // Call func(i) for each i in [0, count) and wait for completion.
+        // The first exception thrown by func is rethrown in the calling thread.
+        void ParallelFor(std::size_t count, std::function<void(std::size_t)> const& func);
+
+        // Run task on a worker thread without waiting for it.
+        // Pools without workers run the task in the calling thread.
+        void Submit(std::function<void()> task);
+
+    private:
+        void WorkerMain();
+
+        std::vector<std::thread> m_workers;
+        std::deque<std::function<void()>> m_tasks;
+        std::mutex m_mutex;
+        std::condition_variable m_cv;
+        bool m_stop;
+    };
+}
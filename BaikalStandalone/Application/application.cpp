@@ -613,6 +613,8 @@ namespace Baikal
             std::cout << "\tPrimary: " << m_settings.stats.primary_throughput * 1e-6f << " Mrays/s\n";
             std::cout << "\tSecondary: " << m_settings.stats.secondary_throughput * 1e-6f << " Mrays/s\n";
             std::cout << "\tShadow: " << m_settings.stats.shadow_throughput * 1e-6f << " Mrays/s\n";
+            std::cout << "\tShading: " << m_settings.stats.shading_throughput * 1e-6f << " Mhits/s\n";
+            std::cout << "\tShading (sorted): " << m_settings.stats.sorted_shading_throughput * 1e-6f << " Mhits/s\n";
         }
     }
 
@@ -887,6 +889,8 @@ namespace Baikal
                 ImGui::Text("Primary rays: %f Mrays/s", stats.primary_throughput * 1e-6f);
                 ImGui::Text("Secondary rays: %f Mrays/s", stats.secondary_throughput * 1e-6f);
                 ImGui::Text("Shadow rays: %f Mrays/s", stats.shadow_throughput * 1e-6f);
+                ImGui::Text("Shading: %f Mhits/s", stats.shading_throughput * 1e-6f);
+                ImGui::Text("Shading (sorted): %f Mhits/s", stats.sorted_shading_throughput * 1e-6f);
             }
 
 #ifdef ENABLE_DENOISER
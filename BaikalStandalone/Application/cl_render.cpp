@@ -49,6 +49,7 @@ namespace Baikal
     {
         InitCl(settings, m_tex);
         LoadScene(settings);
+        InitScheduler();
     }
 
     void AppClRender::InitCl(AppSettings& settings, GLuint tex)
@@ -84,7 +85,6 @@ namespace Baikal
         settings.interop = false;
 
         m_outputs.resize(m_cfgs.size());
-        m_ctrl.reset(new ControlData[m_cfgs.size()]);
 
         for (int i = 0; i < m_cfgs.size(); ++i)
         {
@@ -98,11 +98,6 @@ namespace Baikal
                     settings.interop = true;
                 }
             }
-
-            m_ctrl[i].clear.store(1);
-            m_ctrl[i].stop.store(0);
-            m_ctrl[i].newdata.store(0);
-            m_ctrl[i].idx = i;
         }
 
         if (force_disable_itnerop)
@@ -151,7 +146,8 @@ namespace Baikal
 
             if (m_cfgs[i].type == ConfigManager::kPrimary)
             {
-                m_outputs[i].copybuffer = m_cfgs[i].context.CreateBuffer<RadeonRays::float3>(m_width * m_height, CL_MEM_READ_WRITE);
+                m_outputs[i].rgba8 = m_cfgs[i].context.CreateBuffer<std::uint32_t>(m_width * m_height, CL_MEM_READ_WRITE);
+                m_outputs[i].readback.reset(new Baikal::ClwReadbackRing<std::uint32_t>(m_cfgs[i].context, m_width * m_height));
             }
         }
 
@@ -260,81 +256,87 @@ namespace Baikal
         std::cout << "Sensor size: " << settings.camera_sensor_size.x * 1000.f << "x" << settings.camera_sensor_size.y * 1000.f << "mm\n";
     }
 
-    void AppClRender::UpdateScene()
+    void AppClRender::InitScheduler()
     {
+        auto make_device = [this](int i)
+        {
+            Baikal::MultiDeviceScheduler::Device device;
+            device.context = m_cfgs[i].context;
+            device.controller = m_cfgs[i].controller.get();
+            device.renderer = static_cast<Baikal::MonteCarloRenderer*>(m_cfgs[i].renderer.get());
+            device.output = m_outputs[i].output.get();
+            return device;
+        };
+
+        std::vector<Baikal::MultiDeviceScheduler::Device> secondary;
 
         for (int i = 0; i < m_cfgs.size(); ++i)
         {
-            if (i == m_primary)
+            if (i != m_primary)
             {
-                m_cfgs[i].controller->CompileScene(m_scene);
-                m_cfgs[i].renderer->Clear(float3(0, 0, 0), *m_outputs[i].output);
-
-#ifdef ENABLE_DENOISER
-                m_cfgs[i].renderer->Clear(float3(0, 0, 0), *m_outputs[i].output_normal);
-                m_cfgs[i].renderer->Clear(float3(0, 0, 0), *m_outputs[i].output_position);
-                m_cfgs[i].renderer->Clear(float3(0, 0, 0), *m_outputs[i].output_albedo);
-                m_cfgs[i].renderer->Clear(float3(0, 0, 0), *m_outputs[i].output_mesh_id);
-#endif
-
+                secondary.push_back(make_device(i));
             }
-            else
-                m_ctrl[i].clear.store(true);
         }
+
+        m_scheduler.reset(new Baikal::MultiDeviceScheduler(make_device(m_primary), secondary, m_scene));
     }
 
-    void AppClRender::Update(AppSettings& settings)
+    void AppClRender::UpdateScene()
     {
-        //if (std::chrono::duration_cast<std::chrono::seconds>(time - updatetime).count() > 1)
-        //{
-        for (int i = 0; i < m_cfgs.size(); ++i)
-        {
-            if (m_cfgs[i].type == ConfigManager::kPrimary)
-                continue;
-
-            int desired = 1;
-            if (std::atomic_compare_exchange_strong(&m_ctrl[i].newdata, &desired, 0))
-            {
-                {
-                    m_cfgs[m_primary].context.WriteBuffer(0, m_outputs[m_primary].copybuffer, &m_outputs[i].fdata[0], settings.width * settings.height);
-                }
-
-                auto acckernel = static_cast<Baikal::MonteCarloRenderer*>(m_cfgs[m_primary].renderer.get())->GetAccumulateKernel();
+        m_cfgs[m_primary].controller->CompileScene(m_scene);
+        m_cfgs[m_primary].renderer->Clear(float3(0, 0, 0), *m_outputs[m_primary].output);
 
-                int argc = 0;
-                acckernel.SetArg(argc++, m_outputs[m_primary].copybuffer);
-                acckernel.SetArg(argc++, settings.width * settings.width);
-                acckernel.SetArg(argc++, static_cast<Baikal::ClwOutput*>(m_outputs[m_primary].output.get())->data());
+#ifdef ENABLE_DENOISER
+        m_cfgs[m_primary].renderer->Clear(float3(0, 0, 0), *m_outputs[m_primary].output_normal);
+        m_cfgs[m_primary].renderer->Clear(float3(0, 0, 0), *m_outputs[m_primary].output_position);
+        m_cfgs[m_primary].renderer->Clear(float3(0, 0, 0), *m_outputs[m_primary].output_albedo);
+        m_cfgs[m_primary].renderer->Clear(float3(0, 0, 0), *m_outputs[m_primary].output_mesh_id);
+#endif
 
-                int globalsize = settings.width * settings.height;
-                m_cfgs[m_primary].context.Launch1D(0, ((globalsize + 63) / 64) * 64, 64, acckernel);
-            }
-        }
+        m_scheduler->Clear();
+    }
 
-        //updatetime = time;
-        //}
+    void AppClRender::Update(AppSettings& settings)
+    {
+        // Add samples rendered by secondary devices since the last update
+        m_scheduler->Merge();
 
         if (!settings.interop)
         {
 #ifdef ENABLE_DENOISER
-            m_outputs[m_primary].output_denoised->GetData(&m_outputs[m_primary].fdata[0]);
+            auto output = m_outputs[m_primary].output_denoised.get();
 #else
-            m_outputs[m_primary].output->GetData(&m_outputs[m_primary].fdata[0]);
+            auto output = m_outputs[m_primary].output.get();
 #endif
+            auto& primary = m_outputs[m_primary];
+
+            // Tonemap and quantize on the device, only RGBA8 goes over the bus
+            auto quantizekernel = static_cast<Baikal::MonteCarloRenderer*>(m_cfgs[m_primary].renderer.get())->GetQuantizeKernel();
+
+            int globalsize = output->width() * output->height();
+
+            int argc = 0;
+            quantizekernel.SetArg(argc++, static_cast<Baikal::ClwOutput*>(output)->data());
+            quantizekernel.SetArg(argc++, globalsize);
+            quantizekernel.SetArg(argc++, 2.2f);
+            quantizekernel.SetArg(argc++, primary.rgba8);
+
+            m_cfgs[m_primary].context.Launch1D(0, ((globalsize + 63) / 64) * 64, 64, quantizekernel);
 
-            float gamma = 2.2f;
-            for (int i = 0; i < (int)m_outputs[m_primary].fdata.size(); ++i)
+            // Start reading this frame and present the previous one meanwhile
+            auto readback = primary.readback->Read(primary.rgba8, reinterpret_cast<std::uint32_t*>(&primary.udata[0]), 0, globalsize);
+
+            if (primary.pending_readback.valid())
             {
-                m_outputs[m_primary].udata[4 * i] = (unsigned char)clamp(clamp(pow(m_outputs[m_primary].fdata[i].x / m_outputs[m_primary].fdata[i].w, 1.f / gamma), 0.f, 1.f) * 255, 0, 255);
-                m_outputs[m_primary].udata[4 * i + 1] = (unsigned char)clamp(clamp(pow(m_outputs[m_primary].fdata[i].y / m_outputs[m_primary].fdata[i].w, 1.f / gamma), 0.f, 1.f) * 255, 0, 255);
-                m_outputs[m_primary].udata[4 * i + 2] = (unsigned char)clamp(clamp(pow(m_outputs[m_primary].fdata[i].z / m_outputs[m_primary].fdata[i].w, 1.f / gamma), 0.f, 1.f) * 255, 0, 255);
-                m_outputs[m_primary].udata[4 * i + 3] = 1;
+                primary.pending_readback.get();
+
+                glActiveTexture(GL_TEXTURE0);
+                glBindTexture(GL_TEXTURE_2D, m_tex);
+                glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, output->width(), output->height(), GL_RGBA, GL_UNSIGNED_BYTE, &primary.udata[0]);
+                glBindTexture(GL_TEXTURE_2D, 0);
             }
 
-            glActiveTexture(GL_TEXTURE0);
-            glBindTexture(GL_TEXTURE_2D, m_tex);
-            glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, m_outputs[m_primary].output->width(), m_outputs[m_primary].output->height(), GL_RGBA, GL_UNSIGNED_BYTE, &m_outputs[m_primary].udata[0]);
-            glBindTexture(GL_TEXTURE_2D, 0);
+            primary.pending_readback = std::move(readback);
         }
         else
         {
@@ -438,18 +440,14 @@ namespace Baikal
     {
         std::vector<RadeonRays::float3> data;
 
-        //read cl output in case of iterop
-        std::vector<RadeonRays::float3> output_data;
-        if (settings.interop)
-        {
-            auto output = m_outputs[m_primary].output.get();
-            auto buffer = static_cast<Baikal::ClwOutput*>(output)->data();
-            output_data.resize(buffer.GetElementCount());
-            m_cfgs[m_primary].context.ReadBuffer(0, static_cast<Baikal::ClwOutput*>(output)->data(), &output_data[0], output_data.size()).Wait();
-        }
-
-        //use already copied to CPU cl data in case of no interop
-        auto& fdata = settings.interop ? output_data : m_outputs[m_primary].fdata;
+        //preview only reads tonemapped data back, so read cl output here
+#ifdef ENABLE_DENOISER
+        auto output = m_outputs[m_primary].output_denoised.get();
+#else
+        auto output = m_outputs[m_primary].output.get();
+#endif
+        std::vector<RadeonRays::float3> fdata(output->width() * output->height());
+        output->GetData(&fdata[0]);
 
         data.resize(fdata.size());
         std::transform(fdata.cbegin(), fdata.cend(), data.begin(),
@@ -502,67 +500,16 @@ namespace Baikal
         out->close();
     }
 
-    void AppClRender::RenderThread(ControlData& cd)
-    {
-        auto renderer = m_cfgs[cd.idx].renderer.get();
-        auto controller = m_cfgs[cd.idx].controller.get();
-        auto output = m_outputs[cd.idx].output.get();
-
-        auto updatetime = std::chrono::high_resolution_clock::now();
-
-        while (!cd.stop.load())
-        {
-            int result = 1;
-            bool update = false;
-
-            if (std::atomic_compare_exchange_strong(&cd.clear, &result, 0))
-            {
-                renderer->Clear(float3(0, 0, 0), *output);
-                controller->CompileScene(m_scene);
-                update = true;
-            }
-
-            auto& scene = controller->GetCachedScene(m_scene);
-            renderer->Render(scene);
-
-            auto now = std::chrono::high_resolution_clock::now();
-
-            update = update || (std::chrono::duration_cast<std::chrono::seconds>(now - updatetime).count() > 1);
-
-            if (update)
-            {
-                m_outputs[cd.idx].output->GetData(&m_outputs[cd.idx].fdata[0]);
-                updatetime = now;
-                cd.newdata.store(1);
-            }
-
-            m_cfgs[cd.idx].context.Finish(0);
-        }
-    }
-
     void AppClRender::StartRenderThreads()
     {
-        for (int i = 0; i < m_cfgs.size(); ++i)
-        {
-            if (i != m_primary)
-            {
-                m_renderthreads.push_back(std::thread(&AppClRender::RenderThread, this, std::ref(m_ctrl[i])));
-                m_renderthreads.back().detach();
-            }
-        }
+        m_scheduler->Start();
 
         std::cout << m_cfgs.size() << " OpenCL submission threads started\n";
     }
 
     void AppClRender::StopRenderThreads()
     {
-        for (int i = 0; i < m_cfgs.size(); ++i)
-        {
-            if (i == m_primary)
-                continue;
-
-            m_ctrl[i].stop.store(true);
-        }
+        m_scheduler->Stop();
     }
 
     void AppClRender::RunBenchmark(AppSettings& settings)
@@ -29,7 +29,9 @@
 
 #include "RenderFactory/render_factory.h"
 #include "Renderers/monte_carlo_renderer.h"
+#include "Renderers/multi_device_scheduler.h"
 #include "Output/clwoutput.h"
+#include "Output/clwreadback.h"
 #include "Application/app_utils.h"
 #include "Utils/config_manager.h"
 #include "Application/gl_render.h"
@@ -59,16 +61,12 @@ namespace Baikal
 
             std::vector<float3> fdata;
             std::vector<unsigned char> udata;
-            CLWBuffer<float3> copybuffer;
-        };
 
-        struct ControlData
-        {
-            std::atomic<int> clear;
-            std::atomic<int> stop;
-            std::atomic<int> newdata;
-            std::mutex datamutex;
-            int idx;
+            // Tonemapped RGBA8 image of the primary output and its readback ring
+            CLWBuffer<std::uint32_t> rgba8;
+            std::unique_ptr<Baikal::ClwReadbackRing<std::uint32_t>> readback;
+            // Readback of udata in flight
+            std::future<void> pending_readback;
         };
 
     public:
@@ -107,7 +105,7 @@ namespace Baikal
     private:
         void InitCl(AppSettings& settings, GLuint tex);
         void LoadScene(AppSettings& settings);
-        void RenderThread(ControlData& cd);
+        void InitScheduler();
 
         Baikal::Scene1::Ptr m_scene;
         Baikal::Camera::Ptr m_camera;
@@ -118,8 +116,8 @@ namespace Baikal
         RadeonRays::float2 m_shape_id_pos;
         std::vector<ConfigManager::Config> m_cfgs;
         std::vector<OutputData> m_outputs;
-        std::unique_ptr<ControlData[]> m_ctrl;
-        std::vector<std::thread> m_renderthreads;
+        // Renders on secondary devices and merges their samples into the primary output
+        std::unique_ptr<Baikal::MultiDeviceScheduler> m_scheduler;
         int m_primary = -1;
         std::uint32_t m_width, m_height;
 
@@ -25,19 +25,38 @@ THE SOFTWARE.
 
 #include "CLW.h"
 #include "Renderers/renderer.h"
+#include "Renderers/monte_carlo_renderer.h"
+#include "Renderers/adaptive_renderer.h"
+#include "Renderers/multi_device_scheduler.h"
 #include "RenderFactory/clw_render_factory.h"
+#include "Utils/kernel_cache.h"
+#include "Utils/kernel_profiler.h"
+#include "Utils/cl_program_manager.h"
+#include "Utils/sobol.h"
+#include "Controllers/clw_scene_controller.h"
 #include "Output/output.h"
 #include "SceneGraph/camera.h"
 #include "SceneGraph/IO/scene_io.h"
+#include "math/mathutils.h"
 
 #include "OpenImageIO/imageio.h"
 
 #include <vector>
 #include <memory>
+#include <chrono>
+#include <future>
+#include <stdexcept>
 #include <algorithm>
+#include <numeric>
+#include <limits>
 #include <cstdlib>
 #include <sstream>
 #include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <thread>
+#include <map>
+#include <cmath>
 
 extern int g_argc;
 extern char** g_argv;
@@ -113,7 +132,9 @@ public:
 
         auto platform = platforms[platform_index];
         auto device = platform.GetDevice(device_index);
-        auto context = CLWContext::Create(device);
+        // Profiling queues let statistics tests check kernel times
+        auto context = Baikal::KernelProfiler::CreateContext(device, nullptr, true);
+        m_context = context;
 
         ASSERT_NO_THROW(m_factory = std::make_unique<Baikal::ClwRenderFactory>(context, "cache"));
         ASSERT_NO_THROW(m_renderer = m_factory->CreateRenderer(Baikal::ClwRenderFactory::RendererType::kUnidirectionalPathTracer));
@@ -212,6 +233,49 @@ public:
         delete out;
     }
 
+    // Read back accumulated radiance of the output
+    std::vector<RadeonRays::float3> GetOutputData(Baikal::Output* optional_output = nullptr) const
+    {
+        auto output = optional_output ? optional_output : m_output.get();
+
+        std::vector<RadeonRays::float3> data(output->width() * output->height());
+        output->GetData(&data[0]);
+
+        return data;
+    }
+
+    // Accumulate a number of passes of a compiled scene, the fixture renderer is used by default
+    void RenderIterations(Baikal::ClwScene const& scene,
+                          std::uint32_t num_iterations = kNumIterations,
+                          Baikal::Renderer* optional_renderer = nullptr) const
+    {
+        auto renderer = optional_renderer ? optional_renderer : m_renderer.get();
+
+        for (auto i = 0u; i < num_iterations; ++i)
+        {
+            ASSERT_NO_THROW(renderer->Render(scene));
+        }
+    }
+
+    // Radiance estimate of a pixel, accumulated radiance over its number of samples
+    static RadeonRays::float3 GetRadiance(RadeonRays::float3 const& value)
+    {
+        return value * (1.f / std::max(value.w, 1.f));
+    }
+
+    // Average radiance estimate over all pixels of an image
+    static RadeonRays::float3 GetAverageRadiance(std::vector<RadeonRays::float3> const& image)
+    {
+        RadeonRays::float3 average;
+
+        for (auto const& value : image)
+        {
+            average += GetRadiance(value);
+        }
+
+        return average * (1.f / image.size());
+    }
+
     void LoadImage(std::string const& file_name, std::vector<char>& data)
     {
         OIIO_NAMESPACE_USING
@@ -301,6 +365,7 @@ public:
         return std::find(begin, end, option) != end;
     }
 
+    CLWContext m_context;
     std::unique_ptr<Baikal::Renderer> m_renderer;
     std::unique_ptr<Baikal::SceneController<Baikal::ClwScene>> m_controller;
     std::unique_ptr<Baikal::RenderFactory<Baikal::ClwScene>> m_factory;
@@ -339,6 +404,494 @@ TEST_F(BasicTest, RenderTestScene)
     ASSERT_TRUE(CompareToReference(test_name() + ".png"));
 }
 
+TEST_F(BasicTest, RenderTestSceneTiled)
+{
+    // Limit work buffer to a quarter of the output to force tiling
+    auto renderer = static_cast<Baikal::MonteCarloRenderer*>(m_renderer.get());
+    ASSERT_NO_THROW(renderer->SetMaxRaysPerLaunch(kOutputWidth * kOutputHeight / 4));
+
+    ClearOutput();
+
+    ASSERT_NO_THROW(m_controller->CompileScene(m_scene));
+
+    auto& scene = m_controller->GetCachedScene(m_scene);
+
+    RenderIterations(scene);
+
+    SaveOutput(test_name() + ".png");
+    ASSERT_TRUE(CompareToReference(test_name() + ".png"));
+}
+
+TEST_F(BasicTest, RenderTestSceneShapeReattach)
+{
+    ClearOutput();
+
+    ASSERT_NO_THROW(m_controller->CompileScene(m_scene));
+
+    // Remove a shape and bring it back, intersector should be patched in place
+    auto shape = m_scene->CreateShapeIterator()->ItemAs<Baikal::Shape>();
+
+    ASSERT_NO_THROW(m_scene->DetachShape(shape));
+    ASSERT_NO_THROW(m_controller->CompileScene(m_scene));
+
+    ASSERT_NO_THROW(m_scene->AttachShape(shape));
+    ASSERT_NO_THROW(m_controller->CompileScene(m_scene));
+
+    auto& scene = m_controller->GetCachedScene(m_scene);
+
+    RenderIterations(scene);
+
+    SaveOutput(test_name() + ".png");
+    ASSERT_TRUE(CompareToReference(test_name() + ".png"));
+}
+
+TEST_F(BasicTest, RenderTestScenePathRegeneration)
+{
+    auto renderer = static_cast<Baikal::MonteCarloRenderer*>(m_renderer.get());
+
+    auto render = [&](std::vector<RadeonRays::float3>& image)
+    {
+        ASSERT_NO_THROW(m_controller->CompileScene(m_scene));
+        auto& scene = m_controller->GetCachedScene(m_scene);
+
+        ASSERT_NO_THROW(m_renderer->SetRandomSeed(0));
+        ClearOutput();
+
+        RenderIterations(scene);
+
+        image = GetOutputData();
+    };
+
+    auto get_average = [](std::vector<RadeonRays::float3> const& image)
+    {
+        auto average = GetAverageRadiance(image);
+        return average.x + average.y + average.z;
+    };
+
+    std::vector<RadeonRays::float3> reference, regenerated;
+    render(reference);
+
+    // Restart finished paths for a few passes to keep ray batches full
+    ASSERT_NO_THROW(renderer->SetPathRegenerationPasses(3));
+    render(regenerated);
+
+    // Restarted paths are extra samples of their pixels
+    double reference_samples = 0., regenerated_samples = 0.;
+    for (auto i = 0u; i < reference.size(); ++i)
+    {
+        reference_samples += reference[i].w;
+        regenerated_samples += regenerated[i].w;
+    }
+
+    ASSERT_EQ(reference_samples, static_cast<double>(kNumIterations) * reference.size());
+    ASSERT_GT(regenerated_samples, reference_samples);
+
+    // Each restarted path takes a new camera sample, so the estimate converges to the same image
+    auto reference_average = get_average(reference);
+    ASSERT_GT(reference_average, 0.);
+    ASSERT_NEAR(get_average(regenerated), reference_average, 0.02 * reference_average);
+}
+
+TEST_F(BasicTest, RenderTestSceneMaterialSorting)
+{
+    // Sorted shading has to match the unsorted reference
+    auto renderer = static_cast<Baikal::MonteCarloRenderer*>(m_renderer.get());
+    ASSERT_NO_THROW(renderer->SetMaterialSortingEnabled(true));
+
+    ClearOutput();
+
+    ASSERT_NO_THROW(m_controller->CompileScene(m_scene));
+
+    auto& scene = m_controller->GetCachedScene(m_scene);
+
+    RenderIterations(scene);
+
+    SaveOutput(test_name() + ".png");
+    ASSERT_TRUE(CompareToReference(test_name() + ".png"));
+}
+
+TEST_F(BasicTest, AsyncReadback)
+{
+    ClearOutput();
+
+    ASSERT_NO_THROW(m_controller->CompileScene(m_scene));
+
+    auto& scene = m_controller->GetCachedScene(m_scene);
+
+    ASSERT_NO_THROW(m_renderer->Render(scene));
+
+    auto num_elements = m_output->width() * m_output->height();
+    std::vector<std::vector<RadeonRays::float3>> async_data(3);
+    std::vector<RadeonRays::float3> data(num_elements);
+
+    // Keep more readbacks in flight than the staging ring has slots
+    std::vector<std::future<void>> readbacks;
+    for (auto& destination : async_data)
+    {
+        destination.resize(num_elements);
+        ASSERT_NO_THROW(readbacks.push_back(m_output->GetDataAsync(&destination[0])));
+    }
+
+    // Oldest readback slot has been reused, its data must still be delivered
+    for (auto& readback : readbacks)
+    {
+        ASSERT_NO_THROW(readback.get());
+    }
+
+    ASSERT_NO_THROW(m_output->GetData(&data[0]));
+
+    for (auto& destination : async_data)
+    {
+        for (auto i = 0u; i < num_elements; ++i)
+        {
+            ASSERT_EQ(data[i].x, destination[i].x);
+            ASSERT_EQ(data[i].y, destination[i].y);
+            ASSERT_EQ(data[i].z, destination[i].z);
+            ASSERT_EQ(data[i].w, destination[i].w);
+        }
+    }
+}
+
+TEST_F(BasicTest, RenderTestSceneAdaptive)
+{
+    std::uint32_t constexpr kMinSamples = 16;
+    std::uint32_t constexpr kMaxIterations = 4096;
+
+    std::unique_ptr<Baikal::Renderer> renderer;
+    ASSERT_NO_THROW(renderer = m_factory->CreateRenderer(Baikal::ClwRenderFactory::RendererType::kAdaptivePathTracer));
+
+    auto adaptive_renderer = static_cast<Baikal::AdaptiveRenderer*>(renderer.get());
+    adaptive_renderer->SetNoiseThreshold(0.05f);
+    adaptive_renderer->SetMinSamples(kMinSamples);
+
+    ASSERT_NO_THROW(renderer->SetOutput(Baikal::Renderer::OutputType::kColor, m_output.get()));
+    ASSERT_NO_THROW(renderer->SetRandomSeed(0));
+    ASSERT_NO_THROW(renderer->Clear(RadeonRays::float3(), *m_output));
+
+    ASSERT_NO_THROW(m_controller->CompileScene(m_scene));
+    auto& scene = m_controller->GetCachedScene(m_scene);
+
+    auto converged = false;
+    for (auto i = 0u; i < kMaxIterations && !converged; ++i)
+    {
+        ASSERT_NO_THROW(converged = renderer->Render(scene));
+    }
+
+    ASSERT_TRUE(converged);
+    ASSERT_EQ(adaptive_renderer->GetNumActivePixels(), 0u);
+
+    auto num_elements = m_output->width() * m_output->height();
+    std::vector<RadeonRays::float3> data(num_elements);
+    m_output->GetData(&data[0]);
+
+    // Every pixel gets the minimum number of samples, but noisy ones get more
+    auto min_samples = std::numeric_limits<float>::max();
+    auto max_samples = 0.f;
+    for (auto& value : data)
+    {
+        min_samples = std::min(min_samples, value.w);
+        max_samples = std::max(max_samples, value.w);
+    }
+
+    ASSERT_GE(min_samples, static_cast<float>(kMinSamples));
+    ASSERT_GT(max_samples, min_samples);
+
+    // Converged output is left untouched
+    ASSERT_TRUE(renderer->Render(scene));
+
+    std::vector<RadeonRays::float3> after(num_elements);
+    m_output->GetData(&after[0]);
+
+    for (auto i = 0u; i < num_elements; ++i)
+    {
+        ASSERT_EQ(data[i].w, after[i].w);
+    }
+}
+
+TEST_F(BasicTest, RenderStatistics)
+{
+    auto renderer = static_cast<Baikal::MonteCarloRenderer*>(m_renderer.get());
+
+    ASSERT_NO_THROW(m_controller->CompileScene(m_scene));
+    auto& scene = m_controller->GetCachedScene(m_scene);
+
+    // Counting is opt-in, only memory is reported by default
+    ClearOutput();
+    ASSERT_NO_THROW(renderer->Render(scene));
+
+    Baikal::RenderStatistics stats;
+    ASSERT_NO_THROW(stats = renderer->GetStatistics(scene));
+    ASSERT_GT(stats.geometry_memory, 0u);
+    ASSERT_TRUE(stats.rays_per_bounce.empty());
+    ASSERT_TRUE(stats.kernel_times.empty());
+
+    ASSERT_NO_THROW(renderer->SetStatisticsEnabled(true));
+    ClearOutput();
+
+    RenderIterations(scene, kNumIterations, renderer);
+
+    ASSERT_NO_THROW(stats = renderer->GetStatistics(scene));
+
+    ASSERT_GT(stats.geometry_memory, 0u);
+    ASSERT_GT(stats.texture_memory, 0u);
+    ASSERT_GT(stats.material_memory, 0u);
+    ASSERT_GT(stats.work_buffer_memory, 0u);
+    ASSERT_EQ(stats.output_memory, kOutputWidth * kOutputHeight * sizeof(RadeonRays::float3));
+    ASSERT_EQ(stats.num_samples, kNumIterations);
+
+    // Kernels are timed once statistics are on
+    ASSERT_NE(stats.kernel_times.find("ShadeSurface"), stats.kernel_times.cend());
+    ASSERT_GT(stats.kernel_times["ShadeSurface"].num_launches, 0u);
+
+    // Every pixel starts a path each iteration and compaction only removes paths
+    ASSERT_FALSE(stats.rays_per_bounce.empty());
+    ASSERT_EQ(stats.rays_per_bounce[0], std::uint64_t(kNumIterations) * kOutputWidth * kOutputHeight);
+
+    for (auto i = 0u; i < stats.rays_per_bounce.size(); ++i)
+    {
+        ASSERT_LE(stats.paths_per_bounce[i], stats.rays_per_bounce[i]);
+    }
+
+    ASSERT_NO_THROW(renderer->ResetStatistics());
+    ASSERT_NO_THROW(stats = renderer->GetStatistics(scene));
+    ASSERT_TRUE(stats.rays_per_bounce.empty());
+    ASSERT_TRUE(stats.kernel_times.empty());
+}
+
+TEST_F(BasicTest, KernelProfiler)
+{
+    ASSERT_NO_THROW(Baikal::KernelProfiler::Enable(m_output_path + "KernelProfiler.json"));
+
+    // Profiling needs its own command queue
+    CLWContext context;
+    ASSERT_NO_THROW(context = Baikal::KernelProfiler::CreateContext(m_context.GetDevice(0)));
+
+    auto factory = std::make_unique<Baikal::ClwRenderFactory>(context, "cache");
+    auto renderer = factory->CreateRenderer(Baikal::ClwRenderFactory::RendererType::kUnidirectionalPathTracer);
+    auto controller = factory->CreateSceneController();
+    auto output = factory->CreateOutput(kOutputWidth, kOutputHeight);
+    renderer->SetOutput(Baikal::Renderer::OutputType::kColor, output.get());
+    renderer->Clear(RadeonRays::float3(), *output);
+
+    ASSERT_NO_THROW(controller->CompileScene(m_scene));
+    auto& scene = controller->GetCachedScene(m_scene);
+
+    RenderIterations(scene, kNumIterations, renderer.get());
+
+    // Frames do not wait for their launches, Disable picks up the ones in flight
+    // and the profiler outlives it while it is held
+    auto profiler = Baikal::KernelProfiler::Get();
+    ASSERT_NE(profiler, nullptr);
+
+    ASSERT_NO_THROW(Baikal::KernelProfiler::Disable());
+    ASSERT_EQ(Baikal::KernelProfiler::Get(), nullptr);
+
+    std::ostringstream trace;
+    profiler->WriteTrace(trace);
+    ASSERT_NE(trace.str().find("\"name\":\"ShadeSurface\""), std::string::npos);
+    ASSERT_NE(trace.str().find("\"frame\":" + std::to_string(kNumIterations - 1)), std::string::npos);
+    ASSERT_EQ(profiler->GetNumDroppedRecords(), 0u);
+
+    std::ifstream trace_file(m_output_path + "KernelProfiler.json");
+    ASSERT_TRUE(trace_file.good());
+
+    std::ostringstream summary;
+    profiler->WriteSummary(summary);
+    ASSERT_NE(summary.str().find("GatherLightSamples"), std::string::npos);
+}
+
+TEST_F(BasicTest, ProgramWarmUp)
+{
+    // No disk cache, everything has to be compiled
+    auto factory = std::make_unique<Baikal::ClwRenderFactory>(m_context);
+    auto renderer = factory->CreateRenderer(Baikal::ClwRenderFactory::RendererType::kUnidirectionalPathTracer);
+    auto controller = factory->CreateSceneController();
+    auto output = factory->CreateOutput(kOutputWidth, kOutputHeight);
+    renderer->SetOutput(Baikal::Renderer::OutputType::kColor, output.get());
+
+    ASSERT_FALSE(factory->IsReady());
+    ASSERT_NO_THROW(factory->WarmUp());
+
+    // Lookups do not block while programs are compiled
+    auto start = std::chrono::high_resolution_clock::now();
+    while (!factory->IsReady())
+    {
+        ASSERT_LT(std::chrono::high_resolution_clock::now() - start, std::chrono::minutes(10));
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+
+    // Scene headers invalidate programs, they are recompiled in background
+    ASSERT_NO_THROW(controller->CompileScene(m_scene));
+    auto& scene = controller->GetCachedScene(m_scene);
+
+    renderer->Clear(RadeonRays::float3(), *output);
+    RenderIterations(scene, kNumIterations, renderer.get());
+
+    SaveOutput(test_name() + ".png", output.get());
+}
 
+TEST_F(BasicTest, KernelCache)
+{
+    std::uint64_t const kEntrySize = 1000;
+    Baikal::KernelCache cache(m_output_path + "KernelCache", 4 * kEntrySize);
+
+    std::string const source = "__kernel void Test(__global int* data) { data[get_global_id(0)] = 0; }";
+    auto key = Baikal::KernelCache::GetKey(m_context, "test", source, "");
+    ASSERT_EQ(key.size(), 32);
+    ASSERT_EQ(key, Baikal::KernelCache::GetKey(m_context, "test", source, ""));
+    ASSERT_NE(key, Baikal::KernelCache::GetKey(m_context, "test", source, "-D TEST "));
+    ASSERT_NE(key, Baikal::KernelCache::GetKey(m_context, "test", source + " ", ""));
+
+    std::vector<std::uint8_t> binary(kEntrySize, 42);
+    std::vector<std::uint8_t> loaded;
+    ASSERT_NO_THROW(cache.Save("test", key, binary));
+    ASSERT_TRUE(cache.Load("test", key, loaded));
+    ASSERT_EQ(loaded, binary);
+
+    // Corrupted payload is detected and the entry is dropped
+    {
+        std::ostringstream oss;
+        oss << cache.GetCachePath() << "/test_";
+        for (auto byte : key)
+        {
+            oss << std::hex << std::setw(2) << std::setfill('0') << static_cast<int>(byte);
+        }
+        oss << ".kbin";
 
+        std::fstream file(oss.str(), std::ios::in | std::ios::out | std::ios::binary);
+        ASSERT_TRUE(file.good());
+        file.seekp(-1, std::ios::end);
+        file.put(0);
+    }
+
+    ASSERT_FALSE(cache.Load("test", key, loaded));
+    ASSERT_FALSE(cache.Load("test", key, loaded));
 
+    // Cache does not grow beyond its limit
+    std::vector<Baikal::KernelCache::Key> keys;
+    for (auto i = 0; i < 8; ++i)
+    {
+        keys.push_back(Baikal::KernelCache::GetKey(m_context, "test", source, "-D TEST=" + std::to_string(i)));
+        cache.Save("test", keys.back(), binary);
+    }
+
+    auto num_cached = std::count_if(keys.begin(), keys.end(), [&](Baikal::KernelCache::Key const& k)
+    {
+        return cache.Load("test", k, loaded);
+    });
+
+    ASSERT_GT(num_cached, 0);
+    ASSERT_LT(num_cached, 4);
+}
+
+TEST_F(BasicTest, SamplerConvergence)
+{
+    int const kNumEstimates = 4096;
+    std::vector<int> const sample_counts = { 16, 64, 256 };
+    // Sobol matrices only cover 1024 dimensions
+    std::vector<int> const dimensions = { 1, 901 };
+
+    struct SamplerType
+    {
+        std::string name;
+        int define;
+    };
+
+    // Values of sampler defines in common.cl
+    std::vector<SamplerType> const samplers =
+    {
+        { "RANDOM", 1 },
+        { "SOBOL", 2 },
+        { "CMJ", 3 },
+        { "OWEN_SOBOL", 4 }
+    };
+
+    Baikal::CLProgramManager program_manager("");
+    auto program_id = program_manager.CreateProgram(m_context, "../Baikal/Kernels/CL/sampler_benchmark.cl");
+
+    std::vector<std::uint32_t> seeds(kNumEstimates);
+    std::uint32_t state = 1;
+    for (auto& seed : seeds)
+    {
+        state = state * 1664525u + 1013904223u;
+        seed = state;
+    }
+
+    auto random = m_context.CreateBuffer<std::uint32_t>(kNumEstimates, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, &seeds[0]);
+    auto sobol_mat = m_context.CreateBuffer<std::uint32_t>(1024 * 52, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, &g_SobolMatrices[0]);
+    auto estimates = m_context.CreateBuffer<RadeonRays::float2>(kNumEstimates, CL_MEM_WRITE_ONLY);
+
+    float const kQuarterDisk = RadeonRays::PI / 4.f;
+    float const kBump = 4.f / (RadeonRays::PI * RadeonRays::PI);
+
+    // RMSE of both test integrals for each sampler, dimension and sample count
+    std::map<std::string, std::vector<RadeonRays::float2>> errors;
+
+    for (auto& sampler : samplers)
+    {
+        auto opts = " -D SAMPLER=" + std::to_string(sampler.define) + " -cl-mad-enable -cl-fast-relaxed-math -cl-std=CL1.2 -I . ";
+
+        CLWKernel kernel;
+        ASSERT_NO_THROW(kernel = program_manager.GetProgram(program_id, opts).GetKernel("EstimateIntegrals"));
+
+        for (auto dimension : dimensions)
+        {
+            for (auto num_samples : sample_counts)
+            {
+                int argc = 0;
+                kernel.SetArg(argc++, kNumEstimates);
+                kernel.SetArg(argc++, num_samples);
+                kernel.SetArg(argc++, dimension);
+                kernel.SetArg(argc++, random);
+                kernel.SetArg(argc++, sobol_mat);
+                kernel.SetArg(argc++, estimates);
+
+                m_context.Launch1D(0, ((kNumEstimates + 63) / 64) * 64, 64, kernel);
+
+                std::vector<RadeonRays::float2> data(kNumEstimates);
+                m_context.ReadBuffer(0, estimates, &data[0], kNumEstimates).Wait();
+
+                double disk_error = 0.;
+                double bump_error = 0.;
+                for (auto& estimate : data)
+                {
+                    disk_error += (estimate.x - kQuarterDisk) * (estimate.x - kQuarterDisk);
+                    bump_error += (estimate.y - kBump) * (estimate.y - kBump);
+                }
+
+                RadeonRays::float2 rmse(
+                    static_cast<float>(std::sqrt(disk_error / kNumEstimates)),
+                    static_cast<float>(std::sqrt(bump_error / kNumEstimates)));
+
+                errors[sampler.name].push_back(rmse);
+            }
+        }
+    }
+
+    // Errors are stored by dimension, then by sample count
+    auto get_error = [&](std::string const& sampler, std::size_t dimension, std::size_t count)
+    {
+        return errors[sampler][dimension * sample_counts.size() + count];
+    };
+
+    auto const num_counts = sample_counts.size();
+    for (std::size_t d = 0; d < dimensions.size(); ++d)
+    {
+        for (std::size_t c = 0; c < num_counts; ++c)
+        {
+            // Scrambled Sobol has to beat random sampling at every dimension and sample count
+            ASSERT_LT(get_error("OWEN_SOBOL", d, c).x, get_error("RANDOM", d, c).x);
+            ASSERT_LT(get_error("OWEN_SOBOL", d, c).y, get_error("RANDOM", d, c).y);
+
+            // Quality does not degrade at high dimensions
+            ASSERT_LT(get_error("OWEN_SOBOL", d, c).x, 2.f * get_error("OWEN_SOBOL", 0, c).x);
+            ASSERT_LT(get_error("OWEN_SOBOL", d, c).y, 2.f * get_error("OWEN_SOBOL", 0, c).y);
+        }
+
+        // Random sampling error drops 4 times over 16 times more samples, scrambled Sobol converges faster
+        auto first = get_error("OWEN_SOBOL", d, 0);
+        auto last = get_error("OWEN_SOBOL", d, num_counts - 1);
+        ASSERT_LT(last.x, 0.25f * first.x);
+        ASSERT_LT(last.y, 0.25f * first.y);
+    }
+}
@@ -0,0 +1,207 @@
+/**********************************************************************
+Copyright (c) 2016 Advanced Micro Devices, Inc. All rights reserved.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+********************************************************************/
+#pragma once
+
+#include "basic.h"
+#include "RenderFactory/cpu_render_factory.h"
+#include "SceneGraph/material.h"
+#include "SceneGraph/shape.h"
+#include "SceneGraph/uberv2material.h"
+
+#include <stdexcept>
+
+class CpuEstimatorTest : public BasicTest
+{
+public:
+    void SetUp() override
+    {
+        BasicTest::SetUp();
+
+        ASSERT_NO_THROW(m_cpu_factory = std::make_unique<Baikal::CpuRenderFactory>(m_context, "cache"));
+        ASSERT_NO_THROW(m_cpu_renderer = m_cpu_factory->CreateRenderer(
+            Baikal::ClwRenderFactory::RendererType::kUnidirectionalPathTracer));
+        ASSERT_NO_THROW(m_cpu_controller = m_cpu_factory->CreateSceneController());
+        ASSERT_NO_THROW(m_cpu_output = m_cpu_factory->CreateOutput(kOutputWidth, kOutputHeight));
+        m_cpu_renderer->SetOutput(Baikal::Renderer::OutputType::kColor, m_cpu_output.get());
+    }
+
+    void TearDown() override
+    {
+        m_cpu_output.reset();
+        m_cpu_controller.reset();
+        m_cpu_renderer.reset();
+        m_cpu_factory.reset();
+
+        BasicTest::TearDown();
+    }
+
+    // Render the test scene from a fixed seed with the kernels
+    std::vector<RadeonRays::float3> RenderKernels()
+    {
+        m_controller->CompileScene(m_scene);
+        auto& scene = m_controller->GetCachedScene(m_scene);
+
+        m_renderer->SetRandomSeed(0);
+        ClearOutput();
+
+        RenderIterations(scene);
+
+        return GetOutputData();
+    }
+
+    // Render the test scene from a fixed seed on the host
+    std::vector<RadeonRays::float3> RenderHost()
+    {
+        m_cpu_controller->CompileScene(m_scene);
+        auto& scene = m_cpu_controller->GetCachedScene(m_scene);
+
+        m_cpu_renderer->SetRandomSeed(0);
+        m_cpu_renderer->Clear(RadeonRays::float3(), *m_cpu_output);
+
+        for (auto i = 0u; i < kNumIterations; ++i)
+        {
+            m_cpu_renderer->Render(scene);
+        }
+
+        std::vector<RadeonRays::float3> data(kOutputWidth * kOutputHeight);
+        m_cpu_output->GetData(&data[0]);
+        return data;
+    }
+
+    // Both estimators converge to the same value, the average over all pixels
+    // keeps the noise of the different sampling strategies well below the tolerance
+    void ExpectSameAverage(std::vector<RadeonRays::float3> const& image,
+                           std::vector<RadeonRays::float3> const& reference)
+    {
+        auto average = GetAverageRadiance(image);
+        auto expected = GetAverageRadiance(reference);
+
+        for (auto i = 0; i < 3; ++i)
+        {
+            EXPECT_NEAR(average[i], expected[i], kTolerance * expected[i] + 1e-4f);
+        }
+    }
+
+    void SetSphereMaterial(Baikal::Material::Ptr material)
+    {
+        auto mesh = m_scene->CreateShapeIterator()->ItemAs<Baikal::Mesh>();
+        mesh->SetMaterial(material);
+    }
+
+    static float constexpr kTolerance = 0.03f;
+
+    std::unique_ptr<Baikal::RenderFactory<Baikal::ClwScene>> m_cpu_factory;
+    std::unique_ptr<Baikal::Renderer> m_cpu_renderer;
+    std::unique_ptr<Baikal::SceneController<Baikal::ClwScene>> m_cpu_controller;
+    std::unique_ptr<Baikal::Output> m_cpu_output;
+};
+
+TEST_F(CpuEstimatorTest, CpuEstimator_MatchesKernels)
+{
+    std::vector<RadeonRays::float3> reference;
+    std::vector<RadeonRays::float3> image;
+
+    ASSERT_NO_THROW(reference = RenderKernels());
+    ASSERT_NO_THROW(image = RenderHost());
+
+    ExpectSameAverage(image, reference);
+}
+
+TEST_F(CpuEstimatorTest, CpuEstimator_Bxdfs)
+{
+    using BxdfType = Baikal::SingleBxdf::BxdfType;
+
+    BxdfType const types[] =
+    {
+        BxdfType::kIdealReflect,
+        BxdfType::kIdealRefract,
+        BxdfType::kMicrofacetBeckmann,
+        BxdfType::kMicrofacetGGX,
+        BxdfType::kTranslucent,
+        BxdfType::kMicrofacetRefractionGGX,
+        BxdfType::kMicrofacetRefractionBeckmann
+    };
+
+    for (auto type : types)
+    {
+        SCOPED_TRACE(static_cast<int>(type));
+
+        auto material = Baikal::SingleBxdf::Create(type);
+        material->SetInputValue("albedo", RadeonRays::float4(0.8f, 0.6f, 0.4f, 1.f));
+        material->SetInputValue("roughness", RadeonRays::float4(0.3f, 0.3f, 0.3f, 0.3f));
+        material->SetInputValue("ior", RadeonRays::float4(1.5f, 1.5f, 1.5f, 1.5f));
+        SetSphereMaterial(material);
+
+        std::vector<RadeonRays::float3> reference;
+        std::vector<RadeonRays::float3> image;
+
+        ASSERT_NO_THROW(reference = RenderKernels());
+        ASSERT_NO_THROW(image = RenderHost());
+
+        ExpectSameAverage(image, reference);
+    }
+}
+
+TEST_F(CpuEstimatorTest, CpuEstimator_Deterministic)
+{
+    std::vector<RadeonRays::float3> first;
+    std::vector<RadeonRays::float3> second;
+
+    ASSERT_NO_THROW(first = RenderHost());
+    ASSERT_NO_THROW(second = RenderHost());
+
+    for (auto i = 0u; i < first.size(); ++i)
+    {
+        ASSERT_EQ(first[i].x, second[i].x);
+        ASSERT_EQ(first[i].y, second[i].y);
+        ASSERT_EQ(first[i].z, second[i].z);
+        ASSERT_EQ(first[i].w, second[i].w);
+    }
+}
+
+TEST_F(CpuEstimatorTest, CpuEstimator_UnsupportedMaterials)
+{
+    Baikal::Material::Ptr const materials[] =
+    {
+        Baikal::DisneyBxdf::Create(),
+        Baikal::UberV2Material::Create()
+    };
+
+    for (auto const& material : materials)
+    {
+        // Also when the material is only reachable through a blend
+        auto mix = Baikal::MultiBxdf::Create(Baikal::MultiBxdf::Type::kMix);
+        mix->SetInputValue("base_material", Baikal::SingleBxdf::Create(Baikal::SingleBxdf::BxdfType::kLambert));
+        mix->SetInputValue("top_material", material);
+        mix->SetInputValue("weight", RadeonRays::float4(0.5f, 0.5f, 0.5f, 0.5f));
+
+        SetSphereMaterial(material);
+        ASSERT_THROW(RenderHost(), std::runtime_error);
+
+        SetSphereMaterial(mix);
+        ASSERT_THROW(RenderHost(), std::runtime_error);
+    }
+
+    // Supported materials render again afterwards
+    SetSphereMaterial(Baikal::SingleBxdf::Create(Baikal::SingleBxdf::BxdfType::kLambert));
+    ASSERT_NO_THROW(RenderHost());
+}
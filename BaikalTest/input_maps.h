@@ -28,6 +28,7 @@
 #include "SceneGraph/IO/image_io.h"
 #include "SceneGraph/uberv2material.h"
 #include "SceneGraph/inputmaps.h"
+#include "Utils/cl_inputmap_compiler.h"
 
 
 #define _USE_MATH_DEFINES
@@ -629,3 +630,179 @@ TEST_F(InputMapsTest, InputMap_Normal)
 
     RunAndSave(material, "quad");
 }
+
+TEST_F(InputMapsTest, InputMap_Interpreted)
+{
+    auto image_io(Baikal::ImageIo::CreateImageIo());
+    auto texture1 = image_io->LoadImage("../Resources/Textures/test_albedo1.jpg");
+    auto texture2 = image_io->LoadImage("../Resources/Textures/test_albedo3.jpg");
+
+    auto material = Baikal::UberV2Material::Create();
+    auto color1 = Baikal::InputMap_Sampler::Create(texture1);
+    auto color2 = Baikal::InputMap_ConstantFloat3::Create(float3(1.0f, 0.0f, 0.0f));
+    auto control = Baikal::InputMap_Sampler::Create(texture2);
+    auto diffuse_color = Baikal::InputMap_Lerp::Create(
+        Baikal::InputMap_Mul::Create(color1, Baikal::InputMap_ConstantFloat::Create(0.5f)),
+        Baikal::InputMap_Select::Create(color2, Baikal::InputMap_Select::Selection::kX),
+        control);
+
+    material->SetInputValue("uberv2.diffuse.color", diffuse_color);
+    material->SetLayers(Baikal::UberV2Material::Layers::kDiffuseLayer);
+
+    // Average radiance of the output
+    auto get_average = [this]()
+    {
+        return GetAverageRadiance(GetOutputData());
+    };
+
+    auto render = [this, &material]()
+    {
+        ClearOutput();
+
+        ApplyMaterialToObject("quad", material);
+
+        ASSERT_NO_THROW(m_controller->CompileScene(m_scene));
+
+        auto& scene = m_controller->GetCachedScene(m_scene);
+
+        RenderIterations(scene);
+    };
+
+    // Reference using generated input map source
+    render();
+    auto generated_average = get_average();
+
+    m_scene->SetInputMapMode(Baikal::Scene1::InputMapMode::kInterpreted);
+    render();
+    auto interpreted_average = get_average();
+
+    for (auto i = 0; i < 3; ++i)
+    {
+        ASSERT_NEAR(interpreted_average[i], generated_average[i], 0.01f * generated_average[i] + 1e-4f);
+    }
+
+    auto const& program_manager = static_cast<Baikal::ClwRenderFactory&>(*m_factory).GetProgramManager();
+    auto num_invalidations = program_manager.GetNumInvalidations();
+
+    // Value changes only touch input map data in interpreted mode
+    color2->SetValue(float3(0.0f, 1.0f, 0.0f));
+    render();
+    auto value_average = get_average();
+
+    ASSERT_EQ(program_manager.GetNumInvalidations(), num_invalidations);
+    ASSERT_LT(value_average.x, interpreted_average.x);
+    ASSERT_GT(value_average.y, interpreted_average.y);
+
+    // So do structure changes
+    material->SetInputValue("uberv2.diffuse.color", Baikal::InputMap_Mul::Create(
+        color1, Baikal::InputMap_Select::Create(color2, Baikal::InputMap_Select::Selection::kY)));
+    render();
+    auto structure_average = get_average();
+
+    ASSERT_EQ(program_manager.GetNumInvalidations(), num_invalidations);
+    ASSERT_NE(structure_average.x, value_average.x);
+}
+
+TEST_F(InputMapsTest, InputMap_InterpretedDeep)
+{
+    auto image_io(Baikal::ImageIo::CreateImageIo());
+    auto texture = image_io->LoadImage("../Resources/Textures/test_albedo1.jpg");
+
+    // Nested lerps, each level keeps the previous one in the first argument
+    Baikal::InputMap::Ptr diffuse_color = Baikal::InputMap_Sampler::Create(texture);
+    for (auto i = 0; i < 24; ++i)
+    {
+        diffuse_color = Baikal::InputMap_Lerp::Create(
+            diffuse_color,
+            Baikal::InputMap_ConstantFloat3::Create(float3(0.1f * (i % 10), 0.5f, 0.2f)),
+            Baikal::InputMap_ConstantFloat::Create(0.1f));
+    }
+
+    auto material = Baikal::UberV2Material::Create();
+    material->SetInputValue("uberv2.diffuse.color", diffuse_color);
+    material->SetLayers(Baikal::UberV2Material::Layers::kDiffuseLayer);
+    ApplyMaterialToObject("quad", material);
+
+    auto render = [this]()
+    {
+        ClearOutput();
+
+        ASSERT_NO_THROW(m_controller->CompileScene(m_scene));
+
+        auto& scene = m_controller->GetCachedScene(m_scene);
+
+        RenderIterations(scene);
+    };
+
+    // Average radiance of the output
+    auto get_average = [this]()
+    {
+        return GetAverageRadiance(GetOutputData());
+    };
+
+    render();
+    auto generated_average = get_average();
+
+    // Chain depth does not increase register pressure
+    m_scene->SetInputMapMode(Baikal::Scene1::InputMapMode::kInterpreted);
+    render();
+    auto interpreted_average = get_average();
+
+    ASSERT_EQ(m_controller->GetCachedScene(m_scene).input_map_header, Baikal::CLInputMapCompiler::GetInterpreterSource());
+
+    for (auto i = 0; i < 3; ++i)
+    {
+        ASSERT_NEAR(interpreted_average[i], generated_average[i], 0.01f * generated_average[i] + 1e-4f);
+    }
+
+    // Every level needs two more registers, so the graph falls back to generated source
+    Baikal::InputMap::Ptr wide_color = Baikal::InputMap_ConstantFloat3::Create(float3(0.5f, 0.5f, 0.5f));
+    for (auto i = 0u; i < Baikal::CLInputMapCompiler::kMaxRegisters / 2; ++i)
+    {
+        wide_color = Baikal::InputMap_Lerp::Create(wide_color, wide_color, wide_color);
+    }
+
+    material->SetInputValue("uberv2.diffuse.color", wide_color);
+    ASSERT_NO_THROW(m_controller->CompileScene(m_scene));
+    ASSERT_NE(m_controller->GetCachedScene(m_scene).input_map_header, Baikal::CLInputMapCompiler::GetInterpreterSource());
+}
+
+TEST_F(InputMapsTest, InputMap_SharedStructure)
+{
+    auto image_io(Baikal::ImageIo::CreateImageIo());
+    auto texture1 = image_io->LoadImage("../Resources/Textures/test_albedo1.jpg");
+    auto texture2 = image_io->LoadImage("../Resources/Textures/test_albedo3.jpg");
+
+    auto create_material = [](Baikal::Texture::Ptr texture, float scale)
+    {
+        auto material = Baikal::UberV2Material::Create();
+        auto diffuse_color = Baikal::InputMap_Mul::Create(
+            Baikal::InputMap_Sampler::Create(texture),
+            Baikal::InputMap_ConstantFloat::Create(scale));
+        material->SetInputValue("uberv2.diffuse.color", diffuse_color);
+        material->SetLayers(Baikal::UberV2Material::Layers::kDiffuseLayer);
+        return material;
+    };
+
+    ApplyMaterialToObject("quad", create_material(texture1, 0.5f));
+    ASSERT_NO_THROW(m_controller->CompileScene(m_scene));
+    auto source = m_controller->GetCachedScene(m_scene).input_map_header;
+
+    // Same graph built from new objects has different ids and leaf values
+    ApplyMaterialToObject("quad", create_material(texture2, 0.25f));
+    ASSERT_NO_THROW(m_controller->CompileScene(m_scene));
+    ASSERT_EQ(source, m_controller->GetCachedScene(m_scene).input_map_header);
+
+    ClearOutput();
+
+    auto& scene = m_controller->GetCachedScene(m_scene);
+
+    RenderIterations(scene);
+
+    {
+        std::ostringstream oss;
+        oss << test_name() << ".png";
+        SaveOutput(oss.str());
+        ASSERT_TRUE(CompareToReference(oss.str()));
+    }
+}
@@ -22,6 +22,10 @@ THE SOFTWARE.
 #include "gtest/gtest.h"
 
 #include "Utils/distribution1d.h"
+#include "SceneGraph/scene1.h"
+#include "SceneGraph/light.h"
+#include "Controllers/clw_texture_format.h"
+#include "Controllers/clw_vertex_format.h"
 #include "math/mathutils.h"
 
 class InternalTest : public ::testing::Test
@@ -47,3 +51,105 @@ TEST_F(InternalTest, Distribuiton1D)
 
     cnts[0] += cnts[1];
 }
+
+TEST_F(InternalTest, Scene_DirtyFlags)
+{
+    auto scene = Baikal::Scene1::Create();
+    scene->ClearDirtyFlags();
+
+    scene->AttachLight(Baikal::PointLight::Create());
+    ASSERT_EQ(scene->GetDirtyFlags(), Baikal::Scene1::kLights);
+
+    // Flags are accumulated until cleared and never alias each other
+    scene->SetDirtyFlag(Baikal::Scene1::kBackground);
+    ASSERT_TRUE((scene->GetDirtyFlags() & Baikal::Scene1::kLights) != 0);
+    ASSERT_TRUE((scene->GetDirtyFlags() & Baikal::Scene1::kBackground) != 0);
+    ASSERT_TRUE((scene->GetDirtyFlags() & Baikal::Scene1::kShapes) == 0);
+    ASSERT_TRUE((scene->GetDirtyFlags() & Baikal::Scene1::kCamera) == 0);
+
+    scene->ClearDirtyFlags();
+    ASSERT_EQ(scene->GetDirtyFlags(), Baikal::Scene1::kNone);
+}
+
+TEST_F(InternalTest, TextureFormat_HalfRange)
+{
+    std::vector<char> data(Baikal::GetTexelSize(Baikal::ClwScene::TextureFormat::RGBA16));
+
+    // Values beyond half range are clamped instead of becoming infinite
+    Baikal::StoreTexel(data.data(), Baikal::ClwScene::TextureFormat::RGBA16, 0, RadeonRays::float4(1e6f, -1e6f, 65504.f, 0.5f));
+    auto texel = Baikal::LoadTexel(data.data(), Baikal::ClwScene::TextureFormat::RGBA16, 0);
+
+    ASSERT_EQ(texel.x, 65504.f);
+    ASSERT_EQ(texel.y, -65504.f);
+    ASSERT_EQ(texel.z, 65504.f);
+    ASSERT_EQ(texel.w, 0.5f);
+}
+
+TEST_F(InternalTest, TextureFormat_MipChain)
+{
+    auto format = Baikal::ClwScene::TextureFormat::RGBA32;
+    RadeonRays::int3 size(4, 2, 1);
+
+    // 4x2, 2x1 and 1x1 levels
+    ASSERT_EQ(Baikal::GetNumMipLevels(size), 3);
+    ASSERT_EQ(Baikal::GetMipChainSize(size, format), (8u + 2u + 1u) * Baikal::GetTexelSize(format));
+    ASSERT_EQ(Baikal::GetNumMipLevels(RadeonRays::int3(4, 4, 4)), 1);
+
+    std::vector<char> data(Baikal::GetMipChainSize(size, format));
+
+    float const values[] = { 1.f, 3.f, 10.f, 20.f, 5.f, 7.f, 30.f, 40.f };
+    for (auto i = 0u; i < 8u; ++i)
+    {
+        Baikal::StoreTexel(data.data(), format, i, RadeonRays::float4(values[i], 2.f * values[i], 0.f, 1.f));
+    }
+
+    Baikal::WriteMipChain(data.data(), format, size);
+
+    // Every level is a box filtered previous one, the last one is the average of level 0
+    auto level1_0 = Baikal::LoadTexel(data.data(), format, 8);
+    auto level1_1 = Baikal::LoadTexel(data.data(), format, 9);
+    auto level2 = Baikal::LoadTexel(data.data(), format, 10);
+
+    ASSERT_FLOAT_EQ(level1_0.x, 4.f);
+    ASSERT_FLOAT_EQ(level1_1.x, 25.f);
+    ASSERT_FLOAT_EQ(level2.x, 14.5f);
+    ASSERT_FLOAT_EQ(level2.y, 29.f);
+    ASSERT_FLOAT_EQ(level2.w, 1.f);
+}
+
+TEST_F(InternalTest, VertexFormat_HalfUVs)
+{
+    std::vector<RadeonRays::float2> uvs = { { 0.f, 0.f }, { 0.3333f, 0.6667f }, { 1.f, 1.f }, { -1.9f, 1.99f } };
+
+    ASSERT_TRUE(Baikal::CanStoreHalfUVs(uvs.data(), uvs.size()));
+
+    // Rounding of in range UVs stays within half a texel of a 1024 texel wide texture
+    std::vector<char> data(uvs.size() * Baikal::GetUVSize(Baikal::ClwScene::VERTEX_FORMAT_COMPACT));
+    Baikal::WriteUVs(uvs.data(), uvs.size(), Baikal::ClwScene::VERTEX_FORMAT_COMPACT, data.data());
+
+    for (auto i = 0u; i < uvs.size(); ++i)
+    {
+        auto uv = Baikal::ReadUV(data.data(), i, Baikal::ClwScene::VERTEX_FORMAT_COMPACT);
+        ASSERT_NEAR(uv.x, uvs[i].x, 0.5f / 1024.f);
+        ASSERT_NEAR(uv.y, uvs[i].y, 0.5f / 1024.f);
+    }
+
+    // Tiled UVs have to be kept as float
+    uvs.push_back(RadeonRays::float2(1000.25f, 0.5f));
+    ASSERT_FALSE(Baikal::CanStoreHalfUVs(uvs.data(), uvs.size()));
+
+    auto format = Baikal::ClwScene::VERTEX_FORMAT_COMPACT_FLOAT_UV;
+    data.resize(uvs.size() * Baikal::GetUVSize(format));
+    Baikal::WriteUVs(uvs.data(), uvs.size(), format, data.data());
+
+    for (auto i = 0u; i < uvs.size(); ++i)
+    {
+        auto uv = Baikal::ReadUV(data.data(), i, format);
+        ASSERT_EQ(uv.x, uvs[i].x);
+        ASSERT_EQ(uv.y, uvs[i].y);
+    }
+
+    // Positions and normals stay compact
+    ASSERT_EQ(Baikal::GetPositionSize(format), 3 * sizeof(float));
+    ASSERT_EQ(Baikal::GetNormalSize(format), sizeof(std::uint32_t));
+}
@@ -29,6 +29,7 @@ THE SOFTWARE.
 
 #define _USE_MATH_DEFINES
 #include <math.h>
+#include <cstring>
 
 using namespace RadeonRays;
 
@@ -40,6 +41,54 @@ public:
         auto io = Baikal::SceneIo::CreateSceneIoTest();
         m_scene = io->LoadScene("sphere+plane", "");
     }
+
+    // Render the scene from scratch, image gets radiance averaged over samples
+    void RenderImage(std::uint32_t seed, std::uint32_t num_iterations, std::vector<float3>& image)
+    {
+        ASSERT_NO_THROW(m_controller->CompileScene(m_scene));
+        auto& scene = m_controller->GetCachedScene(m_scene);
+
+        ASSERT_NO_THROW(m_renderer->SetRandomSeed(seed));
+        ClearOutput();
+
+        RenderIterations(scene, num_iterations);
+
+        image = GetOutputData();
+
+        for (auto& value : image)
+        {
+            value = GetRadiance(value);
+        }
+    }
+
+    static double GetLuminance(float3 const& value)
+    {
+        return 0.2126 * value.x + 0.7152 * value.y + 0.0722 * value.z;
+    }
+
+    // Noise is estimated from the difference of two independent images
+    static double GetNoise(std::vector<float3> const& first, std::vector<float3> const& second)
+    {
+        double sum = 0.;
+        for (auto i = 0u; i < first.size(); ++i)
+        {
+            auto luminance = GetLuminance(first[i] - second[i]);
+            sum += luminance * luminance;
+        }
+
+        return std::sqrt(sum / (2. * first.size()));
+    }
+
+    static double GetAverageLuminance(std::vector<float3> const& image)
+    {
+        double sum = 0.;
+        for (auto const& value : image)
+        {
+            sum += GetLuminance(value);
+        }
+
+        return sum / image.size();
+    }
 };
 
 TEST_F(LightTest, Light_PointLight)
@@ -664,6 +713,56 @@ TEST_F(LightTest, Light_ImageBasedLight)
     }
 }
 
+TEST_F(LightTest, Light_ImageBasedLightConvergence)
+{
+    static std::uint32_t constexpr kNumSamples = 4 * kNumIterations;
+
+    m_camera->LookAt(
+        RadeonRays::float3(0.f, 2.f, -10.f),
+        RadeonRays::float3(0.f, 2.f, 0.f),
+        RadeonRays::float3(0.f, 1.f, 0.f));
+
+    LoadTestScene();
+
+    auto material = Baikal::SingleBxdf::Create(Baikal::SingleBxdf::BxdfType::kMicrofacetGGX);
+    material->SetInputValue("roughness", RadeonRays::float3(0.3f, 0.3f, 0.3f));
+    ApplyMaterialToObject("sphere", material);
+
+    m_scene->SetCamera(m_camera);
+
+    auto image_io(Baikal::ImageIo::CreateImageIo());
+    auto light_texture = image_io->LoadImage("../Resources/Textures/studio015.hdr");
+    auto light = Baikal::ImageBasedLight::Create();
+
+    light->SetTexture(light_texture);
+    light->SetMultiplier(1.f);
+    m_scene->AttachLight(light);
+
+    // Light samples follow the luminance distribution of the map
+    std::vector<float3> first, second;
+    RenderImage(0, kNumSamples, first);
+    RenderImage(1, kNumSamples, second);
+    auto importance_noise = GetNoise(first, second);
+    auto importance_average = 0.5 * (GetAverageLuminance(first) + GetAverageLuminance(second));
+
+    // Reflection override with the same texels is a different texture,
+    // so the distribution is dropped and light samples become uniform
+    auto size_in_bytes = light_texture->GetSizeInBytes();
+    auto data = new char[size_in_bytes];
+    std::memcpy(data, light_texture->GetData(), size_in_bytes);
+    light->SetReflectionTexture(Baikal::Texture::Create(data, light_texture->GetSize(), light_texture->GetFormat()));
+
+    RenderImage(0, kNumSamples, first);
+    RenderImage(1, kNumSamples, second);
+    auto uniform_noise = GetNoise(first, second);
+    auto uniform_average = 0.5 * (GetAverageLuminance(first) + GetAverageLuminance(second));
+
+    // Both estimators converge to the same radiance, importance sampling with less noise
+    ASSERT_GT(uniform_average, 0.);
+    ASSERT_NEAR(importance_average, uniform_average, 0.02 * uniform_average);
+    ASSERT_LT(importance_noise, uniform_noise);
+}
+
 TEST_F(LightTest, Light_ImageBasedLightAndLightChanging)
 {
     m_camera->LookAt(
@@ -1024,4 +1123,41 @@ TEST_F(LightTest, Light_IblTransparencyOverride)
         SaveOutput(oss.str());
         ASSERT_TRUE(CompareToReference(oss.str()));
     }
-}
\ No newline at end of file
+}
+TEST_F(LightTest, Light_ManyLightsBvh)
+{
+    using LightSamplingMode = Baikal::Scene1::LightSamplingMode;
+
+    std::uint32_t const kNumSamples = 64;
+
+    auto io = Baikal::SceneIo::CreateSceneIoTest();
+    ASSERT_NO_THROW(m_scene = io->LoadScene("sphere+plane+10k_lights", ""));
+    ASSERT_NO_THROW(SetupCamera());
+    ASSERT_EQ(m_scene->GetNumLights(), 10000u);
+    ASSERT_EQ(m_scene->GetLightSamplingMode(), LightSamplingMode::kPower);
+
+    m_camera->LookAt(
+        RadeonRays::float3(0.f, 6.f, -14.f),
+        RadeonRays::float3(0.f, 1.f, 0.f),
+        RadeonRays::float3(0.f, 1.f, 0.f));
+
+    std::vector<float3> first, second;
+
+    RenderImage(0, kNumSamples, first);
+    RenderImage(1, kNumSamples, second);
+    auto power_noise = GetNoise(first, second);
+    auto power_average = 0.5 * (GetAverageLuminance(first) + GetAverageLuminance(second));
+
+    m_scene->SetLightSamplingMode(LightSamplingMode::kBvh);
+
+    RenderImage(0, kNumSamples, first);
+    RenderImage(1, kNumSamples, second);
+    auto bvh_noise = GetNoise(first, second);
+    auto bvh_average = 0.5 * (GetAverageLuminance(first) + GetAverageLuminance(second));
+
+    // Both selections are unbiased, spatially aware one is less noisy at equal sample count
+    ASSERT_GT(power_average, 0.);
+    ASSERT_NEAR(bvh_average, power_average, 0.02 * power_average);
+    ASSERT_GT(power_noise, 0.);
+    ASSERT_LT(bvh_noise, 0.5 * power_noise);
+}
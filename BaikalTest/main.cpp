@@ -30,6 +30,11 @@ THE SOFTWARE.
 #include "material.h"
 #include "aov.h"
 #include "test_scenes.h"
+#include "scene_cache.h"
+#include "scene_update.h"
+#include "multi_device.h"
+#include "cpu_estimator.h"
+#include "vertex_format.h"
 
 #ifdef ENABLE_UBERV2
 #include "uberv2.h"
@@ -29,6 +29,8 @@ THE SOFTWARE.
 
 #define _USE_MATH_DEFINES
 #include <math.h>
+#include <chrono>
+#include <thread>
 
 using namespace RadeonRays;
 
@@ -1436,3 +1438,237 @@ TEST_F(MaterialTest, Material_PhaseFunction)
     }
 }
 
+
+TEST_F(MaterialTest, Material_DiffuseInPlaceUpdate)
+{
+    m_camera->LookAt(
+        RadeonRays::float3(0.f, 2.f, -10.f),
+        RadeonRays::float3(0.f, 2.f, 0.f),
+        RadeonRays::float3(0.f, 1.f, 0.f));
+
+    std::vector<RadeonRays::float3> colors =
+    {
+        RadeonRays::float3(0.9f, 0.2f, 0.1f),
+        RadeonRays::float3(0.1f, 0.9f, 0.1f),
+        RadeonRays::float3(0.3f, 0.2f, 0.8f)
+    };
+
+    // Material set stays the same, so only the modified material is patched
+    auto material = Baikal::SingleBxdf::Create(Baikal::SingleBxdf::BxdfType::kLambert);
+    ApplyMaterialToObject("sphere", material);
+
+    for (auto& c : colors)
+    {
+        ClearOutput();
+
+        material->SetInputValue("albedo", RadeonRays::float4(c));
+
+        ASSERT_NO_THROW(m_controller->CompileScene(m_scene));
+
+        auto& scene = m_controller->GetCachedScene(m_scene);
+
+        RenderIterations(scene);
+
+        {
+            std::ostringstream oss;
+            oss << test_name() << "_" << c.x << "_" << c.y << "_" << c.z << ".png";
+            SaveOutput(oss.str());
+            ASSERT_TRUE(CompareToReference(oss.str()));
+        }
+    }
+}
+
+TEST_F(MaterialTest, Material_TextureMinification)
+{
+    // Quad lit by a directional light only, so radiance follows the albedo of the first hit
+    auto io = Baikal::SceneIo::CreateSceneIoTest();
+    m_scene = io->LoadScene("quad+spot", "");
+    m_scene->DetachLight(m_scene->CreateLightIterator()->ItemAs<Baikal::Light>());
+
+    auto light = Baikal::DirectionalLight::Create();
+    light->SetDirection(float3(0.f, -1.f, 0.f));
+    light->SetEmittedRadiance(float3(1.f, 1.f, 1.f));
+    m_scene->AttachLight(light);
+
+    SetupCamera();
+
+    // Several texels per pixel from above
+    m_camera->LookAt(
+        RadeonRays::float3(0.f, 20.f, 0.f),
+        RadeonRays::float3(0.f, 0.f, 0.f),
+        RadeonRays::float3(0.f, 0.f, 1.f));
+
+    // Single texel checkerboard averages to grey from the first mip level on
+    int const size = 1024;
+    auto data = new char[size * size * 4];
+    for (auto y = 0; y < size; ++y)
+    {
+        for (auto x = 0; x < size; ++x)
+        {
+            auto value = ((x + y) & 1) ? (char)0xFF : (char)0x00;
+            std::fill(data + 4 * (y * size + x), data + 4 * (y * size + x) + 3, value);
+            data[4 * (y * size + x) + 3] = (char)0xFF;
+        }
+    }
+
+    auto checker = Baikal::Texture::Create(data, RadeonRays::int3(size, size, 1), Baikal::Texture::Format::kRgba8);
+
+    auto material = Baikal::SingleBxdf::Create(Baikal::SingleBxdf::BxdfType::kLambert);
+    m_scene->CreateShapeIterator()->ItemAs<Baikal::Shape>()->SetMaterial(material);
+
+    auto render = [&](std::vector<float3>& image)
+    {
+        ASSERT_NO_THROW(m_controller->CompileScene(m_scene));
+        auto& scene = m_controller->GetCachedScene(m_scene);
+
+        ASSERT_NO_THROW(m_renderer->SetRandomSeed(0));
+        ClearOutput();
+
+        RenderIterations(scene);
+
+        image = GetOutputData();
+    };
+
+    std::vector<float3> textured, reference;
+
+    material->SetInputValue("albedo", checker);
+    render(textured);
+
+    material->SetInputValue("albedo", float4(0.5f, 0.5f, 0.5f, 1.f));
+    render(reference);
+
+    // Point sampling level 0 would leave every pixel with a binomial mix of black and white,
+    // prefiltered lookups have to match constant albedo per pixel
+    auto num_covered = 0u;
+    for (auto i = 0u; i < reference.size(); ++i)
+    {
+        if (reference[i].y < 1e-3f * reference[i].w)
+        {
+            continue;
+        }
+
+        ASSERT_NEAR(textured[i].y / reference[i].y, 1.f, 0.02f) << "pixel " << i;
+        ++num_covered;
+    }
+
+    ASSERT_GT(num_covered, reference.size() / 8);
+}
+
+TEST_F(MaterialTest, Material_DiffuseStreamedTexture)
+{
+    auto controller = static_cast<Baikal::ClwSceneController*>(m_controller.get());
+    controller->SetTextureStreamingEnabled(true, 16 * 1024 * 1024);
+
+    // Only a small preview is loaded, the rest is streamed from the file
+    auto image_io = Baikal::ImageIo::CreateImageIo();
+    auto texture = image_io->LoadImageStreamed("../Resources/Textures/test_albedo1.jpg", 32);
+
+    ASSERT_LE(texture->GetSize().x, 32);
+    ASSERT_LE(texture->GetSize().y, 32);
+
+    auto material = Baikal::SingleBxdf::Create(Baikal::SingleBxdf::BxdfType::kLambert);
+    material->SetInputValue("albedo", texture);
+
+    ApplyMaterialToObject("sphere", material);
+
+    ASSERT_NO_THROW(m_controller->CompileScene(m_scene));
+
+    auto& scene = m_controller->GetCachedScene(m_scene);
+    ASSERT_TRUE(scene.texture_streamer);
+
+    // Render until all the tiles seen by the camera are resident
+    for (auto i = 0u; i < 100u; ++i)
+    {
+        ASSERT_NO_THROW(m_renderer->Render(scene));
+        ASSERT_NO_THROW(m_controller->CompileScene(m_scene));
+
+        if (i > 0 && scene.texture_streamer->IsIdle())
+        {
+            break;
+        }
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+
+    ASSERT_TRUE(scene.texture_streamer->IsIdle());
+
+    ClearOutput();
+
+    for (auto i = 0u; i < kNumIterations; ++i)
+    {
+        ASSERT_NO_THROW(m_renderer->Render(scene));
+        ASSERT_NO_THROW(m_controller->CompileScene(m_scene));
+    }
+
+    {
+        std::ostringstream oss;
+        oss << test_name() << ".png";
+        SaveOutput(oss.str());
+        ASSERT_TRUE(CompareToReference(oss.str()));
+    }
+}
+
+TEST_F(MaterialTest, Material_StreamedTextureLoadFailure)
+{
+    // Full resolution texels are never available
+    class FailingSource : public Baikal::TextureSource
+    {
+    public:
+        RadeonRays::int3 GetSize() const override { return RadeonRays::int3(1024, 1024, 1); }
+        void ReadRow(int, int, int, char*) const override { throw std::runtime_error("FailingSource: read error"); }
+    };
+
+    auto controller = static_cast<Baikal::ClwSceneController*>(m_controller.get());
+    controller->SetTextureStreamingEnabled(true, 16 * 1024 * 1024);
+
+    auto size = 32;
+    auto data = new char[size * size * 4];
+    std::fill(data, data + size * size * 4, (char)0x80);
+
+    auto texture = Baikal::Texture::Create(data, RadeonRays::int3(size, size, 1), Baikal::Texture::Format::kRgba8);
+    texture->SetSource(std::make_shared<FailingSource>());
+
+    auto material = Baikal::SingleBxdf::Create(Baikal::SingleBxdf::BxdfType::kLambert);
+    material->SetInputValue("albedo", texture);
+
+    ApplyMaterialToObject("sphere", material);
+
+    ASSERT_NO_THROW(m_controller->CompileScene(m_scene));
+
+    auto& scene = m_controller->GetCachedScene(m_scene);
+    ASSERT_TRUE(scene.texture_streamer);
+
+    // Failed tiles have to leave the pending set instead of blocking residency forever
+    for (auto i = 0u; i < 100u; ++i)
+    {
+        ASSERT_NO_THROW(m_renderer->Render(scene));
+        ASSERT_NO_THROW(m_controller->CompileScene(m_scene));
+
+        if (i > 0 && scene.texture_streamer->IsIdle() && scene.texture_streamer->GetNumFailedTiles() > 0)
+        {
+            break;
+        }
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+
+    ASSERT_TRUE(scene.texture_streamer->IsIdle());
+    ASSERT_GT(scene.texture_streamer->GetNumFailedTiles(), 0u);
+
+    // Failed tiles are not requested again and the mip tail is still rendered
+    auto num_failed = scene.texture_streamer->GetNumFailedTiles();
+
+    ClearOutput();
+
+    for (auto i = 0u; i < kNumIterations; ++i)
+    {
+        ASSERT_NO_THROW(m_renderer->Render(scene));
+        ASSERT_NO_THROW(m_controller->CompileScene(m_scene));
+        ASSERT_TRUE(scene.texture_streamer->IsIdle());
+    }
+
+    ASSERT_GE(scene.texture_streamer->GetNumFailedTiles(), num_failed);
+
+    auto image = GetOutputData();
+    ASSERT_TRUE(std::any_of(image.cbegin(), image.cend(), [](float3 const& v) { return v.x > 0.f; }));
+}
@@ -0,0 +1,250 @@
+/**********************************************************************
+Copyright (c) 2016 Advanced Micro Devices, Inc. All rights reserved.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+********************************************************************/
+#pragma once
+
+#include "basic.h"
+#include "Renderers/multi_device_scheduler.h"
+
+#include <chrono>
+#include <numeric>
+
+class MultiDeviceTest : public BasicTest
+{
+public:
+    static std::uint32_t constexpr kNumSubDevices = 2;
+
+    // Split the test device, plain contexts on the same device are used if it can not be partitioned
+    std::vector<CLWContext> CreateDeviceContexts() const
+    {
+        try
+        {
+            return Baikal::MultiDeviceScheduler::CreateSubDeviceContexts(m_context.GetDevice(0), kNumSubDevices);
+        }
+        catch (std::runtime_error&)
+        {
+        }
+
+        std::vector<CLWContext> contexts;
+        for (auto i = 0u; i < kNumSubDevices; ++i)
+        {
+            contexts.push_back(Baikal::KernelProfiler::CreateContext(m_context.GetDevice(0)));
+        }
+
+        return contexts;
+    }
+
+    // Create a renderer, a controller and an output for every context
+    void CreateSecondaryDevices(std::vector<CLWContext> const& contexts)
+    {
+        for (auto& context : contexts)
+        {
+            m_factories.push_back(std::make_unique<Baikal::ClwRenderFactory>(context, "cache"));
+            m_renderers.push_back(m_factories.back()->CreateRenderer(Baikal::ClwRenderFactory::RendererType::kUnidirectionalPathTracer));
+            m_controllers.push_back(m_factories.back()->CreateSceneController());
+            m_outputs.push_back(m_factories.back()->CreateOutput(kOutputWidth, kOutputHeight));
+            m_renderers.back()->SetOutput(Baikal::Renderer::OutputType::kColor, m_outputs.back().get());
+
+            Baikal::MultiDeviceScheduler::Device device;
+            device.context = context;
+            device.controller = m_controllers.back().get();
+            device.renderer = static_cast<Baikal::MonteCarloRenderer*>(m_renderers.back().get());
+            device.output = m_outputs.back().get();
+            m_secondary.push_back(device);
+        }
+    }
+
+    Baikal::MultiDeviceScheduler::Device GetPrimaryDevice() const
+    {
+        Baikal::MultiDeviceScheduler::Device primary;
+        primary.context = m_context;
+        primary.controller = m_controller.get();
+        primary.renderer = static_cast<Baikal::MonteCarloRenderer*>(m_renderer.get());
+        primary.output = m_output.get();
+        return primary;
+    }
+
+    // Render the whole frame on a single device using its current seed
+    void Render(Baikal::MultiDeviceScheduler::Device const& device, std::vector<RadeonRays::float3>& image)
+    {
+        ASSERT_NO_THROW(device.controller->CompileScene(m_scene));
+        auto& scene = device.controller->GetCachedScene(m_scene);
+
+        ASSERT_NO_THROW(device.renderer->Clear(RadeonRays::float3(), *device.output));
+
+        RenderIterations(scene, kNumIterations, device.renderer);
+
+        image.resize(device.output->width() * device.output->height());
+        ASSERT_NO_THROW(device.output->GetData(&image[0]));
+    }
+
+    // Mean squared difference of per pixel radiance estimates
+    static float GetMeanSquaredDifference(std::vector<RadeonRays::float3> const& first,
+                                          std::vector<RadeonRays::float3> const& second)
+    {
+        float sum = 0.f;
+
+        for (auto i = 0u; i < first.size(); ++i)
+        {
+            auto difference = GetRadiance(first[i]) - GetRadiance(second[i]);
+            sum += difference.x * difference.x + difference.y * difference.y + difference.z * difference.z;
+        }
+
+        return sum / first.size();
+    }
+
+    std::vector<std::unique_ptr<Baikal::RenderFactory<Baikal::ClwScene>>> m_factories;
+    std::vector<std::unique_ptr<Baikal::Renderer>> m_renderers;
+    std::vector<std::unique_ptr<Baikal::SceneController<Baikal::ClwScene>>> m_controllers;
+    std::vector<std::unique_ptr<Baikal::Output>> m_outputs;
+    std::vector<Baikal::MultiDeviceScheduler::Device> m_secondary;
+};
+
+TEST_F(MultiDeviceTest, MultiDevice_Render)
+{
+    auto contexts = CreateDeviceContexts();
+    ASSERT_EQ(contexts.size(), kNumSubDevices);
+
+    // Average radiance and total number of samples of the output
+    auto get_average = [this](float& num_samples)
+    {
+        auto data = GetOutputData();
+
+        num_samples = 0.f;
+        for (auto const& value : data)
+        {
+            num_samples += value.w;
+        }
+
+        return GetAverageRadiance(data);
+    };
+
+    // Single device reference
+    ClearOutput();
+
+    ASSERT_NO_THROW(m_controller->CompileScene(m_scene));
+
+    RenderIterations(m_controller->GetCachedScene(m_scene));
+
+    float single_samples = 0.f;
+    auto single_average = get_average(single_samples);
+
+    // Secondary devices render bands of the frame and ship them to the primary output
+    ASSERT_NO_THROW(CreateSecondaryDevices(contexts));
+
+    ClearOutput();
+
+    std::size_t num_merged = 0;
+
+    {
+        Baikal::MultiDeviceScheduler scheduler(GetPrimaryDevice(), m_secondary, m_scene);
+        scheduler.SetHalfFloatTransfer(true);
+        scheduler.SetTransferInterval(std::chrono::milliseconds(0));
+
+        auto band_heights = scheduler.GetBandHeights();
+        ASSERT_EQ(band_heights.size(), contexts.size());
+        ASSERT_EQ(std::accumulate(band_heights.cbegin(), band_heights.cend(), 0u), static_cast<std::uint32_t>(kOutputHeight));
+
+        scheduler.Start();
+
+        // Keep rendering until every secondary device has delivered a few tiles
+        auto start = std::chrono::high_resolution_clock::now();
+
+        for (auto i = 0u; i < kNumIterations || num_merged < 4 * contexts.size(); ++i)
+        {
+            ASSERT_NO_THROW(m_renderer->Render(m_controller->GetCachedScene(m_scene)));
+            ASSERT_NO_THROW(num_merged += scheduler.Merge());
+            ASSERT_LT(std::chrono::high_resolution_clock::now() - start, std::chrono::seconds(60));
+        }
+
+        scheduler.Stop();
+        num_merged += scheduler.Merge();
+
+        ASSERT_GT(scheduler.GetNumTransferredBytes(), 0u);
+    }
+
+    ASSERT_GE(num_merged, 4 * contexts.size());
+
+    float multi_samples = 0.f;
+    auto multi_average = get_average(multi_samples);
+
+    ASSERT_GT(multi_samples, single_samples);
+
+    for (auto i = 0; i < 3; ++i)
+    {
+        ASSERT_NEAR(multi_average[i], single_average[i], 0.03f * single_average[i] + 1e-4f);
+    }
+}
+
+TEST_F(MultiDeviceTest, MultiDevice_DeviceSeeds)
+{
+    // Seeds of secondary devices differ from each other and from the primary one
+    for (auto primary_seed : { 0u, 1u, 0xFFFFFFFFu })
+    {
+        std::vector<std::uint32_t> seeds = { primary_seed };
+
+        for (auto i = 0u; i < 16u; ++i)
+        {
+            seeds.push_back(Baikal::MultiDeviceScheduler::GetDeviceSeed(primary_seed, i));
+        }
+
+        std::sort(seeds.begin(), seeds.end());
+        ASSERT_EQ(std::unique(seeds.begin(), seeds.end()), seeds.end());
+    }
+}
+
+TEST_F(MultiDeviceTest, MultiDevice_UncorrelatedSamples)
+{
+    auto contexts = CreateDeviceContexts();
+    ASSERT_NO_THROW(CreateSecondaryDevices(contexts));
+
+    auto primary = GetPrimaryDevice();
+
+    // Scheduler assigns seeds to secondary devices, they render whole frames on their own here
+    Baikal::MultiDeviceScheduler scheduler(primary, m_secondary, m_scene);
+
+    std::vector<std::vector<RadeonRays::float3>> images(m_secondary.size() + 1);
+
+    ASSERT_NO_THROW(Render(primary, images[0]));
+
+    for (auto i = 0u; i < m_secondary.size(); ++i)
+    {
+        ASSERT_NO_THROW(Render(m_secondary[i], images[i + 1]));
+    }
+
+    // Difference of two independent estimates is twice the variance, correlated
+    // estimates have less (and identical ones none at all)
+    std::vector<RadeonRays::float3> independent;
+    ASSERT_NO_THROW(m_renderer->SetRandomSeed(0x5bd1e995u));
+    ASSERT_NO_THROW(Render(primary, independent));
+
+    auto reference_difference = GetMeanSquaredDifference(images[0], independent);
+    ASSERT_GT(reference_difference, 0.f);
+
+    for (auto i = 0u; i < images.size(); ++i)
+    {
+        for (auto j = i + 1; j < images.size(); ++j)
+        {
+            ASSERT_GT(GetMeanSquaredDifference(images[i], images[j]), 0.5f * reference_difference)
+                << "images " << i << " and " << j;
+        }
+    }
+}
@@ -0,0 +1,151 @@
+/**********************************************************************
+Copyright (c) 2016 Advanced Micro Devices, Inc. All rights reserved.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+********************************************************************/
+#pragma once
+
+#include "basic.h"
+#include "Controllers/clw_scene_controller.h"
+#include "SceneGraph/shape.h"
+
+class SceneCacheTest : public BasicTest
+{
+public:
+    // Render the scene compiled by a given controller from a fixed seed
+    std::vector<RadeonRays::float3> Render(Baikal::SceneController<Baikal::ClwScene>& controller)
+    {
+        m_renderer->SetRandomSeed(0);
+        ClearOutput();
+
+        auto& scene = controller.CompileScene(m_scene);
+
+        RenderIterations(scene);
+
+        return GetOutputData();
+    }
+
+    std::unique_ptr<Baikal::ClwSceneController> CreateCachedController()
+    {
+        auto controller = m_factory->CreateSceneController();
+        auto clw_controller = static_cast<Baikal::ClwSceneController*>(controller.release());
+        clw_controller->SetSceneCachePath("cache");
+        return std::unique_ptr<Baikal::ClwSceneController>(clw_controller);
+    }
+};
+
+TEST_F(SceneCacheTest, SceneCache_WarmStart)
+{
+    // First controller either finds or populates the entries
+    {
+        auto controller = CreateCachedController();
+        ASSERT_NO_THROW(controller->CompileScene(m_scene));
+    }
+
+    // Geometry, materials, texture headers and texture data are all served from disk
+    auto controller = CreateCachedController();
+    ASSERT_NO_THROW(controller->CompileScene(m_scene));
+
+    auto stats = controller->GetSceneCacheStatistics();
+    ASSERT_EQ(stats.num_misses, 0u);
+    ASSERT_EQ(stats.num_hits, 4u);
+
+    // Cached data renders exactly like freshly serialized one
+    std::vector<RadeonRays::float3> cached;
+    std::vector<RadeonRays::float3> reference;
+    ASSERT_NO_THROW(cached = Render(*controller));
+    ASSERT_NO_THROW(reference = Render(*m_controller));
+
+    for (auto i = 0u; i < reference.size(); ++i)
+    {
+        ASSERT_EQ(cached[i].x, reference[i].x);
+        ASSERT_EQ(cached[i].y, reference[i].y);
+        ASSERT_EQ(cached[i].z, reference[i].z);
+        ASSERT_EQ(cached[i].w, reference[i].w);
+    }
+}
+
+TEST_F(SceneCacheTest, SceneCache_GeometryEdit)
+{
+    {
+        auto controller = CreateCachedController();
+        ASSERT_NO_THROW(controller->CompileScene(m_scene));
+    }
+
+    // Entries are keyed by content, so rewriting the same vertices still hits
+    auto mesh = m_scene->CreateShapeIterator()->ItemAs<Baikal::Mesh>();
+    std::vector<RadeonRays::float3> vertices(mesh->GetVertices(), mesh->GetVertices() + mesh->GetNumVertices());
+    mesh->SetVertices(vertices.data(), vertices.size());
+
+    {
+        auto controller = CreateCachedController();
+        ASSERT_NO_THROW(controller->CompileScene(m_scene));
+
+        auto stats = controller->GetSceneCacheStatistics();
+        ASSERT_EQ(stats.num_misses, 0u);
+        ASSERT_EQ(stats.num_hits, 4u);
+    }
+
+    // Different normals with the same count miss
+    std::vector<RadeonRays::float3> normals(mesh->GetNormals(), mesh->GetNormals() + mesh->GetNumNormals());
+    for (auto& normal : normals)
+    {
+        normal = RadeonRays::float3(-normal.x, -normal.y, -normal.z);
+    }
+    mesh->SetNormals(normals.data(), normals.size());
+
+    auto controller = CreateCachedController();
+    ASSERT_NO_THROW(controller->CompileScene(m_scene));
+
+    auto stats = controller->GetSceneCacheStatistics();
+    ASSERT_EQ(stats.num_misses, 1u);
+    ASSERT_EQ(stats.num_hits, 3u);
+}
+
+TEST_F(SceneCacheTest, SceneCache_NormalsEdit)
+{
+    auto controller = CreateCachedController();
+
+    std::vector<RadeonRays::float3> before;
+    ASSERT_NO_THROW(before = Render(*controller));
+
+    // Edit normals in place, keeping their count
+    auto mesh = m_scene->CreateShapeIterator()->ItemAs<Baikal::Mesh>();
+    std::vector<RadeonRays::float3> normals(mesh->GetNormals(), mesh->GetNormals() + mesh->GetNumNormals());
+    for (auto& normal : normals)
+    {
+        normal = RadeonRays::float3(-normal.x, -normal.y, -normal.z);
+    }
+    mesh->SetNormals(normals.data(), normals.size());
+
+    std::vector<RadeonRays::float3> after;
+    ASSERT_NO_THROW(after = Render(*controller));
+
+    // Updated attributes are uploaded instead of the cached ones
+    std::size_t num_changed = 0;
+    for (auto i = 0u; i < before.size(); ++i)
+    {
+        if (before[i].x != after[i].x || before[i].y != after[i].y || before[i].z != after[i].z)
+        {
+            ++num_changed;
+        }
+    }
+
+    ASSERT_GT(num_changed, 0u);
+}
@@ -0,0 +1,116 @@
+/**********************************************************************
+Copyright (c) 2016 Advanced Micro Devices, Inc. All rights reserved.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+********************************************************************/
+#pragma once
+
+#include "basic.h"
+#include "SceneGraph/texture.h"
+#include "SceneGraph/material.h"
+#include "SceneGraph/shape.h"
+
+#include <algorithm>
+
+class SceneUpdateTest : public BasicTest
+{
+public:
+    Baikal::Shape::Ptr GetFirstShape() const
+    {
+        auto shape_iter = m_scene->CreateShapeIterator();
+        return shape_iter->ItemAs<Baikal::Shape>();
+    }
+};
+
+TEST_F(SceneUpdateTest, SceneUpdate_NoOp)
+{
+    static std::uint32_t constexpr kNumCompilations = 100;
+
+    ASSERT_NO_THROW(m_controller->CompileScene(m_scene));
+
+    auto& compiled = m_controller->GetCachedScene(m_scene);
+    auto stats = m_controller->GetUpdateStatistics();
+
+    // Nothing changed, every call returns the same scene without looking at objects
+    for (auto i = 0u; i < kNumCompilations; ++i)
+    {
+        ASSERT_EQ(&m_controller->CompileScene(m_scene), &compiled);
+    }
+
+    auto noop_stats = m_controller->GetUpdateStatistics();
+    ASSERT_EQ(noop_stats.num_compilations, stats.num_compilations + kNumCompilations);
+    ASSERT_EQ(noop_stats.num_collector_rebuilds, stats.num_collector_rebuilds);
+    ASSERT_EQ(noop_stats.num_changed_objects, 0u);
+}
+
+TEST_F(SceneUpdateTest, SceneUpdate_ValueEdit)
+{
+    auto material = Baikal::SingleBxdf::Create(Baikal::SingleBxdf::BxdfType::kLambert);
+    GetFirstShape()->SetMaterial(material);
+
+    ASSERT_NO_THROW(m_controller->CompileScene(m_scene));
+
+    auto num_rebuilds = m_controller->GetUpdateStatistics().num_collector_rebuilds;
+
+    // Value edits keep the collectors and only touch the edited object
+    m_camera->SetFocusDistance(2.f);
+    ASSERT_NO_THROW(m_controller->CompileScene(m_scene));
+    ASSERT_FALSE(m_camera->IsDirty());
+    ASSERT_EQ(m_controller->GetUpdateStatistics().num_collector_rebuilds, num_rebuilds);
+
+    material->SetInputValue("albedo", RadeonRays::float4(0.2f, 0.4f, 0.6f, 1.f));
+    ASSERT_NO_THROW(m_controller->CompileScene(m_scene));
+    ASSERT_FALSE(material->IsDirty());
+
+    auto stats = m_controller->GetUpdateStatistics();
+    ASSERT_EQ(stats.num_collector_rebuilds, num_rebuilds);
+    ASSERT_EQ(stats.num_changed_objects, 1u);
+}
+
+TEST_F(SceneUpdateTest, SceneUpdate_StructureEdit)
+{
+    ASSERT_NO_THROW(m_controller->CompileScene(m_scene));
+
+    auto num_rebuilds = m_controller->GetUpdateStatistics().num_collector_rebuilds;
+
+    // Assigning a material changes the set of collected objects
+    auto material = Baikal::SingleBxdf::Create(Baikal::SingleBxdf::BxdfType::kLambert);
+    GetFirstShape()->SetMaterial(material);
+    ASSERT_NO_THROW(m_controller->CompileScene(m_scene));
+    ASSERT_EQ(m_controller->GetUpdateStatistics().num_collector_rebuilds, num_rebuilds + 1);
+
+    // So does replacing a texture input with a value
+    auto data = new char[2 * 2 * 4];
+    std::fill(data, data + 2 * 2 * 4, (char)0x80);
+    auto texture = Baikal::Texture::Create(data, RadeonRays::int3(2, 2, 1), Baikal::Texture::Format::kRgba8);
+    material->SetInputValue("albedo", texture);
+    ASSERT_NO_THROW(m_controller->CompileScene(m_scene));
+    ASSERT_EQ(m_controller->GetUpdateStatistics().num_collector_rebuilds, num_rebuilds + 2);
+
+    material->SetInputValue("albedo", RadeonRays::float4(0.5f, 0.5f, 0.5f, 1.f));
+    ASSERT_NO_THROW(m_controller->CompileScene(m_scene));
+    ASSERT_EQ(m_controller->GetUpdateStatistics().num_collector_rebuilds, num_rebuilds + 3);
+
+    // Detaching and reattaching the shape recollects as well
+    auto shape = GetFirstShape();
+    m_scene->DetachShape(shape);
+    m_scene->AttachShape(shape);
+    ASSERT_NO_THROW(m_controller->CompileScene(m_scene));
+    ASSERT_EQ(m_controller->GetUpdateStatistics().num_collector_rebuilds, num_rebuilds + 4);
+}
@@ -0,0 +1,159 @@
+/**********************************************************************
+Copyright (c) 2016 Advanced Micro Devices, Inc. All rights reserved.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+********************************************************************/
+#pragma once
+
+#include "basic.h"
+#include "Controllers/clw_scene_controller.h"
+#include "SceneGraph/light.h"
+#include "SceneGraph/material.h"
+#include "SceneGraph/shape.h"
+#include "SceneGraph/texture.h"
+
+#include <algorithm>
+
+class VertexFormatTest : public BasicTest
+{
+public:
+    // Render the scene compiled by a given controller from a fixed seed
+    void Render(Baikal::SceneController<Baikal::ClwScene>& controller, std::vector<RadeonRays::float3>& image)
+    {
+        ASSERT_NO_THROW(controller.CompileScene(m_scene));
+        auto& scene = controller.GetCachedScene(m_scene);
+
+        ASSERT_NO_THROW(m_renderer->SetRandomSeed(0));
+        ClearOutput();
+
+        RenderIterations(scene);
+
+        image = GetOutputData();
+    }
+
+    std::unique_ptr<Baikal::SceneController<Baikal::ClwScene>> CreateCompactController()
+    {
+        auto controller = m_factory->CreateSceneController();
+        static_cast<Baikal::ClwSceneController*>(controller.get())->SetCompactVertexFormatEnabled(true);
+        return controller;
+    }
+
+    // Number of pixels whose radiance differs by more than a relative tolerance
+    static std::size_t CountMismatches(std::vector<RadeonRays::float3> const& image,
+                                       std::vector<RadeonRays::float3> const& reference,
+                                       float tolerance)
+    {
+        std::size_t num_mismatches = 0;
+
+        for (auto i = 0u; i < reference.size(); ++i)
+        {
+            auto value = GetRadiance(image[i]);
+            auto expected = GetRadiance(reference[i]);
+
+            for (auto c = 0; c < 3; ++c)
+            {
+                if (std::abs(value[c] - expected[c]) > tolerance * expected[c] + 1e-3f)
+                {
+                    ++num_mismatches;
+                    break;
+                }
+            }
+        }
+
+        return num_mismatches;
+    }
+};
+
+TEST_F(VertexFormatTest, VertexFormat_CompactPerPixel)
+{
+    std::vector<RadeonRays::float3> reference;
+    std::vector<RadeonRays::float3> compact;
+
+    ASSERT_NO_THROW(Render(*m_controller, reference));
+
+    auto controller = CreateCompactController();
+    ASSERT_NO_THROW(Render(*controller, compact));
+
+    ASSERT_EQ(controller->GetCachedScene(m_scene).vertex_format, Baikal::ClwScene::VERTEX_FORMAT_COMPACT);
+
+    // Same random numbers, so only quantized normals can move individual pixels
+    ASSERT_LE(CountMismatches(compact, reference, 0.03f), reference.size() / 100);
+}
+
+TEST_F(VertexFormatTest, VertexFormat_LargeUVRange)
+{
+    // Quad lit by a directional light only, so radiance follows the albedo of the first hit
+    auto io = Baikal::SceneIo::CreateSceneIoTest();
+    m_scene = io->LoadScene("quad+spot", "");
+    m_scene->DetachLight(m_scene->CreateLightIterator()->ItemAs<Baikal::Light>());
+
+    auto light = Baikal::DirectionalLight::Create();
+    light->SetDirection(RadeonRays::float3(0.f, -1.f, 0.f));
+    light->SetEmittedRadiance(RadeonRays::float3(1.f, 1.f, 1.f));
+    m_scene->AttachLight(light);
+
+    SetupCamera();
+
+    m_camera->LookAt(
+        RadeonRays::float3(0.f, 20.f, 0.f),
+        RadeonRays::float3(0.f, 0.f, 0.f),
+        RadeonRays::float3(0.f, 0.f, 1.f));
+
+    // Coarse checkerboard, so every texel covers many pixels
+    int const size = 8;
+    auto data = new char[size * size * 4];
+    for (auto y = 0; y < size; ++y)
+    {
+        for (auto x = 0; x < size; ++x)
+        {
+            auto value = ((x + y) & 1) ? (char)0xFF : (char)0x20;
+            std::fill(data + 4 * (y * size + x), data + 4 * (y * size + x) + 3, value);
+            data[4 * (y * size + x) + 3] = (char)0xFF;
+        }
+    }
+
+    auto checker = Baikal::Texture::Create(data, RadeonRays::int3(size, size, 1), Baikal::Texture::Format::kRgba8);
+
+    auto material = Baikal::SingleBxdf::Create(Baikal::SingleBxdf::BxdfType::kLambert);
+    material->SetInputValue("albedo", checker);
+
+    auto mesh = m_scene->CreateShapeIterator()->ItemAs<Baikal::Mesh>();
+    mesh->SetMaterial(material);
+
+    // Texture repeats, so shifting UVs by whole tiles does not change the image,
+    // but half precision has a spacing of a whole tile at 1000
+    std::vector<RadeonRays::float2> uvs(mesh->GetUVs(), mesh->GetUVs() + mesh->GetNumUVs());
+    for (auto& uv : uvs)
+    {
+        uv.x += 1000.f;
+        uv.y += 1000.f;
+    }
+    mesh->SetUVs(std::move(uvs));
+
+    std::vector<RadeonRays::float3> reference;
+    std::vector<RadeonRays::float3> compact;
+
+    ASSERT_NO_THROW(Render(*m_controller, reference));
+
+    auto controller = CreateCompactController();
+    ASSERT_NO_THROW(Render(*controller, compact));
+
+    ASSERT_EQ(controller->GetCachedScene(m_scene).vertex_format, Baikal::ClwScene::VERTEX_FORMAT_COMPACT_FLOAT_UV);
+    ASSERT_LE(CountMismatches(compact, reference, 0.03f), reference.size() / 100);
+}
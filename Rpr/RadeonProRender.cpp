@@ -118,8 +118,11 @@ rpr_int rprContextGetInfo(rpr_context in_context, rpr_context_info in_context_in
     switch (in_context_info)
     {
     case RPR_CONTEXT_RENDER_STATISTICS:
-        context->GetRenderStatistics(out_data, out_size_ret);
-        break;
+        return context->GetRenderStatistics(out_data, out_size_ret);
+    case RPR_CONTEXT_BAIKAL_RENDER_STATISTICS:
+        return context->GetBaikalRenderStatistics(out_data, out_size_ret);
+    case RPR_CONTEXT_BAIKAL_KERNEL_STATISTICS:
+        return context->GetBaikalKernelStatistics(in_size, out_data, out_size_ret);
     case RPR_CONTEXT_PARAMETER_COUNT:
         break;
     case RPR_OBJECT_NAME:
@@ -239,6 +242,27 @@ rpr_int rprContextSetParameter1u(rpr_context in_context, rpr_char const * name,
         return RPR_ERROR_INVALID_CONTEXT;
     }
 
+    if (!strcmp(name, RPR_BAIKAL_CONTEXT_STATISTICS))
+    {
+        context->SetStatisticsEnabled(x != 0);
+        return RPR_SUCCESS;
+    }
+
+    if (!strcmp(name, RPR_BAIKAL_CONTEXT_LIGHT_SAMPLING))
+    {
+        switch (x)
+        {
+        case RPR_BAIKAL_LIGHT_SAMPLING_POWER:
+            context->SetLightSamplingMode(Baikal::Scene1::LightSamplingMode::kPower);
+            return RPR_SUCCESS;
+        case RPR_BAIKAL_LIGHT_SAMPLING_BVH:
+            context->SetLightSamplingMode(Baikal::Scene1::LightSamplingMode::kBvh);
+            return RPR_SUCCESS;
+        default:
+            return RPR_ERROR_INVALID_PARAMETER;
+        }
+    }
+
     //TODO: handle context parameters
     return RPR_SUCCESS;
 
@@ -0,0 +1,80 @@
+/*****************************************************************************\
+*
+*  Module Name    RadeonProRender_Baikal.h
+*  Project        Radeon ProRender Baikal backend
+*
+*  Description    Baikal specific context queries
+*
+*  Copyright 2017 Advanced Micro Devices, Inc.
+*
+*  All rights reserved.  This notice is intended as a precaution against
+*  inadvertent publication and does not imply publication or any waiver
+*  of confidentiality.  The year included in the foregoing notice is the
+*  year of creation of the work.
+*
+\*****************************************************************************/
+#ifndef __RADEONPRORENDER_BAIKAL_H
+#define __RADEONPRORENDER_BAIKAL_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "RadeonProRender.h"
+
+/* rpr_context_info */
+#define RPR_CONTEXT_BAIKAL_RENDER_STATISTICS 0x5001 
+#define RPR_CONTEXT_BAIKAL_KERNEL_STATISTICS 0x5002 
+
+/* rprContextSetParameter1u name, non-zero enables per bounce ray counts and kernel
+   times. These cost a counter update per pass and keep kernel events, so they are off
+   by default and the statistics queries only report memory. Contexts created through
+   RPR always use profiling command queues, so kernel times are available once enabled. */
+#define RPR_BAIKAL_CONTEXT_STATISTICS "baikal.statistics"
+
+/* rprContextSetParameter1u name, selects how lights are picked for direct lighting.
+   Power sampling is the default: it needs no extra data and is cheaper per sample. The
+   light BVH accounts for distance and orientation to the shading point, which lowers
+   noise in scenes with many local lights. The mode applies to the current scene. */
+#define RPR_BAIKAL_CONTEXT_LIGHT_SAMPLING "baikal.lightsampling"
+
+/* RPR_BAIKAL_CONTEXT_LIGHT_SAMPLING values */
+#define RPR_BAIKAL_LIGHT_SAMPLING_POWER 0x0
+#define RPR_BAIKAL_LIGHT_SAMPLING_BVH 0x1
+
+#define RPR_BAIKAL_MAX_STATISTICS_BOUNCES 32
+#define RPR_BAIKAL_KERNEL_NAME_LENGTH 64
+
+/* Device memory in bytes and ray counts accumulated over all devices of a context */
+struct _rpr_baikal_render_statistics
+{
+    rpr_longlong geometry_memory;
+    rpr_longlong texture_memory;
+    rpr_longlong material_memory;
+    rpr_longlong light_memory;
+    rpr_longlong work_buffer_memory;
+    rpr_longlong output_memory;
+    rpr_uint num_samples;
+    rpr_uint num_bounces;
+    rpr_longlong rays_per_bounce[RPR_BAIKAL_MAX_STATISTICS_BOUNCES];
+    rpr_longlong paths_per_bounce[RPR_BAIKAL_MAX_STATISTICS_BOUNCES];
+};
+
+typedef _rpr_baikal_render_statistics rpr_baikal_render_statistics;
+
+/* RPR_CONTEXT_BAIKAL_KERNEL_STATISTICS returns an array of these, one per kernel */
+struct _rpr_baikal_kernel_statistics
+{
+    rpr_char name[RPR_BAIKAL_KERNEL_NAME_LENGTH];
+    /* Total execution time in milliseconds */
+    rpr_float time;
+    rpr_uint num_launches;
+};
+
+typedef _rpr_baikal_kernel_statistics rpr_baikal_kernel_statistics;
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /*__RADEONPRORENDER_BAIKAL_H  */
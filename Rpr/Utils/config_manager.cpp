@@ -23,6 +23,7 @@ THE SOFTWARE.
 
 #include "CLW.h"
 #include "RenderFactory/render_factory.h"
+#include "Utils/kernel_profiler.h"
 
 #ifndef APP_BENCHMARK
 
@@ -128,14 +129,14 @@ void ConfigManager::CreateConfigs(
                     (cl_context_properties)kCGLShareGroup, 0
                 };
 #endif
-                cfg.context = CLWContext::Create(platforms[i].GetDevice(d), props);
+                cfg.context = Baikal::KernelProfiler::CreateContext(platforms[i].GetDevice(d), props, true);
                 cfg.type = kPrimary;
                 cfg.caninterop = true;
                 hasprimary = true;
             }
             else
             {
-                cfg.context = CLWContext::Create(platforms[i].GetDevice(d));
+                cfg.context = Baikal::KernelProfiler::CreateContext(platforms[i].GetDevice(d), nullptr, true);
                 cfg.type = kSecondary;
             }
 
@@ -165,6 +166,8 @@ void ConfigManager::CreateConfigs(
         configs[i].factory = std::make_unique<Baikal::ClwRenderFactory>(configs[i].context, "cache");
         configs[i].controller = configs[i].factory->CreateSceneController();
         configs[i].renderer = configs[i].factory->CreateRenderer(Baikal::ClwRenderFactory::RendererType::kUnidirectionalPathTracer);
+        // Start compiling kernels before the first frame
+        configs[i].factory->WarmUp();
     }
 }
 
@@ -201,7 +204,7 @@ void ConfigManager::CreateConfigs(
 
             Config cfg;
             cfg.caninterop = false;
-            cfg.context = CLWContext::Create(platforms[i].GetDevice(d));
+            cfg.context = Baikal::KernelProfiler::CreateContext(platforms[i].GetDevice(d), nullptr, true);
             cfg.type = kSecondary;
 
             configs.push_back(std::move(cfg));
@@ -224,6 +227,8 @@ void ConfigManager::CreateConfigs(
         configs[i].factory = std::make_unique<Baikal::ClwRenderFactory>(configs[i].context);
         configs[i].controller = configs[i].factory->CreateSceneController();
         configs[i].renderer = configs[i].factory->CreateRenderer(Baikal::ClwRenderFactory::RendererType::kUnidirectionalPathTracer);
+        // Start compiling kernels before the first frame
+        configs[i].factory->WarmUp();
     }
 }
 #endif //APP_BENCHMARK
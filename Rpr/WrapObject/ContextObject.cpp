@@ -37,6 +37,10 @@ THE SOFTWARE.
 
 #include "RenderFactory/render_factory.h"
 
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
 namespace
 {
     struct ParameterDesc
@@ -106,6 +110,8 @@ namespace
 
 ContextObject::ContextObject(rpr_creation_flags creation_flags)
     : m_current_scene(nullptr)
+    , m_kernel_statistics_pending(false)
+    , m_light_sampling_mode(Baikal::Scene1::LightSamplingMode::kPower)
 {
     rpr_int result = RPR_SUCCESS;
 
@@ -134,27 +140,155 @@ ContextObject::ContextObject(rpr_creation_flags creation_flags)
     }
 }
 
-void ContextObject::GetRenderStatistics(void * out_data, size_t * out_size_ret) const
+void ContextObject::SetStatisticsEnabled(bool enabled)
+{
+    for (auto& c : m_cfgs)
+    {
+        static_cast<Baikal::MonteCarloRenderer*>(c.renderer.get())->SetStatisticsEnabled(enabled);
+    }
+}
+
+void ContextObject::GetStatistics(Baikal::RenderStatistics& stats) const
+{
+    stats = Baikal::RenderStatistics();
+
+    for (auto& c : m_cfgs)
+    {
+        auto renderer = static_cast<Baikal::MonteCarloRenderer*>(c.renderer.get());
+
+        //scene memory is only known once the scene has been compiled
+        Baikal::RenderStatistics cfg_stats;
+        if (m_current_scene && c.controller->HasCachedScene(m_current_scene->GetScene()))
+        {
+            cfg_stats = renderer->GetStatistics(c.controller->GetCachedScene(m_current_scene->GetScene()));
+        }
+        else
+        {
+            cfg_stats = renderer->GetStatistics(Baikal::ClwScene());
+        }
+
+        stats.geometry_memory += cfg_stats.geometry_memory;
+        stats.texture_memory += cfg_stats.texture_memory;
+        stats.material_memory += cfg_stats.material_memory;
+        stats.light_memory += cfg_stats.light_memory;
+        stats.work_buffer_memory += cfg_stats.work_buffer_memory;
+        stats.output_memory += cfg_stats.output_memory;
+        stats.num_samples = std::max(stats.num_samples, cfg_stats.num_samples);
+
+        auto num_bounces = std::max(stats.rays_per_bounce.size(), cfg_stats.rays_per_bounce.size());
+        stats.rays_per_bounce.resize(num_bounces, 0);
+        stats.paths_per_bounce.resize(num_bounces, 0);
+        for (size_t i = 0; i < cfg_stats.rays_per_bounce.size(); ++i)
+        {
+            stats.rays_per_bounce[i] += cfg_stats.rays_per_bounce[i];
+            stats.paths_per_bounce[i] += cfg_stats.paths_per_bounce[i];
+        }
+
+        for (auto& time : cfg_stats.kernel_times)
+        {
+            stats.kernel_times[time.first].time += time.second.time;
+            stats.kernel_times[time.first].num_launches += time.second.num_launches;
+        }
+    }
+}
+
+rpr_int ContextObject::GetRenderStatistics(void * out_data, size_t * out_size_ret) const
 {
     if (out_data)
     {
-        //TODO: more statistics
+        Baikal::RenderStatistics stats;
+        GetStatistics(stats);
+
         rpr_render_statistics* rs = static_cast<rpr_render_statistics*>(out_data);
-        rs->gpumem_usage = 0;
+        rs->gpumem_usage = static_cast<rpr_longlong>(stats.GetDeviceMemory());
         rs->gpumem_total = 0;
         rs->gpumem_max_allocation = 0;
-        //for (const auto& cfg : m_cfgs)
-        //{
-            // TODO: implement me
-            //rs->gpumem_usage += cfg.renderer->GetWorkingSetSize();
-            //rs->gpumem_total += cfg.renderer->GetWorkingSetSize();
-            //rs->gpumem_max_allocation += cfg.renderer->GetWorkingSetSize();
-        //}
+        rs->sysmem_usage = 0;
+        for (const auto& cfg : m_cfgs)
+        {
+            auto device = cfg.context.GetDevice(0);
+            rs->gpumem_total += static_cast<rpr_longlong>(device.GetGlobalMemSize());
+            rs->gpumem_max_allocation = std::max(rs->gpumem_max_allocation, static_cast<rpr_longlong>(device.GetMaxAllocSize()));
+        }
     }
     if (out_size_ret)
     {
         *out_size_ret = sizeof(rpr_render_statistics);
     }
+    return RPR_SUCCESS;
+}
+
+rpr_int ContextObject::GetBaikalRenderStatistics(void * out_data, size_t * out_size_ret) const
+{
+    if (out_data)
+    {
+        Baikal::RenderStatistics stats;
+        GetStatistics(stats);
+
+        rpr_baikal_render_statistics* rs = static_cast<rpr_baikal_render_statistics*>(out_data);
+        memset(rs, 0, sizeof(rpr_baikal_render_statistics));
+        rs->geometry_memory = static_cast<rpr_longlong>(stats.geometry_memory);
+        rs->texture_memory = static_cast<rpr_longlong>(stats.texture_memory);
+        rs->material_memory = static_cast<rpr_longlong>(stats.material_memory);
+        rs->light_memory = static_cast<rpr_longlong>(stats.light_memory);
+        rs->work_buffer_memory = static_cast<rpr_longlong>(stats.work_buffer_memory);
+        rs->output_memory = static_cast<rpr_longlong>(stats.output_memory);
+        rs->num_samples = stats.num_samples;
+        rs->num_bounces = static_cast<rpr_uint>(std::min<size_t>(stats.rays_per_bounce.size(), RPR_BAIKAL_MAX_STATISTICS_BOUNCES));
+        for (rpr_uint i = 0; i < rs->num_bounces; ++i)
+        {
+            rs->rays_per_bounce[i] = static_cast<rpr_longlong>(stats.rays_per_bounce[i]);
+            rs->paths_per_bounce[i] = static_cast<rpr_longlong>(stats.paths_per_bounce[i]);
+        }
+    }
+    if (out_size_ret)
+    {
+        *out_size_ret = sizeof(rpr_baikal_render_statistics);
+    }
+    return RPR_SUCCESS;
+}
+
+rpr_int ContextObject::GetBaikalKernelStatistics(size_t in_size, void * out_data, size_t * out_size_ret) const
+{
+    //a size query takes the snapshot the following fill copies out, so the size
+    //stays valid even if more kernels complete in between
+    if (!out_data || !m_kernel_statistics_pending)
+    {
+        Baikal::RenderStatistics stats;
+        GetStatistics(stats);
+
+        m_kernel_statistics.clear();
+        for (auto& time : stats.kernel_times)
+        {
+            rpr_baikal_kernel_statistics ks;
+            memset(&ks, 0, sizeof(rpr_baikal_kernel_statistics));
+            strncpy(ks.name, time.first.c_str(), RPR_BAIKAL_KERNEL_NAME_LENGTH - 1);
+            ks.time = time.second.time;
+            ks.num_launches = time.second.num_launches;
+            m_kernel_statistics.push_back(ks);
+        }
+    }
+    m_kernel_statistics_pending = !out_data;
+
+    auto size = m_kernel_statistics.size() * sizeof(rpr_baikal_kernel_statistics);
+    if (out_size_ret)
+    {
+        *out_size_ret = size;
+    }
+
+    if (out_data)
+    {
+        if (in_size < size)
+        {
+            return RPR_ERROR_INVALID_PARAMETER;
+        }
+
+        if (size > 0)
+        {
+            memcpy(out_data, m_kernel_statistics.data(), size);
+        }
+    }
+    return RPR_SUCCESS;
 }
 
 void ContextObject::SetAOV(rpr_int in_aov, FramebufferObject* buffer)
@@ -361,6 +495,7 @@ void ContextObject::SetParameter(const std::string& input, const std::string& va
 void ContextObject::PrepareScene()
 {
     m_current_scene->AddEmissive();
+    m_current_scene->GetScene()->SetLightSamplingMode(m_light_sampling_mode);
 
     //if (m_current_scene->IsDirty())
     {
@@ -26,10 +26,12 @@ THE SOFTWARE.
 
 #include "Utils/config_manager.h"
 #include "Renderers/monte_carlo_renderer.h"
+#include "SceneGraph/scene1.h"
 
 #include <vector>
 #include "RadeonProRender.h"
 #include "RadeonProRender_GL.h"
+#include "RadeonProRender_Baikal.h"
 
 class TextureObject;
 class FramebufferObject;
@@ -51,7 +53,13 @@ public:
     void SetCurrenScene(SceneObject* scene) { m_current_scene = scene; }
     
     //context info
-    void GetRenderStatistics(void * out_data, size_t * out_size_ret) const;
+    rpr_int GetRenderStatistics(void * out_data, size_t * out_size_ret) const;
+    rpr_int GetBaikalRenderStatistics(void * out_data, size_t * out_size_ret) const;
+    rpr_int GetBaikalKernelStatistics(size_t in_size, void * out_data, size_t * out_size_ret) const;
+    //per bounce counts and kernel times are only collected once enabled
+    void SetStatisticsEnabled(bool enabled);
+    //light selection mode, applied to the current scene before rendering
+    void SetLightSamplingMode(Baikal::Scene1::LightSamplingMode mode) { m_light_sampling_mode = mode; }
     void SetParameter(const std::string& input, float x, float y = 0.f, float z = 0.f, float w = 0.f);
     void SetParameter(const std::string& input, const std::string& value);
 
@@ -83,6 +91,9 @@ public:
 private:
     void PrepareScene();
 
+    //statistics of all render configs
+    void GetStatistics(Baikal::RenderStatistics& stats) const;
+
     //after render update
     void PostRender();
 
@@ -91,4 +102,8 @@ private:
     //know framefubbers used as AOV outputs
     std::set<FramebufferObject*> m_output_framebuffers;
     SceneObject* m_current_scene;
+    //kernel statistics taken by a size query, returned by the following fill
+    mutable std::vector<rpr_baikal_kernel_statistics> m_kernel_statistics;
+    mutable bool m_kernel_statistics_pending;
+    Baikal::Scene1::LightSamplingMode m_light_sampling_mode;
 };